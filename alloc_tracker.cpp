@@ -0,0 +1,204 @@
+#include "alloc_tracker.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+static const int MAX_TAGS = 64;
+
+static atomic<bool> G_TRACKING(false);
+static atomic<uint64_t> G_ALLOCATIONS(0);
+static atomic<uint64_t> G_ALLOCATED_BYTES(0);
+static atomic<uint64_t> G_FREES(0);
+
+// 标签槽位只增不减, 地址固定, 热路径上不加锁
+static AllocTagStats G_TAGS[MAX_TAGS];
+static atomic<int> G_TAG_COUNT(0);
+static mutex G_TAG_LOCK;
+
+static thread_local AllocTagStats *G_CURRENT_TAG = nullptr;
+static thread_local bool G_PAUSED = false;
+
+static void countAllocation(size_t size) {
+    if (G_TRACKING.load(memory_order_relaxed) && !G_PAUSED) {
+        G_ALLOCATIONS.fetch_add(1, memory_order_relaxed);
+        G_ALLOCATED_BYTES.fetch_add(size, memory_order_relaxed);
+        if (G_CURRENT_TAG) {
+            G_CURRENT_TAG->allocations.fetch_add(1, memory_order_relaxed);
+            G_CURRENT_TAG->bytes.fetch_add(size, memory_order_relaxed);
+        }
+    }
+}
+
+static void countFree(void *p) {
+    if (p && G_TRACKING.load(memory_order_relaxed) && !G_PAUSED) {
+        G_FREES.fetch_add(1, memory_order_relaxed);
+        if (G_CURRENT_TAG) {
+            G_CURRENT_TAG->frees.fetch_add(1, memory_order_relaxed);
+        }
+    }
+}
+
+static void *alignedAlloc(size_t size, size_t align) {
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, align);
+#else
+    // aligned_alloc 要求大小是对齐的整数倍
+    return aligned_alloc(align, ((size ? size : 1) + align - 1) / align * align);
+#endif
+}
+
+void *operator new(size_t size) {
+    countAllocation(size);
+    void *p = malloc(size ? size : 1);
+    if (nullptr == p) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+// 标准库的 nothrow 版本一般会转调上面的, 但 sanitizer 之类会自己接管, 这里一起换掉, 分配和释放才配得上
+void *operator new(size_t size, const nothrow_t &) noexcept {
+    countAllocation(size);
+    return malloc(size ? size : 1);
+}
+
+void operator delete(void *p) noexcept {
+    countFree(p);
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    ::operator delete(p);
+}
+
+void operator delete(void *p, const nothrow_t &) noexcept {
+    ::operator delete(p);
+}
+
+// alignas 超过 __STDCPP_DEFAULT_NEW_ALIGNMENT__ 的类型 (比如按缓存行对齐的计数器) 走这一组
+void *operator new(size_t size, align_val_t alignment) {
+    countAllocation(size);
+    void *p = alignedAlloc(size, (size_t) alignment);
+    if (nullptr == p) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void *operator new(size_t size, align_val_t alignment, const nothrow_t &) noexcept {
+    countAllocation(size);
+    return alignedAlloc(size, (size_t) alignment);
+}
+
+void operator delete(void *p, align_val_t) noexcept {
+    countFree(p);
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+void operator delete(void *p, size_t, align_val_t alignment) noexcept {
+    ::operator delete(p, alignment);
+}
+
+void operator delete(void *p, align_val_t alignment, const nothrow_t &) noexcept {
+    ::operator delete(p, alignment);
+}
+
+void setAllocTracking(bool on) {
+    G_TRACKING.store(on, memory_order_relaxed);
+}
+
+bool allocTracking() {
+    return G_TRACKING.load(memory_order_relaxed);
+}
+
+AllocTotals allocTotals() {
+    return {G_ALLOCATIONS.load(memory_order_relaxed), G_ALLOCATED_BYTES.load(memory_order_relaxed),
+            G_FREES.load(memory_order_relaxed)};
+}
+
+AllocTagStats *allocTag(const char *name) {
+    int count = G_TAG_COUNT.load(memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        if (G_TAGS[i].name == name || strcmp(G_TAGS[i].name, name) == 0) {
+            return &G_TAGS[i];
+        }
+    }
+    lock_guard<mutex> guard(G_TAG_LOCK);
+    count = G_TAG_COUNT.load(memory_order_relaxed);
+    for (int i = 0; i < count; ++i) {
+        if (strcmp(G_TAGS[i].name, name) == 0) {
+            return &G_TAGS[i];
+        }
+    }
+    if (count == MAX_TAGS) {
+        return nullptr;
+    }
+    G_TAGS[count].name = name;
+    G_TAG_COUNT.store(count + 1, memory_order_release);
+    return &G_TAGS[count];
+}
+
+string allocReport() {
+    // 报告本身的分配不计入任何标签
+    AllocPause pause;
+    string out;
+    char line[256];
+    snprintf(line, sizeof(line), "%-24s %10s %10s %12s %14s %12s %12s %12s\n", "path", "calls", "rows",
+             "allocs", "bytes", "allocs/row", "bytes/row", "allocs/call");
+    out += line;
+    int count = G_TAG_COUNT.load(memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        const AllocTagStats &tag = G_TAGS[i];
+        uint64_t calls = tag.calls.load(memory_order_relaxed);
+        uint64_t rows = tag.rows.load(memory_order_relaxed);
+        uint64_t allocations = tag.allocations.load(memory_order_relaxed);
+        uint64_t bytes = tag.bytes.load(memory_order_relaxed);
+        snprintf(line, sizeof(line), "%-24s %10llu %10llu %12llu %14llu %12.2f %12.1f %12.2f\n", tag.name,
+                 (unsigned long long) calls, (unsigned long long) rows, (unsigned long long) allocations,
+                 (unsigned long long) bytes, rows ? (double) allocations / (double) rows : 0,
+                 rows ? (double) bytes / (double) rows : 0, calls ? (double) allocations / (double) calls : 0);
+        out += line;
+    }
+    AllocTotals totals = allocTotals();
+    snprintf(line, sizeof(line), "total: %llu allocations, %llu bytes, %llu frees\n",
+             (unsigned long long) totals.allocations, (unsigned long long) totals.bytes,
+             (unsigned long long) totals.frees);
+    out += line;
+    return out;
+}
+
+AllocScope::AllocScope(const char *name) : tag(nullptr), previous(G_CURRENT_TAG) {
+    if (!G_TRACKING.load(memory_order_relaxed)) {
+        return;
+    }
+    tag = allocTag(name);
+    if (tag) {
+        tag->calls.fetch_add(1, memory_order_relaxed);
+        G_CURRENT_TAG = tag;
+    }
+}
+
+AllocScope::~AllocScope() {
+    G_CURRENT_TAG = previous;
+}
+
+AllocPause::AllocPause() : previous(G_PAUSED) {
+    G_PAUSED = true;
+}
+
+AllocPause::~AllocPause() {
+    G_PAUSED = previous;
+}
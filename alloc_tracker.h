@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * Counters of one tagged code path. rows/calls come from the scopes, the
+ * rest from the program's operator new/delete while a scope with this tag
+ * is innermost on the thread.
+ */
+struct AllocTagStats {
+    const char *name = nullptr;
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> rows{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> frees{0};
+};
+
+struct AllocTotals {
+    uint64_t allocations;
+    uint64_t bytes;
+    uint64_t frees;
+};
+
+/**
+ * Allocation accounting. alloc_tracker.cpp replaces the global operator
+ * new/delete, plain and over-aligned, throwing and nothrow (still
+ * malloc/free and aligned_alloc underneath); the standard library's array
+ * forms forward to these. With tracking off they only add a relaxed load
+ * and a thread-local read. With it on, every allocation is counted in the
+ * process totals and in the tag of the innermost AllocScope on the calling
+ * thread.
+ */
+void setAllocTracking(bool on);
+
+bool allocTracking();
+
+/**
+ * Process-wide counts since tracking was switched on.
+ */
+AllocTotals allocTotals();
+
+/**
+ * The tag's counters, created on first use (name must outlive the process,
+ * normally a literal). At most 64 tags; after that this returns nullptr.
+ */
+AllocTagStats *allocTag(const char *name);
+
+/**
+ * Per-tag table: calls, rows, allocations, bytes, allocations/row,
+ * bytes/row, allocations/call.
+ */
+std::string allocReport();
+
+/**
+ * Tags the allocations of its thread from construction to destruction:
+ *
+ *   AllocScope alloc("printResultSet");
+ *   ... alloc.addRows(rows);
+ *
+ * Scopes nest; the innermost one gets the counts.
+ */
+class AllocScope {
+public:
+    explicit AllocScope(const char *name);
+
+    ~AllocScope();
+
+    void addRows(uint64_t n) {
+        if (tag) {
+            tag->rows.fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    AllocScope(const AllocScope &) = delete;
+
+    AllocScope &operator=(const AllocScope &) = delete;
+
+private:
+    AllocTagStats *tag;
+    AllocTagStats *previous;
+};
+
+/**
+ * Stops counting on this thread until destroyed, for work that stands in for
+ * a client library's own heap (the stand-in's server side).
+ */
+class AllocPause {
+public:
+    AllocPause();
+
+    ~AllocPause();
+
+    AllocPause(const AllocPause &) = delete;
+
+    AllocPause &operator=(const AllocPause &) = delete;
+
+private:
+    bool previous;
+};
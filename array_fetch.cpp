@@ -0,0 +1,235 @@
+#include "array_fetch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "batch_controller.h"
+#include "memory_governor.h"
+#include "latency_histogram.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+// SQLT_IBFLOAT, SQLT_IBDOUBLE: 二进制浮点, 放进 double 不丢精度
+static bool binaryFloatType(int type) {
+    return type == 100 || type == 101;
+}
+
+// SQLT_CHR, SQLT_AFC, SQLT_VCS, SQLT_AVC: 数据长度就是显示长度
+static bool characterType(int type) {
+    return type == 1 || type == 96 || type == 9 || type == 97;
+}
+
+/**
+ * Text width (without the '\0') a non-character column needs when the
+ * server converts it to a string. ATTR_DATA_SIZE is its internal size:
+ * 22 for NUMBER, 7 for DATE, 11 for TIMESTAMP, n for RAW(n).
+ */
+static unsigned int displayWidth(int type, int size) {
+    switch (type) {
+        case 2:     // NUMBER: 40 位有效数字, 加符号、小数点和指数
+        case 4:
+            return 64;
+        case 12:    // DATE/TIMESTAMP/INTERVAL 按会话的 NLS 格式转换, 带时区名时最长;
+        case 180:   // 描述里是 180-183/231, 定义类型里是 184-190/232, 两套都认
+        case 181:
+        case 182:
+        case 183:
+        case 231:
+        case 184:
+        case 185:
+        case 186:
+        case 187:
+        case 188:
+        case 189:
+        case 190:
+        case 232:
+            return 128;
+        case 23:    // RAW(n): 每字节两个十六进制字符
+            return (unsigned int) std::max(size, 1) * 2;
+        default:
+            return std::max(64u, (unsigned int) std::max(size, 0) * 2);
+    }
+}
+
+// 预算再紧也至少给这么多行 (请求本身更少时按请求)
+static const unsigned int MIN_GRANT_ROWS = 16;
+
+ArrayFetcher::ArrayFetcher(ResultSet *rs, unsigned int batchRows, uint64_t fingerprint, unsigned int maxWidth,
+                           MemoryLease *lease)
+        : rs(rs), controller(nullptr), ownLease(lease ? nullptr : new MemoryLease(fingerprint)),
+          lease(lease ? lease : ownLease.get()), wanted(std::max(1u, batchRows)), batch(0),
+          fingerprint(fingerprint), done(false), columns(arena.resource()) {
+    describe(maxWidth);
+    bind(wanted);
+}
+
+ArrayFetcher::ArrayFetcher(ResultSet *rs, BatchSizeController &controller, uint64_t fingerprint,
+                           unsigned int maxWidth, MemoryLease *lease)
+        : rs(rs), controller(&controller), ownLease(lease ? nullptr : new MemoryLease(fingerprint)),
+          lease(lease ? lease : ownLease.get()), wanted(controller.rows()), batch(0), fingerprint(fingerprint),
+          done(false), columns(arena.resource()) {
+    describe(maxWidth);
+    controller.setRowBytes(rowBytes());
+    bind(wanted);
+}
+
+ArrayFetcher::~ArrayFetcher() {
+    lease->release((size_t) batch * std::max<size_t>(1, rowBytes()));
+}
+
+void ArrayFetcher::describe(unsigned int maxWidth) {
+    // OCCI 只给 std::vector/std::string, 这里只活到把名字拷进 arena 为止
+    vector<MetaData> metaData = rs->getColumnListMetaData();
+    columns.reserve(metaData.size());
+    for (size_t i = 0; i < metaData.size(); ++i) {
+        columns.emplace_back(arena.resource());
+        Column &c = columns.back();
+        c.name = metaData[i].getString(MetaData::ATTR_NAME);
+        int type = metaData[i].getInt(MetaData::ATTR_DATA_TYPE);
+        int size = metaData[i].getInt(MetaData::ATTR_DATA_SIZE);
+        c.numeric = binaryFloatType(type);
+        if (c.numeric) {
+            c.width = sizeof(double);
+        } else {
+            // NUMBER/DATE 等也取成文本: 转成 double 会丢掉 15 位以后的有效数字
+            unsigned int width = characterType(type) ? (size > 0 ? (unsigned int) size : maxWidth)
+                                                     : displayWidth(type, size);
+            // 多留一个字节给结尾的 '\0'
+            c.width = std::min(maxWidth, width) + 1;
+        }
+    }
+}
+
+void ArrayFetcher::bind(unsigned int rows) {
+    rows = std::max(1u, rows);
+    if (rows == batch) {
+        return;
+    }
+    // 没有列时也按每行 1 字节记, 免得除零
+    size_t perRow = std::max<size_t>(1, rowBytes());
+    if (rows > batch) {
+        unsigned int floor = std::max(batch, std::min(rows, MIN_GRANT_ROWS));
+        size_t granted = lease->reserve((size_t) (rows - batch) * perRow, (size_t) (floor - batch) * perRow);
+        unsigned int extra = (unsigned int) (granted / perRow);
+        lease->release(granted - (size_t) extra * perRow);
+        rows = batch + extra;
+        if (rows == batch) {
+            return;
+        }
+    } else {
+        lease->release((size_t) (batch - rows) * perRow);
+    }
+    // 变小时也真的还内存, 否则内存上限形同虚设
+    bool shrink = rows * 2 < batch;
+    batch = rows;
+    for (size_t i = 0; i < columns.size(); ++i) {
+        Column &c = columns[i];
+        c.ind.resize(batch);
+        c.length.resize(batch);
+        if (c.numeric) {
+            c.numbers.resize(batch);
+        } else {
+            c.chars.resize((size_t) c.width * batch);
+        }
+        if (shrink) {
+            c.ind.shrink_to_fit();
+            c.length.shrink_to_fit();
+            c.numbers.shrink_to_fit();
+            c.chars.shrink_to_fit();
+        }
+        unsigned int col = (unsigned int) i + 1;
+        if (c.numeric) {
+            rs->setDataBuffer(col, c.numbers.data(), OCCIFLOAT, sizeof(double), c.length.data(), c.ind.data());
+        } else {
+            rs->setDataBuffer(col, c.chars.data(), OCCI_SQLT_STR, (sb4) c.width, c.length.data(), c.ind.data());
+        }
+    }
+}
+
+unsigned int ArrayFetcher::next() {
+    if (done) {
+        return 0;
+    }
+    if (controller) {
+        wanted = controller->rows();
+    }
+    // 上一批因为预算缩过的话, 这一批再试着长回去
+    bind(wanted);
+    auto start = chrono::steady_clock::now();
+    ResultSet::Status status = dbCall(DbOp::NEXT, fingerprint, [&] { return rs->next(batch); });
+    unsigned int rows = rs->getNumArrayRows();
+    if (controller) {
+        controller->observe(rows, (uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+                chrono::steady_clock::now() - start).count());
+    }
+    // 最后一批不满 batch 行时返回 END_OF_FETCH, 但这批数据仍然有效
+    if (status == ResultSet::END_OF_FETCH) {
+        done = true;
+    }
+    return rows;
+}
+
+double ArrayFetcher::number(unsigned int row, unsigned int col) const {
+    const Column &c = columns[col - 1];
+    return c.numeric ? c.numbers[row] : strtod(text(row, col), nullptr);
+}
+
+const char *ArrayFetcher::text(unsigned int row, unsigned int col) const {
+    const Column &c = columns[col - 1];
+    return c.numeric ? "" : c.chars.data() + (size_t) row * c.width;
+}
+
+// 数值按 getString 的样子格式化, 返回写入的长度
+static int formatNumber(double n, char (&value)[64]) {
+    if (n == (double) (long long) n && n < 1e15 && n > -1e15) {
+        return snprintf(value, sizeof(value), "%lld", (long long) n);
+    }
+    return snprintf(value, sizeof(value), "%.15g", n);
+}
+
+string ArrayFetcher::getString(unsigned int row, unsigned int col) const {
+    const Column &c = columns[col - 1];
+    if (c.ind[row] == -1) {
+        return "";
+    }
+    if (!c.numeric) {
+        return text(row, col);
+    }
+    char value[64];
+    int n = formatNumber(c.numbers[row], value);
+    return string(value, (size_t) n);
+}
+
+std::pmr::string ArrayFetcher::getString(unsigned int row, unsigned int col,
+                                         std::pmr::memory_resource *resource) const {
+    const Column &c = columns[col - 1];
+    if (c.ind[row] == -1) {
+        return std::pmr::string(resource);
+    }
+    if (!c.numeric) {
+        return std::pmr::string(text(row, col), resource);
+    }
+    char value[64];
+    int n = formatNumber(c.numbers[row], value);
+    return std::pmr::string(value, (size_t) n, resource);
+}
+
+size_t ArrayFetcher::bufferBytes() const {
+    size_t bytes = 0;
+    for (const auto &c: columns) {
+        bytes += c.numbers.size() * sizeof(double) + c.chars.size() + c.length.size() * sizeof(ub2) +
+                 c.ind.size() * sizeof(sb2);
+    }
+    return bytes;
+}
+
+size_t ArrayFetcher::rowBytes() const {
+    size_t bytes = 0;
+    for (const auto &c: columns) {
+        bytes += c.width + sizeof(ub2) + sizeof(sb2);
+    }
+    return bytes;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "occi_common.h"
+#include "query_arena.h"
+
+class BatchSizeController;
+
+class MemoryLease;
+
+/**
+ * Fetches a result set `batchRows` rows per round trip into column arrays
+ * bound with ResultSet::setDataBuffer, instead of one next() per row.
+ *
+ * BINARY_FLOAT/BINARY_DOUBLE columns land in double arrays, everything
+ * else in NUL-terminated char arrays (capped at maxWidth): character
+ * columns sized from their data size, NUMBER, DATE, TIMESTAMP and RAW
+ * from the width of their text form, so the server converts them exactly
+ * as getString() would. Values are valid until the following next().
+ *
+ *   ArrayFetcher fetcher(rs, 100, fp);
+ *   while (unsigned int n = fetcher.next()) {
+ *       for (unsigned int r = 0; r < n; ++r) ... fetcher.text(r, 1) ...
+ *   }
+ *
+ * With a BatchSizeController the batch length follows controller.rows():
+ * the arrays are resized and bound again between batches, and every
+ * next() reports its rows and time back to the controller.
+ *
+ * The arrays are reserved from the MemoryGovernor, on the given lease or
+ * on one of the fetcher's own. When the budget is tight a batch gets fewer
+ * rows than asked for (at least min(asked, 16)), and later batches try to
+ * grow back.
+ *
+ * Column names and descriptors live in an arena inside the fetcher, and
+ * getString() can format into a caller's arena, so a fetch loop does not
+ * allocate per column or per cell.
+ */
+class ArrayFetcher {
+public:
+    ArrayFetcher(oracle::occi::ResultSet *rs, unsigned int batchRows, uint64_t fingerprint = 0,
+                 unsigned int maxWidth = 4000, MemoryLease *lease = nullptr);
+
+    ArrayFetcher(oracle::occi::ResultSet *rs, BatchSizeController &controller, uint64_t fingerprint = 0,
+                 unsigned int maxWidth = 4000, MemoryLease *lease = nullptr);
+
+    ~ArrayFetcher();
+
+    ArrayFetcher(const ArrayFetcher &) = delete;
+
+    ArrayFetcher &operator=(const ArrayFetcher &) = delete;
+
+    /**
+     * Fetches the next batch, returns its row count (0 once the result set is done).
+     */
+    unsigned int next();
+
+    unsigned int columnCount() const { return (unsigned int) columns.size(); }
+
+    unsigned int batchRows() const { return batch; }
+
+    const std::pmr::string &columnName(unsigned int col) const { return columns[col - 1].name; }
+
+    /**
+     * Whether the column is fetched into a double array (BINARY_FLOAT/DOUBLE).
+     */
+    bool isNumeric(unsigned int col) const { return columns[col - 1].numeric; }
+
+    /**
+     * col is 1-based like OCCI, row is the index inside the current batch.
+     */
+    bool isNull(unsigned int row, unsigned int col) const { return columns[col - 1].ind[row] == -1; }
+
+    /**
+     * The value as a double; text columns (NUMBER included) are parsed.
+     */
+    double number(unsigned int row, unsigned int col) const;
+
+    /**
+     * Text column value; double columns have no text, use getString().
+     */
+    const char *text(unsigned int row, unsigned int col) const;
+
+    /**
+     * The value as ResultSet::getString would return it.
+     */
+    std::string getString(unsigned int row, unsigned int col) const;
+
+    /**
+     * The same, allocated from resource (e.g. a QueryArena reset per row).
+     */
+    std::pmr::string getString(unsigned int row, unsigned int col, std::pmr::memory_resource *resource) const;
+
+    /**
+     * Bytes held by the column arrays.
+     */
+    size_t bufferBytes() const;
+
+    /**
+     * Buffer bytes per row of the batch.
+     */
+    size_t rowBytes() const;
+
+private:
+    struct Column {
+        explicit Column(std::pmr::memory_resource *resource) : name(resource) {}
+
+        std::pmr::string name;
+        bool numeric = false;
+        unsigned int width = 0;
+        std::vector<double> numbers;
+        std::vector<char> chars;
+        std::vector<ub2> length;
+        std::vector<sb2> ind;
+    };
+
+    void describe(unsigned int maxWidth);
+
+    void bind(unsigned int rows);
+
+    oracle::occi::ResultSet *rs;
+    BatchSizeController *controller;
+    std::unique_ptr<MemoryLease> ownLease;
+    MemoryLease *lease;
+    // 想要的行数; 预算紧时 batch 可能比它小
+    unsigned int wanted;
+    unsigned int batch;
+    uint64_t fingerprint;
+    bool done;
+    // 先于 columns 构造, 晚于它析构
+    QueryArena arena;
+    std::pmr::vector<Column> columns;
+};
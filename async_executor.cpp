@@ -0,0 +1,336 @@
+#include "async_executor.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "logger.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+AsyncExecutor::AsyncExecutor(Environment *env, unsigned int loops) : env(env), loopCount(loops ? loops : 1) {}
+
+AsyncExecutor::~AsyncExecutor() {
+    stop();
+}
+
+bool AsyncExecutor::addConnection(Connection *conn) {
+    if (nullptr == conn || running) {
+        return false;
+    }
+    connections.push_back(conn);
+    return true;
+}
+
+bool AsyncExecutor::start() {
+    if (running || connections.empty()) {
+        return false;
+    }
+    vector<unique_ptr<Slot>> ready;
+    for (size_t i = 0; i < connections.size(); ++i) {
+        unique_ptr<Slot> slot(new Slot());
+        slot->conn = connections[i];
+        slot->session.reset(new DbSession(env, connections[i]));
+        DbResult<void> mode = slot->session->setNonBlocking(true);
+        if (!mode) {
+            logError("async session %zu: non-blocking mode failed, error number %d: %s", i, mode.code(),
+                     mode.error().message);
+            continue;
+        }
+        slot->stmt.reset(new DbStatement(*slot->session));
+        ready.push_back(std::move(slot));
+    }
+    if (ready.empty()) {
+        return false;
+    }
+    sessions = (unsigned int) ready.size();
+    // 会话轮流分给各个事件循环, 之后只由那个线程碰它
+    unsigned int count = std::min<unsigned int>(loopCount, (unsigned int) ready.size());
+    for (unsigned int i = 0; i < count; ++i) {
+        loops.emplace_back(new Loop());
+    }
+    for (size_t i = 0; i < ready.size(); ++i) {
+        loops[i % count]->slots.push_back(std::move(ready[i]));
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        running = true;
+        stopping = false;
+    }
+    for (auto &loop: loops) {
+        Loop *current = loop.get();
+        loop->worker = thread([this, current] { runLoop(*current); });
+    }
+    logInfo("async executor: %zu sessions on %u event loops", ready.size(), count);
+    return true;
+}
+
+void AsyncExecutor::stop() {
+    {
+        lock_guard<mutex> guard(lock);
+        if (!running) {
+            return;
+        }
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &loop: loops) {
+        if (loop->worker.joinable()) {
+            loop->worker.join();
+        }
+        for (auto &slot: loop->slots) {
+            // 语句句柄先还掉, 再把连接切回阻塞模式交还调用方
+            slot->stmt.reset();
+            slot->session->setNonBlocking(false);
+        }
+    }
+    loops.clear();
+    sessions = 0;
+    lock_guard<mutex> guard(lock);
+    running = false;
+    stopping = false;
+}
+
+void AsyncExecutor::query(const string &sql, const vector<BindValue> &binds, unsigned int columns,
+                          AsyncCallback done, size_t width) {
+    Request request;
+    request.isQuery = true;
+    request.sql = sql;
+    request.binds = binds;
+    request.columns = columns;
+    request.width = width;
+    request.done = std::move(done);
+    submit(std::move(request));
+}
+
+future<AsyncResult> AsyncExecutor::query(const string &sql, const vector<BindValue> &binds, unsigned int columns,
+                                         size_t width) {
+    auto promised = make_shared<promise<AsyncResult>>();
+    future<AsyncResult> result = promised->get_future();
+    query(sql, binds, columns, [promised](AsyncResult &r) { promised->set_value(std::move(r)); }, width);
+    return result;
+}
+
+void AsyncExecutor::stream(const string &sql, const vector<BindValue> &binds, unsigned int columns,
+                           AsyncRowsCallback rows, AsyncCallback done, size_t width) {
+    Request request;
+    request.isQuery = true;
+    request.sql = sql;
+    request.binds = binds;
+    request.columns = columns;
+    request.width = width;
+    request.rows = std::move(rows);
+    request.done = std::move(done);
+    submit(std::move(request));
+}
+
+void AsyncExecutor::update(const string &sql, const vector<BindValue> &binds, bool commit, AsyncCallback done) {
+    Request request;
+    request.isQuery = false;
+    request.sql = sql;
+    request.binds = binds;
+    request.commit = commit;
+    request.done = std::move(done);
+    submit(std::move(request));
+}
+
+future<AsyncResult> AsyncExecutor::update(const string &sql, const vector<BindValue> &binds, bool commit) {
+    auto promised = make_shared<promise<AsyncResult>>();
+    future<AsyncResult> result = promised->get_future();
+    update(sql, binds, commit, [promised](AsyncResult &r) { promised->set_value(std::move(r)); });
+    return result;
+}
+
+void AsyncExecutor::submit(Request &&request) {
+    request.submitted = chrono::steady_clock::now();
+    {
+        lock_guard<mutex> guard(lock);
+        if (running && !stopping) {
+            queue.push_back(std::move(request));
+            queued.fetch_add(1, memory_order_release);
+            wake.notify_one();
+            return;
+        }
+    }
+    AsyncResult result;
+    result.error.code = OCI_ERROR;
+    snprintf(result.error.message, sizeof(result.error.message), "async executor is not running");
+    if (request.done) {
+        request.done(result);
+    }
+}
+
+bool AsyncExecutor::take(Request &request) {
+    // 空队列时不碰锁, 每个空闲会话每一轮都会问一次
+    if (0 == queued.load(memory_order_acquire)) {
+        return false;
+    }
+    lock_guard<mutex> guard(lock);
+    if (queue.empty()) {
+        return false;
+    }
+    request = std::move(queue.front());
+    queue.pop_front();
+    queued.fetch_sub(1, memory_order_release);
+    return true;
+}
+
+void AsyncExecutor::runLoop(Loop &loop) {
+    while (true) {
+        bool busy = false;
+        bool progressed = false;
+        for (auto &slot: loop.slots) {
+            if (slot->phase == Phase::IDLE) {
+                if (!take(slot->request)) {
+                    continue;
+                }
+                slot->phase = Phase::PREPARE;
+            }
+            busy = true;
+            if (step(*slot)) {
+                progressed = true;
+            } else {
+                pendingCount.fetch_add(1, memory_order_relaxed);
+            }
+        }
+        if (!busy) {
+            unique_lock<mutex> guard(lock);
+            if (queue.empty() && stopping) {
+                return;
+            }
+            wake.wait(guard, [this] { return !queue.empty() || stopping; });
+            continue;
+        }
+        if (!progressed) {
+            if (pollInterval.count() > 0) {
+                this_thread::sleep_for(pollInterval);
+            } else {
+                this_thread::yield();
+            }
+        }
+    }
+}
+
+bool AsyncExecutor::step(Slot &slot) {
+    Request &request = slot.request;
+    DbStatement &stmt = *slot.stmt;
+    switch (slot.phase) {
+        case Phase::PREPARE: {
+            DbResult<void> prepared = stmt.prepare(request.sql);
+            if (prepared.pending()) {
+                return false;
+            }
+            if (!prepared) {
+                finish(slot, &prepared.error());
+                return true;
+            }
+            for (const auto &bind: request.binds) {
+                DbResult<void> bound;
+                switch (bind.type) {
+                    case BindType::INT:
+                        bound = stmt.bind(bind.index, bind.i);
+                        break;
+                    case BindType::DOUBLE:
+                        bound = stmt.bind(bind.index, bind.d);
+                        break;
+                    case BindType::STRING:
+                        bound = stmt.bind(bind.index, bind.s);
+                        break;
+                    default:
+                        bound = stmt.bindNull(bind.index);
+                        break;
+                }
+                if (!bound) {
+                    finish(slot, &bound.error());
+                    return true;
+                }
+            }
+            for (unsigned int i = 1; request.isQuery && i <= request.columns; ++i) {
+                DbResult<void> defined = stmt.defineString(i, request.width);
+                if (!defined) {
+                    finish(slot, &defined.error());
+                    return true;
+                }
+            }
+            slot.phase = Phase::EXECUTE;
+            return true;
+        }
+        case Phase::EXECUTE:
+            if (request.isQuery) {
+                DbResult<void> executed = stmt.executeQuery();
+                if (executed.pending()) {
+                    return false;
+                }
+                if (!executed) {
+                    finish(slot, &executed.error());
+                    return true;
+                }
+                slot.phase = Phase::FETCH;
+            } else {
+                DbResult<unsigned int> rows = stmt.executeUpdate(request.commit);
+                if (rows.pending()) {
+                    return false;
+                }
+                if (!rows) {
+                    finish(slot, &rows.error());
+                    return true;
+                }
+                slot.result.rowCount = rows.value();
+                finish(slot, nullptr);
+            }
+            return true;
+        case Phase::FETCH:
+            // 一次最多取 fetchBatch 行, 大结果集不至于饿着同一线程上的其他会话
+            for (unsigned int n = 0; n < fetchBatch; ++n) {
+                DbResult<bool> fetched = stmt.fetch();
+                if (fetched.pending()) {
+                    deliverRows(slot);
+                    return n > 0;
+                }
+                if (!fetched) {
+                    finish(slot, &fetched.error());
+                    return true;
+                }
+                if (!fetched.value()) {
+                    finish(slot, nullptr);
+                    return true;
+                }
+                vector<string> row;
+                row.reserve(request.columns);
+                for (unsigned int i = 1; i <= request.columns; ++i) {
+                    row.emplace_back(stmt.text(i));
+                }
+                slot.result.rows.push_back(std::move(row));
+                ++slot.result.rowCount;
+            }
+            deliverRows(slot);
+            return true;
+        default:
+            return false;
+    }
+}
+
+void AsyncExecutor::deliverRows(Slot &slot) {
+    if (slot.request.rows && !slot.result.rows.empty()) {
+        slot.request.rows(slot.result.rows);
+        slot.result.rows.clear();
+    }
+}
+
+void AsyncExecutor::finish(Slot &slot, const DbError *error) {
+    deliverRows(slot);
+    AsyncResult &result = slot.result;
+    result.ok = nullptr == error;
+    if (error) {
+        result.error = *error;
+    }
+    result.elapsedNs = (uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now() - slot.request.submitted).count();
+    completedCount.fetch_add(1, memory_order_relaxed);
+    if (slot.request.done) {
+        slot.request.done(result);
+    }
+    slot.result = AsyncResult();
+    slot.request = Request();
+    slot.phase = Phase::IDLE;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db_result.h"
+#include "occi_common.h"
+#include "statement_probe.h"
+
+/**
+ * Outcome of one asynchronous statement. rows holds every row of a query as
+ * strings; rowCount is the rows fetched or, for DML, the rows affected.
+ * elapsedNs counts from submission, so it includes the wait for a session.
+ */
+struct AsyncResult {
+    bool ok = false;
+    DbError error;
+    unsigned int rowCount = 0;
+    std::vector<std::vector<std::string>> rows;
+    uint64_t elapsedNs = 0;
+};
+
+/**
+ * Runs on the event-loop thread that finished the statement; keep it short
+ * and do not block in it, every other session of that loop waits meanwhile.
+ */
+typedef std::function<void(AsyncResult &)> AsyncCallback;
+
+/**
+ * A batch of rows of a streamed query, on the event-loop thread like
+ * AsyncCallback; the callee may move the rows out.
+ */
+typedef std::function<void(std::vector<std::vector<std::string>> &)> AsyncRowsCallback;
+
+/**
+ * Drives many sessions from a few threads with OCI non-blocking mode.
+ *
+ * Each connection added is switched to OCI_ATTR_NONBLOCKING_MODE and given
+ * to one of `loops` event-loop threads. A loop takes submitted statements
+ * off a shared queue for its idle sessions, then polls every busy session in
+ * turn: execute and fetch calls return OCI_STILL_EXECUTING while the server
+ * works and are repeated with the same arguments until they complete, so one
+ * thread keeps a round trip in flight on each of its sessions. OCI offers no
+ * readiness descriptor for a pending call, so a pass in which no session
+ * made progress is followed by a short sleep (setPollInterval).
+ *
+ *   AsyncExecutor executor(env, 2);
+ *   executor.addConnection(env->createConnection(user, pass, connect));
+ *   executor.start();
+ *   std::future<AsyncResult> r = executor.query("SELECT name FROM t WHERE id = :1", {{1, BindType::INT, 7}}, 1);
+ *
+ * Connections stay the caller's: they are used by the executor alone until
+ * stop(), which puts them back in blocking mode.
+ */
+class AsyncExecutor {
+public:
+    AsyncExecutor(oracle::occi::Environment *env, unsigned int loops = 1);
+
+    ~AsyncExecutor();
+
+    AsyncExecutor(const AsyncExecutor &) = delete;
+
+    AsyncExecutor &operator=(const AsyncExecutor &) = delete;
+
+    /**
+     * Before start(); connections that refuse non-blocking mode are left out
+     * there (and logged).
+     */
+    bool addConnection(oracle::occi::Connection *conn);
+
+    /**
+     * Sleep after a pass without progress; 0 = yield instead. Before start().
+     */
+    void setPollInterval(std::chrono::microseconds interval) { pollInterval = interval; }
+
+    /**
+     * Rows fetched per session before the loop moves on to the next one.
+     */
+    void setFetchBatch(unsigned int rows) { fetchBatch = rows ? rows : 1; }
+
+    bool start();
+
+    /**
+     * Finishes every statement already submitted, then stops the loops.
+     */
+    void stop();
+
+    /**
+     * Fetches `columns` columns as strings of up to `width` characters.
+     */
+    void query(const std::string &sql, const std::vector<BindValue> &binds, unsigned int columns,
+               AsyncCallback done, size_t width = 256);
+
+    std::future<AsyncResult> query(const std::string &sql, const std::vector<BindValue> &binds,
+                                   unsigned int columns, size_t width = 256);
+
+    /**
+     * Like query(), but rows are handed to `rows` in batches of up to
+     * setFetchBatch() as they arrive; `done` then gets the row count and
+     * status with no rows in it.
+     */
+    void stream(const std::string &sql, const std::vector<BindValue> &binds, unsigned int columns,
+                AsyncRowsCallback rows, AsyncCallback done, size_t width = 256);
+
+    void update(const std::string &sql, const std::vector<BindValue> &binds, bool commit, AsyncCallback done);
+
+    std::future<AsyncResult> update(const std::string &sql, const std::vector<BindValue> &binds, bool commit);
+
+    /**
+     * Sessions the loops drive since start(): those that took non-blocking mode.
+     */
+    unsigned int sessionCount() const { return sessions; }
+
+    uint64_t completed() const { return completedCount.load(std::memory_order_relaxed); }
+
+    /**
+     * Calls that came back OCI_STILL_EXECUTING, i.e. polls of a pending call.
+     */
+    uint64_t stillExecuting() const { return pendingCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Request {
+        bool isQuery = true;
+        std::string sql;
+        std::vector<BindValue> binds;
+        unsigned int columns = 0;
+        size_t width = 0;
+        bool commit = false;
+        AsyncRowsCallback rows;
+        AsyncCallback done;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    enum class Phase {
+        IDLE,
+        PREPARE,
+        EXECUTE,
+        FETCH
+    };
+
+    struct Slot {
+        oracle::occi::Connection *conn = nullptr;
+        std::unique_ptr<DbSession> session;
+        std::unique_ptr<DbStatement> stmt;
+        Phase phase = Phase::IDLE;
+        Request request;
+        AsyncResult result;
+    };
+
+    struct Loop {
+        std::vector<std::unique_ptr<Slot>> slots;
+        std::thread worker;
+    };
+
+    void submit(Request &&request);
+
+    bool take(Request &request);
+
+    void runLoop(Loop &loop);
+
+    /**
+     * Advances one busy session; false when its call is still executing.
+     */
+    bool step(Slot &slot);
+
+    void deliverRows(Slot &slot);
+
+    void finish(Slot &slot, const DbError *error);
+
+    oracle::occi::Environment *env;
+    unsigned int loopCount;
+    std::vector<oracle::occi::Connection *> connections;
+    std::vector<std::unique_ptr<Loop>> loops;
+    unsigned int sessions = 0;
+    std::chrono::microseconds pollInterval{50};
+    unsigned int fetchBatch = 16;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<Request> queue;
+    std::atomic<size_t> queued{0};
+    bool running = false;
+    bool stopping = false;
+
+    std::atomic<uint64_t> completedCount{0};
+    std::atomic<uint64_t> pendingCount{0};
+};
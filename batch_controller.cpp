@@ -0,0 +1,124 @@
+#include "batch_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "logger.h"
+#include "sql_fingerprint.h"
+
+using namespace std;
+
+BatchSizeController::BatchSizeController(const string &name, const BatchTargets &targets)
+        : controllerName(name), targets(targets) {
+    this->targets.minRows = std::max(1u, targets.minRows);
+    this->targets.maxRows = std::max(this->targets.minRows, targets.maxRows);
+    this->targets.settleCalls = std::max(1u, targets.settleCalls);
+    current = std::min(std::max(targets.initialRows, this->targets.minRows), this->targets.maxRows);
+    shownRows = current;
+
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    string labels = metricLabel("controller", name);
+    resizeCounter = metrics.counter("oci_batch_resizes_total", labels);
+    gaugeIds.push_back(metrics.addGauge("oci_batch_rows", labels, [this] { return (double) rows(); }));
+    gaugeIds.push_back(metrics.addGauge("oci_batch_row_bytes", labels,
+                                        [this] { return (double) shownRowBytes.load(memory_order_relaxed); }));
+}
+
+BatchSizeController::~BatchSizeController() {
+    for (int id: gaugeIds) {
+        MetricsRegistry::instance().removeGauge(id);
+    }
+}
+
+unsigned int BatchSizeController::memoryRows() const {
+    if (0 == rowBytes) {
+        return targets.maxRows;
+    }
+    return (unsigned int) std::min<size_t>(targets.maxRows, std::max<size_t>(1, targets.memoryCeiling / rowBytes));
+}
+
+void BatchSizeController::setRowBytes(size_t bytes) {
+    lock_guard<mutex> guard(lock);
+    if (bytes == rowBytes) {
+        return;
+    }
+    rowBytes = bytes;
+    shownRowBytes.store(bytes, memory_order_relaxed);
+    // 内存上限不讲滞回, 超了立刻收
+    unsigned int cap = std::max(targets.minRows, memoryRows());
+    if (current > cap) {
+        apply(cap);
+    }
+}
+
+void BatchSizeController::observe(unsigned int rows, uint64_t callNs) {
+    lock_guard<mutex> guard(lock);
+    // 结果集最后不满的一批耗时偏低, 不当样本
+    if (0 == rows || (uint64_t) rows * 2 < current) {
+        return;
+    }
+    ++calls;
+    windowRows += rows;
+    windowNs += std::max<uint64_t>(1, callNs);
+    if (calls < targets.settleCalls) {
+        return;
+    }
+    double callNsAvg = (double) windowNs / calls;
+    double throughput = (double) windowRows * 1e9 / (double) windowNs;
+    calls = 0;
+    windowRows = 0;
+    windowNs = 0;
+
+    double target = chrono::duration<double, nano>(targets.callLatency).count();
+    double desired = current * target / callNsAvg;
+    desired = std::max(current / 2.0, std::min(current * 2.0, desired));
+    // 上次变大之后吞吐没怎么涨: round trip 已经摊薄了, 再大只是多占内存
+    if (grew && desired > current && throughput < lastThroughput * (1 + targets.minGain)) {
+        growthCap = current;
+    }
+    grew = false;
+
+    unsigned int upper = memoryRows();
+    if (growthCap) {
+        upper = std::min(upper, growthCap);
+    }
+    upper = std::max(targets.minRows, upper);
+    unsigned int next = std::max(targets.minRows, std::min(upper, (unsigned int) desired));
+    if (next == current || fabs((double) next - current) <= targets.hysteresis * current) {
+        return;
+    }
+    if (next < current) {
+        growthCap = 0;
+    } else {
+        grew = true;
+        lastThroughput = throughput;
+    }
+    apply(next);
+}
+
+void BatchSizeController::apply(unsigned int next) {
+    logDebug("batch %s: %u -> %u rows", controllerName.c_str(), current, next);
+    current = next;
+    shownRows.store(next, memory_order_relaxed);
+    resizeCount.fetch_add(1, memory_order_relaxed);
+    resizeCounter->add();
+}
+
+BatchControllers &BatchControllers::instance() {
+    static BatchControllers registry;
+    return registry;
+}
+
+BatchControllers::BatchControllers() {
+    // 先构造指标注册表, 它就比控制器晚析构, 控制器析构时还能摘掉仪表
+    MetricsRegistry::instance();
+}
+
+BatchSizeController &BatchControllers::forStatement(uint64_t fingerprint) {
+    lock_guard<mutex> guard(lock);
+    auto &controller = controllers[fingerprint];
+    if (!controller) {
+        controller.reset(new BatchSizeController(fingerprintHex(fingerprint)));
+    }
+    return *controller;
+}
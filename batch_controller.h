@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metrics.h"
+
+struct BatchTargets {
+    // 一次 round trip (next(N) / executeArrayUpdate(N)) 的目标耗时
+    std::chrono::microseconds callLatency{20000};
+    // 一批数据在列数组/绑定数组里最多占这么多字节
+    size_t memoryCeiling = 4 << 20;
+    unsigned int minRows = 1;
+    unsigned int maxRows = 10000;
+    unsigned int initialRows = 100;
+    // 算出来的批大小和当前相差超过这个比例才调整
+    double hysteresis = 0.25;
+    // 每次调整后至少观察这么多次满批的调用才做下一次决定
+    unsigned int settleCalls = 3;
+    // 变大一次吞吐提升不到这个比例就不再往上加
+    double minGain = 0.05;
+};
+
+/**
+ * Picks the batch length for array fetch (ResultSet::next(N)) and array
+ * DML (Statement::executeArrayUpdate(N)) online, from what the calls
+ * actually cost.
+ *
+ * Callers ask rows() before each call, size their buffers for it and report
+ * back with observe(). After settleCalls near-full calls the controller
+ * scales the batch by callLatency / measured call time, at most 2x up or
+ * down per step. Because the round-trip overhead does not grow with the
+ * batch, repeated steps approach the target from below. It does not grow
+ * any more once the last growth step gained less than minGain in rows per
+ * second. This cap is lifted when the batch has to shrink. The batch never
+ * needs more than memoryCeiling bytes, at the row width reported with
+ * setRowBytes(). Changes within the hysteresis band are ignored, so the
+ * size does not flap with the noise in call times.
+ *
+ * One controller per call site, shared by every thread that runs it.
+ */
+class BatchSizeController {
+public:
+    explicit BatchSizeController(const std::string &name, const BatchTargets &targets = BatchTargets());
+
+    ~BatchSizeController();
+
+    BatchSizeController(const BatchSizeController &) = delete;
+
+    BatchSizeController &operator=(const BatchSizeController &) = delete;
+
+    /**
+     * The batch length to use for the next call.
+     */
+    unsigned int rows() const { return shownRows.load(std::memory_order_relaxed); }
+
+    /**
+     * Buffer bytes one row takes (all columns, indicators and lengths).
+     */
+    void setRowBytes(size_t bytes);
+
+    /**
+     * One call that moved `rows` rows in callNs. Calls far below the
+     * current batch (the tail of a result set) are not taken as samples.
+     */
+    void observe(unsigned int rows, uint64_t callNs);
+
+    uint64_t resizes() const { return resizeCount.load(std::memory_order_relaxed); }
+
+    const std::string &name() const { return controllerName; }
+
+private:
+    void apply(unsigned int next);
+
+    unsigned int memoryRows() const;
+
+    std::string controllerName;
+    BatchTargets targets;
+    std::mutex lock;
+    unsigned int current;
+    size_t rowBytes = 0;
+    // 当前批大小下的观察窗口
+    unsigned int calls = 0;
+    uint64_t windowRows = 0;
+    uint64_t windowNs = 0;
+    // 上一个批大小下的吞吐 (行/秒) 和变大的上限, 0 = 没有
+    double lastThroughput = 0;
+    bool grew = false;
+    unsigned int growthCap = 0;
+
+    std::atomic<unsigned int> shownRows{0};
+    std::atomic<size_t> shownRowBytes{0};
+    std::atomic<uint64_t> resizeCount{0};
+    MetricCounter *resizeCounter;
+    std::vector<int> gaugeIds;
+};
+
+/**
+ * One BatchSizeController per SQL fingerprint, for call sites that run
+ * arbitrary statements: a batch learned on a narrow query is never applied
+ * to a wide one. Controllers are named by the fingerprint, created on first
+ * use and kept for the life of the process.
+ */
+class BatchControllers {
+public:
+    static BatchControllers &instance();
+
+    BatchControllers(const BatchControllers &) = delete;
+
+    BatchControllers &operator=(const BatchControllers &) = delete;
+
+    BatchSizeController &forStatement(uint64_t fingerprint);
+
+private:
+    BatchControllers();
+
+    std::mutex lock;
+    std::map<uint64_t, std::unique_ptr<BatchSizeController>> controllers;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "occi_common.h"
+#include "latency_histogram.h"
+
+/**
+ * Knobs shared by every scenario, set from the command line.
+ */
+struct BenchParams {
+    uint64_t rows = 1000;
+    unsigned int width = 32;
+    unsigned int batch = 100;
+    unsigned int threads = 8;
+    unsigned int sessions = 2;
+    unsigned int iterations = 10;
+    unsigned int trials = 5;
+    unsigned int warmup = 1;
+    unsigned int latencyUs = 50;
+    unsigned int rowNs = 200;
+    unsigned int parseUs = 30;
+};
+
+/**
+ * What one scenario works with. op() returns the number of items (rows,
+ * statements, checkouts) it processed, which throughput is counted in.
+ * Scenarios that time something finer than a whole op() (e.g. checkout
+ * wait) record into `latency` themselves and set ownLatency.
+ */
+struct BenchRun {
+    const BenchParams &params;
+    oracle::occi::Environment *env;
+    oracle::occi::Connection *conn;
+    LatencyHistogram latency;
+    bool ownLatency = false;
+
+    BenchRun(const BenchParams &params, oracle::occi::Environment *env, oracle::occi::Connection *conn)
+            : params(params), env(env), conn(conn) {}
+};
+
+/**
+ * allocBudget: most operator new calls per item the scenario may make
+ * (averaged over all trials) before the run counts as failed; negative
+ * means no budget.
+ */
+struct BenchScenario {
+    std::string name;
+    std::string group;
+    std::function<void(BenchRun &)> setup;
+    std::function<uint64_t(BenchRun &)> op;
+    std::function<void(BenchRun &)> teardown;
+    double allocBudget = -1;
+};
+
+std::vector<BenchScenario> benchScenarios();
+
+/**
+ * Allocation count/bytes since start (alloc_tracker.h); the stand-in's
+ * server side is not counted.
+ */
+uint64_t benchAllocations();
+
+uint64_t benchAllocatedBytes();
+
+/**
+ * Current resident set size in KiB (0 where unknown). The runner samples it
+ * around each scenario: the process-wide peak only ever grows, so it would
+ * charge every later scenario with the largest one before it.
+ */
+uint64_t benchRssKb();
@@ -0,0 +1,384 @@
+/**
+ * oracle_oci_bench_compare: diffs two oracle_oci_bench result files.
+ *
+ * For every scenario present in both runs it compares mean throughput and p99
+ * latency over the per-trial samples with Welch's t-test, prints the relative
+ * change with its confidence interval, and exits 1 if any scenario got worse
+ * by more than --threshold percent with the interval excluding zero.
+ * Changes smaller than --noise percent are reported as noise whatever the
+ * test says, so a tight interval on a 0.3% drift does not read as a finding.
+ * A scenario of the base run that the candidate lacks counts as a
+ * regression too, unless --allow-missing.
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "json_reader.h"
+
+using namespace std;
+
+struct CompareOptions {
+    double thresholdPct = 5;
+    double noisePct = 2;
+    double confidence = 0.95;
+    string filter;
+    // 候选里少了基线的场景 (删掉或改名) 时只提示, 不算回退
+    bool allowMissing = false;
+};
+
+struct Samples {
+    vector<double> values;
+
+    double mean() const {
+        double sum = 0;
+        for (double v: values) {
+            sum += v;
+        }
+        return values.empty() ? 0 : sum / (double) values.size();
+    }
+
+    double variance() const {
+        if (values.size() < 2) {
+            return 0;
+        }
+        double m = mean();
+        double sum = 0;
+        for (double v: values) {
+            sum += (v - m) * (v - m);
+        }
+        return sum / (double) (values.size() - 1);
+    }
+};
+
+// 不完全 beta 函数的连分式展开 (Lentz 算法)
+static double betaContinuedFraction(double a, double b, double x) {
+    const double tiny = 1e-300;
+    double qab = a + b;
+    double qap = a + 1;
+    double qam = a - 1;
+    double c = 1;
+    double d = 1 - qab * x / qap;
+    if (fabs(d) < tiny) {
+        d = tiny;
+    }
+    d = 1 / d;
+    double h = d;
+    for (int m = 1; m <= 300; ++m) {
+        int m2 = 2 * m;
+        double aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+        d = 1 + aa * d;
+        d = fabs(d) < tiny ? tiny : d;
+        c = 1 + aa / c;
+        c = fabs(c) < tiny ? tiny : c;
+        d = 1 / d;
+        h *= d * c;
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+        d = 1 + aa * d;
+        d = fabs(d) < tiny ? tiny : d;
+        c = 1 + aa / c;
+        c = fabs(c) < tiny ? tiny : c;
+        d = 1 / d;
+        double delta = d * c;
+        h *= delta;
+        if (fabs(delta - 1) < 1e-12) {
+            break;
+        }
+    }
+    return h;
+}
+
+// 正则化不完全 beta 函数 I_x(a, b)
+static double incompleteBeta(double a, double b, double x) {
+    if (x <= 0) {
+        return 0;
+    }
+    if (x >= 1) {
+        return 1;
+    }
+    double front = exp(lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) + b * log(1 - x));
+    if (x < (a + 1) / (a + b + 2)) {
+        return front * betaContinuedFraction(a, b, x) / a;
+    }
+    return 1 - front * betaContinuedFraction(b, a, 1 - x) / b;
+}
+
+/**
+ * P(T <= t) for Student's t with df degrees of freedom (df may be fractional,
+ * as Welch-Satterthwaite gives it).
+ */
+static double studentCdf(double t, double df) {
+    double tail = 0.5 * incompleteBeta(df / 2, 0.5, df / (df + t * t));
+    return t >= 0 ? 1 - tail : tail;
+}
+
+static double studentQuantile(double p, double df) {
+    double low = 0;
+    double high = 1;
+    while (studentCdf(high, df) < p && high < 1e6) {
+        high *= 2;
+    }
+    for (int i = 0; i < 200 && high - low > 1e-9; ++i) {
+        double mid = (low + high) / 2;
+        if (studentCdf(mid, df) < p) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return (low + high) / 2;
+}
+
+/**
+ * Change of candidate vs base in percent of the base mean, with a Welch
+ * confidence interval on the difference of means (the base mean is taken as
+ * exact when scaling, which is fine at the trial counts a bench uses).
+ * hasInterval is false when either side has fewer than two samples.
+ */
+struct Change {
+    double base = 0;
+    double candidate = 0;
+    double pct = 0;
+    double lowPct = 0;
+    double highPct = 0;
+    double pValue = 1;
+    bool hasInterval = false;
+};
+
+static Change compareSamples(const Samples &base, const Samples &candidate, double confidence) {
+    Change change;
+    change.base = base.mean();
+    change.candidate = candidate.mean();
+    if (change.base == 0) {
+        return change;
+    }
+    double diff = change.candidate - change.base;
+    change.pct = diff / change.base * 100;
+    size_t n1 = base.values.size();
+    size_t n2 = candidate.values.size();
+    if (n1 < 2 || n2 < 2) {
+        return change;
+    }
+    double v1 = base.variance() / (double) n1;
+    double v2 = candidate.variance() / (double) n2;
+    double se = sqrt(v1 + v2);
+    change.hasInterval = true;
+    if (se == 0) {
+        change.lowPct = change.highPct = change.pct;
+        change.pValue = diff == 0 ? 1 : 0;
+        return change;
+    }
+    // Welch-Satterthwaite 自由度
+    double df = (v1 + v2) * (v1 + v2) / (v1 * v1 / (double) (n1 - 1) + v2 * v2 / (double) (n2 - 1));
+    double t = studentQuantile(1 - (1 - confidence) / 2, df);
+    change.lowPct = (diff - t * se) / change.base * 100;
+    change.highPct = (diff + t * se) / change.base * 100;
+    change.pValue = 2 * (1 - studentCdf(fabs(diff / se), df));
+    return change;
+}
+
+enum class Verdict {
+    SAME,
+    BETTER,
+    WORSE,
+    REGRESSED
+};
+
+/**
+ * higherIsBetter: throughput yes, latency no.
+ */
+static Verdict judge(const Change &change, bool higherIsBetter, const CompareOptions &options) {
+    if (fabs(change.pct) < options.noisePct) {
+        return Verdict::SAME;
+    }
+    // 区间跨过 0 说明差异不显著; 只有一轮时没有区间, 只能看点估计
+    if (change.hasInterval && change.lowPct <= 0 && change.highPct >= 0) {
+        return Verdict::SAME;
+    }
+    double worsePct = higherIsBetter ? -change.pct : change.pct;
+    if (worsePct < 0) {
+        return Verdict::BETTER;
+    }
+    return worsePct > options.thresholdPct ? Verdict::REGRESSED : Verdict::WORSE;
+}
+
+static const char *verdictName(Verdict verdict) {
+    switch (verdict) {
+        case Verdict::BETTER:
+            return "better";
+        case Verdict::WORSE:
+            return "worse";
+        case Verdict::REGRESSED:
+            return "REGRESSED";
+        default:
+            return "~";
+    }
+}
+
+static Samples throughputSamples(const JsonValue &result) {
+    Samples samples;
+    const JsonValue &trials = result["trials"];
+    for (size_t i = 0; i < trials.size(); ++i) {
+        samples.values.push_back(trials[i]["throughput"].number());
+    }
+    return samples;
+}
+
+// 早期的结果文件没有逐轮 p99, 退回到整体的 p99 (没有置信区间)
+static Samples p99Samples(const JsonValue &result) {
+    Samples samples;
+    const JsonValue &trials = result["trials"];
+    for (size_t i = 0; i < trials.size(); ++i) {
+        if (!trials[i].has("p99_us")) {
+            samples.values.clear();
+            break;
+        }
+        samples.values.push_back(trials[i]["p99_us"].number());
+    }
+    if (samples.values.empty()) {
+        samples.values.push_back(result["latency_us"]["p99"].number());
+    }
+    return samples;
+}
+
+static const JsonValue *findResult(const JsonValue &doc, const string &name) {
+    const JsonValue &results = doc["results"];
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i]["name"].text() == name) {
+            return &results[i];
+        }
+    }
+    return nullptr;
+}
+
+static void printChange(const string &scenario, const char *metric, const Change &change, Verdict verdict) {
+    char interval[48];
+    if (change.hasInterval) {
+        snprintf(interval, sizeof(interval), "[%+.1f%%, %+.1f%%]", change.lowPct, change.highPct);
+    } else {
+        snprintf(interval, sizeof(interval), "n/a");
+    }
+    printf("%-22s %-10s %14.1f %14.1f %+8.1f%% %20s %7.3f  %s\n", scenario.c_str(), metric, change.base,
+           change.candidate, change.pct, interval, change.pValue, verdictName(verdict));
+}
+
+// 参数不同的两次运行没有可比性, 提醒一下但不拒绝
+static void warnParams(const JsonValue &base, const JsonValue &candidate) {
+    const JsonValue &params = base["params"];
+    for (const auto &key: params.keys()) {
+        double a = params[key].number();
+        double b = candidate["params"][key].number();
+        if (a != b) {
+            printf("warning: params.%s differs (%g vs %g)\n", key.c_str(), a, b);
+        }
+    }
+}
+
+static void usage() {
+    printf("usage: oracle_oci_bench_compare <base.json|-> <candidate.json|-> [--threshold PCT] [--noise PCT]\n"
+           "                                [--confidence 0.95] [--filter <substr>] [--allow-missing]\n"
+           "exit status: 0 no regression, 1 regression beyond --threshold or a base scenario missing\n"
+           "             from the candidate (unless --allow-missing), 2 bad input\n");
+}
+
+int main(int argc, char *argv[]) {
+    CompareOptions options;
+    vector<string> paths;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc) {
+                usage();
+                exit(2);
+            }
+            return argv[++i];
+        };
+        if (arg == "--threshold") {
+            options.thresholdPct = atof(value());
+        } else if (arg == "--noise") {
+            options.noisePct = atof(value());
+        } else if (arg == "--confidence") {
+            options.confidence = atof(value());
+        } else if (arg == "--filter") {
+            options.filter = value();
+        } else if (arg == "--allow-missing") {
+            options.allowMissing = true;
+        } else if (!arg.empty() && arg[0] == '-' && arg != "-") {
+            usage();
+            return 2;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.size() != 2 || options.confidence <= 0 || options.confidence >= 1) {
+        usage();
+        return 2;
+    }
+
+    JsonValue base;
+    JsonValue candidate;
+    string error;
+    if (!readJsonFile(paths[0], base, error) || !readJsonFile(paths[1], candidate, error)) {
+        printf("%s\n", error.c_str());
+        return 2;
+    }
+    if (!base["results"].isArray() || !candidate["results"].isArray()) {
+        printf("not an oracle_oci_bench result file.\n");
+        return 2;
+    }
+    warnParams(base, candidate);
+
+    printf("%-22s %-10s %14s %14s %9s %20s %7s  %s\n", "scenario", "metric", "base", "candidate", "change",
+           "ci", "p", "verdict");
+    int regressions = 0;
+    const JsonValue &baseResults = base["results"];
+    for (size_t i = 0; i < baseResults.size(); ++i) {
+        const JsonValue &a = baseResults[i];
+        const string &name = a["name"].text();
+        if (!options.filter.empty() && name.find(options.filter) == string::npos) {
+            continue;
+        }
+        const JsonValue *b = findResult(candidate, name);
+        if (nullptr == b) {
+            printf("%-22s only in base%s\n", name.c_str(), options.allowMissing ? "" : " (regression)");
+            regressions += !options.allowMissing;
+            continue;
+        }
+        if (!a["ok"].boolean() || !(*b)["ok"].boolean()) {
+            bool candidateFailed = !(*b)["ok"].boolean();
+            printf("%-22s failed in %s\n", name.c_str(), candidateFailed ? "candidate" : "base");
+            // 基线好好的, 新版本跑挂了, 也算回退
+            if (candidateFailed && a["ok"].boolean()) {
+                ++regressions;
+            }
+            continue;
+        }
+
+        Change throughput = compareSamples(throughputSamples(a), throughputSamples(*b), options.confidence);
+        Verdict verdict = judge(throughput, true, options);
+        printChange(name, "items/s", throughput, verdict);
+        regressions += verdict == Verdict::REGRESSED;
+
+        Change p99 = compareSamples(p99Samples(a), p99Samples(*b), options.confidence);
+        verdict = judge(p99, false, options);
+        printChange(name, "p99(us)", p99, verdict);
+        regressions += verdict == Verdict::REGRESSED;
+    }
+    const JsonValue &candidateResults = candidate["results"];
+    for (size_t i = 0; i < candidateResults.size(); ++i) {
+        const string &name = candidateResults[i]["name"].text();
+        if ((options.filter.empty() || name.find(options.filter) != string::npos) && !findResult(base, name)) {
+            printf("%-22s only in candidate\n", name.c_str());
+        }
+    }
+
+    if (regressions) {
+        printf("%d regression(s) beyond %.1f%% at %.0f%% confidence.\n", regressions, options.thresholdPct,
+               options.confidence * 100);
+        return 1;
+    }
+    printf("no regression beyond %.1f%%.\n", options.thresholdPct);
+    return 0;
+}
@@ -0,0 +1,343 @@
+#include "bench.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+#include "alloc_tracker.h"
+#include "standin.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+uint64_t benchAllocations() {
+    return allocTotals().allocations;
+}
+
+uint64_t benchAllocatedBytes() {
+    return allocTotals().bytes;
+}
+
+uint64_t benchRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return (uint64_t) counters.WorkingSetSize / 1024;
+    }
+    return 0;
+#else
+    FILE *status = fopen("/proc/self/status", "r");
+    if (nullptr == status) {
+        return 0;
+    }
+    char line[256];
+    uint64_t kb = 0;
+    while (fgets(line, sizeof(line), status)) {
+        if (strncmp(line, "VmRSS:", 6) == 0) {
+            kb = strtoull(line + 6, nullptr, 10);
+            break;
+        }
+    }
+    fclose(status);
+    return kb;
+#endif
+}
+
+struct TrialResult {
+    double seconds;
+    uint64_t items;
+    // 每轮单独的 p99, 对比工具要用逐轮样本算置信区间
+    double p99Ns;
+};
+
+struct ScenarioResult {
+    string name;
+    string group;
+    vector<TrialResult> trials;
+    LatencyHistogram latency;
+    uint64_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+    uint64_t items = 0;
+    // 场景期间 (setup 之后、每轮之后) 采到的最大 RSS 减去开始前的 RSS
+    uint64_t rssGrowthKb = 0;
+    bool failed = false;
+    string error;
+};
+
+static double throughput(const TrialResult &trial) {
+    return trial.seconds > 0 ? (double) trial.items / trial.seconds : 0;
+}
+
+static ScenarioResult runScenario(const BenchScenario &scenario, const BenchParams &params, Environment *env,
+                                  Connection *conn) {
+    ScenarioResult result;
+    result.name = scenario.name;
+    result.group = scenario.group;
+    BenchRun run(params, env, conn);
+    uint64_t rssBefore = benchRssKb();
+    uint64_t rssTop = rssBefore;
+    auto sampleRss = [&rssTop] {
+        uint64_t kb = benchRssKb();
+        rssTop = kb > rssTop ? kb : rssTop;
+    };
+    // setup 成功后无论 op 是否抛异常都要 teardown, 否则调度器、会话留给下一个场景
+    bool needTeardown = false;
+    try {
+        scenario.setup(run);
+        needTeardown = true;
+        sampleRss();
+        for (unsigned int i = 0; i < params.warmup; ++i) {
+            scenario.op(run);
+        }
+        for (unsigned int t = 0; t < params.trials; ++t) {
+            run.latency.reset();
+            uint64_t allocationsBefore = benchAllocations();
+            uint64_t bytesBefore = benchAllocatedBytes();
+            TrialResult trial{0, 0, 0};
+            auto trialStart = chrono::steady_clock::now();
+            for (unsigned int i = 0; i < params.iterations; ++i) {
+                auto start = chrono::steady_clock::now();
+                trial.items += scenario.op(run);
+                if (!run.ownLatency) {
+                    run.latency.record((uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+                            chrono::steady_clock::now() - start).count());
+                }
+            }
+            trial.seconds = chrono::duration<double>(chrono::steady_clock::now() - trialStart).count();
+            result.allocations += benchAllocations() - allocationsBefore;
+            result.allocatedBytes += benchAllocatedBytes() - bytesBefore;
+            result.items += trial.items;
+            trial.p99Ns = (double) run.latency.quantile(0.99);
+            result.latency.add(run.latency);
+            result.trials.push_back(trial);
+            sampleRss();
+        }
+        needTeardown = false;
+        scenario.teardown(run);
+        double perItem = result.items ? (double) result.allocations / (double) result.items : 0;
+        if (scenario.allocBudget >= 0 && perItem > scenario.allocBudget) {
+            char error[128];
+            snprintf(error, sizeof(error), "%.2f allocations per item, budget %.2f", perItem, scenario.allocBudget);
+            result.failed = true;
+            result.error = error;
+        }
+    }
+    catch (const SQLException &e) {
+        result.failed = true;
+        result.error = e.getMessage();
+    }
+    catch (const exception &e) {
+        result.failed = true;
+        result.error = e.what();
+    }
+    if (needTeardown) {
+        try {
+            scenario.teardown(run);
+        }
+        catch (const SQLException &e) {
+            result.error += "; teardown: " + e.getMessage();
+        }
+        catch (const exception &e) {
+            result.error += string("; teardown: ") + e.what();
+        }
+    }
+    result.rssGrowthKb = rssTop - rssBefore;
+    return result;
+}
+
+static string jsonString(const string &text) {
+    string out = "\"";
+    for (char c: text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char) c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static bool writeJson(const string &path, const BenchParams &params, const vector<ScenarioResult> &results) {
+    FILE *out = path == "-" ? stdout : fopen(path.c_str(), "w");
+    if (nullptr == out) {
+        printf("open %s error.\n", path.c_str());
+        return false;
+    }
+    fprintf(out, "{\n  \"benchmark\": \"oracle_oci_bench\",\n");
+    fprintf(out, "  \"params\": {\"rows\": %llu, \"width\": %u, \"batch\": %u, \"threads\": %u, \"sessions\": %u, "
+                 "\"iterations\": %u, \"trials\": %u, \"warmup\": %u, \"latency_us\": %u, \"row_ns\": %u, "
+                 "\"parse_us\": %u},\n",
+            (unsigned long long) params.rows, params.width, params.batch, params.threads, params.sessions,
+            params.iterations, params.trials, params.warmup, params.latencyUs, params.rowNs, params.parseUs);
+    fprintf(out, "  \"results\": [");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const ScenarioResult &r = results[i];
+        double mean = 0;
+        for (const auto &trial: r.trials) {
+            mean += throughput(trial);
+        }
+        mean = r.trials.empty() ? 0 : mean / (double) r.trials.size();
+        double variance = 0;
+        for (const auto &trial: r.trials) {
+            variance += (throughput(trial) - mean) * (throughput(trial) - mean);
+        }
+        double stddev = r.trials.size() > 1 ? sqrt(variance / (double) (r.trials.size() - 1)) : 0;
+
+        fprintf(out, "%s\n    {\"name\": %s, \"group\": %s, \"ok\": %s", i ? "," : "", jsonString(r.name).c_str(),
+                jsonString(r.group).c_str(), r.failed ? "false" : "true");
+        if (r.failed) {
+            fprintf(out, ", \"error\": %s", jsonString(r.error).c_str());
+        }
+        fprintf(out, ",\n     \"trials\": [");
+        for (size_t t = 0; t < r.trials.size(); ++t) {
+            fprintf(out, "%s{\"seconds\": %.9g, \"items\": %llu, \"throughput\": %.9g, \"p99_us\": %.9g}",
+                    t ? ", " : "", r.trials[t].seconds, (unsigned long long) r.trials[t].items,
+                    throughput(r.trials[t]), r.trials[t].p99Ns / 1000.0);
+        }
+        fprintf(out, "],\n     \"throughput\": {\"mean\": %.9g, \"stddev\": %.9g},\n", mean, stddev);
+        fprintf(out, "     \"latency_us\": {\"count\": %llu, \"mean\": %.9g, \"p50\": %.9g, \"p90\": %.9g, "
+                     "\"p99\": %.9g, \"p999\": %.9g, \"max\": %.9g},\n",
+                (unsigned long long) r.latency.count(), r.latency.mean() / 1000.0,
+                r.latency.quantile(0.50) / 1000.0, r.latency.quantile(0.90) / 1000.0,
+                r.latency.quantile(0.99) / 1000.0, r.latency.quantile(0.999) / 1000.0, r.latency.max() / 1000.0);
+        fprintf(out, "     \"allocations\": {\"count\": %llu, \"bytes\": %llu, \"per_item\": %.9g, "
+                     "\"bytes_per_item\": %.9g},\n",
+                (unsigned long long) r.allocations, (unsigned long long) r.allocatedBytes,
+                r.items ? (double) r.allocations / (double) r.items : 0,
+                r.items ? (double) r.allocatedBytes / (double) r.items : 0);
+        fprintf(out, "     \"rss_growth_kb\": %llu}", (unsigned long long) r.rssGrowthKb);
+    }
+    fprintf(out, "\n  ]\n}\n");
+    bool ok = ferror(out) == 0;
+    if (out != stdout) {
+        fclose(out);
+    }
+    return ok;
+}
+
+static void usage() {
+    printf("usage: oracle_oci_bench [--filter <substr>] [--out <file.json|->] [--rows N] [--width N]\n"
+           "                        [--batch N] [--threads N] [--sessions N] [--iterations N] [--trials N]\n"
+           "                        [--warmup N] [--latency-us N] [--row-ns N] [--parse-us N] [--list]\n");
+}
+
+int main(int argc, char *argv[]) {
+    setAllocTracking(true);
+    BenchParams params;
+    string filter;
+    string outPath = "bench_result.json";
+    bool list = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc) {
+                usage();
+                exit(2);
+            }
+            return argv[++i];
+        };
+        if (arg == "--filter") {
+            filter = value();
+        } else if (arg == "--out") {
+            outPath = value();
+        } else if (arg == "--rows") {
+            params.rows = strtoull(value(), nullptr, 10);
+        } else if (arg == "--width") {
+            params.width = (unsigned int) atoi(value());
+        } else if (arg == "--batch") {
+            params.batch = (unsigned int) atoi(value());
+        } else if (arg == "--threads") {
+            params.threads = (unsigned int) atoi(value());
+        } else if (arg == "--sessions") {
+            params.sessions = (unsigned int) atoi(value());
+        } else if (arg == "--iterations") {
+            params.iterations = (unsigned int) atoi(value());
+        } else if (arg == "--trials") {
+            params.trials = (unsigned int) atoi(value());
+        } else if (arg == "--warmup") {
+            params.warmup = (unsigned int) atoi(value());
+        } else if (arg == "--latency-us") {
+            params.latencyUs = (unsigned int) atoi(value());
+        } else if (arg == "--row-ns") {
+            params.rowNs = (unsigned int) atoi(value());
+        } else if (arg == "--parse-us") {
+            params.parseUs = (unsigned int) atoi(value());
+        } else if (arg == "--list") {
+            list = true;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    vector<BenchScenario> scenarios = benchScenarios();
+    if (list) {
+        for (const auto &scenario: scenarios) {
+            printf("%s\n", scenario.name.c_str());
+        }
+        return 0;
+    }
+
+    StandinLatency latency;
+    latency.roundTrip = chrono::microseconds(params.latencyUs);
+    latency.perRow = chrono::nanoseconds(params.rowNs);
+    latency.parse = chrono::microseconds(params.parseUs);
+    latency.connect = chrono::microseconds(params.latencyUs * 4);
+    StandinBackend::instance().setLatency(latency);
+
+    Environment *env = Environment::createEnvironment(Environment::THREADED_MUTEXED);
+    Connection *conn = env->createConnection("bench", "bench", "bench");
+
+    vector<ScenarioResult> results;
+    // --out - 时 stdout 只放 JSON, 好直接接给 oracle_oci_bench_compare; 表格改走 stderr
+    FILE *table = outPath == "-" ? stderr : stdout;
+    fprintf(table, "%-22s %14s %12s %12s %12s %14s\n", "scenario", "items/s", "p50(us)", "p99(us)", "max(us)",
+           "allocs/item");
+    for (const auto &scenario: scenarios) {
+        if (!filter.empty() && scenario.name.find(filter) == string::npos) {
+            continue;
+        }
+        ScenarioResult result = runScenario(scenario, params, env, conn);
+        if (result.failed) {
+            fprintf(table, "%-22s failed: %s\n", result.name.c_str(), result.error.c_str());
+        } else {
+            double seconds = 0;
+            for (const auto &trial: result.trials) {
+                seconds += trial.seconds;
+            }
+            fprintf(table, "%-22s %14.0f %12.1f %12.1f %12.1f %14.2f\n", result.name.c_str(),
+                   seconds > 0 ? (double) result.items / seconds : 0, result.latency.quantile(0.50) / 1000.0,
+                   result.latency.quantile(0.99) / 1000.0, result.latency.max() / 1000.0,
+                   result.items ? (double) result.allocations / (double) result.items : 0);
+        }
+        results.push_back(std::move(result));
+    }
+
+    env->terminateConnection(conn);
+    Environment::terminateEnvironment(env);
+
+    if (!writeJson(outPath, params, results)) {
+        return 1;
+    }
+    if (outPath != "-") {
+        printf("results written to %s\n", outPath.c_str());
+    }
+    for (const auto &result: results) {
+        if (result.failed) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,797 @@
+#include "bench.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "array_fetch.h"
+#include "async_executor.h"
+#include "batch_controller.h"
+#include "concurrency_limiter.h"
+#include "coro_query.h"
+#include "job_scheduler.h"
+#include "memory_governor.h"
+#include "oci_heap.h"
+#include "query_arena.h"
+#include "session_pool.h"
+#include "shard_router.h"
+#include "standin.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+static const char *FETCH_SQL = "SELECT id, name, amount, category, note FROM bench_fetch";
+static const char *POINT_SQL = "SELECT name FROM bench_fetch WHERE id = :1";
+static const char *INSERT_SQL = "INSERT INTO bench_dml (id, name, amount) VALUES (:1, :2, :3)";
+
+// 防止编译器把只读不用的取值优化掉
+static volatile uint64_t G_SINK;
+
+static void defineFetchTable(const BenchParams &params) {
+    StandinBackend::instance().defineTable(
+            {"BENCH_FETCH", params.rows,
+             {{"ID", StandinType::NUMBER, StandinDistribution::SEQUENCE, 1, 0, 0},
+              {"NAME", StandinType::VARCHAR, StandinDistribution::UNIFORM, 1, 1000000, params.width},
+              {"AMOUNT", StandinType::BINARY_DOUBLE, StandinDistribution::UNIFORM, 0, 10000, 0},
+              {"CATEGORY", StandinType::NUMBER, StandinDistribution::ZIPF, 1, 100, 0},
+              {"NOTE", StandinType::VARCHAR, StandinDistribution::UNIFORM, 1, 1000000, params.width}},
+             42});
+}
+
+static void defineDmlTable(const BenchParams &params) {
+    StandinBackend::instance().defineTable(
+            {"BENCH_DML", 0,
+             {{"ID", StandinType::NUMBER, StandinDistribution::SEQUENCE, 1, 0, 0},
+              {"NAME", StandinType::VARCHAR, StandinDistribution::CONSTANT, 0, 0, params.width},
+              {"AMOUNT", StandinType::BINARY_DOUBLE, StandinDistribution::CONSTANT, 0, 0, 0}},
+             1});
+}
+
+/**
+ * Reads every row of FETCH_SQL with next(), via getString or typed getters.
+ * prefetch 0 keeps the OCCI default (one row per round trip).
+ */
+static uint64_t fetchRows(BenchRun &run, unsigned int prefetch, bool typed) {
+    Statement *stmt = run.conn->createStatement(FETCH_SQL);
+    if (prefetch) {
+        stmt->setPrefetchRowCount(prefetch);
+    }
+    ResultSet *rs = stmt->executeQuery();
+    uint64_t rows = 0;
+    uint64_t sink = 0;
+    while (rs->next()) {
+        if (typed) {
+            sink += (uint64_t) rs->getInt(1);
+            sink += rs->getString(2).size();
+            sink += (uint64_t) rs->getDouble(3);
+            sink += (uint64_t) rs->getInt(4);
+            sink += rs->getString(5).size();
+        } else {
+            for (unsigned int i = 1; i <= 5; ++i) {
+                sink += rs->getString(i).size();
+            }
+        }
+        ++rows;
+    }
+    stmt->closeResultSet(rs);
+    run.conn->terminateStatement(stmt);
+    G_SINK = sink;
+    return rows;
+}
+
+// *.array_adaptive 的控制器跨 trial 保留, 学到的批大小一直沿用
+static unique_ptr<BatchSizeController> G_BATCH_CONTROLLER;
+
+static void startBatchController(BenchRun &run, const string &name) {
+    BatchTargets targets;
+    targets.initialRows = run.params.batch;
+    G_BATCH_CONTROLLER.reset(new BatchSizeController(name, targets));
+}
+
+static void stopBatchController(BenchRun &) {
+    G_BATCH_CONTROLLER.reset();
+}
+
+/**
+ * Array fetch with a fixed batch of params.batch rows, or sized by a
+ * BatchSizeController when one is given.
+ */
+static uint64_t fetchArray(BenchRun &run, BatchSizeController *controller) {
+    Statement *stmt = run.conn->createStatement(FETCH_SQL);
+    ResultSet *rs = stmt->executeQuery();
+    uint64_t rows = 0;
+    uint64_t sink = 0;
+    {
+        unique_ptr<ArrayFetcher> owned(controller ? new ArrayFetcher(rs, *controller)
+                                                  : new ArrayFetcher(rs, run.params.batch));
+        ArrayFetcher &fetcher = *owned;
+        while (unsigned int n = fetcher.next()) {
+            // 直接读列数组, 不经过 std::string, 每行不应有任何分配
+            for (unsigned int r = 0; r < n; ++r) {
+                for (unsigned int c = 1; c <= fetcher.columnCount(); ++c) {
+                    sink += fetcher.isNumeric(c) ? (uint64_t) fetcher.number(r, c) : strlen(fetcher.text(r, c));
+                }
+            }
+            rows += n;
+        }
+    }
+    stmt->closeResultSet(rs);
+    run.conn->terminateStatement(stmt);
+    G_SINK = sink;
+    return rows;
+}
+
+static uint64_t insertSingle(BenchRun &run) {
+    defineDmlTable(run.params);
+    string name(run.params.width, 'n');
+    Statement *stmt = run.conn->createStatement(INSERT_SQL);
+    for (uint64_t i = 0; i < run.params.rows; ++i) {
+        stmt->setInt(1, (int) i);
+        stmt->setString(2, name);
+        stmt->setDouble(3, (double) i * 0.5);
+        stmt->executeUpdate();
+    }
+    run.conn->terminateStatement(stmt);
+    return run.params.rows;
+}
+
+/**
+ * Array insert, params.batch rows per executeArrayUpdate or as many as the
+ * controller says; the bind arrays grow and are bound again when it does.
+ */
+static uint64_t insertArray(BenchRun &run, BatchSizeController *controller) {
+    defineDmlTable(run.params);
+    unsigned int width = run.params.width + 1;
+    vector<int> ids;
+    vector<char> names;
+    vector<double> amounts;
+    vector<ub2> idLen;
+    vector<ub2> nameLen;
+    vector<ub2> amountLen;
+    if (controller) {
+        controller->setRowBytes(sizeof(int) + width + sizeof(double) + 3 * sizeof(ub2));
+    }
+
+    Statement *stmt = run.conn->createStatement(INSERT_SQL);
+    unsigned int bound = 0;
+    uint64_t done = 0;
+    while (done < run.params.rows) {
+        unsigned int batch = controller ? controller->rows() : run.params.batch;
+        if (batch > bound) {
+            ids.resize(batch);
+            names.assign((size_t) batch * width, 'n');
+            amounts.resize(batch);
+            idLen.assign(batch, sizeof(int));
+            nameLen.assign(batch, (ub2) width);
+            amountLen.assign(batch, sizeof(double));
+            for (unsigned int i = 0; i < batch; ++i) {
+                names[(size_t) i * width + width - 1] = '\0';
+            }
+            stmt->setDataBuffer(1, ids.data(), OCCIINT, sizeof(int), idLen.data());
+            stmt->setDataBuffer(2, names.data(), OCCI_SQLT_STR, (sb4) width, nameLen.data());
+            stmt->setDataBuffer(3, amounts.data(), OCCIFLOAT, sizeof(double), amountLen.data());
+            bound = batch;
+        }
+        unsigned int n = (unsigned int) std::min<uint64_t>(batch, run.params.rows - done);
+        for (unsigned int i = 0; i < n; ++i) {
+            ids[i] = (int) (done + i);
+            amounts[i] = (double) (done + i) * 0.5;
+        }
+        auto start = chrono::steady_clock::now();
+        stmt->executeArrayUpdate(n);
+        if (controller) {
+            controller->observe(n, (uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now() - start).count());
+        }
+        done += n;
+    }
+    run.conn->terminateStatement(stmt);
+    return done;
+}
+
+/**
+ * Point lookups by primary key, either through one prepared statement or
+ * one statement per execution (cached or not, depending on the session).
+ */
+static uint64_t pointQueries(BenchRun &run, bool reuse) {
+    unsigned int count = run.params.batch;
+    uint64_t sink = 0;
+    Statement *shared = reuse ? run.conn->createStatement(POINT_SQL) : nullptr;
+    for (unsigned int i = 0; i < count; ++i) {
+        Statement *stmt = reuse ? shared : run.conn->createStatement(POINT_SQL);
+        stmt->setInt(1, (int) (i % std::max<uint64_t>(1, run.params.rows)) + 1);
+        ResultSet *rs = stmt->executeQuery();
+        if (rs->next()) {
+            sink += rs->getString(1).size();
+        }
+        stmt->closeResultSet(rs);
+        if (!reuse) {
+            run.conn->terminateStatement(stmt);
+        }
+    }
+    if (shared) {
+        run.conn->terminateStatement(shared);
+    }
+    G_SINK = sink;
+    return count;
+}
+
+/**
+ * `threads` workers share a pool of `sessions` sessions; each checkout does
+ * one short query. Latency recorded is the checkout wait.
+ */
+static uint64_t poolContention(BenchRun &run) {
+    SessionPool pool(run.env, "bench_pool", run.params.sessions, 0, 1);
+    if (!pool.open("bench", "bench")) {
+        return 0;
+    }
+    unsigned int perThread = run.params.batch;
+    mutex lock;
+    vector<thread> workers;
+    for (unsigned int t = 0; t < run.params.threads; ++t) {
+        workers.emplace_back([&] {
+            LatencyHistogram waits;
+            for (unsigned int i = 0; i < perThread; ++i) {
+                auto start = chrono::steady_clock::now();
+                Connection *conn = pool.checkout();
+                waits.record((uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+                        chrono::steady_clock::now() - start).count());
+                if (nullptr == conn) {
+                    continue;
+                }
+                Statement *stmt = conn->createStatement("SELECT dummy FROM dual");
+                ResultSet *rs = stmt->executeQuery();
+                rs->next();
+                stmt->closeResultSet(rs);
+                conn->terminateStatement(stmt);
+                pool.release(conn);
+            }
+            lock_guard<mutex> guard(lock);
+            run.latency.add(waits);
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    pool.close();
+    return (uint64_t) perThread * run.params.threads;
+}
+
+// async.* 的会话在 setup 里打开, 建连耗时不算进吞吐
+static vector<Connection *> G_ASYNC_SESSIONS;
+static unique_ptr<AsyncExecutor> G_ASYNC_EXECUTOR;
+
+static void openAsyncSessions(BenchRun &run) {
+    defineFetchTable(run.params);
+    for (unsigned int i = 0; i < run.params.threads; ++i) {
+        G_ASYNC_SESSIONS.push_back(run.env->createConnection("bench", "bench", "bench"));
+    }
+    run.ownLatency = true;
+}
+
+static void closeAsyncSessions(BenchRun &run) {
+    if (G_ASYNC_EXECUTOR) {
+        G_ASYNC_EXECUTOR->stop();
+        G_ASYNC_EXECUTOR.reset();
+    }
+    for (Connection *conn: G_ASYNC_SESSIONS) {
+        run.env->terminateConnection(conn);
+    }
+    G_ASYNC_SESSIONS.clear();
+}
+
+/**
+ * Baseline for async.event_loop: `batch` point queries in flight at once,
+ * each on a thread of its own that blocks in its round trips, sharing the
+ * `threads` sessions. Latency is counted from the query's launch.
+ */
+static uint64_t threadPerQuery(BenchRun &run) {
+    unsigned int count = run.params.batch;
+    mutex lock;
+    condition_variable freed;
+    vector<Connection *> idle = G_ASYNC_SESSIONS;
+    vector<thread> workers;
+    workers.reserve(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        auto start = chrono::steady_clock::now();
+        workers.emplace_back([&, i, start] {
+            Connection *conn;
+            {
+                unique_lock<mutex> guard(lock);
+                freed.wait(guard, [&] { return !idle.empty(); });
+                conn = idle.back();
+                idle.pop_back();
+            }
+            Statement *stmt = conn->createStatement(POINT_SQL);
+            stmt->setInt(1, (int) (i % std::max<uint64_t>(1, run.params.rows)) + 1);
+            ResultSet *rs = stmt->executeQuery();
+            if (rs->next()) {
+                G_SINK = rs->getString(1).size();
+            }
+            stmt->closeResultSet(rs);
+            conn->terminateStatement(stmt);
+            lock_guard<mutex> guard(lock);
+            idle.push_back(conn);
+            run.latency.record((uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now() - start).count());
+            freed.notify_one();
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    return count;
+}
+
+/**
+ * The same `batch` point queries submitted at once to an AsyncExecutor that
+ * drives the `threads` sessions in non-blocking mode from `sessions` event
+ * loops.
+ */
+static uint64_t eventLoop(BenchRun &run) {
+    unsigned int count = run.params.batch;
+    mutex lock;
+    condition_variable finished;
+    unsigned int left = count;
+    for (unsigned int i = 0; i < count; ++i) {
+        int64_t id = (int64_t) (i % std::max<uint64_t>(1, run.params.rows)) + 1;
+        G_ASYNC_EXECUTOR->query(POINT_SQL, {{1, BindType::INT, id}}, 1, [&](AsyncResult &result) {
+            lock_guard<mutex> guard(lock);
+            if (!result.rows.empty()) {
+                G_SINK = result.rows[0][0].size();
+            }
+            run.latency.record(result.elapsedNs);
+            if (0 == --left) {
+                finished.notify_one();
+            }
+        }, run.params.width);
+    }
+    unique_lock<mutex> guard(lock);
+    finished.wait(guard, [&] { return 0 == left; });
+    return count;
+}
+
+static void startAsyncExecutor(BenchRun &run) {
+    openAsyncSessions(run);
+    G_ASYNC_EXECUTOR.reset(new AsyncExecutor(run.env, run.params.sessions));
+    for (Connection *conn: G_ASYNC_SESSIONS) {
+        G_ASYNC_EXECUTOR->addConnection(conn);
+    }
+    G_ASYNC_EXECUTOR->start();
+}
+
+/**
+ * `threads` sessions fetch the whole table at once with batch * 10 row
+ * arrays under a 256 KiB MemoryGovernor budget, a few such arrays, so
+ * batches get shrunk or wait for memory. Latency is one query.
+ */
+static uint64_t budgetedFetch(BenchRun &run) {
+    mutex lock;
+    uint64_t rows = 0;
+    vector<thread> workers;
+    for (Connection *conn: G_ASYNC_SESSIONS) {
+        workers.emplace_back([&, conn] {
+            auto start = chrono::steady_clock::now();
+            Statement *stmt = conn->createStatement(FETCH_SQL);
+            ResultSet *rs = stmt->executeQuery();
+            uint64_t n = 0;
+            {
+                ArrayFetcher fetcher(rs, run.params.batch * 10);
+                while (unsigned int got = fetcher.next()) {
+                    n += got;
+                }
+            }
+            stmt->closeResultSet(rs);
+            conn->terminateStatement(stmt);
+            lock_guard<mutex> guard(lock);
+            run.latency.record((uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now() - start).count());
+            rows += n;
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    return rows;
+}
+
+/**
+ * `threads` sessions fetch the table at once and format every cell, as
+ * printResultSet does: into a std::string each, or into a per-row
+ * QueryArena on the worker's stack.
+ */
+static uint64_t parallelFormat(BenchRun &run, bool useArena) {
+    mutex lock;
+    uint64_t rows = 0;
+    uint64_t sink = 0;
+    vector<thread> workers;
+    for (Connection *conn: G_ASYNC_SESSIONS) {
+        workers.emplace_back([&, conn] {
+            auto start = chrono::steady_clock::now();
+            Statement *stmt = conn->createStatement(FETCH_SQL);
+            ResultSet *rs = stmt->executeQuery();
+            uint64_t n = 0;
+            uint64_t bytes = 0;
+            {
+                ArrayFetcher fetcher(rs, run.params.batch);
+                QueryArena arena;
+                while (unsigned int got = fetcher.next()) {
+                    for (unsigned int r = 0; r < got; ++r) {
+                        for (unsigned int c = 1; c <= fetcher.columnCount(); ++c) {
+                            bytes += useArena ? fetcher.getString(r, c, arena.resource()).size()
+                                              : fetcher.getString(r, c).size();
+                        }
+                        arena.reset();
+                    }
+                    n += got;
+                }
+            }
+            stmt->closeResultSet(rs);
+            conn->terminateStatement(stmt);
+            lock_guard<mutex> guard(lock);
+            run.latency.record((uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now() - start).count());
+            rows += n;
+            sink += bytes;
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    G_SINK = sink;
+    return rows;
+}
+
+static Environment *G_HEAP_ENV = nullptr;
+
+/**
+ * openAsyncSessions on an environment whose client heap is OciHeap, with a
+ * 64 MiB huge page region for the prefetch buffers.
+ */
+static void openHeapSessions(BenchRun &run) {
+    static bool reserved = OciHeap::instance().reserveHugeRegion(64 * 1024 * 1024);
+    (void) reserved;
+    G_HEAP_ENV = Environment::createEnvironment(Environment::THREADED_MUTEXED, &OciHeap::instance(),
+                                                OciHeap::allocate, OciHeap::reallocate, OciHeap::release);
+    Environment *shared = run.env;
+    run.env = G_HEAP_ENV;
+    openAsyncSessions(run);
+    run.env = shared;
+}
+
+static void closeHeapSessions(BenchRun &run) {
+    Environment *shared = run.env;
+    run.env = G_HEAP_ENV;
+    closeAsyncSessions(run);
+    run.env = shared;
+    Environment::terminateEnvironment(G_HEAP_ENV);
+    G_HEAP_ENV = nullptr;
+}
+
+/**
+ * Every async session opens, runs and closes the fetch query four times
+ * at once, prefetching `batch` rows: the handle, define and prefetch
+ * buffer churn that OCI does on its own heap.
+ */
+static uint64_t statementChurn(BenchRun &run) {
+    mutex lock;
+    uint64_t rows = 0;
+    vector<thread> workers;
+    for (Connection *conn: G_ASYNC_SESSIONS) {
+        workers.emplace_back([&, conn] {
+            uint64_t n = 0;
+            for (int i = 0; i < 4; ++i) {
+                auto start = chrono::steady_clock::now();
+                Statement *stmt = conn->createStatement(FETCH_SQL);
+                stmt->setPrefetchRowCount(run.params.batch);
+                ResultSet *rs = stmt->executeQuery();
+                while (rs->next()) {
+                    ++n;
+                }
+                stmt->closeResultSet(rs);
+                conn->terminateStatement(stmt);
+                lock_guard<mutex> guard(lock);
+                run.latency.record((uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+                        chrono::steady_clock::now() - start).count());
+            }
+            lock_guard<mutex> guard(lock);
+            rows += n;
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    return rows;
+}
+
+#ifdef OCI_DEMO_COROUTINES
+static const unsigned int FANOUT = 8;
+
+static CoroTask<uint64_t> fanoutHandler(CoroDb &db, unsigned int first, const BenchParams &params) {
+    auto start = chrono::steady_clock::now();
+    // 先把 FANOUT 条查询都发出去, 再逐个等
+    vector<CoroTask<AsyncResult>> queries;
+    for (unsigned int k = 0; k < FANOUT; ++k) {
+        int64_t id = (int64_t) ((first + k) % std::max<uint64_t>(1, params.rows)) + 1;
+        queries.push_back(db.fetchAll(POINT_SQL, {{1, BindType::INT, id}}, 1, params.width));
+    }
+    for (auto &query: queries) {
+        AsyncResult result = co_await query;
+        if (!result.rows.empty()) {
+            G_SINK = result.rows[0][0].size();
+        }
+    }
+    co_return (uint64_t) chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Request handlers as coroutines on the async.event_loop executor: each
+ * fans out FANOUT point queries through CoroDb before awaiting any, `batch`
+ * queries in all. Latency is per handler.
+ */
+static uint64_t coroutineFanout(BenchRun &run) {
+    CoroDb db(*G_ASYNC_EXECUTOR);
+    unsigned int handlers = std::max(1u, run.params.batch / FANOUT);
+    vector<CoroTask<uint64_t>> tasks;
+    tasks.reserve(handlers);
+    for (unsigned int h = 0; h < handlers; ++h) {
+        tasks.push_back(fanoutHandler(db, h * FANOUT, run.params));
+    }
+    for (auto &task: tasks) {
+        run.latency.record(task.get());
+    }
+    return (uint64_t) handlers * FANOUT;
+}
+#endif
+
+static unique_ptr<ConcurrencyLimiter> G_LIMITER;
+
+static void startLimiter(BenchRun &run) {
+    LimiterOptions options;
+    options.initialLimit = 8;
+    options.minLimit = 8;
+    options.maxLimit = 8;
+    options.maxWait = chrono::milliseconds(100);
+    options.tenantQuota = 1;
+    G_LIMITER.reset(new ConcurrencyLimiter("bench", options));
+    run.ownLatency = true;
+}
+
+static void stopLimiter(BenchRun &) {
+    G_LIMITER.reset();
+}
+
+/**
+ * Tenant A holds its one-slot quota and has a second request queued
+ * behind it; `batch` acquires of tenant B must pass that waiter instead of
+ * waiting for A's release. Latency is B's acquire; a shed B fails the run.
+ */
+static uint64_t mixedTenants(BenchRun &run) {
+    ConcurrencyLimiter &limiter = *G_LIMITER;
+    if (!limiter.acquire("A")) {
+        throw runtime_error("limiter.mixed_tenants: tenant A was shed");
+    }
+    thread queuedA([&limiter] {
+        if (limiter.acquire("A")) {
+            limiter.release("A", 1000);
+        }
+    });
+    while (limiter.queued() == 0) {
+        this_thread::yield();
+    }
+    unsigned int shed = 0;
+    for (unsigned int i = 0; i < run.params.batch; ++i) {
+        auto start = chrono::steady_clock::now();
+        bool admitted = limiter.acquire("B");
+        run.latency.record((uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+                chrono::steady_clock::now() - start).count());
+        if (admitted) {
+            limiter.release("B", 1000);
+        } else {
+            ++shed;
+        }
+    }
+    limiter.release("A", 1000);
+    queuedA.join();
+    if (shed) {
+        throw runtime_error("limiter.mixed_tenants: " + to_string(shed) + " tenant B acquires shed behind A's "
+                            "quota-blocked waiter");
+    }
+    return run.params.batch;
+}
+
+// shard.route: 三个 stand-in 分片, 和 main.cpp 的 G_SHARDS 一样按 40 个 chunk 一段
+static const unsigned int SHARD_CHUNKS = 120;
+static unique_ptr<ShardRouter> G_SHARD_ROUTER;
+static unsigned int G_SHARD_ROUND = 0;
+
+static void openShards(BenchRun &run) {
+    defineFetchTable(run.params);
+    G_SHARD_ROUTER.reset(new ShardRouter(run.env, SHARD_CHUNKS, 2));
+    G_SHARD_ROUTER->addShard({"shard1", "bench-shard1", 0, 39, ""});
+    G_SHARD_ROUTER->addShard({"shard2", "bench-shard2", 40, 79, ""});
+    G_SHARD_ROUTER->addShard({"shard3", "bench-shard3", 80, 119, ""});
+    if (!G_SHARD_ROUTER->open("bench", "bench")) {
+        throw runtime_error("shard.route: no shard opened");
+    }
+    if (G_SHARD_ROUTER->remap(50, 10, 0) || G_SHARD_ROUTER->remap(100, SHARD_CHUNKS, 0)) {
+        throw runtime_error("shard.route: remap accepted a bad chunk range");
+    }
+    G_SHARD_ROUND = 0;
+}
+
+static void closeShards(BenchRun &) {
+    G_SHARD_ROUTER.reset();
+}
+
+/**
+ * Routes `batch` sharding keys to their shards and runs a point query on
+ * each, after moving chunks 0-39 to shard3 on odd rounds and back to shard1
+ * on even ones. Throws when a key lands on a shard that does not own its
+ * chunk, so stale routing after remap() fails the scenario.
+ */
+static uint64_t shardRoute(BenchRun &run) {
+    ShardRouter &router = *G_SHARD_ROUTER;
+    int moved = G_SHARD_ROUND++ % 2 ? 2 : 0;
+    router.remap(0, 39, moved);
+    for (unsigned int i = 0; i < run.params.batch; ++i) {
+        string key = "customer-" + to_string(i);
+        unsigned int chunk = router.chunkOf(key);
+        int owner = chunk < 40 ? moved : (int) (chunk / 40);
+        ShardSession session = router.checkout(key);
+        if (session.shard != owner) {
+            router.release(session);
+            throw runtime_error("shard.route: " + key + " (chunk " + to_string(chunk) + ") routed to shard " +
+                                to_string(session.shard) + ", owner " + to_string(owner));
+        }
+        Statement *stmt = session.conn->createStatement(POINT_SQL);
+        stmt->setInt(1, (int) (i % std::max<uint64_t>(1, run.params.rows)) + 1);
+        ResultSet *rs = stmt->executeQuery();
+        if (rs->next()) {
+            G_SINK = rs->getString(1).size();
+        }
+        stmt->closeResultSet(rs);
+        session.conn->terminateStatement(stmt);
+        router.release(session);
+    }
+    return run.params.batch;
+}
+
+static unique_ptr<JobScheduler> G_SCHEDULER;
+
+static void startScheduler(BenchRun &run) {
+    defineFetchTable(run.params);
+    G_SCHEDULER.reset(new JobScheduler(run.env, "bench", "bench", "bench", run.params.threads));
+    G_SCHEDULER->start();
+    run.ownLatency = true;
+}
+
+static void stopScheduler(BenchRun &) {
+    G_SCHEDULER.reset();
+}
+
+/**
+ * 2 * `threads` full scans of bench_fetch submitted ahead of `batch` point
+ * lookups on a scheduler with `threads` workers. Latency is the lookups'
+ * (submit to done). prioritized: lookups are INTERACTIVE and scans BULK
+ * (capped at half the workers); otherwise everything is one BATCH class,
+ * as when every job is treated alike.
+ */
+static uint64_t mixedJobs(BenchRun &run, bool prioritized) {
+    unsigned int scans = run.params.threads * 2;
+    unsigned int lookups = run.params.batch;
+    mutex lock;
+    condition_variable finished;
+    unsigned int left = scans + lookups;
+    auto done = [&](uint64_t latencyNs) {
+        lock_guard<mutex> guard(lock);
+        if (latencyNs) {
+            run.latency.record(latencyNs);
+        }
+        if (0 == --left) {
+            finished.notify_one();
+        }
+    };
+    for (unsigned int i = 0; i < scans; ++i) {
+        G_SCHEDULER->submit(prioritized ? JobClass::BULK : JobClass::BATCH, [&](Connection *conn) {
+            Statement *stmt = conn->createStatement(FETCH_SQL);
+            stmt->setPrefetchRowCount(run.params.batch);
+            ResultSet *rs = stmt->executeQuery();
+            uint64_t sink = 0;
+            while (rs->next() != ResultSet::END_OF_FETCH) {
+                sink += rs->getString(2).size();
+            }
+            stmt->closeResultSet(rs);
+            conn->terminateStatement(stmt);
+            G_SINK = sink;
+            done(0);
+        });
+    }
+    for (unsigned int i = 0; i < lookups; ++i) {
+        auto start = chrono::steady_clock::now();
+        G_SCHEDULER->submit(prioritized ? JobClass::INTERACTIVE : JobClass::BATCH, [&, i, start](Connection *conn) {
+            Statement *stmt = conn->createStatement(POINT_SQL);
+            stmt->setInt(1, (int) (i % std::max<uint64_t>(1, run.params.rows)) + 1);
+            ResultSet *rs = stmt->executeQuery();
+            if (rs->next()) {
+                G_SINK = rs->getString(1).size();
+            }
+            stmt->closeResultSet(rs);
+            conn->terminateStatement(stmt);
+            done((uint64_t) chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+        });
+    }
+    unique_lock<mutex> guard(lock);
+    finished.wait(guard, [&] { return 0 == left; });
+    return lookups;
+}
+
+vector<BenchScenario> benchScenarios() {
+    auto fetchSetup = [](BenchRun &run) { defineFetchTable(run.params); };
+    auto none = [](BenchRun &) {};
+    return {
+            {"fetch.per_row", "fetch", fetchSetup, [](BenchRun &run) { return fetchRows(run, 0, false); }, none},
+            {"fetch.array", "fetch", fetchSetup, [](BenchRun &run) { return fetchArray(run, nullptr); }, none, 0.1},
+            {"fetch.array_adaptive", "fetch",
+             [](BenchRun &run) {
+                 defineFetchTable(run.params);
+                 startBatchController(run, "bench_fetch");
+             },
+             [](BenchRun &run) { return fetchArray(run, G_BATCH_CONTROLLER.get()); }, stopBatchController, 0.1},
+            {"fetch.get_string", "fetch", fetchSetup,
+             [](BenchRun &run) { return fetchRows(run, run.params.batch, false); }, none},
+            {"fetch.typed", "fetch", fetchSetup,
+             [](BenchRun &run) { return fetchRows(run, run.params.batch, true); }, none, 2.5},
+            {"dml.single", "dml", none, insertSingle, none, 0.1},
+            {"dml.array", "dml", none, [](BenchRun &run) { return insertArray(run, nullptr); }, none, 0.1},
+            {"dml.array_adaptive", "dml", [](BenchRun &run) { startBatchController(run, "bench_dml"); },
+             [](BenchRun &run) { return insertArray(run, G_BATCH_CONTROLLER.get()); }, stopBatchController, 0.1},
+            {"stmt.recreate", "stmt", fetchSetup, [](BenchRun &run) { return pointQueries(run, false); }, none},
+            {"stmt.cached", "stmt",
+             [](BenchRun &run) {
+                 defineFetchTable(run.params);
+                 run.conn->setStmtCacheSize(20);
+             },
+             [](BenchRun &run) { return pointQueries(run, false); },
+             [](BenchRun &run) { run.conn->setStmtCacheSize(0); }},
+            {"stmt.reuse", "stmt", fetchSetup, [](BenchRun &run) { return pointQueries(run, true); }, none, 1.5},
+            {"pool.contention", "pool",
+             [](BenchRun &run) {
+                 StandinBackend::instance().defineTable(
+                         {"DUAL", 1, {{"DUMMY", StandinType::VARCHAR, StandinDistribution::CONSTANT, 0, 0, 1}}, 1});
+                 run.ownLatency = true;
+             },
+             poolContention, none},
+            {"async.thread_per_query", "async", openAsyncSessions, threadPerQuery, closeAsyncSessions},
+            {"async.event_loop", "async", startAsyncExecutor, eventLoop, closeAsyncSessions},
+            {"shard.route", "shard", openShards, shardRoute, closeShards},
+            {"limiter.mixed_tenants", "limiter", startLimiter, mixedTenants, stopLimiter},
+            {"sched.single_class", "sched", startScheduler,
+             [](BenchRun &run) { return mixedJobs(run, false); }, stopScheduler},
+            {"sched.priority", "sched", startScheduler,
+             [](BenchRun &run) { return mixedJobs(run, true); }, stopScheduler},
+            {"fetch.format_heap", "fetch", openAsyncSessions,
+             [](BenchRun &run) { return parallelFormat(run, false); }, closeAsyncSessions},
+            {"fetch.format_arena", "fetch", openAsyncSessions,
+             [](BenchRun &run) { return parallelFormat(run, true); }, closeAsyncSessions, 0.1},
+            {"fetch.oci_heap_default", "fetch", openAsyncSessions, statementChurn, closeAsyncSessions},
+            {"fetch.oci_heap_custom", "fetch", openHeapSessions, statementChurn, closeHeapSessions},
+            {"fetch.budgeted", "fetch",
+             [](BenchRun &run) {
+                 openAsyncSessions(run);
+                 MemoryGovernor::instance().setBudget(256 * 1024);
+             },
+             budgetedFetch,
+             [](BenchRun &run) {
+                 MemoryGovernor::instance().setBudget(0);
+                 closeAsyncSessions(run);
+             }},
+#ifdef OCI_DEMO_COROUTINES
+            {"async.coroutine_fanout", "async", startAsyncExecutor, coroutineFanout, closeAsyncSessions},
+#endif
+    };
+}
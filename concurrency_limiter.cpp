@@ -0,0 +1,164 @@
+#include "concurrency_limiter.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+ConcurrencyLimiter::ConcurrencyLimiter(const string &name, const LimiterOptions &options)
+        : limiterName(name), options(options) {
+    this->options.minLimit = std::max(1u, options.minLimit);
+    this->options.maxLimit = std::max(this->options.minLimit, options.maxLimit);
+    estimate = std::min<double>(std::max(options.initialLimit, this->options.minLimit), this->options.maxLimit);
+    publish();
+
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    labels = metricLabel("limiter", name);
+    queueWait = metrics.histogram("oci_limiter_queue_wait_seconds", labels);
+    gaugeIds.push_back(metrics.addGauge("oci_limiter_limit", labels, [this] { return (double) limit(); }));
+    gaugeIds.push_back(metrics.addGauge("oci_limiter_in_flight", labels, [this] { return (double) inFlight(); }));
+    gaugeIds.push_back(metrics.addGauge("oci_limiter_queued", labels, [this] { return (double) queued(); }));
+}
+
+ConcurrencyLimiter::~ConcurrencyLimiter() {
+    for (int id: gaugeIds) {
+        MetricsRegistry::instance().removeGauge(id);
+    }
+}
+
+ConcurrencyLimiter::Tenant &ConcurrencyLimiter::tenant(const string &name) {
+    auto it = tenants.find(name);
+    if (it == tenants.end()) {
+        it = tenants.emplace(name, Tenant()).first;
+        it->second.shed = MetricsRegistry::instance().counter(
+                "oci_limiter_shed_total", labels + "," + metricLabel("tenant", name));
+    }
+    return it->second;
+}
+
+void ConcurrencyLimiter::setTenantQuota(const string &name, unsigned int quota) {
+    lock_guard<mutex> guard(lock);
+    Tenant &t = tenant(name);
+    t.quota = quota;
+    t.quotaSet = true;
+    grantWaiters();
+    publish();
+}
+
+bool ConcurrencyLimiter::admit(Tenant &t) const {
+    if (running >= (unsigned int) estimate) {
+        return false;
+    }
+    unsigned int quota = t.quotaSet ? t.quota : options.tenantQuota;
+    return 0 == quota || t.inFlight < quota;
+}
+
+void ConcurrencyLimiter::grant(Tenant &t) {
+    ++running;
+    ++t.inFlight;
+    windowPeak = std::max(windowPeak, running);
+}
+
+void ConcurrencyLimiter::grantWaiters() {
+    for (auto it = waiters.begin(); it != waiters.end() && running < (unsigned int) estimate;) {
+        Tenant &t = tenant((*it)->tenant);
+        if (!admit(t)) {
+            ++it;
+            continue;
+        }
+        grant(t);
+        (*it)->granted = true;
+        (*it)->ready.notify_one();
+        it = waiters.erase(it);
+    }
+}
+
+bool ConcurrencyLimiter::acquire(const string &name) {
+    auto start = chrono::steady_clock::now();
+    unique_lock<mutex> guard(lock);
+    Tenant &t = tenant(name);
+    // 前面有人排队时不插队
+    if (waiters.empty() && admit(t)) {
+        grant(t);
+        publish();
+        queueWait->observe(0);
+        return true;
+    }
+    if (waiters.size() >= options.maxQueue || options.maxWait.count() <= 0) {
+        ++shedCount;
+        t.shed->add();
+        return false;
+    }
+    Waiter waiter;
+    waiter.tenant = name;
+    waiters.push_back(&waiter);
+    // 排在前面的可能都卡在各自租户的配额上, 这时新来的不用等 release 也能进
+    grantWaiters();
+    publish();
+    waiter.ready.wait_until(guard, start + options.maxWait, [&] { return waiter.granted; });
+    queueWait->observe(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    if (waiter.granted) {
+        return true;
+    }
+    waiters.erase(std::find(waiters.begin(), waiters.end(), &waiter));
+    publish();
+    ++shedCount;
+    t.shed->add();
+    return false;
+}
+
+void ConcurrencyLimiter::release(const string &name, uint64_t latencyNs, bool failed) {
+    lock_guard<mutex> guard(lock);
+    Tenant &t = tenant(name);
+    if (running > 0) {
+        --running;
+    }
+    if (t.inFlight > 0) {
+        --t.inFlight;
+    }
+    updateLimit(latencyNs, failed);
+    grantWaiters();
+    publish();
+}
+
+void ConcurrencyLimiter::publish() {
+    shownLimit.store((unsigned int) estimate, memory_order_relaxed);
+    shownRunning.store(running, memory_order_relaxed);
+    shownQueued.store((unsigned int) waiters.size(), memory_order_relaxed);
+}
+
+void ConcurrencyLimiter::updateLimit(uint64_t latencyNs, bool failed) {
+    if (failed) {
+        estimate = std::max<double>(options.minLimit, estimate * 0.9);
+        return;
+    }
+    windowSum += (double) latencyNs;
+    ++windowSamples;
+    if (windowSamples < std::max(10u, (unsigned int) estimate)) {
+        return;
+    }
+    double shortRtt = std::max(1.0, windowSum / windowSamples);
+    bool used = windowPeak * 2 >= (unsigned int) estimate;
+    windowSum = 0;
+    windowSamples = 0;
+    windowPeak = running;
+
+    // 基线是无负载时的延迟: 更低的窗口立刻采纳, 更高的只按 baselineDrift 的时间常数慢慢跟上,
+    // 否则上限放大 -> 延迟变高 -> 基线跟着变高, 上限会一路涨到 maxLimit
+    auto now = chrono::steady_clock::now();
+    if (baseline <= 0 || shortRtt <= baseline) {
+        baseline = shortRtt;
+    } else {
+        double elapsed = chrono::duration<double>(now - baselineAt).count();
+        double drift = chrono::duration<double>(options.baselineDrift).count();
+        baseline += (shortRtt - baseline) * std::min(1.0, drift > 0 ? elapsed / drift : 1.0);
+    }
+    baselineAt = now;
+    double gradient = std::max(0.5, std::min(1.0, options.tolerance * baseline / shortRtt));
+    double next = estimate * gradient + std::sqrt(estimate);
+    if (!used) {
+        next = std::min(next, estimate);
+    }
+    next = estimate * (1 - options.smoothing) + next * options.smoothing;
+    estimate = std::max<double>(options.minLimit, std::min<double>(options.maxLimit, next));
+}
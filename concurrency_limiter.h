@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metrics.h"
+
+struct LimiterOptions {
+    unsigned int initialLimit = 8;
+    unsigned int minLimit = 1;
+    unsigned int maxLimit = 64;
+    // 排队最多等这么久, 超时即拒绝 (shed)
+    std::chrono::milliseconds maxWait{50};
+    unsigned int maxQueue = 256;
+    // 短期平均延迟超过长期基线的这个倍数才开始收缩
+    double tolerance = 1.5;
+    // 每个窗口新算出的上限只占这么大权重
+    double smoothing = 0.2;
+    // 延迟基线向上跟随的时间常数: 持续这么久的变慢才被当成新常态
+    std::chrono::seconds baselineDrift{60};
+    // 租户默认的在途上限, 0 = 只受总上限约束
+    unsigned int tenantQuota = 0;
+};
+
+/**
+ * Admission control with an adaptive concurrency limit, in front of a
+ * SessionPool (SessionPool::setLimiter) or any other resource.
+ *
+ * Callers take a slot with acquire() and give it back with release() and
+ * the latency of what they did with it. Once per window (max(10, limit)
+ * samples) the limit follows the gradient between the long-term latency
+ * baseline and the window's average:
+ *
+ *   gradient = clamp(tolerance * longRtt / shortRtt, 0.5, 1)
+ *   limit    = limit * gradient + sqrt(limit)
+ *
+ * (smoothed, within [minLimit, maxLimit]), so it probes upward while
+ * latency holds and backs off as soon as the database slows down. A failed
+ * call (timeout, ORA- error that points at an overloaded server) cuts the
+ * limit by 10% at once, the multiplicative-decrease half of AIMD. The limit
+ * only grows when it was actually used, so an idle client does not drift
+ * towards maxLimit.
+ *
+ * Callers over the limit wait in FIFO order up to maxWait and are then
+ * shed, as are arrivals beyond maxQueue waiters; this queues the excess on
+ * the client instead of piling sessions onto a struggling server. Each
+ * tenant may also hold at most its quota of slots; a waiter whose tenant
+ * is at quota lets the ones behind it pass.
+ */
+class ConcurrencyLimiter {
+public:
+    explicit ConcurrencyLimiter(const std::string &name, const LimiterOptions &options = LimiterOptions());
+
+    ~ConcurrencyLimiter();
+
+    ConcurrencyLimiter(const ConcurrencyLimiter &) = delete;
+
+    ConcurrencyLimiter &operator=(const ConcurrencyLimiter &) = delete;
+
+    /**
+     * Most slots the tenant may hold at once; 0 = no quota beyond the limit.
+     */
+    void setTenantQuota(const std::string &tenant, unsigned int quota);
+
+    /**
+     * false: shed (queue full or maxWait passed), do not run the request.
+     */
+    bool acquire(const std::string &tenant = "");
+
+    /**
+     * latencyNs: how long the slot was used for; failed: the call failed in
+     * a way that suggests overload.
+     */
+    void release(const std::string &tenant, uint64_t latencyNs, bool failed = false);
+
+    // 读的是发布出来的快照, 不拿锁: 指标抓取时会在注册表的锁里调用这几个
+    unsigned int limit() const { return shownLimit.load(std::memory_order_relaxed); }
+
+    unsigned int inFlight() const { return shownRunning.load(std::memory_order_relaxed); }
+
+    unsigned int queued() const { return shownQueued.load(std::memory_order_relaxed); }
+
+    uint64_t shed() const { return shedCount.load(std::memory_order_relaxed); }
+
+    const std::string &name() const { return limiterName; }
+
+private:
+    struct Waiter {
+        std::string tenant;
+        std::condition_variable ready;
+        bool granted = false;
+    };
+
+    struct Tenant {
+        unsigned int inFlight = 0;
+        unsigned int quota = 0;
+        bool quotaSet = false;
+        MetricCounter *shed = nullptr;
+    };
+
+    Tenant &tenant(const std::string &name);
+
+    bool admit(Tenant &t) const;
+
+    void grant(Tenant &t);
+
+    void grantWaiters();
+
+    void updateLimit(uint64_t latencyNs, bool failed);
+
+    void publish();
+
+    std::string limiterName;
+    LimiterOptions options;
+    mutable std::mutex lock;
+    double estimate;
+    unsigned int running = 0;
+    std::deque<Waiter *> waiters;
+    std::map<std::string, Tenant> tenants;
+    std::atomic<uint64_t> shedCount{0};
+    std::atomic<unsigned int> shownLimit{0};
+    std::atomic<unsigned int> shownRunning{0};
+    std::atomic<unsigned int> shownQueued{0};
+
+    // 当前窗口
+    double windowSum = 0;
+    unsigned int windowSamples = 0;
+    unsigned int windowPeak = 0;
+    double baseline = 0;
+    std::chrono::steady_clock::time_point baselineAt;
+
+    std::string labels;
+    MetricHistogram *queueWait;
+    std::vector<int> gaugeIds;
+};
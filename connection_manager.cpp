@@ -0,0 +1,251 @@
+#include "connection_manager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+
+#include "logger.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+// 错误率超过该值的节点暂时不参与选择 (除非已经没有其他节点)
+static const double EJECT_ERROR_RATE = 0.5;
+
+static void ewmaUpdate(atomic<double> &value, double sample, double alpha) {
+    double current = value.load(memory_order_relaxed);
+    double next;
+    do {
+        next = current < 0 ? sample : current + alpha * (sample - current);
+    } while (!value.compare_exchange_weak(current, next, memory_order_relaxed));
+}
+
+static int64_t nowNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static unsigned int randomIndex(unsigned int bound) {
+    thread_local minstd_rand rng(random_device{}());
+    return (unsigned int) (rng() % bound);
+}
+
+ConnectionManager::ConnectionManager(Environment *env, double alpha)
+        : env(env), alpha(alpha) {
+}
+
+ConnectionManager::~ConnectionManager() {
+    close();
+}
+
+void ConnectionManager::addEndpoint(const EndpointConfig &config) {
+    unique_ptr<Endpoint> ep(new Endpoint());
+    ep->config = config;
+    ep->pool.reset(new SessionPool(env, config.connectString, config.maxSessions));
+    ep->ewmaLatencyUs = -1;
+    ep->errorRate = 0;
+    ep->inflight = 0;
+    ep->requests = 0;
+    for (auto &slot: ep->window) {
+        slot = 0;
+    }
+    ep->windowPos = 0;
+    ep->lastSampleNs = 0;
+    ep->available = false;
+    endpoints.push_back(std::move(ep));
+}
+
+bool ConnectionManager::open(const string &user, const string &pass) {
+    bool primary = false;
+    for (auto &ep: endpoints) {
+        ep->available = ep->pool->open(user, pass);
+        if (!ep->available) {
+            logWarn("endpoint %s unavailable", ep->config.name.c_str());
+        } else if (ep->config.role == EndpointRole::PRIMARY) {
+            primary = true;
+        }
+    }
+    return primary;
+}
+
+void ConnectionManager::close() {
+    for (auto &ep: endpoints) {
+        ep->pool->close();
+        ep->available = false;
+    }
+}
+
+double ConnectionManager::freshness(int64_t lastSample, int64_t now) {
+    if (0 == lastSample || now <= lastSample) {
+        return 1.0;
+    }
+    return pow(0.5, (double) (now - lastSample) / 1e9 / STATS_HALF_LIFE_SECONDS);
+}
+
+double ConnectionManager::meanLatencyUs() const {
+    double sum = 0;
+    int known = 0;
+    for (const auto &other: endpoints) {
+        double l = other->ewmaLatencyUs.load(memory_order_relaxed);
+        if (l >= 0) {
+            sum += l;
+            ++known;
+        }
+    }
+    return known ? sum / known : 1000.0;
+}
+
+double ConnectionManager::errorRate(const Endpoint &ep) const {
+    return ep.errorRate.load(memory_order_relaxed) * freshness(ep.lastSampleNs.load(memory_order_relaxed), nowNs());
+}
+
+double ConnectionManager::latencyUs(const Endpoint &ep) const {
+    double latency = ep.ewmaLatencyUs.load(memory_order_relaxed);
+    // 还没有样本的节点按已知节点的平均延迟估计, 既能被探测到又不会被一拥而上
+    double mean = meanLatencyUs();
+    if (latency < 0) {
+        return mean;
+    }
+    return mean + (latency - mean) * freshness(ep.lastSampleNs.load(memory_order_relaxed), nowNs());
+}
+
+double ConnectionManager::score(const Endpoint &ep) const {
+    double latency = latencyUs(ep);
+    double health = 1.0 - errorRate(ep);
+    if (health < 0.05) {
+        health = 0.05;
+    }
+    return latency * (ep.inflight.load(memory_order_relaxed) + 1) / health;
+}
+
+int ConnectionManager::pick(bool readOnly, int exclude) {
+    vector<int> candidates;
+    vector<int> ejected;
+    for (size_t i = 0; i < endpoints.size(); ++i) {
+        const Endpoint &ep = *endpoints[i];
+        if (!ep.available || (int) i == exclude) {
+            continue;
+        }
+        if (!readOnly && ep.config.role != EndpointRole::PRIMARY) {
+            continue;
+        }
+        if (errorRate(ep) > EJECT_ERROR_RATE) {
+            ejected.push_back((int) i);
+        } else {
+            candidates.push_back((int) i);
+        }
+    }
+    if (candidates.empty()) {
+        candidates.swap(ejected);
+    }
+    if (candidates.empty()) {
+        return -1;
+    }
+    if (candidates.size() == 1) {
+        return candidates[0];
+    }
+
+    // power of two choices
+    unsigned int n = (unsigned int) candidates.size();
+    unsigned int a = randomIndex(n);
+    unsigned int b = randomIndex(n - 1);
+    if (b >= a) {
+        ++b;
+    }
+    int first = candidates[a];
+    int second = candidates[b];
+    return score(*endpoints[first]) <= score(*endpoints[second]) ? first : second;
+}
+
+ManagedSession ConnectionManager::acquire(bool readOnly, int exclude) {
+    ManagedSession session;
+    for (size_t attempt = 0; attempt < endpoints.size(); ++attempt) {
+        int index = pick(readOnly, exclude);
+        if (index < 0) {
+            break;
+        }
+        Endpoint &ep = *endpoints[index];
+        auto start = chrono::steady_clock::now();
+        Connection *conn = ep.pool->checkout();
+        auto elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+        if (conn) {
+            ep.inflight.fetch_add(1, memory_order_relaxed);
+            session.conn = conn;
+            session.endpoint = index;
+            return session;
+        }
+        observe(index, elapsed, false);
+    }
+    logError("no endpoint available (%s)", readOnly ? "read-only" : "read-write");
+    return session;
+}
+
+void ConnectionManager::release(ManagedSession &session) {
+    if (nullptr == session.conn) {
+        return;
+    }
+    Endpoint &ep = *endpoints[session.endpoint];
+    ep.inflight.fetch_sub(1, memory_order_relaxed);
+    ep.pool->release(session.conn);
+    session.conn = nullptr;
+    session.endpoint = -1;
+}
+
+void ConnectionManager::drop(ManagedSession &session) {
+    if (nullptr == session.conn) {
+        return;
+    }
+    Endpoint &ep = *endpoints[session.endpoint];
+    ep.inflight.fetch_sub(1, memory_order_relaxed);
+    ep.pool->drop(session.conn);
+    session.conn = nullptr;
+    session.endpoint = -1;
+}
+
+void ConnectionManager::observe(int endpoint, chrono::microseconds latency, bool ok) {
+    if (endpoint < 0 || endpoint >= (int) endpoints.size()) {
+        return;
+    }
+    Endpoint &ep = *endpoints[endpoint];
+    ep.requests.fetch_add(1, memory_order_relaxed);
+    // 闲置期间淡化的统计先落回存储值, 新样本在它上面接着平滑; 同一段闲置只有一个线程拿到
+    int64_t now = nowNs();
+    double weight = freshness(ep.lastSampleNs.exchange(now, memory_order_relaxed), now);
+    if (weight < 1.0) {
+        ep.errorRate.store(ep.errorRate.load(memory_order_relaxed) * weight, memory_order_relaxed);
+        double latency = ep.ewmaLatencyUs.load(memory_order_relaxed);
+        if (latency >= 0) {
+            double mean = meanLatencyUs();
+            ep.ewmaLatencyUs.store(mean + (latency - mean) * weight, memory_order_relaxed);
+        }
+    }
+    ewmaUpdate(ep.errorRate, ok ? 0.0 : 1.0, alpha);
+    if (ok) {
+        ewmaUpdate(ep.ewmaLatencyUs, (double) latency.count(), alpha);
+        unsigned long long pos = ep.windowPos.fetch_add(1, memory_order_relaxed);
+        ep.window[pos % LATENCY_WINDOW].store((unsigned int) min<long long>(latency.count(), UINT32_MAX),
+                                              memory_order_relaxed);
+    }
+}
+
+chrono::microseconds ConnectionManager::latencyQuantile(int endpoint, double q) const {
+    const Endpoint &ep = *endpoints[endpoint];
+    size_t count = (size_t) min<unsigned long long>(ep.windowPos.load(memory_order_relaxed), LATENCY_WINDOW);
+    if (0 == count) {
+        return chrono::microseconds(-1);
+    }
+    vector<unsigned int> samples(count);
+    for (size_t i = 0; i < count; ++i) {
+        samples[i] = ep.window[i].load(memory_order_relaxed);
+    }
+    size_t rank = (size_t) (q * (count - 1));
+    nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return chrono::microseconds(samples[rank]);
+}
+
+EndpointStats ConnectionManager::stats(int endpoint) const {
+    const Endpoint &ep = *endpoints[endpoint];
+    double latency = ep.ewmaLatencyUs.load() < 0 ? -1.0 : latencyUs(ep);
+    return {latency, errorRate(ep), ep.inflight.load(), ep.requests.load()};
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "occi_common.h"
+#include "session_pool.h"
+
+enum class EndpointRole {
+    PRIMARY,
+    REPLICA
+};
+
+struct EndpointConfig {
+    std::string name;
+    std::string connectString;
+    EndpointRole role;
+    unsigned int maxSessions;
+};
+
+/**
+ * A session handed out by the ConnectionManager, remembers where it came from.
+ */
+struct ManagedSession {
+    oracle::occi::Connection *conn = nullptr;
+    int endpoint = -1;
+};
+
+struct EndpointStats {
+    double ewmaLatencyUs;
+    double errorRate;
+    int inflight;
+    unsigned long long requests;
+};
+
+/**
+ * Spreads sessions over several endpoints (a primary plus read replicas).
+ *
+ * Every endpoint keeps an EWMA of observed round-trip latency and of its error
+ * rate. Read-write sessions go to primaries, read-only sessions may go anywhere;
+ * within the eligible set two endpoints are sampled at random and the one with
+ * the lower latency * load score wins (power of two choices), so a slow replica
+ * quickly stops receiving new work without all traffic herding onto one node.
+ *
+ * Stats only move when an endpoint is used, so an endpoint that is not used
+ * has its stats fade with time since its last sample (half-life
+ * STATS_HALF_LIFE): the error rate decays towards 0 and the latency towards
+ * the mean of the others. An ejected or slow-looking endpoint thus gets
+ * picked again after a while, and its next calls decide whether it stays.
+ */
+class ConnectionManager {
+public:
+    explicit ConnectionManager(oracle::occi::Environment *env, double alpha = 0.2);
+
+    ~ConnectionManager();
+
+    ConnectionManager(const ConnectionManager &) = delete;
+
+    ConnectionManager &operator=(const ConnectionManager &) = delete;
+
+    void addEndpoint(const EndpointConfig &config);
+
+    bool open(const std::string &user, const std::string &pass);
+
+    void close();
+
+    /**
+     * exclude keeps one endpoint out of the choice, e.g. the one a hedged
+     * request is already waiting on.
+     */
+    ManagedSession acquire(bool readOnly, int exclude = -1);
+
+    void release(ManagedSession &session);
+
+    /**
+     * Destroys the session instead of returning it to its pool, e.g. after
+     * an OCIBreak left it in an unknown state.
+     */
+    void drop(ManagedSession &session);
+
+    /**
+     * Feeds one observed call latency (or failure) back into the endpoint's score.
+     */
+    void observe(int endpoint, std::chrono::microseconds latency, bool ok);
+
+    EndpointStats stats(int endpoint) const;
+
+    /**
+     * Latency quantile (0..1) over the endpoint's most recent successful calls,
+     * or -1 when nothing has been observed yet.
+     */
+    std::chrono::microseconds latencyQuantile(int endpoint, double q) const;
+
+    const EndpointConfig &endpoint(int index) const { return endpoints[index]->config; }
+
+    size_t endpointCount() const { return endpoints.size(); }
+
+private:
+    static const size_t LATENCY_WINDOW = 512;
+
+    static constexpr double STATS_HALF_LIFE_SECONDS = 10.0;
+
+    struct Endpoint {
+        EndpointConfig config;
+        std::unique_ptr<SessionPool> pool;
+        std::atomic<double> ewmaLatencyUs;
+        std::atomic<double> errorRate;
+        std::atomic<int> inflight;
+        std::atomic<unsigned long long> requests;
+        std::array<std::atomic<unsigned int>, LATENCY_WINDOW> window;
+        std::atomic<unsigned long long> windowPos;
+        // steady_clock 纳秒, 0 = 还没有样本
+        std::atomic<int64_t> lastSampleNs;
+        bool available;
+    };
+
+    /**
+     * Weight (0..1] the stored stats still carry after idling since lastSample.
+     */
+    static double freshness(int64_t lastSample, int64_t now);
+
+    double meanLatencyUs() const;
+
+    double errorRate(const Endpoint &ep) const;
+
+    double latencyUs(const Endpoint &ep) const;
+
+    double score(const Endpoint &ep) const;
+
+    int pick(bool readOnly, int exclude);
+
+    oracle::occi::Environment *env;
+    double alpha;
+    std::vector<std::unique_ptr<Endpoint>> endpoints;
+};
@@ -0,0 +1,86 @@
+#include "coro_query.h"
+
+#ifdef OCI_DEMO_COROUTINES
+
+using namespace std;
+
+struct RowStream::State {
+    mutex lock;
+    deque<RowBatch> batches;
+    bool finished = false;
+    AsyncResult result;
+    coroutine_handle<> waiter;
+
+    // 在事件循环线程上调用, 等着的协程就地恢复
+    void wakeWaiter(unique_lock<mutex> &guard) {
+        coroutine_handle<> next = std::exchange(waiter, nullptr);
+        guard.unlock();
+        if (next) {
+            next.resume();
+        }
+    }
+};
+
+bool RowStream::NextAwaiter::await_ready() {
+    lock_guard<mutex> guard(state.lock);
+    return !state.batches.empty() || state.finished;
+}
+
+bool RowStream::NextAwaiter::await_suspend(coroutine_handle<> handle) {
+    lock_guard<mutex> guard(state.lock);
+    if (!state.batches.empty() || state.finished) {
+        return false;
+    }
+    state.waiter = handle;
+    return true;
+}
+
+optional<RowBatch> RowStream::NextAwaiter::await_resume() {
+    lock_guard<mutex> guard(state.lock);
+    if (state.batches.empty()) {
+        return nullopt;
+    }
+    RowBatch batch = std::move(state.batches.front());
+    state.batches.pop_front();
+    return batch;
+}
+
+const AsyncResult &RowStream::result() const {
+    return state->result;
+}
+
+CoroTask<AsyncResult> CoroDb::fetchAll(const string &sql, const vector<BindValue> &binds, unsigned int columns,
+                                       size_t width) {
+    auto state = make_shared<coro_detail::TaskState<AsyncResult>>();
+    executor.query(sql, binds, columns, [state](AsyncResult &result) {
+        state->value.emplace(std::move(result));
+        state->complete();
+    }, width);
+    return CoroTask<AsyncResult>(state);
+}
+
+RowStream CoroDb::query(const string &sql, const vector<BindValue> &binds, unsigned int columns, size_t width) {
+    auto state = make_shared<RowStream::State>();
+    executor.stream(sql, binds, columns, [state](RowBatch &rows) {
+        unique_lock<mutex> guard(state->lock);
+        state->batches.push_back(std::move(rows));
+        state->wakeWaiter(guard);
+    }, [state](AsyncResult &result) {
+        unique_lock<mutex> guard(state->lock);
+        state->result = std::move(result);
+        state->finished = true;
+        state->wakeWaiter(guard);
+    }, width);
+    return RowStream(state);
+}
+
+CoroTask<AsyncResult> CoroDb::update(const string &sql, const vector<BindValue> &binds, bool commit) {
+    auto state = make_shared<coro_detail::TaskState<AsyncResult>>();
+    executor.update(sql, binds, commit, [state](AsyncResult &result) {
+        state->value.emplace(std::move(result));
+        state->complete();
+    });
+    return CoroTask<AsyncResult>(state);
+}
+
+#endif
@@ -0,0 +1,247 @@
+#pragma once
+
+/**
+ * C++20 coroutine front end for AsyncExecutor. Opt-in: configure with
+ * -DOCI_DEMO_COROUTINES=ON, which also raises the build to C++20; without it
+ * this header is empty and the tree stays C++17.
+ *
+ *   CoroTask<size_t> handler(CoroDb &db, int id) {
+ *       // both statements are submitted here and run concurrently
+ *       CoroTask<AsyncResult> user = db.fetchAll("SELECT name FROM users WHERE id = :1", {{1, BindType::INT, id}}, 1);
+ *       RowStream orders = db.query("SELECT id, amount FROM orders WHERE user_id = :1", {{1, BindType::INT, id}}, 2);
+ *       size_t n = 0;
+ *       while (auto batch = co_await orders.next()) {
+ *           n += batch->size();
+ *       }
+ *       AsyncResult u = co_await user;
+ *       co_return u.ok && orders.result().ok ? n : 0;
+ *   }
+ *
+ * Tasks start eagerly and run until their first co_await on something not
+ * yet done; they continue on the event-loop thread that completed it, so
+ * keep the work between awaits short. Statement errors come back in
+ * AsyncResult (no exceptions); exceptions thrown by a coroutine body are
+ * rethrown where the task is awaited or get() is called.
+ */
+
+#ifdef OCI_DEMO_COROUTINES
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "async_executor.h"
+
+template<typename T>
+class CoroTask;
+
+namespace coro_detail {
+
+    /**
+     * What a CoroTask and whoever completes it share: the result, and the
+     * one coroutine (or get() caller) waiting for it.
+     */
+    template<typename T>
+    struct TaskState {
+        typedef std::conditional_t<std::is_void_v<T>, std::monostate, T> Value;
+
+        std::mutex lock;
+        std::condition_variable finished;
+        bool done = false;
+        std::optional<Value> value;
+        std::exception_ptr error;
+        std::coroutine_handle<> waiter;
+
+        bool ready() {
+            std::lock_guard<std::mutex> guard(lock);
+            return done;
+        }
+
+        /**
+         * false: already done, the awaiting coroutine carries on at once.
+         */
+        bool suspend(std::coroutine_handle<> handle) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (done) {
+                return false;
+            }
+            waiter = handle;
+            return true;
+        }
+
+        void complete() {
+            std::coroutine_handle<> next;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                done = true;
+                next = std::exchange(waiter, nullptr);
+            }
+            finished.notify_all();
+            if (next) {
+                next.resume();
+            }
+        }
+
+        void wait() {
+            std::unique_lock<std::mutex> guard(lock);
+            finished.wait(guard, [this] { return done; });
+        }
+
+        T take() {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            if constexpr (std::is_void_v<T>) {
+                return;
+            } else {
+                return std::move(*value);
+            }
+        }
+    };
+
+    template<typename T>
+    struct FinalAwaiter {
+        std::shared_ptr<TaskState<T>> state;
+
+        bool await_ready() noexcept { return false; }
+
+        // 先销毁协程帧再唤醒等待者, 等待者可能在别的线程立刻析构 task
+        void await_suspend(std::coroutine_handle<> handle) noexcept {
+            std::shared_ptr<TaskState<T>> finishing = std::move(state);
+            handle.destroy();
+            finishing->complete();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    template<typename T>
+    struct PromiseBase {
+        std::shared_ptr<TaskState<T>> state = std::make_shared<TaskState<T>>();
+
+        CoroTask<T> get_return_object();
+
+        std::suspend_never initial_suspend() noexcept { return {}; }
+
+        FinalAwaiter<T> final_suspend() noexcept { return {state}; }
+
+        void unhandled_exception() { state->error = std::current_exception(); }
+    };
+
+    template<typename T>
+    struct Promise : PromiseBase<T> {
+        void return_value(T value) { this->state->value.emplace(std::move(value)); }
+    };
+
+    template<>
+    struct Promise<void> : PromiseBase<void> {
+        void return_void() { state->value.emplace(); }
+    };
+}
+
+/**
+ * An eagerly started coroutine, or a statement submitted through CoroDb.
+ * Await it once (co_await) from a coroutine, or block on get() from plain
+ * code such as main().
+ */
+template<typename T = void>
+class CoroTask {
+public:
+    typedef coro_detail::Promise<T> promise_type;
+
+    explicit CoroTask(std::shared_ptr<coro_detail::TaskState<T>> state) : state(std::move(state)) {}
+
+    bool await_ready() const { return state->ready(); }
+
+    bool await_suspend(std::coroutine_handle<> handle) { return state->suspend(handle); }
+
+    T await_resume() { return state->take(); }
+
+    T get() {
+        state->wait();
+        return state->take();
+    }
+
+private:
+    std::shared_ptr<coro_detail::TaskState<T>> state;
+};
+
+template<typename T>
+CoroTask<T> coro_detail::PromiseBase<T>::get_return_object() {
+    return CoroTask<T>(state);
+}
+
+typedef std::vector<std::vector<std::string>> RowBatch;
+
+/**
+ * Async generator of the row batches of one query:
+ *
+ *   while (auto batch = co_await rows.next()) { ... *batch ... }
+ *
+ * next() yields nothing once the query has ended; result() then says
+ * whether it ended with an error. Batches the consumer has not asked for
+ * yet are buffered, the executor does not wait for them.
+ */
+class RowStream {
+public:
+    struct State;
+
+    class NextAwaiter {
+    public:
+        explicit NextAwaiter(State &state) : state(state) {}
+
+        bool await_ready();
+
+        bool await_suspend(std::coroutine_handle<> handle);
+
+        std::optional<RowBatch> await_resume();
+
+    private:
+        State &state;
+    };
+
+    explicit RowStream(std::shared_ptr<State> state) : state(std::move(state)) {}
+
+    NextAwaiter next() { return NextAwaiter(*state); }
+
+    /**
+     * Status and row count; complete once next() has yielded nothing.
+     */
+    const AsyncResult &result() const;
+
+private:
+    std::shared_ptr<State> state;
+};
+
+/**
+ * Coroutine-returning calls on an AsyncExecutor (started, with its
+ * sessions, by the caller). Every call submits its statement immediately,
+ * so a handler overlaps its queries by issuing them all before awaiting
+ * any.
+ */
+class CoroDb {
+public:
+    explicit CoroDb(AsyncExecutor &executor) : executor(executor) {}
+
+    CoroTask<AsyncResult> fetchAll(const std::string &sql, const std::vector<BindValue> &binds,
+                                   unsigned int columns, size_t width = 256);
+
+    RowStream query(const std::string &sql, const std::vector<BindValue> &binds, unsigned int columns,
+                    size_t width = 256);
+
+    CoroTask<AsyncResult> update(const std::string &sql, const std::vector<BindValue> &binds, bool commit = false);
+
+private:
+    AsyncExecutor &executor;
+};
+
+#endif
@@ -0,0 +1,275 @@
+#include "db_result.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+using namespace oracle::occi;
+
+static bool succeeded(sword status) {
+    return status == OCI_SUCCESS || status == OCI_SUCCESS_WITH_INFO;
+}
+
+DbSession::DbSession(Environment *env, Connection *conn) : svc(nullptr), server(nullptr), err(nullptr) {
+    if (nullptr == env || nullptr == conn) {
+        return;
+    }
+    void *handle = nullptr;
+    if (!succeeded(OCIHandleAlloc(env->getOCIEnvironment(), &handle, OCI_HTYPE_ERROR, 0, nullptr))) {
+        return;
+    }
+    err = (OCIError *) handle;
+    svc = conn->getOCIServiceContext();
+    server = conn->getOCIServer();
+}
+
+DbSession::~DbSession() {
+    if (err) {
+        OCIHandleFree(err, OCI_HTYPE_ERROR);
+    }
+}
+
+DbResult<void> DbSession::setNonBlocking(bool on) {
+    if (!valid()) {
+        return fail(OCI_INVALID_HANDLE);
+    }
+    if (on == nonBlocking()) {
+        return DbResult<void>();
+    }
+    // 设置这个属性是在两种模式间切换, 值本身不起作用
+    ub1 mode = on ? 1 : 0;
+    sword status = OCIAttrSet(server, OCI_HTYPE_SERVER, &mode, 0, OCI_ATTR_NONBLOCKING_MODE, err);
+    if (!succeeded(status)) {
+        return fail(status);
+    }
+    return DbResult<void>();
+}
+
+bool DbSession::nonBlocking() const {
+    ub1 mode = 0;
+    if (!valid() || !succeeded(OCIAttrGet(server, OCI_HTYPE_SERVER, &mode, nullptr, OCI_ATTR_NONBLOCKING_MODE, err))) {
+        return false;
+    }
+    return mode != 0;
+}
+
+const DbError &DbSession::fail(sword status) {
+    if (status == OCI_STILL_EXECUTING) {
+        // 轮询时每次都会走到这里, 不查错误句柄也不格式化
+        error.code = status;
+        strcpy(error.message, "still executing");
+        return error;
+    }
+    sb4 code = 0;
+    error.message[0] = '\0';
+    if (status == OCI_INVALID_HANDLE || nullptr == err ||
+        !succeeded(OCIErrorGet(err, 1, nullptr, &code, (OraText *) error.message, sizeof(error.message),
+                               OCI_HTYPE_ERROR))) {
+        // 拿不到 ORA 号时用状态码本身
+        code = status;
+        snprintf(error.message, sizeof(error.message), "OCI call failed with status %d", (int) status);
+    }
+    error.code = (int) code;
+    // OCIErrorGet 的消息带换行
+    size_t n = strlen(error.message);
+    while (n && (error.message[n - 1] == '\n' || error.message[n - 1] == '\r')) {
+        error.message[--n] = '\0';
+    }
+    return error;
+}
+
+const DbError &DbSession::fail(int code, const char *message) {
+    error.code = code;
+    snprintf(error.message, sizeof(error.message), "%s", message);
+    return error;
+}
+
+DbStatement::DbStatement(DbSession &session) : session(session), stmt(nullptr) {}
+
+DbStatement::~DbStatement() {
+    if (stmt) {
+        OCIStmtRelease(stmt, session.err, nullptr, 0, OCI_DEFAULT);
+    }
+}
+
+DbResult<void> DbStatement::prepare(const string &sql) {
+    if (!session.valid()) {
+        return session.fail(OCI_INVALID_HANDLE);
+    }
+    if (stmt) {
+        OCIStmtRelease(stmt, session.err, nullptr, 0, OCI_DEFAULT);
+        stmt = nullptr;
+    }
+    binds.clear();
+    defines.clear();
+    sword status = OCIStmtPrepare2(session.svc, &stmt, session.err, (const OraText *) sql.data(),
+                                   (ub4) sql.size(), nullptr, 0, OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (!succeeded(status)) {
+        stmt = nullptr;
+        return session.fail(status);
+    }
+    return DbResult<void>();
+}
+
+DbStatement::Slot *DbStatement::slot(deque<Slot> &slots, unsigned int index) {
+    if (0 == index) {
+        return nullptr;
+    }
+    while (slots.size() < index) {
+        slots.emplace_back();
+    }
+    return &slots[index - 1];
+}
+
+DbResult<void> DbStatement::bindSlot(unsigned int index, Slot &s, void *value, sb4 size, ub2 type) {
+    if (nullptr == stmt) {
+        return session.fail(OCI_INVALID_HANDLE);
+    }
+    OCIBind *bind = nullptr;
+    sword status = OCIBindByPos(stmt, &bind, session.err, index, value, size, type, &s.ind, nullptr, nullptr, 0,
+                                nullptr, OCI_DEFAULT);
+    if (!succeeded(status)) {
+        return session.fail(status);
+    }
+    return DbResult<void>();
+}
+
+DbResult<void> DbStatement::bind(unsigned int index, int64_t value) {
+    Slot *s = slot(binds, index);
+    if (nullptr == s) {
+        return session.fail(1036, "ORA-01036: illegal variable name/number");
+    }
+    s->i = value;
+    s->ind = 0;
+    return bindSlot(index, *s, &s->i, sizeof(s->i), SQLT_INT);
+}
+
+DbResult<void> DbStatement::bind(unsigned int index, double value) {
+    Slot *s = slot(binds, index);
+    if (nullptr == s) {
+        return session.fail(1036, "ORA-01036: illegal variable name/number");
+    }
+    s->d = value;
+    s->ind = 0;
+    return bindSlot(index, *s, &s->d, sizeof(s->d), SQLT_FLT);
+}
+
+DbResult<void> DbStatement::bind(unsigned int index, const string &value) {
+    Slot *s = slot(binds, index);
+    if (nullptr == s) {
+        return session.fail(1036, "ORA-01036: illegal variable name/number");
+    }
+    // 字符串可能换了缓冲区, 每次都按位置重新绑定
+    s->s = value;
+    s->ind = 0;
+    return bindSlot(index, *s, (void *) s->s.c_str(), (sb4) s->s.size() + 1, SQLT_STR);
+}
+
+DbResult<void> DbStatement::bindNull(unsigned int index) {
+    Slot *s = slot(binds, index);
+    if (nullptr == s) {
+        return session.fail(1036, "ORA-01036: illegal variable name/number");
+    }
+    s->s.clear();
+    s->ind = -1;
+    return bindSlot(index, *s, (void *) s->s.c_str(), 1, SQLT_STR);
+}
+
+DbResult<unsigned int> DbStatement::executeUpdate(bool commit) {
+    if (nullptr == stmt) {
+        return session.fail(OCI_INVALID_HANDLE);
+    }
+    sword status = OCIStmtExecute(session.svc, stmt, session.err, 1, 0, nullptr, nullptr,
+                                  commit ? OCI_COMMIT_ON_SUCCESS : OCI_DEFAULT);
+    if (!succeeded(status)) {
+        return session.fail(status);
+    }
+    ub4 rows = 0;
+    status = OCIAttrGet(stmt, OCI_HTYPE_STMT, &rows, nullptr, OCI_ATTR_ROW_COUNT, session.err);
+    if (!succeeded(status)) {
+        return session.fail(status);
+    }
+    return DbResult<unsigned int>((unsigned int) rows);
+}
+
+DbResult<void> DbStatement::executeQuery() {
+    if (nullptr == stmt) {
+        return session.fail(OCI_INVALID_HANDLE);
+    }
+    sword status = OCIStmtExecute(session.svc, stmt, session.err, 0, 0, nullptr, nullptr, OCI_DEFAULT);
+    if (!succeeded(status)) {
+        return session.fail(status);
+    }
+    return DbResult<void>();
+}
+
+DbResult<void> DbStatement::defineSlot(unsigned int index, Slot &s, void *value, sb4 size, ub2 type) {
+    if (nullptr == stmt) {
+        return session.fail(OCI_INVALID_HANDLE);
+    }
+    OCIDefine *define = nullptr;
+    sword status = OCIDefineByPos(stmt, &define, session.err, index, value, size, type, &s.ind, &s.length,
+                                  nullptr, OCI_DEFAULT);
+    if (!succeeded(status)) {
+        return session.fail(status);
+    }
+    return DbResult<void>();
+}
+
+DbResult<void> DbStatement::defineString(unsigned int index, size_t width) {
+    Slot *s = slot(defines, index);
+    if (nullptr == s) {
+        return session.fail(1007, "ORA-01007: variable not in select list");
+    }
+    s->buffer.assign(width + 1, '\0');
+    return defineSlot(index, *s, s->buffer.data(), (sb4) s->buffer.size(), SQLT_STR);
+}
+
+DbResult<void> DbStatement::defineInteger(unsigned int index) {
+    Slot *s = slot(defines, index);
+    if (nullptr == s) {
+        return session.fail(1007, "ORA-01007: variable not in select list");
+    }
+    return defineSlot(index, *s, &s->i, sizeof(s->i), SQLT_INT);
+}
+
+DbResult<void> DbStatement::defineNumber(unsigned int index) {
+    Slot *s = slot(defines, index);
+    if (nullptr == s) {
+        return session.fail(1007, "ORA-01007: variable not in select list");
+    }
+    return defineSlot(index, *s, &s->d, sizeof(s->d), SQLT_FLT);
+}
+
+DbResult<bool> DbStatement::fetch() {
+    if (nullptr == stmt) {
+        return session.fail(OCI_INVALID_HANDLE);
+    }
+    sword status = OCIStmtFetch2(stmt, session.err, 1, OCI_FETCH_NEXT, 0, OCI_DEFAULT);
+    if (status == OCI_NO_DATA) {
+        return DbResult<bool>(false);
+    }
+    if (!succeeded(status)) {
+        return session.fail(status);
+    }
+    return DbResult<bool>(true);
+}
+
+bool DbStatement::isNull(unsigned int index) const {
+    return index == 0 || index > defines.size() || defines[index - 1].ind < 0;
+}
+
+const char *DbStatement::text(unsigned int index) const {
+    if (isNull(index) || defines[index - 1].buffer.empty()) {
+        return "";
+    }
+    return defines[index - 1].buffer.data();
+}
+
+int64_t DbStatement::integer(unsigned int index) const {
+    return isNull(index) ? 0 : defines[index - 1].i;
+}
+
+double DbStatement::number(unsigned int index) const {
+    return isNull(index) ? 0 : defines[index - 1].d;
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "occi_common.h"
+
+/**
+ * The error of a failed call: ORA- number and message text. One lives in
+ * each DbSession and is overwritten by the session's next failure, so
+ * reporting an error allocates nothing.
+ */
+struct DbError {
+    static const size_t MAX_MESSAGE = 512;
+
+    int code = 0;
+    char message[MAX_MESSAGE] = {0};
+
+    /**
+     * Not an error: a non-blocking call has not finished yet and must be
+     * repeated with the same arguments.
+     */
+    bool stillExecuting() const { return code == OCI_STILL_EXECUTING; }
+};
+
+/**
+ * A value or the session's DbError, expected<T, DbError>-style:
+ *
+ *   DbResult<unsigned int> rows = stmt.executeUpdate();
+ *   if (!rows) { ... rows.error().code ... }
+ *
+ * The error reference is only valid until the session fails again.
+ */
+template<typename T>
+class DbResult {
+public:
+    DbResult(T value) : val(value), err(nullptr) {}
+
+    DbResult(const DbError &error) : val(), err(&error) {}
+
+    bool ok() const { return nullptr == err; }
+
+    explicit operator bool() const { return ok(); }
+
+    const T &value() const { return val; }
+
+    const DbError &error() const { return *err; }
+
+    int code() const { return err ? err->code : 0; }
+
+    bool pending() const { return err && err->stillExecuting(); }
+
+private:
+    T val;
+    const DbError *err;
+};
+
+template<>
+class DbResult<void> {
+public:
+    DbResult() : err(nullptr) {}
+
+    DbResult(const DbError &error) : err(&error) {}
+
+    bool ok() const { return nullptr == err; }
+
+    explicit operator bool() const { return ok(); }
+
+    const DbError &error() const { return *err; }
+
+    int code() const { return err ? err->code : 0; }
+
+    bool pending() const { return err && err->stillExecuting(); }
+
+private:
+    const DbError *err;
+};
+
+/**
+ * Non-throwing access to an OCCI connection for loops where failures are
+ * expected (duplicate keys, no data): the calls below go through the OCI C
+ * API on the connection's own service context, which reports errors as
+ * status codes, so a failed row costs an OCIErrorGet into the preallocated
+ * DbError instead of an SQLException and a stack unwind.
+ *
+ * Shares the OCCI connection (and its transaction); not thread-safe, use
+ * one DbSession per thread like the connection itself.
+ *
+ * In non-blocking mode execute and fetch return pending() results instead
+ * of waiting for the server; the caller repeats the same call until it
+ * completes (see AsyncExecutor). The mode belongs to the server handle, so
+ * OCCI calls on the connection must not be mixed in meanwhile.
+ */
+class DbSession {
+public:
+    DbSession(oracle::occi::Environment *env, oracle::occi::Connection *conn);
+
+    ~DbSession();
+
+    DbSession(const DbSession &) = delete;
+
+    DbSession &operator=(const DbSession &) = delete;
+
+    bool valid() const { return nullptr != err; }
+
+    const DbError &lastError() const { return error; }
+
+    /**
+     * Switches OCI_ATTR_NONBLOCKING_MODE on the connection's server handle.
+     */
+    DbResult<void> setNonBlocking(bool on);
+
+    bool nonBlocking() const;
+
+private:
+    friend class DbStatement;
+
+    /**
+     * Fills error from the error handle after a failed OCI call.
+     */
+    const DbError &fail(sword status);
+
+    /**
+     * Fills error with a client-side ORA- code and message.
+     */
+    const DbError &fail(int code, const char *message);
+
+    OCISvcCtx *svc;
+    OCIServer *server;
+    OCIError *err;
+    DbError error;
+};
+
+/**
+ * One prepared statement on a DbSession. Bind values are kept in the
+ * statement (and rebound by position), defines are per-column buffers
+ * read with text()/integer()/number() after fetch(). Positions start at 1;
+ * position 0 fails with ORA-01036 (bind) or ORA-01007 (define).
+ *
+ *   DbStatement insert(session);
+ *   insert.prepare("INSERT INTO author_tab VALUES (:x, :y)");
+ *   for (...) {
+ *       insert.bind(1, id);
+ *       insert.bind(2, name);
+ *       if (!insert.executeUpdate()) { ... }
+ *   }
+ */
+class DbStatement {
+public:
+    explicit DbStatement(DbSession &session);
+
+    ~DbStatement();
+
+    DbStatement(const DbStatement &) = delete;
+
+    DbStatement &operator=(const DbStatement &) = delete;
+
+    /**
+     * Uses the client's statement cache (OCIStmtPrepare2).
+     */
+    DbResult<void> prepare(const std::string &sql);
+
+    DbResult<void> bind(unsigned int index, int64_t value);
+
+    DbResult<void> bind(unsigned int index, int value) { return bind(index, (int64_t) value); }
+
+    DbResult<void> bind(unsigned int index, double value);
+
+    DbResult<void> bind(unsigned int index, const std::string &value);
+
+    DbResult<void> bindNull(unsigned int index);
+
+    /**
+     * Rows affected; commit = OCI_COMMIT_ON_SUCCESS.
+     */
+    DbResult<unsigned int> executeUpdate(bool commit = false);
+
+    DbResult<void> executeQuery();
+
+    DbResult<void> defineString(unsigned int index, size_t width);
+
+    DbResult<void> defineInteger(unsigned int index);
+
+    DbResult<void> defineNumber(unsigned int index);
+
+    /**
+     * true with a row in the define buffers, false at the end of the result.
+     */
+    DbResult<bool> fetch();
+
+    bool isNull(unsigned int index) const;
+
+    const char *text(unsigned int index) const;
+
+    int64_t integer(unsigned int index) const;
+
+    double number(unsigned int index) const;
+
+private:
+    struct Slot {
+        int64_t i = 0;
+        double d = 0;
+        std::string s;
+        std::vector<char> buffer;
+        sb2 ind = 0;
+        ub2 length = 0;
+    };
+
+    /**
+     * The slot of a 1-based position, nullptr for 0.
+     */
+    Slot *slot(std::deque<Slot> &slots, unsigned int index);
+
+    DbResult<void> bindSlot(unsigned int index, Slot &s, void *value, sb4 size, ub2 type);
+
+    DbResult<void> defineSlot(unsigned int index, Slot &s, void *value, sb4 size, ub2 type);
+
+    DbSession &session;
+    OCIStmt *stmt;
+    // deque: 追加元素不会移动已有槽位, 绑定/定义过的地址一直有效
+    std::deque<Slot> binds;
+    std::deque<Slot> defines;
+};
@@ -0,0 +1,269 @@
+#include "hedged_query.h"
+#include "alloc_tracker.h"
+#include "latency_histogram.h"
+#include "logger.h"
+#include "metrics.h"
+#include "statement_probe.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+using namespace oracle::occi;
+
+HedgeBudget::HedgeBudget(double ratio, double burst)
+        : ratio(ratio), burst(burst), tokens(burst) {
+}
+
+void HedgeBudget::onRequest() {
+    lock_guard<mutex> guard(lock);
+    tokens = min(burst, tokens + ratio);
+}
+
+bool HedgeBudget::tryHedge() {
+    lock_guard<mutex> guard(lock);
+    if (tokens < 1.0) {
+        return false;
+    }
+    tokens -= 1.0;
+    return true;
+}
+
+bool fetchAll(Connection *conn, const string &sql, QueryResult &result, const atomic<bool> *cancelled) {
+    SqlMetrics metrics = MetricsRegistry::instance().sql(sql);
+    uint64_t fp = tagSql(sql);
+    TraceSpan span("fetchAll", fp);
+    AllocScope alloc("fetchAll");
+    Statement *stmt = nullptr;
+    try {
+        stmt = dbCall(DbOp::CREATE_STATEMENT, fp, [&] { return conn->createStatement(sql); });
+        StatementProbe probe(sql, StatementKind::QUERY, fp);
+        auto start = chrono::steady_clock::now();
+        ResultSet *pRs = dbCall(DbOp::EXECUTE_QUERY, fp, [&] { return stmt->executeQuery(); });
+        auto executed = chrono::steady_clock::now();
+        metrics.execute->observe(chrono::duration<double>(executed - start).count());
+
+        vector<MetaData> metaData = pRs->getColumnListMetaData();
+        unsigned int count = (unsigned int) metaData.size();
+        for (const auto &item: metaData) {
+            result.columns.push_back(item.getString(MetaData::ATTR_NAME));
+        }
+        uint64_t bytes = 0;
+        while (dbCall(DbOp::NEXT, fp, [&] { return pRs->next(); })) {
+            if (cancelled && cancelled->load(memory_order_relaxed)) {
+                break;
+            }
+            vector<string> row;
+            row.reserve(count);
+            for (unsigned int i = 0; i < count; ++i) {
+                row.push_back(pRs->getString(i + 1));
+                bytes += row.back().size();
+            }
+            result.rows.push_back(std::move(row));
+        }
+        metrics.fetch->observe(chrono::duration<double>(chrono::steady_clock::now() - executed).count());
+        metrics.rows->add(result.rows.size());
+        metrics.bytes->add(bytes);
+        span.setCount(result.rows.size());
+        probe.addRows(result.rows.size());
+        alloc.addRows(result.rows.size());
+        stmt->closeResultSet(pRs);
+        dbCall(DbOp::TERMINATE_STATEMENT, fp, [&] { conn->terminateStatement(stmt); });
+    }
+    catch (const SQLException &e) {
+        // ORA-01013 是被 cancel 掉的那一方, 不算真正的错误
+        if (e.getErrorCode() != 1013) {
+            logError("%s", e.what());
+        }
+        // 被 cancel 或已经断开的会话上再关语句也可能抛, 这里在工作线程里, 不能让它逃出去
+        if (stmt) {
+            try {
+                conn->terminateStatement(stmt);
+            }
+            catch (const SQLException &e) {
+                logDebug("%s", e.what());
+            }
+        }
+        return false;
+    }
+    return !(cancelled && cancelled->load(memory_order_relaxed));
+}
+
+struct HedgedReader::Race {
+    mutex lock;
+    condition_variable done;
+    string sql;
+    int winner = -1;
+    int launched = 0;
+    int finished = 0;
+    ManagedSession sessions[2];
+    bool running[2] = {false, false};
+    atomic<bool> cancelled[2] = {{false}, {false}};
+    QueryResult results[2];
+
+    bool settled() const { return winner >= 0 || finished == launched; }
+};
+
+HedgedReader::HedgedReader(ConnectionManager &manager, double budgetRatio, chrono::microseconds minDelay,
+                           unsigned int maxWorkers)
+        : manager(manager), budget(budgetRatio), minDelay(minDelay), inflight(0),
+          requestCount(0), hedgeCount(0), hedgeWinCount(0), maxWorkers(max(2u, maxWorkers)) {
+}
+
+HedgedReader::~HedgedReader() {
+    // 被取消的请求还在后台收尾, 等它们处理完会话
+    {
+        unique_lock<mutex> lk(inflightLock);
+        inflightDone.wait(lk, [this] { return 0 == inflight; });
+    }
+    {
+        lock_guard<mutex> guard(taskLock);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+void HedgedReader::submit(function<void()> task) {
+    lock_guard<mutex> guard(taskLock);
+    tasks.push_back(std::move(task));
+    // 没有空闲线程才加一个, 否则对冲请求会排在慢的那次尝试后面
+    if (idleWorkers < tasks.size() && workers.size() < maxWorkers) {
+        workers.emplace_back([this] { work(); });
+    } else {
+        taskReady.notify_one();
+    }
+}
+
+void HedgedReader::work() {
+    unique_lock<mutex> lk(taskLock);
+    while (true) {
+        ++idleWorkers;
+        taskReady.wait(lk, [this] { return stopping || !tasks.empty(); });
+        --idleWorkers;
+        if (tasks.empty()) {
+            return;
+        }
+        function<void()> task = std::move(tasks.front());
+        tasks.pop_front();
+        lk.unlock();
+        task();
+        lk.lock();
+    }
+}
+
+chrono::microseconds HedgedReader::hedgeDelay(int endpoint) const {
+    chrono::microseconds p95 = manager.latencyQuantile(endpoint, 0.95);
+    if (p95.count() < 0) {
+        return p95;
+    }
+    return max(p95, minDelay);
+}
+
+void HedgedReader::launch(const shared_ptr<Race> &race, int slot, ManagedSession session) {
+    {
+        lock_guard<mutex> guard(race->lock);
+        race->sessions[slot] = session;
+        race->running[slot] = true;
+        ++race->launched;
+    }
+    {
+        lock_guard<mutex> guard(inflightLock);
+        ++inflight;
+    }
+    submit([this, race, slot]() {
+        ManagedSession session = race->sessions[slot];
+        QueryResult result;
+        result.endpoint = session.endpoint;
+        result.hedged = slot > 0;
+
+        auto start = chrono::steady_clock::now();
+        bool ok = fetchAll(session.conn, race->sql, result, &race->cancelled[slot]);
+        auto elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+        result.ok = ok;
+
+        bool cancelled;
+        {
+            lock_guard<mutex> guard(race->lock);
+            // 之后不会再对这个会话调用 cancel; 在锁里读 cancelled, 调过 cancel 的都能看到
+            race->running[slot] = false;
+            cancelled = race->cancelled[slot].load();
+            if (ok && race->winner < 0) {
+                race->winner = slot;
+            }
+            race->results[slot] = std::move(result);
+            ++race->finished;
+        }
+        race->done.notify_all();
+
+        if (cancelled) {
+            // OCIBreak 可能还挂在会话上, 不放回池里; 它的耗时只是被截断的下界, 不当延迟样本
+            manager.drop(session);
+        } else {
+            manager.observe(session.endpoint, elapsed, ok);
+            manager.release(session);
+        }
+
+        {
+            lock_guard<mutex> guard(inflightLock);
+            --inflight;
+        }
+        inflightDone.notify_all();
+    });
+}
+
+QueryResult HedgedReader::query(const string &sql, bool hedge) {
+    requestCount.fetch_add(1, memory_order_relaxed);
+    budget.onRequest();
+
+    ManagedSession first = manager.acquire(true);
+    if (nullptr == first.conn) {
+        return QueryResult();
+    }
+    int firstEndpoint = first.endpoint;
+    chrono::microseconds delay = hedgeDelay(firstEndpoint);
+
+    shared_ptr<Race> race = make_shared<Race>();
+    race->sql = sql;
+    launch(race, 0, first);
+
+    unique_lock<mutex> lk(race->lock);
+    if (hedge && delay.count() >= 0 && !race->done.wait_for(lk, delay, [&] { return race->settled(); })) {
+        if (budget.tryHedge()) {
+            lk.unlock();
+            ManagedSession second = manager.acquire(true, firstEndpoint);
+            if (second.conn) {
+                hedgeCount.fetch_add(1, memory_order_relaxed);
+                launch(race, 1, second);
+            }
+            lk.lock();
+        }
+    }
+    race->done.wait(lk, [&] { return race->settled(); });
+
+    // 取消仍在执行的一方
+    for (int slot = 0; slot < 2; ++slot) {
+        if (race->running[slot] && slot != race->winner) {
+            race->cancelled[slot] = true;
+            try {
+                race->sessions[slot].conn->cancel();
+            }
+            catch (const SQLException &e) {
+                logError("%s", e.what());
+            }
+        }
+    }
+
+    if (race->winner < 0) {
+        // 都失败了, 返回第一次尝试的结果
+        return std::move(race->results[0]);
+    }
+    if (race->winner > 0) {
+        hedgeWinCount.fetch_add(1, memory_order_relaxed);
+    }
+    return std::move(race->results[race->winner]);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "connection_manager.h"
+
+/**
+ * A fully materialized result, so that whichever attempt wins can hand it back.
+ */
+struct QueryResult {
+    std::vector<std::string> columns;
+    std::vector<std::vector<std::string>> rows;
+    int endpoint = -1;
+    bool ok = false;
+    bool hedged = false;
+};
+
+/**
+ * Caps hedges to a fraction of the requests: every request earns `ratio`
+ * tokens, a hedge spends one, and at most `burst` tokens are kept.
+ */
+class HedgeBudget {
+public:
+    explicit HedgeBudget(double ratio = 0.05, double burst = 10);
+
+    void onRequest();
+
+    bool tryHedge();
+
+private:
+    std::mutex lock;
+    double ratio;
+    double burst;
+    double tokens;
+};
+
+/**
+ * Runs read-only point queries with optional hedging.
+ *
+ * The first attempt goes to the endpoint chosen by the ConnectionManager. If it
+ * has not completed by that endpoint's observed p95, the same query is sent to
+ * a second endpoint; the first answer wins and the other call is cancelled
+ * (Connection::cancel -> OCIBreak). Losing attempts finish in the background
+ * and destroy their session, which the break may have left mid-call.
+ *
+ * Attempts run on a small pool of worker threads kept by the reader. A
+ * worker is added only when every existing one is busy, so a hedge is never
+ * queued behind a slow attempt, up to maxWorkers; after that attempts wait.
+ */
+class HedgedReader {
+public:
+    HedgedReader(ConnectionManager &manager, double budgetRatio = 0.05,
+                 std::chrono::microseconds minDelay = std::chrono::milliseconds(1), unsigned int maxWorkers = 16);
+
+    ~HedgedReader();
+
+    HedgedReader(const HedgedReader &) = delete;
+
+    HedgedReader &operator=(const HedgedReader &) = delete;
+
+    QueryResult query(const std::string &sql, bool hedge = true);
+
+    unsigned long long requests() const { return requestCount.load(); }
+
+    unsigned long long hedges() const { return hedgeCount.load(); }
+
+    unsigned long long hedgeWins() const { return hedgeWinCount.load(); }
+
+private:
+    struct Race;
+
+    void launch(const std::shared_ptr<Race> &race, int slot, ManagedSession session);
+
+    std::chrono::microseconds hedgeDelay(int endpoint) const;
+
+    void submit(std::function<void()> task);
+
+    void work();
+
+    ConnectionManager &manager;
+    HedgeBudget budget;
+    std::chrono::microseconds minDelay;
+
+    std::mutex inflightLock;
+    std::condition_variable inflightDone;
+    int inflight;
+
+    std::atomic<unsigned long long> requestCount;
+    std::atomic<unsigned long long> hedgeCount;
+    std::atomic<unsigned long long> hedgeWinCount;
+
+    std::mutex taskLock;
+    std::condition_variable taskReady;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> workers;
+    unsigned int maxWorkers;
+    unsigned int idleWorkers = 0;
+    bool stopping = false;
+};
+
+/**
+ * Executes sql on conn and reads every row as strings, stopping early once
+ * *cancelled is set. Returns false (and leaves the partial result) when the
+ * query fails or is cancelled.
+ */
+bool fetchAll(oracle::occi::Connection *conn, const std::string &sql, QueryResult &result,
+              const std::atomic<bool> *cancelled = nullptr);
@@ -0,0 +1,266 @@
+#include "job_scheduler.h"
+
+#include <algorithm>
+#include <exception>
+
+#include "logger.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+// 当前线程是哪个调度器的第几个 worker, 作业里再提交的作业进自己的队列
+static thread_local const JobScheduler *G_SCHED_OWNER = nullptr;
+static thread_local unsigned int G_SCHED_WORKER = 0;
+
+const char *jobClassName(JobClass cls) {
+    switch (cls) {
+        case JobClass::INTERACTIVE:
+            return "interactive";
+        case JobClass::BATCH:
+            return "batch";
+        case JobClass::BULK:
+            return "bulk";
+    }
+    return "unknown";
+}
+
+JobScheduler::JobScheduler(Environment *env, const string &user, const string &pass, const string &connectString,
+                           unsigned int workers)
+        : env(env), user(user), pass(pass), connect(connectString), workerTarget(workers ? workers : 1) {
+    classes[(int) JobClass::BULK].limit = std::max(1u, workerTarget / 2);
+}
+
+JobScheduler::~JobScheduler() {
+    stop();
+}
+
+void JobScheduler::setClassLimit(JobClass cls, unsigned int limit) {
+    classes[(int) cls].limit = limit;
+    wakeOne();
+}
+
+bool JobScheduler::start() {
+    if (running) {
+        return false;
+    }
+    for (unsigned int i = 0; i < workerTarget; ++i) {
+        Connection *conn = nullptr;
+        try {
+            conn = env->createConnection(user, pass, connect);
+        }
+        catch (const SQLException &e) {
+            logError("scheduler worker %u: %s", i, e.what());
+            continue;
+        }
+        unique_ptr<Worker> worker(new Worker());
+        worker->index = (unsigned int) workers.size();
+        worker->conn = conn;
+        workers.push_back(std::move(worker));
+    }
+    if (workers.empty()) {
+        return false;
+    }
+
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    for (int c = 0; c < CLASS_COUNT; ++c) {
+        string labels = metricLabel("class", jobClassName((JobClass) c));
+        ClassState &state = classes[c];
+        state.wait = metrics.histogram("oci_sched_queue_wait_seconds", labels);
+        state.jobs = metrics.counter("oci_sched_jobs_total", labels);
+        gaugeIds.push_back(metrics.addGauge("oci_sched_queued_jobs", labels,
+                                            [&state] { return (double) state.queued.load(); }));
+        gaugeIds.push_back(metrics.addGauge("oci_sched_running_jobs", labels,
+                                            [&state] { return (double) state.running.load(); }));
+    }
+
+    {
+        lock_guard<mutex> guard(idleLock);
+        stopping = false;
+    }
+    running = true;
+    for (auto &worker: workers) {
+        Worker *self = worker.get();
+        worker->thread = thread([this, self] { workerLoop(*self); });
+    }
+    logInfo("scheduler: %zu workers on %s", workers.size(), connect.c_str());
+    return true;
+}
+
+void JobScheduler::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    {
+        lock_guard<mutex> guard(idleLock);
+        stopping = true;
+    }
+    idle.notify_all();
+    for (auto &worker: workers) {
+        worker->thread.join();
+        try {
+            env->terminateConnection(worker->conn);
+        }
+        catch (const SQLException &e) {
+            logError("scheduler worker %u: %s", worker->index, e.what());
+        }
+    }
+    workers.clear();
+    for (int id: gaugeIds) {
+        MetricsRegistry::instance().removeGauge(id);
+    }
+    gaugeIds.clear();
+}
+
+bool JobScheduler::submit(JobClass cls, Job job) {
+    // stop() 排空队列期间, 作业里提交的后续作业照收
+    if (!running && G_SCHED_OWNER != this) {
+        return false;
+    }
+    // queued 在锁里先加: 作业一入队就可能被偷走减掉, 后加的话计数会短暂下溢
+    if (G_SCHED_OWNER == this) {
+        Worker &worker = *workers[G_SCHED_WORKER];
+        lock_guard<mutex> guard(worker.lock);
+        classes[(int) cls].queued.fetch_add(1, memory_order_relaxed);
+        worker.queues[(int) cls].push_back({std::move(job), chrono::steady_clock::now()});
+    } else {
+        lock_guard<mutex> guard(injectorLock);
+        classes[(int) cls].queued.fetch_add(1, memory_order_relaxed);
+        injector[(int) cls].push_back({std::move(job), chrono::steady_clock::now()});
+    }
+    wakeOne();
+    return true;
+}
+
+void JobScheduler::wakeOne() {
+    {
+        lock_guard<mutex> guard(idleLock);
+    }
+    idle.notify_one();
+}
+
+bool JobScheduler::reserve(ClassState &state) {
+    unsigned int limit = state.limit.load(memory_order_relaxed);
+    unsigned int cap = limit ? std::min<unsigned int>(limit, (unsigned int) workers.size())
+                             : (unsigned int) workers.size();
+    unsigned int current = state.running.load(memory_order_relaxed);
+    while (current < cap) {
+        if (state.running.compare_exchange_weak(current, current + 1, memory_order_acq_rel)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobScheduler::runnable() const {
+    for (const auto &state: classes) {
+        unsigned int limit = state.limit.load(memory_order_relaxed);
+        if (state.queued.load(memory_order_relaxed) > 0 &&
+            (0 == limit || state.running.load(memory_order_relaxed) < limit)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobScheduler::drained() const {
+    for (const auto &state: classes) {
+        if (state.queued.load(memory_order_relaxed) > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JobScheduler::takeOwn(Worker &self, int cls, Task &task) {
+    lock_guard<mutex> guard(self.lock);
+    deque<Task> &queue = self.queues[cls];
+    if (queue.empty()) {
+        return false;
+    }
+    task = std::move(queue.back());
+    queue.pop_back();
+    return true;
+}
+
+bool JobScheduler::takeInjected(int cls, Task &task) {
+    lock_guard<mutex> guard(injectorLock);
+    deque<Task> &queue = injector[cls];
+    if (queue.empty()) {
+        return false;
+    }
+    task = std::move(queue.front());
+    queue.pop_front();
+    return true;
+}
+
+bool JobScheduler::steal(Worker &self, int cls, Task &task) {
+    size_t count = workers.size();
+    for (size_t k = 1; k < count; ++k) {
+        Worker &victim = *workers[(self.index + k) % count];
+        lock_guard<mutex> guard(victim.lock);
+        deque<Task> &queue = victim.queues[cls];
+        if (!queue.empty()) {
+            task = std::move(queue.front());
+            queue.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobScheduler::next(Worker &self, Task &task, int &cls) {
+    bool injectorFirst = ++self.picks % INJECTOR_INTERVAL == 0;
+    for (int c = 0; c < CLASS_COUNT; ++c) {
+        ClassState &state = classes[c];
+        if (0 == state.queued.load(memory_order_relaxed) || !reserve(state)) {
+            continue;
+        }
+        // 自己派生的取最新的, 外部提交的按先来后到, 最后从别人队列的最老一端偷
+        bool taken = injectorFirst ? takeInjected(c, task) || takeOwn(self, c, task)
+                                   : takeOwn(self, c, task) || takeInjected(c, task);
+        if (taken || steal(self, c, task)) {
+            state.queued.fetch_sub(1, memory_order_relaxed);
+            cls = c;
+            return true;
+        }
+        state.running.fetch_sub(1, memory_order_acq_rel);
+    }
+    return false;
+}
+
+void JobScheduler::workerLoop(Worker &self) {
+    G_SCHED_OWNER = this;
+    G_SCHED_WORKER = self.index;
+    while (true) {
+        Task task;
+        int cls = 0;
+        if (next(self, task, cls)) {
+            ClassState &state = classes[cls];
+            state.wait->observe(chrono::duration<double>(chrono::steady_clock::now() - task.queued).count());
+            try {
+                task.job(self.conn);
+            }
+            catch (const SQLException &e) {
+                logError("%s job failed, error number %d: %s", jobClassName((JobClass) cls), e.getErrorCode(),
+                         e.what());
+            }
+            catch (const exception &e) {
+                logError("%s job failed: %s", jobClassName((JobClass) cls), e.what());
+            }
+            state.jobs->add();
+            state.running.fetch_sub(1, memory_order_acq_rel);
+            // 占着上限的作业结束了, 同类排队的作业可能可以跑了
+            if (state.queued.load(memory_order_relaxed) > 0) {
+                wakeOne();
+            }
+            continue;
+        }
+        unique_lock<mutex> guard(idleLock);
+        if (stopping && drained()) {
+            break;
+        }
+        // 超时兜底: 偷取和上限检查都不持有 idleLock
+        idle.wait_for(guard, chrono::milliseconds(10), [this] { return runnable() || (stopping && drained()); });
+    }
+    G_SCHED_OWNER = nullptr;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+#include "occi_common.h"
+
+/**
+ * Priority classes, highest first: interactive lookups run ahead of batch
+ * DML, which runs ahead of bulk exports.
+ */
+enum class JobClass : uint8_t {
+    INTERACTIVE = 0,
+    BATCH = 1,
+    BULK = 2
+};
+
+const char *jobClassName(JobClass cls);
+
+/**
+ * A database job; runs on a worker thread with that worker's session.
+ */
+typedef std::function<void(oracle::occi::Connection *)> Job;
+
+/**
+ * Runs jobs on a fixed set of worker threads, each with its own session
+ * and its own deque per class.
+ *
+ * A job submitted from inside a job goes to the submitting worker's deque,
+ * one from outside to a shared injector queue. A worker looks at the classes
+ * in priority order and takes the newest job it spawned itself (LIFO, still
+ * warm in its session's statement cache), else the oldest external job
+ * (FIFO, so no submission waits behind later ones), else steals the oldest
+ * job of another worker, so no worker idles while any queue has runnable
+ * work. Every INJECTOR_INTERVAL-th pick looks at the injector first, so a
+ * worker busy with its own follow-up jobs still serves external ones.
+ *
+ * Each class has a cap on jobs running at once (setClassLimit); a class at
+ * its cap is skipped, which keeps workers free for the classes above it.
+ * By default bulk jobs may take half the workers, the other classes all.
+ */
+class JobScheduler {
+public:
+    static const int CLASS_COUNT = 3;
+
+    static const unsigned int INJECTOR_INTERVAL = 8;
+
+    JobScheduler(oracle::occi::Environment *env, const std::string &user, const std::string &pass,
+                 const std::string &connectString, unsigned int workers);
+
+    ~JobScheduler();
+
+    JobScheduler(const JobScheduler &) = delete;
+
+    JobScheduler &operator=(const JobScheduler &) = delete;
+
+    /**
+     * Opens one session per worker and starts the workers; false when no
+     * session could be opened.
+     */
+    bool start();
+
+    /**
+     * Runs every job already submitted, then stops the workers and closes
+     * their sessions.
+     */
+    void stop();
+
+    /**
+     * Most jobs of cls running at once; 0 = as many as there are workers.
+     */
+    void setClassLimit(JobClass cls, unsigned int limit);
+
+    /**
+     * false when the scheduler is not running (jobs may still submit
+     * follow-up jobs while stop() drains the queues).
+     */
+    bool submit(JobClass cls, Job job);
+
+    unsigned int workerCount() const { return (unsigned int) workers.size(); }
+
+    uint64_t queuedCount(JobClass cls) const { return classes[(int) cls].queued.load(std::memory_order_relaxed); }
+
+    uint64_t runningCount(JobClass cls) const { return classes[(int) cls].running.load(std::memory_order_relaxed); }
+
+private:
+    struct Task {
+        Job job;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    struct Worker {
+        unsigned int index = 0;
+        oracle::occi::Connection *conn = nullptr;
+        std::mutex lock;
+        std::deque<Task> queues[CLASS_COUNT];
+        std::thread thread;
+        // next() 调用次数, 每 INJECTOR_INTERVAL 次先看共享队列
+        unsigned int picks = 0;
+    };
+
+    struct ClassState {
+        std::atomic<unsigned int> limit{0};
+        std::atomic<unsigned int> running{0};
+        std::atomic<uint64_t> queued{0};
+        MetricHistogram *wait = nullptr;
+        MetricCounter *jobs = nullptr;
+    };
+
+    void workerLoop(Worker &self);
+
+    bool reserve(ClassState &state);
+
+    bool next(Worker &self, Task &task, int &cls);
+
+    bool takeOwn(Worker &self, int cls, Task &task);
+
+    bool takeInjected(int cls, Task &task);
+
+    bool steal(Worker &self, int cls, Task &task);
+
+    bool runnable() const;
+
+    bool drained() const;
+
+    void wakeOne();
+
+    oracle::occi::Environment *env;
+    std::string user;
+    std::string pass;
+    std::string connect;
+    unsigned int workerTarget;
+    std::vector<std::unique_ptr<Worker>> workers;
+    // 外部提交的作业, 按提交顺序取
+    std::mutex injectorLock;
+    std::deque<Task> injector[CLASS_COUNT];
+    ClassState classes[CLASS_COUNT];
+    std::vector<int> gaugeIds;
+
+    std::atomic<bool> running{false};
+    std::mutex idleLock;
+    std::condition_variable idle;
+    bool stopping = false;
+};
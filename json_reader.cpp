@@ -0,0 +1,334 @@
+#include "json_reader.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+// 嵌套层数上限, 防止恶意/损坏的输入把栈递归爆
+static const int MAX_DEPTH = 256;
+
+static const JsonValue &nullValue() {
+    static const JsonValue value;
+    return value;
+}
+
+const JsonValue &JsonValue::operator[](size_t index) const {
+    return type == Kind::ARRAY && index < items.size() ? items[index] : nullValue();
+}
+
+const JsonValue &JsonValue::operator[](const string &key) const {
+    if (type == Kind::OBJECT) {
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (names[i] == key) {
+                return items[i];
+            }
+        }
+    }
+    return nullValue();
+}
+
+bool JsonValue::has(const string &key) const {
+    if (type == Kind::OBJECT) {
+        for (const auto &name: names) {
+            if (name == key) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+class JsonParser {
+public:
+    JsonParser(const string &text) : text(text), pos(0) {}
+
+    bool parseDocument(JsonValue &out, string &error) {
+        if (!parseValue(out, 0)) {
+            error = message;
+            return false;
+        }
+        skipSpace();
+        if (pos != text.size()) {
+            fail("trailing characters");
+            error = message;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const string &text;
+    size_t pos;
+    string message;
+
+    bool fail(const char *what) {
+        if (message.empty()) {
+            message = string(what) + " at offset " + to_string(pos);
+        }
+        return false;
+    }
+
+    void skipSpace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) {
+            ++pos;
+        }
+    }
+
+    bool literal(const char *word) {
+        size_t i = 0;
+        for (; word[i]; ++i) {
+            if (pos + i >= text.size() || text[pos + i] != word[i]) {
+                return fail("invalid literal");
+            }
+        }
+        pos += i;
+        return true;
+    }
+
+    bool parseValue(JsonValue &out, int depth) {
+        if (depth > MAX_DEPTH) {
+            return fail("nesting too deep");
+        }
+        skipSpace();
+        if (pos >= text.size()) {
+            return fail("unexpected end");
+        }
+        char c = text[pos];
+        if (c == '{') {
+            return parseObject(out, depth);
+        }
+        if (c == '[') {
+            return parseArray(out, depth);
+        }
+        if (c == '"') {
+            out.type = JsonValue::Kind::STRING;
+            return parseString(out.str);
+        }
+        if (c == 't') {
+            out.type = JsonValue::Kind::BOOL;
+            out.flag = true;
+            return literal("true");
+        }
+        if (c == 'f') {
+            out.type = JsonValue::Kind::BOOL;
+            out.flag = false;
+            return literal("false");
+        }
+        if (c == 'n') {
+            out.type = JsonValue::Kind::NUL;
+            return literal("null");
+        }
+        return parseNumber(out);
+    }
+
+    bool parseObject(JsonValue &out, int depth) {
+        out.type = JsonValue::Kind::OBJECT;
+        ++pos;
+        skipSpace();
+        if (pos < text.size() && text[pos] == '}') {
+            ++pos;
+            return true;
+        }
+        while (true) {
+            skipSpace();
+            if (pos >= text.size() || text[pos] != '"') {
+                return fail("expected object key");
+            }
+            string key;
+            if (!parseString(key)) {
+                return false;
+            }
+            skipSpace();
+            if (pos >= text.size() || text[pos] != ':') {
+                return fail("expected ':'");
+            }
+            ++pos;
+            out.names.push_back(std::move(key));
+            out.items.emplace_back();
+            if (!parseValue(out.items.back(), depth + 1)) {
+                return false;
+            }
+            skipSpace();
+            if (pos < text.size() && text[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            if (pos < text.size() && text[pos] == '}') {
+                ++pos;
+                return true;
+            }
+            return fail("expected ',' or '}'");
+        }
+    }
+
+    bool parseArray(JsonValue &out, int depth) {
+        out.type = JsonValue::Kind::ARRAY;
+        ++pos;
+        skipSpace();
+        if (pos < text.size() && text[pos] == ']') {
+            ++pos;
+            return true;
+        }
+        while (true) {
+            out.items.emplace_back();
+            if (!parseValue(out.items.back(), depth + 1)) {
+                return false;
+            }
+            skipSpace();
+            if (pos < text.size() && text[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            if (pos < text.size() && text[pos] == ']') {
+                ++pos;
+                return true;
+            }
+            return fail("expected ',' or ']'");
+        }
+    }
+
+    static void appendUtf8(string &out, unsigned long cp) {
+        if (cp < 0x80) {
+            out += (char) cp;
+        } else if (cp < 0x800) {
+            out += (char) (0xC0 | (cp >> 6));
+            out += (char) (0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += (char) (0xE0 | (cp >> 12));
+            out += (char) (0x80 | ((cp >> 6) & 0x3F));
+            out += (char) (0x80 | (cp & 0x3F));
+        } else {
+            out += (char) (0xF0 | (cp >> 18));
+            out += (char) (0x80 | ((cp >> 12) & 0x3F));
+            out += (char) (0x80 | ((cp >> 6) & 0x3F));
+            out += (char) (0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool hex4(unsigned long &cp) {
+        if (pos + 4 > text.size()) {
+            return fail("truncated \\u escape");
+        }
+        cp = 0;
+        for (int i = 0; i < 4; ++i) {
+            char h = text[pos++];
+            cp <<= 4;
+            if (h >= '0' && h <= '9') {
+                cp |= (unsigned long) (h - '0');
+            } else if (h >= 'a' && h <= 'f') {
+                cp |= (unsigned long) (h - 'a' + 10);
+            } else if (h >= 'A' && h <= 'F') {
+                cp |= (unsigned long) (h - 'A' + 10);
+            } else {
+                return fail("invalid \\u escape");
+            }
+        }
+        return true;
+    }
+
+    bool parseString(string &out) {
+        ++pos;
+        while (pos < text.size()) {
+            char c = text[pos++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos >= text.size()) {
+                break;
+            }
+            char e = text[pos++];
+            switch (e) {
+                case '"':
+                case '\\':
+                case '/':
+                    out += e;
+                    break;
+                case 'b':
+                    out += '\b';
+                    break;
+                case 'f':
+                    out += '\f';
+                    break;
+                case 'n':
+                    out += '\n';
+                    break;
+                case 'r':
+                    out += '\r';
+                    break;
+                case 't':
+                    out += '\t';
+                    break;
+                case 'u': {
+                    unsigned long cp;
+                    if (!hex4(cp)) {
+                        return false;
+                    }
+                    // U+10000 以上的字符以 UTF-16 代理对出现, 合成一个码点
+                    if (cp >= 0xD800 && cp < 0xDC00 && pos + 1 < text.size() && text[pos] == '\\' &&
+                        text[pos + 1] == 'u') {
+                        pos += 2;
+                        unsigned long low;
+                        if (!hex4(low)) {
+                            return false;
+                        }
+                        if (low < 0xDC00 || low > 0xDFFF) {
+                            return fail("invalid surrogate pair");
+                        }
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, cp);
+                    break;
+                }
+                default:
+                    return fail("invalid escape");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    bool parseNumber(JsonValue &out) {
+        const char *start = text.c_str() + pos;
+        char *end = nullptr;
+        double n = strtod(start, &end);
+        if (end == start) {
+            return fail("unexpected character");
+        }
+        out.type = JsonValue::Kind::NUMBER;
+        out.value = n;
+        pos += (size_t) (end - start);
+        return true;
+    }
+};
+
+bool JsonValue::parse(const string &text, JsonValue &out, string &error) {
+    out = JsonValue();
+    JsonParser parser(text);
+    return parser.parseDocument(out, error);
+}
+
+bool readJsonFile(const string &path, JsonValue &out, string &error) {
+    FILE *in = path == "-" ? stdin : fopen(path.c_str(), "rb");
+    if (nullptr == in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    string text;
+    char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        text.append(buffer, n);
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (!JsonValue::parse(text, out, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * A parsed JSON document, enough for reading back what this program writes
+ * (bench results, tuned configs). Objects keep their key order; looking up a
+ * missing key or index yields a null value instead of failing, so
+ *
+ *   double p99 = doc["results"][0]["latency_us"]["p99"].number();
+ *
+ * reads as 0 when any step is absent.
+ */
+class JsonValue {
+public:
+    enum class Kind {
+        NUL,
+        BOOL,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    JsonValue() : type(Kind::NUL), flag(false), value(0) {}
+
+    Kind kind() const { return type; }
+
+    bool isNull() const { return type == Kind::NUL; }
+
+    bool isNumber() const { return type == Kind::NUMBER; }
+
+    bool isArray() const { return type == Kind::ARRAY; }
+
+    bool isObject() const { return type == Kind::OBJECT; }
+
+    bool boolean(bool fallback = false) const { return type == Kind::BOOL ? flag : fallback; }
+
+    double number(double fallback = 0) const { return type == Kind::NUMBER ? value : fallback; }
+
+    /**
+     * The string value, empty for non-strings.
+     */
+    const std::string &text() const { return str; }
+
+    /**
+     * Element count of an array or object, 0 otherwise.
+     */
+    size_t size() const { return items.size(); }
+
+    const JsonValue &operator[](size_t index) const;
+
+    const JsonValue &operator[](const std::string &key) const;
+
+    bool has(const std::string &key) const;
+
+    /**
+     * Keys of an object, in document order (parallel to the elements).
+     */
+    const std::vector<std::string> &keys() const { return names; }
+
+    /**
+     * Parses text into out; on failure returns false and describes the
+     * position in error.
+     */
+    static bool parse(const std::string &text, JsonValue &out, std::string &error);
+
+private:
+    friend class JsonParser;
+
+    Kind type;
+    bool flag;
+    double value;
+    std::string str;
+    std::vector<std::string> names;
+    std::vector<JsonValue> items;
+};
+
+/**
+ * Reads and parses a whole file; "-" reads standard input.
+ */
+bool readJsonFile(const std::string &path, JsonValue &out, std::string &error);
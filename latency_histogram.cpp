@@ -0,0 +1,338 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+#include "sql_fingerprint.h"
+
+using namespace std;
+
+static int highestBit(uint64_t v) {
+    int bit = 0;
+    if (v >> 32) { v >>= 32; bit += 32; }
+    if (v >> 16) { v >>= 16; bit += 16; }
+    if (v >> 8) { v >>= 8; bit += 8; }
+    if (v >> 4) { v >>= 4; bit += 4; }
+    if (v >> 2) { v >>= 2; bit += 2; }
+    if (v >> 1) { bit += 1; }
+    return bit;
+}
+
+LatencyHistogram::LatencyHistogram() : counts(BUCKETS, 0), total(0), sumNs(0), maxNs(0) {
+}
+
+int LatencyHistogram::bucketIndex(uint64_t ns) {
+    if (ns < (uint64_t) SUB_COUNT) {
+        return (int) ns;
+    }
+    int exponent = highestBit(ns);
+    if (exponent > MAX_EXPONENT) {
+        return BUCKETS - 1;
+    }
+    int shift = exponent - SUB_BITS;
+    int mantissa = (int) (ns >> shift) - SUB_COUNT;
+    return SUB_COUNT + shift * SUB_COUNT + mantissa;
+}
+
+uint64_t LatencyHistogram::bucketLow(int index) {
+    if (index < SUB_COUNT) {
+        return (uint64_t) index;
+    }
+    int shift = (index - SUB_COUNT) / SUB_COUNT;
+    int mantissa = (index - SUB_COUNT) % SUB_COUNT;
+    return (uint64_t) (SUB_COUNT + mantissa) << shift;
+}
+
+uint64_t LatencyHistogram::bucketHigh(int index) {
+    if (index < SUB_COUNT) {
+        return (uint64_t) index;
+    }
+    int shift = (index - SUB_COUNT) / SUB_COUNT;
+    return bucketLow(index) + ((uint64_t) 1 << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    ++counts[bucketIndex(ns)];
+    ++total;
+    sumNs += ns;
+    maxNs = std::max(maxNs, ns);
+}
+
+void LatencyHistogram::add(const LatencyHistogram &other) {
+    for (int i = 0; i < BUCKETS; ++i) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sumNs += other.sumNs;
+    maxNs = std::max(maxNs, other.maxNs);
+}
+
+void LatencyHistogram::addBucket(int index, uint64_t n) {
+    counts[index] += n;
+    total += n;
+}
+
+void LatencyHistogram::addSummary(uint64_t sum, uint64_t max) {
+    sumNs += sum;
+    maxNs = std::max(maxNs, max);
+}
+
+void LatencyHistogram::reset() {
+    fill(counts.begin(), counts.end(), 0);
+    total = 0;
+    sumNs = 0;
+    maxNs = 0;
+}
+
+uint64_t LatencyHistogram::quantile(double q) const {
+    if (0 == total) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) (q * total + 0.999999);
+    rank = std::max<uint64_t>(1, std::min(rank, total));
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            uint64_t mid = bucketLow(i) + (bucketHigh(i) - bucketLow(i)) / 2;
+            return std::min(mid, maxNs);
+        }
+    }
+    return maxNs;
+}
+
+const char *dbOpName(DbOp op) {
+    switch (op) {
+        case DbOp::CREATE_CONNECTION:
+            return "createConnection";
+        case DbOp::CREATE_STATEMENT:
+            return "createStatement";
+        case DbOp::EXECUTE_QUERY:
+            return "executeQuery";
+        case DbOp::NEXT:
+            return "next";
+        case DbOp::EXECUTE_UPDATE:
+            return "executeUpdate";
+        case DbOp::TERMINATE_STATEMENT:
+            return "terminateStatement";
+        default:
+            return "?";
+    }
+}
+
+const char *dbOpStage(DbOp op) {
+    switch (op) {
+        case DbOp::CREATE_CONNECTION:
+            return "connect";
+        case DbOp::CREATE_STATEMENT:
+            return "parse";
+        case DbOp::EXECUTE_QUERY:
+        case DbOp::EXECUTE_UPDATE:
+            return "execute";
+        case DbOp::NEXT:
+            return "fetch";
+        case DbOp::TERMINATE_STATEMENT:
+            return "close";
+        default:
+            return "?";
+    }
+}
+
+/**
+ * One thread's histogram for one key. Only the owning thread writes,
+ * the merger reads concurrently, so the counters are atomics updated with
+ * plain relaxed load/store pairs.
+ */
+struct LatencyRecorder::Shard {
+    Key key;
+    unique_ptr<atomic<uint64_t>[]> counts;
+    atomic<uint64_t> sumNs;
+    atomic<uint64_t> maxNs;
+
+    // 合并线程已经合并过的部分, 只在持有 LatencyRecorder::lock 时访问
+    vector<uint64_t> seen;
+    uint64_t seenSum;
+
+    explicit Shard(const Key &key)
+            : key(key), counts(new atomic<uint64_t>[LatencyHistogram::BUCKETS]),
+              sumNs(0), maxNs(0), seen(LatencyHistogram::BUCKETS, 0), seenSum(0) {
+        for (int i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+            counts[i].store(0, memory_order_relaxed);
+        }
+    }
+};
+
+static inline void bump(atomic<uint64_t> &value, uint64_t n) {
+    value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+struct KeyHash {
+    size_t operator()(const LatencyRecorder::Key &key) const {
+        return (size_t) (key.second * 31 + (uint64_t) key.first);
+    }
+};
+
+struct ThreadShards {
+    unordered_map<LatencyRecorder::Key, LatencyRecorder::Shard *, KeyHash> shards;
+
+    ~ThreadShards() {
+        for (auto &item: shards) {
+            LatencyRecorder::instance().detach(item.second);
+        }
+    }
+};
+
+static thread_local ThreadShards threadShards;
+
+LatencyRecorder &LatencyRecorder::instance() {
+    static LatencyRecorder recorder;
+    return recorder;
+}
+
+LatencyRecorder::LatencyRecorder() : merging(false) {
+}
+
+LatencyRecorder::~LatencyRecorder() {
+    stopMerger();
+}
+
+void LatencyRecorder::record(DbOp op, uint64_t fingerprint, uint64_t ns) {
+    Key key((int) op, fingerprint);
+    Shard *shard;
+    auto it = threadShards.shards.find(key);
+    if (it == threadShards.shards.end()) {
+        shard = new Shard(key);
+        attach(shard);
+        threadShards.shards.emplace(key, shard);
+    } else {
+        shard = it->second;
+    }
+    bump(shard->counts[LatencyHistogram::bucketIndex(ns)], 1);
+    bump(shard->sumNs, ns);
+    if (ns > shard->maxNs.load(memory_order_relaxed)) {
+        shard->maxNs.store(ns, memory_order_relaxed);
+    }
+}
+
+void LatencyRecorder::label(uint64_t fingerprint, const string &sql) {
+    lock_guard<mutex> guard(lock);
+    if (labels.find(fingerprint) == labels.end()) {
+        labels[fingerprint] = sql.substr(0, 60);
+    }
+}
+
+uint64_t tagSql(const string &sql) {
+    string normalized = normalizeSql(sql);
+    uint64_t fingerprint = hashNormalizedSql(normalized);
+    LatencyRecorder::instance().label(fingerprint, normalized);
+    return fingerprint;
+}
+
+void LatencyRecorder::attach(Shard *shard) {
+    lock_guard<mutex> guard(lock);
+    live.push_back(shard);
+}
+
+static void fold(LatencyRecorder::Shard *shard, LatencyHistogram &into);
+
+void LatencyRecorder::detach(Shard *shard) {
+    lock_guard<mutex> guard(lock);
+    fold(shard, merged[shard->key]);
+    live.erase(remove(live.begin(), live.end(), shard), live.end());
+    delete shard;
+}
+
+/**
+ * Adds what the shard recorded since the last fold. Caller holds the recorder lock.
+ */
+static void fold(LatencyRecorder::Shard *shard, LatencyHistogram &into) {
+    for (int i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+        uint64_t now = shard->counts[i].load(memory_order_relaxed);
+        if (now != shard->seen[i]) {
+            into.addBucket(i, now - shard->seen[i]);
+            shard->seen[i] = now;
+        }
+    }
+    uint64_t sum = shard->sumNs.load(memory_order_relaxed);
+    into.addSummary(sum - shard->seenSum, shard->maxNs.load(memory_order_relaxed));
+    shard->seenSum = sum;
+}
+
+void LatencyRecorder::merge() {
+    lock_guard<mutex> guard(lock);
+    for (Shard *shard: live) {
+        fold(shard, merged[shard->key]);
+    }
+}
+
+void LatencyRecorder::startMerger(chrono::milliseconds interval) {
+    lock_guard<mutex> guard(mergerLock);
+    if (merging) {
+        return;
+    }
+    merging = true;
+    merger = thread([this, interval]() {
+        unique_lock<mutex> lk(mergerLock);
+        while (merging) {
+            mergerWake.wait_for(lk, interval, [this] { return !merging; });
+            lk.unlock();
+            merge();
+            lk.lock();
+        }
+    });
+}
+
+void LatencyRecorder::stopMerger() {
+    {
+        lock_guard<mutex> guard(mergerLock);
+        if (!merging) {
+            return;
+        }
+        merging = false;
+    }
+    mergerWake.notify_all();
+    if (merger.joinable()) {
+        merger.join();
+    }
+}
+
+map<LatencyRecorder::Key, LatencyHistogram> LatencyRecorder::snapshot() {
+    merge();
+    lock_guard<mutex> guard(lock);
+    return merged;
+}
+
+static string micros(uint64_t ns) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.1f", ns / 1000.0);
+    return buf;
+}
+
+string LatencyRecorder::report() {
+    map<Key, LatencyHistogram> all = snapshot();
+    map<uint64_t, string> names;
+    {
+        lock_guard<mutex> guard(lock);
+        names = labels;
+    }
+    string out;
+    char line[512];
+    snprintf(line, sizeof(line), "%-20s %10s %10s %10s %10s %10s  %s\n",
+             "call", "count", "p50(us)", "p99(us)", "p99.9(us)", "max(us)", "sql");
+    out += line;
+    for (const auto &item: all) {
+        const LatencyHistogram &h = item.second;
+        if (0 == h.count()) {
+            continue;
+        }
+        auto name = names.find(item.first.second);
+        snprintf(line, sizeof(line), "%-20s %10llu %10s %10s %10s %10s  %s\n",
+                 dbOpName((DbOp) item.first.first), (unsigned long long) h.count(),
+                 micros(h.quantile(0.50)).c_str(), micros(h.quantile(0.99)).c_str(),
+                 micros(h.quantile(0.999)).c_str(), micros(h.max()).c_str(),
+                 name != names.end() ? name->second.c_str() : "-");
+        out += line;
+    }
+    return out;
+}
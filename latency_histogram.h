@@ -0,0 +1,213 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "trace.h"
+
+/**
+ * Log-linear histogram of nanosecond latencies (HDR style).
+ *
+ * Values below 16ns are exact; above that every power of two is split into
+ * 16 linear sub-buckets, so any recorded value is known within 1/16 (6.25%),
+ * and quantiles are reported at the bucket midpoint. Values up to 2^40 ns
+ * (~18 minutes) are kept, larger ones are clamped into the last bucket.
+ */
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 4;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int MAX_EXPONENT = 40;
+    static const int BUCKETS = SUB_COUNT + (MAX_EXPONENT - SUB_BITS + 1) * SUB_COUNT;
+
+    LatencyHistogram();
+
+    void record(uint64_t ns);
+
+    void add(const LatencyHistogram &other);
+
+    /**
+     * Adds n values known only by their bucket; sum and max come via addSummary().
+     */
+    void addBucket(int index, uint64_t n);
+
+    void addSummary(uint64_t sum, uint64_t max);
+
+    void reset();
+
+    uint64_t count() const { return total; }
+
+    uint64_t max() const { return maxNs; }
+
+    double mean() const { return total ? (double) sumNs / total : 0; }
+
+    /**
+     * q in [0, 1], returns nanoseconds.
+     */
+    uint64_t quantile(double q) const;
+
+    uint64_t bucketCount(int index) const { return counts[index]; }
+
+    static int bucketIndex(uint64_t ns);
+
+    static uint64_t bucketLow(int index);
+
+    static uint64_t bucketHigh(int index);
+
+private:
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t sumNs;
+    uint64_t maxNs;
+};
+
+/**
+ * The calls the program makes into OCCI, for tagging recorded latencies.
+ */
+enum class DbOp {
+    CREATE_CONNECTION,
+    CREATE_STATEMENT,
+    EXECUTE_QUERY,
+    NEXT,
+    EXECUTE_UPDATE,
+    TERMINATE_STATEMENT,
+    COUNT
+};
+
+const char *dbOpName(DbOp op);
+
+/**
+ * The execution stage a call belongs to in traces: connect, parse, execute, fetch, close.
+ */
+const char *dbOpStage(DbOp op);
+
+/**
+ * Per-thread latency recording for (call, SQL fingerprint) pairs.
+ *
+ * record() only touches the calling thread's own shard: a thread-local map
+ * lookup plus relaxed atomic stores, no lock and no read-modify-write. A
+ * shard is registered with the recorder once, when the thread first sees a
+ * key. merge() folds every live shard into the merged totals and is run
+ * periodically by startMerger() (and on demand by snapshot()).
+ */
+class LatencyRecorder {
+public:
+    typedef std::pair<int, uint64_t> Key;
+
+    static LatencyRecorder &instance();
+
+    void record(DbOp op, uint64_t fingerprint, uint64_t ns);
+
+    /**
+     * Registers a human readable statement for a fingerprint, shown in report().
+     */
+    void label(uint64_t fingerprint, const std::string &sql);
+
+    void merge();
+
+    void startMerger(std::chrono::milliseconds interval);
+
+    void stopMerger();
+
+    std::map<Key, LatencyHistogram> snapshot();
+
+    /**
+     * p50/p99/p99.9/max per call and statement.
+     */
+    std::string report();
+
+    struct Shard;
+
+private:
+    LatencyRecorder();
+
+    ~LatencyRecorder();
+
+    friend struct ThreadShards;
+
+    void attach(Shard *shard);
+
+    void detach(Shard *shard);
+
+    std::mutex lock;
+    std::vector<Shard *> live;
+    std::map<Key, LatencyHistogram> merged;
+    std::map<uint64_t, std::string> labels;
+
+    std::mutex mergerLock;
+    std::condition_variable mergerWake;
+    bool merging;
+    std::thread merger;
+};
+
+/**
+ * sqlFingerprint(sql), also registering the normalized text for report().
+ */
+uint64_t tagSql(const std::string &sql);
+
+/**
+ * Number of dbCall() wrappers entered on the calling thread, the client side
+ * of round-trip accounting (see RoundTripScope).
+ */
+inline uint64_t &threadDbCalls() {
+    static thread_local uint64_t calls = 0;
+    return calls;
+}
+
+/**
+ * Nanoseconds the calling thread spent inside dbCall() wrappers: time in the
+ * client library, on the wire and on the server, as opposed to the
+ * program's own work in between.
+ */
+inline uint64_t &threadDbNanos() {
+    static thread_local uint64_t nanos = 0;
+    return nanos;
+}
+
+/**
+ * Times one OCCI call and records it on scope exit (also when the call throws).
+ */
+class DbCallTimer {
+public:
+    DbCallTimer(DbOp op, uint64_t fingerprint)
+            : op(op), fingerprint(fingerprint), start(std::chrono::steady_clock::now()) {
+        ++threadDbCalls();
+    }
+
+    ~DbCallTimer() {
+        auto end = std::chrono::steady_clock::now();
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+        threadDbNanos() += (uint64_t) ns.count();
+        LatencyRecorder::instance().record(op, fingerprint, (uint64_t) ns.count());
+        if (Tracer::instance().enabled()) {
+            Tracer::instance().record(dbOpStage(op), dbOpName(op), start, end, fingerprint);
+        }
+    }
+
+    DbCallTimer(const DbCallTimer &) = delete;
+
+    DbCallTimer &operator=(const DbCallTimer &) = delete;
+
+private:
+    DbOp op;
+    uint64_t fingerprint;
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * dbCall(DbOp::EXECUTE_QUERY, fp, [&] { return stmt->executeQuery(sql); })
+ */
+template<typename F>
+auto dbCall(DbOp op, uint64_t fingerprint, F &&fn) -> decltype(fn()) {
+    DbCallTimer timer(op, fingerprint);
+    return fn();
+}
@@ -0,0 +1,299 @@
+#include "loadgen.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "logger.h"
+#include "statement_probe.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+// 和 occidml 里的语句一致, 查询改成按主键查一行, 表变大时每次请求的代价不变
+static const char *SELECT_SQL = "SELECT author_id, author_name FROM author_tab WHERE author_id = :x";
+static const char *INSERT_SQL = "INSERT INTO author_tab VALUES (:x, :y)";
+static const char *UPDATE_SQL = "UPDATE author_tab SET author_name = :x WHERE author_id = :y";
+static const char *DELETE_SQL = "DELETE FROM author_tab WHERE author_id= :x AND author_name = :y";
+static const char *CREATE_SQL = "CREATE TABLE author_tab (author_id NUMBER, author_name VARCHAR2(25))";
+
+static const char *OP_NAMES[] = {"select", "insert", "update", "delete"};
+
+const char *loadOpName(LoadOp op) {
+    return OP_NAMES[(int) op];
+}
+
+bool parseLoadMix(const string &text, LoadgenOptions &options) {
+    unsigned int mix[(int) LoadOp::COUNT] = {0, 0, 0, 0};
+    stringstream in(text);
+    string item;
+    while (getline(in, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == string::npos) {
+            return false;
+        }
+        string name = item.substr(0, eq);
+        int op = -1;
+        for (int i = 0; i < (int) LoadOp::COUNT; ++i) {
+            if (name == OP_NAMES[i]) {
+                op = i;
+            }
+        }
+        if (op < 0) {
+            return false;
+        }
+        mix[op] = (unsigned int) atoi(item.c_str() + eq + 1);
+    }
+    unsigned int total = 0;
+    for (unsigned int weight: mix) {
+        total += weight;
+    }
+    if (total == 0) {
+        return false;
+    }
+    for (int i = 0; i < (int) LoadOp::COUNT; ++i) {
+        options.mix[i] = mix[i];
+    }
+    return true;
+}
+
+bool parseLoadgenOption(const string &name, const string &value, LoadgenOptions &options) {
+    if (name == "--qps") {
+        options.qps = atof(value.c_str());
+        return options.qps > 0;
+    } else if (name == "--threads") {
+        options.threads = (unsigned int) atoi(value.c_str());
+        return options.threads > 0;
+    } else if (name == "--seconds") {
+        options.seconds = atof(value.c_str());
+        return options.seconds > 0;
+    } else if (name == "--keys") {
+        options.keys = (unsigned int) atoi(value.c_str());
+        return options.keys > 0;
+    } else if (name == "--seed") {
+        options.seed = strtoull(value.c_str(), nullptr, 10);
+        return true;
+    } else if (name == "--mix") {
+        return parseLoadMix(value, options);
+    } else if (name == "--limit") {
+        options.limit = (unsigned int) atoi(value.c_str());
+        return true;
+    } else if (name == "--max-wait-ms") {
+        options.maxWaitMs = (unsigned int) atoi(value.c_str());
+        return true;
+    } else if (name == "--tenant-quota") {
+        options.tenantQuota = (unsigned int) atoi(value.c_str());
+        return true;
+    }
+    return false;
+}
+
+static void createAuthorTable(SessionPool &pool) {
+    Connection *conn = pool.checkout();
+    if (nullptr == conn) {
+        return;
+    }
+    Statement *stmt = nullptr;
+    try {
+        stmt = conn->createStatement(CREATE_SQL);
+        stmt->executeUpdate();
+    }
+    catch (const SQLException &e) {
+        // ORA-00955: 表已经存在
+        if (e.getErrorCode() != 955) {
+            logError("%s", e.what());
+        }
+    }
+    if (stmt) {
+        conn->terminateStatement(stmt);
+    }
+    pool.release(conn);
+}
+
+static const char *opSql(LoadOp op) {
+    switch (op) {
+        case LoadOp::INSERT_ROW:
+            return INSERT_SQL;
+        case LoadOp::UPDATE_ROW:
+            return UPDATE_SQL;
+        case LoadOp::DELETE_ROW:
+            return DELETE_SQL;
+        default:
+            return SELECT_SQL;
+    }
+}
+
+/**
+ * One request: checkout, one statement, release. Returns false on error.
+ */
+static bool runOp(SessionPool &pool, LoadOp op, int key, const uint64_t *fingerprints) {
+    Connection *conn = pool.checkout(loadOpName(op));
+    if (nullptr == conn) {
+        return false;
+    }
+    const string sql = opSql(op);
+    uint64_t fp = fingerprints[(int) op];
+    string name = "author" + to_string(key);
+    bool ok = true;
+    Statement *stmt = nullptr;
+    try {
+        stmt = dbCall(DbOp::CREATE_STATEMENT, fp, [&] { return conn->createStatement(sql); });
+        if (op == LoadOp::SELECT_ROW) {
+            StatementProbe probe(sql, StatementKind::QUERY, fp);
+            stmt->setInt(1, key);
+            probe.bind(1, key);
+            ResultSet *rs = dbCall(DbOp::EXECUTE_QUERY, fp, [&] { return stmt->executeQuery(); });
+            while (dbCall(DbOp::NEXT, fp, [&] { return rs->next(); })) {
+                probe.addRows(1);
+            }
+            stmt->closeResultSet(rs);
+        } else {
+            StatementProbe probe(sql, StatementKind::UPDATE, fp);
+            stmt->setAutoCommit(true);
+            if (op == LoadOp::UPDATE_ROW) {
+                stmt->setString(1, name);
+                probe.bind(1, name);
+                stmt->setInt(2, key);
+                probe.bind(2, key);
+            } else {
+                stmt->setInt(1, key);
+                probe.bind(1, key);
+                stmt->setString(2, name);
+                probe.bind(2, name);
+            }
+            probe.addRows(dbCall(DbOp::EXECUTE_UPDATE, fp, [&] { return stmt->executeUpdate(); }));
+        }
+    }
+    catch (const SQLException &e) {
+        ok = false;
+    }
+    // 工作线程里不能让异常逃出去; 关不掉语句说明会话已经坏了, 这个请求也算失败
+    if (stmt) {
+        try {
+            dbCall(DbOp::TERMINATE_STATEMENT, fp, [&] { conn->terminateStatement(stmt); });
+        }
+        catch (const SQLException &e) {
+            logDebug("%s", e.what());
+            ok = false;
+        }
+    }
+    pool.release(conn);
+    return ok;
+}
+
+LoadgenReport runLoadgen(SessionPool &pool, const LoadgenOptions &options) {
+    LoadgenReport report;
+    createAuthorTable(pool);
+
+    uint64_t fingerprints[(int) LoadOp::COUNT];
+    for (int i = 0; i < (int) LoadOp::COUNT; ++i) {
+        fingerprints[i] = tagSql(opSql((LoadOp) i));
+    }
+
+    // 到达时间表由所有 worker 共享: 谁空闲谁取下一个请求, 即 M/G/N 排队
+    mutex scheduleLock;
+    mt19937_64 rng(options.seed ? options.seed : random_device{}());
+    exponential_distribution<double> gap(std::max(options.qps, 0.001));
+    discrete_distribution<int> pick(begin(options.mix), end(options.mix));
+    uniform_int_distribution<int> key(1, (int) std::max(1u, options.keys));
+    auto start = chrono::steady_clock::now() + chrono::milliseconds(10);
+    auto deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(
+            chrono::duration<double>(options.seconds));
+    auto nextArrival = start;
+
+    mutex reportLock;
+    vector<thread> workers;
+    for (unsigned int w = 0; w < std::max(1u, options.threads); ++w) {
+        workers.emplace_back([&] {
+            LoadOpStats stats[(int) LoadOp::COUNT];
+            uint64_t scheduled = 0;
+            while (true) {
+                chrono::steady_clock::time_point intended;
+                LoadOp op;
+                int k;
+                {
+                    lock_guard<mutex> guard(scheduleLock);
+                    intended = nextArrival;
+                    if (intended >= deadline) {
+                        break;
+                    }
+                    nextArrival += chrono::duration_cast<chrono::steady_clock::duration>(
+                            chrono::duration<double>(gap(rng)));
+                    op = (LoadOp) pick(rng);
+                    k = key(rng);
+                }
+                ++scheduled;
+                // 落后于计划时不等待, 立刻执行; 落后的时间计入延迟
+                this_thread::sleep_until(intended);
+                auto begin = chrono::steady_clock::now();
+                bool ok = runOp(pool, op, k, fingerprints);
+                auto end = chrono::steady_clock::now();
+                LoadOpStats &s = stats[(int) op];
+                ++s.requests;
+                s.errors += ok ? 0 : 1;
+                s.latency.record((uint64_t) chrono::duration_cast<chrono::nanoseconds>(end - intended).count());
+                s.service.record((uint64_t) chrono::duration_cast<chrono::nanoseconds>(end - begin).count());
+            }
+            lock_guard<mutex> guard(reportLock);
+            report.scheduled += scheduled;
+            for (int i = 0; i < (int) LoadOp::COUNT; ++i) {
+                report.ops[i].requests += stats[i].requests;
+                report.ops[i].errors += stats[i].errors;
+                report.ops[i].latency.add(stats[i].latency);
+                report.ops[i].service.add(stats[i].service);
+            }
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+string formatLoadgenReport(const LoadgenReport &report, const LoadgenOptions &options) {
+    char line[256];
+    string out;
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    LatencyHistogram all;
+    LatencyHistogram service;
+    for (const auto &op: report.ops) {
+        requests += op.requests;
+        errors += op.errors;
+        all.add(op.latency);
+        service.add(op.service);
+    }
+    double achieved = report.seconds > 0 ? (double) requests / report.seconds : 0;
+    snprintf(line, sizeof(line), "target %.1f qps, achieved %.1f qps over %.1fs, %llu requests, %llu errors\n",
+             options.qps, achieved, report.seconds, (unsigned long long) requests, (unsigned long long) errors);
+    out += line;
+    snprintf(line, sizeof(line), "%-8s %9s %10s %10s %10s %10s %10s %12s\n", "op", "requests", "p50(us)",
+             "p90(us)", "p99(us)", "p99.9(us)", "max(us)", "svc p99(us)");
+    out += line;
+    auto row = [&](const char *name, uint64_t n, const LatencyHistogram &h, const LatencyHistogram &svc) {
+        snprintf(line, sizeof(line), "%-8s %9llu %10.1f %10.1f %10.1f %10.1f %10.1f %12.1f\n", name,
+                 (unsigned long long) n, h.quantile(0.50) / 1000.0, h.quantile(0.90) / 1000.0,
+                 h.quantile(0.99) / 1000.0, h.quantile(0.999) / 1000.0, h.max() / 1000.0,
+                 svc.quantile(0.99) / 1000.0);
+        out += line;
+    };
+    for (int i = 0; i < (int) LoadOp::COUNT; ++i) {
+        if (report.ops[i].requests) {
+            row(OP_NAMES[i], report.ops[i].requests, report.ops[i].latency, report.ops[i].service);
+        }
+    }
+    row("all", requests, all, service);
+    // 延迟远大于服务时间说明请求在排队, 目标 QPS 超过了这组 worker/会话的容量
+    if (achieved < options.qps * 0.95 || all.quantile(0.99) > 2 * service.quantile(0.99) + 1000000) {
+        out += "warning: saturated, requests queued behind the workers (latency >> service time)\n";
+    }
+    return out;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "latency_histogram.h"
+#include "session_pool.h"
+
+// DELETE 在 winnt.h 里是宏, 所以都带上 _ROW
+enum class LoadOp {
+    SELECT_ROW,
+    INSERT_ROW,
+    UPDATE_ROW,
+    DELETE_ROW,
+    COUNT
+};
+
+const char *loadOpName(LoadOp op);
+
+struct LoadgenOptions {
+    double qps = 100;
+    unsigned int threads = 4;
+    double seconds = 10;
+    // 各操作的权重, 按 LoadOp 的顺序
+    unsigned int mix[(int) LoadOp::COUNT] = {70, 10, 10, 10};
+    // author_id 在 [1, keys] 里均匀随机
+    unsigned int keys = 1000;
+    uint64_t seed = 0;
+    // >0: 池前面放一个自适应并发限制器, 上限不超过 limit; 每种操作算一个租户
+    unsigned int limit = 0;
+    unsigned int maxWaitMs = 50;
+    unsigned int tenantQuota = 0;
+};
+
+/**
+ * Parses "select=70,insert=10,update=10,delete=10" into options.mix;
+ * operations left out get weight 0.
+ */
+bool parseLoadMix(const std::string &text, LoadgenOptions &options);
+
+/**
+ * Applies one `loadgen` command-line option (--qps, --threads, --seconds,
+ * --keys, --seed, --mix, --limit, --max-wait-ms, --tenant-quota); false for
+ * an unknown option or a bad value.
+ */
+bool parseLoadgenOption(const std::string &name, const std::string &value, LoadgenOptions &options);
+
+struct LoadOpStats {
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    // 从计划到达时间算起, 包含排队等待 (修正了 coordinated omission)
+    LatencyHistogram latency;
+    // 从真正开始执行算起, 只有服务时间
+    LatencyHistogram service;
+};
+
+struct LoadgenReport {
+    double seconds = 0;
+    uint64_t scheduled = 0;
+    LoadOpStats ops[(int) LoadOp::COUNT];
+};
+
+/**
+ * Open-loop load on author_tab: requests arrive as a Poisson process at
+ * options.qps (exponential gaps from one shared schedule), whether or not
+ * earlier ones have finished, and `threads` workers serve them in arrival
+ * order through pool. Latency is measured from each request's scheduled
+ * arrival, so time spent queued behind a slow request is counted instead of
+ * silently thinning the load the way a closed loop does.
+ *
+ * Creates author_tab if it is missing.
+ */
+LoadgenReport runLoadgen(SessionPool &pool, const LoadgenOptions &options);
+
+std::string formatLoadgenReport(const LoadgenReport &report, const LoadgenOptions &options);
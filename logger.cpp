@@ -0,0 +1,258 @@
+#include "logger.h"
+
+#include <algorithm>
+#include <ctime>
+
+using namespace std;
+
+static const size_t RING_CAPACITY = 8192;
+static const char *LEVEL_NAMES[] = {"debug", "info", "warn", "error"};
+// 默认每秒行数: 错误风暴时最多写这么多, 其余只计数
+static const uint32_t DEFAULT_LIMITS[] = {1000, 1000, 100, 100};
+
+const char *logLevelName(LogLevel level) {
+    return LEVEL_NAMES[(int) level];
+}
+
+bool parseLogLevel(const string &text, LogLevel &level) {
+    for (int i = 0; i < 4; ++i) {
+        if (text == LEVEL_NAMES[i]) {
+            level = (LogLevel) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void appendUtcTimestamp(string &out, chrono::system_clock::time_point at) {
+    time_t seconds = chrono::system_clock::to_time_t(at);
+    long millis = (long) (chrono::duration_cast<chrono::milliseconds>(at.time_since_epoch()).count() % 1000);
+    tm utc;
+#ifdef _WIN32
+    gmtime_s(&utc, &seconds);
+#else
+    gmtime_r(&seconds, &utc);
+#endif
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &utc);
+    out += text;
+    snprintf(text, sizeof(text), ".%03ldZ", millis);
+    out += text;
+}
+
+static uint32_t threadNumber() {
+    static atomic<uint32_t> next(1);
+    static thread_local uint32_t G_LOG_THREAD = next.fetch_add(1, memory_order_relaxed);
+    return G_LOG_THREAD;
+}
+
+static void appendLine(string &out, LogLevel level, uint32_t thread, chrono::system_clock::time_point at,
+                       const char *text, size_t length) {
+    appendUtcTimestamp(out, at);
+    out += " level=";
+    out += logLevelName(level);
+    out += " thread=";
+    out += to_string(thread);
+    out += " msg=\"";
+    for (size_t i = 0; i < length; ++i) {
+        char c = text[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c != '\r') {
+            out += c;
+        }
+    }
+    out += "\"\n";
+}
+
+Logger &Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger() : minLevel((uint8_t) LogLevel::INFO) {
+    for (int i = 0; i < 4; ++i) {
+        levels[i].limit.store(DEFAULT_LIMITS[i], memory_order_relaxed);
+    }
+}
+
+Logger::~Logger() {
+    stop();
+}
+
+bool Logger::start(const string &path) {
+    if (running.load(memory_order_relaxed)) {
+        return true;
+    }
+    if (path.empty() || path == "-") {
+        out = stderr;
+    } else {
+        out = fopen(path.c_str(), "a");
+        if (nullptr == out) {
+            fprintf(stderr, "open log file %s error.\n", path.c_str());
+            return false;
+        }
+    }
+    if (!ring) {
+        ring.reset(new MpscRing<LogRecord>(RING_CAPACITY));
+    }
+    stopping = false;
+    writer = thread(&Logger::writeLoop, this);
+    running.store(true, memory_order_release);
+    return true;
+}
+
+void Logger::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    if (out != stderr) {
+        fclose(out);
+    }
+    out = nullptr;
+}
+
+void Logger::setLevel(LogLevel level) {
+    minLevel.store((uint8_t) level, memory_order_relaxed);
+}
+
+void Logger::setRateLimit(LogLevel level, uint32_t perSecond) {
+    levels[(int) level].limit.store(perSecond, memory_order_relaxed);
+}
+
+uint64_t Logger::suppressed() const {
+    uint64_t total = 0;
+    for (const auto &state: levels) {
+        total += state.suppressed.load(memory_order_relaxed);
+    }
+    return total;
+}
+
+bool Logger::admit(LevelState &state) {
+    uint32_t limit = state.limit.load(memory_order_relaxed);
+    if (0 == limit) {
+        return true;
+    }
+    // 按秒开窗口, 换窗口时谁抢到 CAS 谁清零; 边界上多放几行无所谓
+    int64_t second = chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t window = state.window.load(memory_order_relaxed);
+    if (window != second && state.window.compare_exchange_strong(window, second, memory_order_relaxed)) {
+        state.used.store(0, memory_order_relaxed);
+    }
+    if (state.used.fetch_add(1, memory_order_relaxed) < limit) {
+        return true;
+    }
+    state.suppressed.fetch_add(1, memory_order_relaxed);
+    return false;
+}
+
+void Logger::write(LogLevel level, const char *format, va_list args) {
+    if (!enabled(level) || !admit(levels[(int) level])) {
+        return;
+    }
+    LogRecord record;
+    record.level = level;
+    record.thread = threadNumber();
+    record.at = chrono::system_clock::now();
+    int n = vsnprintf(record.text, LogRecord::MAX_TEXT, format, args);
+    size_t length = n < 0 ? 0 : std::min((size_t) n, LogRecord::MAX_TEXT - 1);
+    // e.what() 常带换行结尾
+    while (length && (record.text[length - 1] == '\n' || record.text[length - 1] == '\r')) {
+        --length;
+    }
+    record.length = (uint16_t) length;
+
+    if (running.load(memory_order_acquire)) {
+        if (!ring->push(record)) {
+            droppedCount.fetch_add(1, memory_order_relaxed);
+        }
+        return;
+    }
+    string line;
+    appendLine(line, record.level, record.thread, record.at, record.text, record.length);
+    fputs(line.c_str(), stderr);
+}
+
+void Logger::appendSuppressed(string &batch) {
+    char text[128];
+    for (int i = 0; i < 4; ++i) {
+        LevelState &state = levels[i];
+        uint64_t suppressed = state.suppressed.load(memory_order_relaxed);
+        uint64_t reported = state.reported.load(memory_order_relaxed);
+        if (suppressed > reported) {
+            int n = snprintf(text, sizeof(text), "suppressed %llu %s lines (limit %u/s)",
+                             (unsigned long long) (suppressed - reported), LEVEL_NAMES[i],
+                             state.limit.load(memory_order_relaxed));
+            appendLine(batch, LogLevel::WARN, 0, chrono::system_clock::now(), text, (size_t) n);
+            state.reported.store(suppressed, memory_order_relaxed);
+        }
+    }
+    uint64_t dropped = droppedCount.load(memory_order_relaxed);
+    if (dropped > droppedReported) {
+        int n = snprintf(text, sizeof(text), "dropped %llu lines (log queue full)",
+                         (unsigned long long) (dropped - droppedReported));
+        appendLine(batch, LogLevel::WARN, 0, chrono::system_clock::now(), text, (size_t) n);
+        droppedReported = dropped;
+    }
+}
+
+void Logger::writeLoop() {
+    LogRecord record;
+    string batch;
+    batch.reserve(64 * 1024);
+    bool done = false;
+    while (!done) {
+        {
+            // 生产者不通知, 入队只有一次 CAS; 写线程每 20ms 把攒下的行一次写出
+            unique_lock<mutex> guard(lock);
+            wake.wait_for(guard, chrono::milliseconds(20), [this] { return stopping; });
+            done = stopping;
+        }
+        batch.clear();
+        while (ring->pop(record)) {
+            appendLine(batch, record.level, record.thread, record.at, record.text, record.length);
+        }
+        appendSuppressed(batch);
+        if (!batch.empty()) {
+            fwrite(batch.data(), 1, batch.size(), out);
+            fflush(out);
+        }
+    }
+}
+
+void logDebug(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    Logger::instance().write(LogLevel::DBG, format, args);
+    va_end(args);
+}
+
+void logInfo(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    Logger::instance().write(LogLevel::INFO, format, args);
+    va_end(args);
+}
+
+void logWarn(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    Logger::instance().write(LogLevel::WARN, format, args);
+    va_end(args);
+}
+
+void logError(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    Logger::instance().write(LogLevel::ERR, format, args);
+    va_end(args);
+}
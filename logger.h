@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "mpsc_ring.h"
+
+// DBG/ERR 而不是 DEBUG/ERROR: Debug 构建 add_definitions(-DDEBUG), wingdi.h 又把 ERROR 定义成宏
+enum class LogLevel : uint8_t {
+    DBG = 0,
+    INFO = 1,
+    WARN = 2,
+    ERR = 3
+};
+
+const char *logLevelName(LogLevel level);
+
+/**
+ * "debug", "info", "warn" or "error"; false leaves level untouched.
+ */
+bool parseLogLevel(const std::string &text, LogLevel &level);
+
+/**
+ * One message as the caller left it. The text is formatted into the record
+ * itself (truncated at MAX_TEXT), so logging allocates nothing on the
+ * calling thread.
+ */
+struct LogRecord {
+    static const size_t MAX_TEXT = 480;
+
+    LogLevel level = LogLevel::INFO;
+    uint32_t thread = 0;
+    std::chrono::system_clock::time_point at;
+    uint16_t length = 0;
+    char text[MAX_TEXT];
+};
+
+/**
+ * Status and error messages of the program, one logfmt line each:
+ *
+ *   2026-10-19T08:15:02.114Z level=error thread=3 msg="ORA-00942: table or view does not exist"
+ *
+ * Once started, callers format into a LogRecord and push it into a lock-free
+ * ring; a writer thread drains the ring every 20ms and writes the batch with
+ * a single fwrite. Nothing on the calling thread waits for the file. Before
+ * start() (or after stop()) lines are written synchronously to stderr, so
+ * code shared with the benchmark keeps working without a writer.
+ *
+ * Each level has its own budget of lines per second; beyond it lines are
+ * counted, not formatted, and the writer reports how many were suppressed.
+ * A full ring drops lines the same way.
+ */
+class Logger {
+public:
+    static Logger &instance();
+
+    Logger(const Logger &) = delete;
+
+    Logger &operator=(const Logger &) = delete;
+
+    /**
+     * "-" or empty = stderr.
+     */
+    bool start(const std::string &path);
+
+    /**
+     * Writes what is queued and stops the writer; later lines go to stderr.
+     */
+    void stop();
+
+    void setLevel(LogLevel level);
+
+    bool enabled(LogLevel level) const {
+        return (uint8_t) level >= minLevel.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Lines per second for level; 0 = unlimited.
+     */
+    void setRateLimit(LogLevel level, uint32_t perSecond);
+
+    void write(LogLevel level, const char *format, va_list args);
+
+    uint64_t suppressed() const;
+
+    uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+    struct LevelState {
+        std::atomic<uint32_t> limit{0};
+        std::atomic<int64_t> window{0};
+        std::atomic<uint32_t> used{0};
+        std::atomic<uint64_t> suppressed{0};
+        std::atomic<uint64_t> reported{0};
+    };
+
+    Logger();
+
+    ~Logger();
+
+    bool admit(LevelState &state);
+
+    void writeLoop();
+
+    void appendSuppressed(std::string &batch);
+
+    std::atomic<uint8_t> minLevel;
+    LevelState levels[4];
+    std::unique_ptr<MpscRing<LogRecord>> ring;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> droppedCount{0};
+    uint64_t droppedReported = 0;
+    FILE *out = nullptr;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::thread writer;
+    bool stopping = false;
+};
+
+/**
+ * printf-style shorthands for Logger::instance(). A disabled level costs one
+ * relaxed load; a rate-limited one an extra atomic increment.
+ */
+void logDebug(const char *format, ...);
+
+void logInfo(const char *format, ...);
+
+void logWarn(const char *format, ...);
+
+void logError(const char *format, ...);
+
+/**
+ * "2026-10-19T08:15:02.114Z", shared with the slow query log.
+ */
+void appendUtcTimestamp(std::string &out, std::chrono::system_clock::time_point at);
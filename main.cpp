@@ -1,9 +1,32 @@
 
 #include <iostream>
 
-#define WIN32COMMON
-
-#include <occi.h>
+#include "occi_common.h"
+#include "alloc_tracker.h"
+#include "array_fetch.h"
+#include "batch_controller.h"
+#include "concurrency_limiter.h"
+#include "connection_manager.h"
+#include "hedged_query.h"
+#include "latency_histogram.h"
+#include "loadgen.h"
+#include "logger.h"
+#include "memory_governor.h"
+#include "metrics.h"
+#include "metrics_http.h"
+#include "occidml.h"
+#include "oci_heap.h"
+#include "query_arena.h"
+#include "query_tuner.h"
+#include "roundtrip_counter.h"
+#include "shard_router.h"
+#include "statement_probe.h"
+#include "slow_query_log.h"
+#include "sql_fingerprint.h"
+#include "trace.h"
+#include "tuned_config.h"
+#include "workload_capture.h"
+#include "workload_replay.h"
 
 using namespace std;
 using namespace oracle::occi;
@@ -11,6 +34,31 @@ using namespace oracle::occi;
 Environment *G_ENV;
 Connection *G_CON;
 Statement *G_STATE;
+ConnectionManager *G_MANAGER;
+ManagedSession G_SESSION;
+
+const string G_USER = "user_dev";
+const string G_PASS = "123456";
+const string G_CONNECT_STRING = "127.0.0.1:1521/pdb";
+// const string G_CONNECT_STRING = "127.0.0.1:1521/xe";
+
+// 主库 + 只读副本, 只读查询按延迟在所有节点之间分配
+const vector<EndpointConfig> G_ENDPOINTS = {
+        {"primary",  G_CONNECT_STRING,      EndpointRole::PRIMARY, 4},
+        {"replica1", "127.0.0.1:1522/pdb", EndpointRole::REPLICA, 4},
+        {"replica2", "127.0.0.1:1523/pdb", EndpointRole::REPLICA, 4},
+};
+
+// 本地模拟的分片节点, 每个节点负责一段连续的 chunk
+const unsigned int G_SHARD_CHUNKS = 120;
+const vector<ShardEndpoint> G_SHARDS = {
+        {"shard1", "127.0.0.1:1521/shard1", 0,  39, ""},
+        {"shard2", "127.0.0.1:1522/shard2", 40, 79, ""},
+        {"shard3", "127.0.0.1:1523/shard3", 80, 119, ""},
+};
+
+// OCI_DEMO_OCI_HEAP 打开后 OCI 的客户端堆走 OciHeap
+bool G_OCI_HEAP = false;
 
 
 bool connect();
@@ -19,34 +67,72 @@ int generateStatement();
 
 void printResultSet(const std::string&);
 
+bool printResultSet(Statement *, const std::string&);
+
+void printReadOnlyResultSet(const std::string&);
+
+void printQueryResult(const QueryResult&);
+
+int runHedgedQuery(const std::string&, int);
+
+int runShardQuery(const std::string&, const std::string&);
+
+int runReplay(const std::string&, const ReplayOptions&);
+
+int runLoadgen(const LoadgenOptions&);
+
+int runTune(const std::string&, const TuneOptions&, const std::string&);
+
 void disConnect();
 
+/**
+ * A threaded environment, on OciHeap when G_OCI_HEAP is set.
+ */
+Environment *newEnvironment() {
+    if (!G_OCI_HEAP) {
+        return Environment::createEnvironment(Environment::THREADED_MUTEXED);
+    }
+    return Environment::createEnvironment(Environment::THREADED_MUTEXED, &OciHeap::instance(), OciHeap::allocate,
+                                          OciHeap::reallocate, OciHeap::release);
+}
+
 bool connect() {
+    TraceSpan span("connect");
     try {
-        // 创建 OCCI 上下文环境  
-        G_ENV = Environment::createEnvironment();
+        // 创建 OCCI 上下文环境, 连接池要求多线程模式
+        G_ENV = newEnvironment();
         if (nullptr == G_ENV) {
-            printf("createEnvironment error.\n");
+            logError("createEnvironment error.");
             return false;
         } else {
-            cout << "createEnvironment success" << endl;
+            logInfo("createEnvironment success");
         }
 
-        string name = "user_dev";
-        string pass = "123456";
-        string connectString = "127.0.0.1:1521/pdb";
-        // string connectString = "127.0.0.1:1521/xe";
-        // 创建数据库连接  
-        G_CON = G_ENV->createConnection(name, pass, connectString);
+        // 创建连接管理器, 读写会话来自主库
+        G_MANAGER = new ConnectionManager(G_ENV);
+        for (const auto &endpoint: G_ENDPOINTS) {
+            G_MANAGER->addEndpoint(endpoint);
+        }
+        if (!G_MANAGER->open(G_USER, G_PASS)) {
+            logError("open endpoints error.");
+            return false;
+        }
+        G_SESSION = G_MANAGER->acquire(false);
+        G_CON = G_SESSION.conn;
         if (nullptr == G_CON) {
-            printf("createConnection error.\n");
+            logError("createConnection error.");
             return false;
         } else {
-            cout << "conn success" << endl;
+            logInfo("conn success");
+        }
+        // 语句缓存属于会话, 取调优配置里要求最大的那个
+        unsigned int cacheSize = TunedConfig::instance().stmtCacheSize();
+        if (cacheSize > 0) {
+            G_CON->setStmtCacheSize(cacheSize);
         }
     }
-    catch (SQLException e) {
-        cout << e.what() << endl;
+    catch (const SQLException &e) {
+        logError("%s", e.what());
         return false;
     }
 
@@ -56,14 +142,14 @@ bool connect() {
 int generateStatement() {
 
     try {
-        G_STATE = G_CON->createStatement();
+        G_STATE = dbCall(DbOp::CREATE_STATEMENT, 0, [] { return G_CON->createStatement(); });
         if (NULL == G_STATE) {
-            printf("createStatement error.\n");
+            logError("createStatement error.");
             return -1;
         }
     }
-    catch (SQLException e) {
-        cout << e.what() << endl;
+    catch (const SQLException &e) {
+        logError("%s", e.what());
         return -1;
     }
     return 0;
@@ -71,54 +157,549 @@ int generateStatement() {
 
 
 void printResultSet(const std::string& sql) {
+    printResultSet(G_STATE, sql);
+}
+
+
+// 调过的预取内存在预算紧张时最少缩到这么多
+static const unsigned int PREFETCH_MIN_BYTES = 64 * 1024;
+
+bool printResultSet(Statement *stmt, const std::string& sql) {
+    SqlMetrics metrics = MetricsRegistry::instance().sql(sql);
+    uint64_t fp = tagSql(sql);
+    RoundTripScope trips(stmt->getConnection(), "printResultSet");
+    TraceSpan span("printResultSet", fp);
+    AllocScope alloc("printResultSet");
     try {
-        ResultSet *pRs = G_STATE->executeQuery(sql);
-        vector<MetaData> metaData = pRs->getColumnListMetaData();
-        int count = metaData.size();
-        for (const auto &item: metaData) {
-            std::string cName = item.getString(oracle::occi::MetaData::ATTR_NAME);
-            printf("%s,", cName.c_str());
+        StatementProbe probe(sql, StatementKind::QUERY, fp);
+        // 取数数组和预取内存都记在这条查询的租约上, 从全进程的内存预算里拿
+        MemoryLease memory(fp);
+        // tune 子命令调过的语句用调好的 prefetch 和批大小
+        const TunedStatement *tuned = TunedConfig::instance().find(fp);
+        if (tuned) {
+            TunedSettings settings = tuned->settings;
+            if (settings.prefetchMemory) {
+                // 预算不够时少预取一些, 但至少给 PREFETCH_MIN_BYTES: 0 对 applyTunedSettings 是"不设",
+                // OCI 默认不限预取内存, 上限反而在最紧的时候丢了. 行数按同样比例缩小
+                unsigned int asked = settings.prefetchMemory;
+                size_t granted = memory.reserve(asked, std::min(asked, PREFETCH_MIN_BYTES));
+                settings.prefetchMemory = (unsigned int) granted;
+                if (granted < asked && settings.prefetchRows) {
+                    settings.prefetchRows = std::max(1u, (unsigned int) ((uint64_t) settings.prefetchRows *
+                                                                          granted / asked));
+                }
+            }
+            applyTunedSettings(stmt, settings);
+        }
+        auto start = chrono::steady_clock::now();
+        ResultSet *pRs = dbCall(DbOp::EXECUTE_QUERY, fp, [&] { return stmt->executeQuery(sql); });
+        metrics.execute->observe(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+
+        // 没调过的语句, 批大小由这条语句自己的控制器按实测的单次耗时和行宽在线调整
+        BatchSizeController &printBatch = BatchControllers::instance().forStatement(fp);
+        uint64_t rows = 0;
+        uint64_t bytes = 0;
+        chrono::steady_clock::duration fetchTime(0);
+        {
+            unique_ptr<ArrayFetcher> owned(tuned && tuned->settings.arrayRows
+                                           ? new ArrayFetcher(pRs, tuned->settings.arrayRows, fp, 4000, &memory)
+                                           : new ArrayFetcher(pRs, printBatch, fp, 4000, &memory));
+            ArrayFetcher &fetcher = *owned;
+            unsigned int count = fetcher.columnCount();
+            for (unsigned int i = 1; i <= count; ++i) {
+                printf("%s,", fetcher.columnName(i).c_str());
+            }
+            printf("\n");
+
+            // 单元格格式化的结果只活到 printf 为止, 放在栈上的 arena 里, 每行清一次
+            QueryArena rowArena;
+            // 只统计 next() 本身的耗时, 不包括格式化输出
+            while (true) {
+                auto fetchStart = chrono::steady_clock::now();
+                unsigned int n = fetcher.next();
+                fetchTime += chrono::steady_clock::now() - fetchStart;
+                if (0 == n) {
+                    break;
+                }
+                TraceSpan format("format");
+                for (unsigned int r = 0; r < n; ++r) {
+                    for (unsigned int i = 1; i <= count; ++i) {
+                        std::pmr::string value = fetcher.getString(r, i, rowArena.resource());
+                        bytes += value.size();
+                        printf("%s,", value.c_str());
+                    }
+                    printf("\n");
+                    rowArena.reset();
+                }
+                rows += n;
+            }
+        }
+        {
+            TraceSpan flush("flush");
+            fflush(stdout);
+        }
+        span.setCount(rows);
+        metrics.fetch->observe(chrono::duration<double>(fetchTime).count());
+        metrics.rows->add(rows);
+        metrics.bytes->add(bytes);
+        trips.addRows(rows);
+        probe.addRows(rows);
+        alloc.addRows(rows);
+        stmt->closeResultSet(pRs);
+    }
+    catch (const SQLException &e) {
+        logError("%s", e.what());
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Runs a read-only query on whichever endpoint currently scores best,
+ * and feeds the time spent in OCCI calls (not the formatting and printing
+ * of the rows) back into the manager.
+ */
+void printReadOnlyResultSet(const std::string& sql) {
+    ManagedSession session = G_MANAGER->acquire(true);
+    if (nullptr == session.conn) {
+        return;
+    }
+    bool ok = true;
+    // 只算 dbCall 里的时间: 大结果集或慢终端的输出耗时不该让端点显得慢
+    uint64_t dbNsStart = threadDbNanos();
+    try {
+        Statement *stmt = dbCall(DbOp::CREATE_STATEMENT, 0, [&] { return session.conn->createStatement(); });
+        ok = printResultSet(stmt, sql);
+        dbCall(DbOp::TERMINATE_STATEMENT, 0, [&] { session.conn->terminateStatement(stmt); });
+    }
+    catch (const SQLException &e) {
+        logError("%s", e.what());
+        ok = false;
+    }
+    auto elapsed = chrono::duration_cast<chrono::microseconds>(chrono::nanoseconds(threadDbNanos() - dbNsStart));
+    G_MANAGER->observe(session.endpoint, elapsed, ok);
+    G_MANAGER->release(session);
+}
+
+
+void printQueryResult(const QueryResult& result) {
+    {
+        TraceSpan format("format");
+        format.setCount(result.rows.size());
+        for (const auto &name: result.columns) {
+            printf("%s,", name.c_str());
         }
         printf("\n");
-        while (pRs->next()) {
-            for (int i = 0; i < count; ++i) {
-                printf("%s,", pRs->getString(i + 1).c_str());
+        for (const auto &row: result.rows) {
+            for (const auto &value: row) {
+                printf("%s,", value.c_str());
             }
             printf("\n");
         }
-        G_STATE->closeResultSet(pRs);
     }
-    catch (SQLException e) {
-        cout << e.what() << endl;
+    TraceSpan flush("flush");
+    fflush(stdout);
+}
+
+
+/**
+ * Runs a read-only point query `times` times with hedging enabled and prints
+ * the last result plus how often the hedge fired and won.
+ */
+int runHedgedQuery(const std::string& sql, int times) {
+    QueryResult result;
+    {
+        HedgedReader reader(*G_MANAGER);
+        for (int i = 0; i < times; ++i) {
+            result = reader.query(sql);
+        }
+        logInfo("requests %llu, hedges %llu, hedge wins %llu", reader.requests(), reader.hedges(),
+                reader.hedgeWins());
+    }
+    if (!result.ok) {
+        return -1;
     }
+    logInfo("served by %s%s", G_MANAGER->endpoint(result.endpoint).name.c_str(), result.hedged ? " (hedged)" : "");
+    printQueryResult(result);
+    return 0;
+}
+
+
+/**
+ * Runs a single-shard query on the shard owning the key, without the coordinator.
+ */
+int runShardQuery(const std::string& key, const std::string& sql) {
+    ShardRouter router(G_ENV, G_SHARD_CHUNKS, 4);
+    for (const auto &shard: G_SHARDS) {
+        router.addShard(shard);
+    }
+    router.setCoordinator(G_CONNECT_STRING);
+    if (!router.open(G_USER, G_PASS)) {
+        return -1;
+    }
+
+    ShardSession session = router.checkout(key);
+    if (nullptr == session.conn) {
+        return -1;
+    }
+    logInfo("key %s -> %s", key.c_str(), router.shard(session.shard).name.c_str());
+    bool ok = false;
+    try {
+        Statement *stmt = dbCall(DbOp::CREATE_STATEMENT, 0, [&] { return session.conn->createStatement(); });
+        ok = printResultSet(stmt, sql);
+        dbCall(DbOp::TERMINATE_STATEMENT, 0, [&] { session.conn->terminateStatement(stmt); });
+    }
+    catch (const SQLException &e) {
+        logError("%s", e.what());
+        ok = false;
+    }
+    router.release(session);
+    return ok ? 0 : -1;
+}
+
+
+/**
+ * Replays a captured workload (OCI_DEMO_CAPTURE) against G_CONNECT_STRING
+ * through a pool of options.concurrency sessions.
+ */
+int runReplay(const std::string& path, const ReplayOptions& options) {
+    vector<StatementRecord> workload;
+    string error;
+    if (!readWorkload(path, workload, error)) {
+        logError("%s", error.c_str());
+        return -1;
+    }
+    logInfo("loaded %zu statements from %s", workload.size(), path.c_str());
+
+    G_ENV = newEnvironment();
+    int ret = 0;
+    {
+        SessionPool pool(G_ENV, G_CONNECT_STRING, std::max(1u, options.concurrency));
+        if (pool.open(G_USER, G_PASS)) {
+            ReplayReport report = replayWorkload(pool, workload, options);
+            printf("%s", formatReplayReport(report).c_str());
+            ret = report.errors > report.capturedFailed ? -1 : 0;
+            pool.close();
+        } else {
+            ret = -1;
+        }
+    }
+    Environment::terminateEnvironment(G_ENV);
+    G_ENV = nullptr;
+    return ret;
+}
+
+
+/**
+ * Open-loop insert/update/delete/select load on author_tab against
+ * G_CONNECT_STRING, one pool session per worker thread.
+ */
+int runLoadgen(const LoadgenOptions& options) {
+    G_ENV = newEnvironment();
+    int ret = -1;
+    {
+        SessionPool pool(G_ENV, G_CONNECT_STRING, std::max(1u, options.threads));
+        unique_ptr<ConcurrencyLimiter> limiter;
+        if (options.limit > 0) {
+            LimiterOptions limits;
+            limits.maxLimit = options.limit;
+            limits.initialLimit = std::min(options.limit, std::max(1u, options.threads / 2));
+            limits.maxWait = chrono::milliseconds(options.maxWaitMs);
+            limits.tenantQuota = options.tenantQuota;
+            limiter.reset(new ConcurrencyLimiter("loadgen", limits));
+            pool.setLimiter(limiter.get());
+        }
+        if (pool.open(G_USER, G_PASS)) {
+            LoadgenReport report = runLoadgen(pool, options);
+            printf("%s", formatLoadgenReport(report, options).c_str());
+            if (limiter) {
+                printf("limiter: limit %u, %llu requests shed\n", limiter->limit(),
+                       (unsigned long long) limiter->shed());
+            }
+            ret = 0;
+            pool.close();
+        }
+    }
+    Environment::terminateEnvironment(G_ENV);
+    G_ENV = nullptr;
+    return ret;
+}
+
+
+/**
+ * Sweeps the fetch/DML settings of one statement on a session of
+ * G_CONNECT_STRING and merges the result into the tuned config at outPath.
+ */
+int runTune(const std::string& sql, const TuneOptions& options, const std::string& outPath) {
+    // 已有的配置文件先读进来, 其它语句的条目原样保留
+    TunedConfig config;
+    string error;
+    FILE *existing = fopen(outPath.c_str(), "r");
+    if (existing) {
+        fclose(existing);
+        if (!config.load(outPath, error)) {
+            logError("%s", error.c_str());
+            return -1;
+        }
+    }
+
+    G_ENV = newEnvironment();
+    int ret = -1;
+    try {
+        Connection *conn = G_ENV->createConnection(G_USER, G_PASS, G_CONNECT_STRING);
+        TunedStatement tuned;
+        vector<TunePoint> all;
+        if (tuneStatement(conn, sql, options, tuned, all, error)) {
+            printf("%s", formatTuneReport(tuned, all).c_str());
+            config.put(tuned);
+            if (config.save(outPath, error)) {
+                logInfo("tuned settings for %s written to %s", fingerprintHex(tuned.fingerprint).c_str(),
+                        outPath.c_str());
+                ret = 0;
+            } else {
+                logError("%s", error.c_str());
+            }
+        } else {
+            logError("tune: %s", error.c_str());
+        }
+        G_ENV->terminateConnection(conn);
+    }
+    catch (const SQLException &e) {
+        logError("%s", e.what());
+    }
+    Environment::terminateEnvironment(G_ENV);
+    G_ENV = nullptr;
+    return ret;
 }
 
 
 void disConnect() {
     // 终止 Statement 对象    
     if (G_STATE){
-        G_CON->terminateStatement(G_STATE);
+        dbCall(DbOp::TERMINATE_STATEMENT, 0, [] { G_CON->terminateStatement(G_STATE); });
     }
     if (G_ENV){
-        // 关闭连接  
-        G_ENV->terminateConnection(G_CON);
+        // 归还连接并关闭所有连接池
+        if (G_MANAGER) {
+            G_MANAGER->release(G_SESSION);
+            delete G_MANAGER;
+            G_MANAGER = nullptr;
+        }
+        if (G_OCI_HEAP) {
+            logInfo("oci client heap: %u bytes by OCI, %zu bytes by OciHeap", G_ENV->getCurrentHeapSize(),
+                    OciHeap::instance().inUse());
+        }
         // 释放 OCCI 上下文环境    
         Environment::terminateEnvironment(G_ENV);
     }
-    cout << "end!" << endl;
+    logInfo("end!");
 }
 
 
-int main() {
+int main(int argc, char *argv[]) {
     // system("pause");
 
-    if (connect()){
-        generateStatement();
+    // 状态和错误信息走异步日志: OCI_DEMO_LOG=<file> (默认 stderr), OCI_DEMO_LOG_LEVEL=debug|info|warn|error,
+    // OCI_DEMO_LOG_RATE=<每级每秒行数, 0 不限>
+    LogLevel logLevel = LogLevel::INFO;
+    const char *logLevelText = getenv("OCI_DEMO_LOG_LEVEL");
+    if (logLevelText && parseLogLevel(logLevelText, logLevel)) {
+        Logger::instance().setLevel(logLevel);
+    }
+    const char *logRate = getenv("OCI_DEMO_LOG_RATE");
+    if (logRate) {
+        for (LogLevel level: {LogLevel::DBG, LogLevel::INFO, LogLevel::WARN, LogLevel::ERR}) {
+            Logger::instance().setRateLimit(level, (uint32_t) atoi(logRate));
+        }
+    }
+    const char *logFile = getenv("OCI_DEMO_LOG");
+    Logger::instance().start(logFile ? logFile : "");
+
+    // 设置 OCI_DEMO_METRICS_PORT 后在 127.0.0.1 上暴露 Prometheus 指标
+    MetricsServer metricsServer;
+    const char *metricsPort = getenv("OCI_DEMO_METRICS_PORT");
+    if (metricsPort) {
+        metricsServer.start((unsigned short) atoi(metricsPort));
+    }
+
+    // 设置 OCI_DEMO_LATENCY_REPORT 后退出前打印每个调用/语句的 p50/p99/p99.9
+    bool latencyReport = getenv("OCI_DEMO_LATENCY_REPORT") != nullptr;
+    if (latencyReport) {
+        LatencyRecorder::instance().startMerger(chrono::seconds(1));
+    }
+
+    // 设置 OCI_DEMO_TRACE=<file> 后把各阶段的耗时写成 Chrome trace JSON
+    const char *traceFile = getenv("OCI_DEMO_TRACE");
+    if (traceFile) {
+        Tracer::instance().start(traceFile);
+        Tracer::instance().setThreadName("main");
+    }
+
+    // 设置 OCI_DEMO_ALLOC_REPORT 后统计每条代码路径的分配次数/字节数, 退出前按行折算打印
+    bool allocReportOn = getenv("OCI_DEMO_ALLOC_REPORT") != nullptr;
+    setAllocTracking(allocReportOn);
+
+    // 设置 OCI_DEMO_CAPTURE=<file> 后把执行过的每条语句 (含绑定值, 耗时, 行数) 写进二进制日志
+    WorkloadWriter capture;
+    const char *captureFile = getenv("OCI_DEMO_CAPTURE");
+    if (captureFile) {
+        capture.open(captureFile);
+    }
+
+    // 设置 OCI_DEMO_SLOW_LOG=<file|-> 后记录超过阈值的语句 (OCI_DEMO_SLOW_MS 默认阈值,
+    // OCI_DEMO_SLOW_SQL 按指纹单独设置, OCI_DEMO_SLOW_BINDS 绑定值脱敏, OCI_DEMO_SLOW_BIND_SAMPLE 采样)
+    SlowQueryLog slowLog;
+    const char *slowLogFile = getenv("OCI_DEMO_SLOW_LOG");
+    if (slowLogFile) {
+        const char *slowMs = getenv("OCI_DEMO_SLOW_MS");
+        if (slowMs) {
+            slowLog.setDefaultThreshold(chrono::nanoseconds((int64_t) (atof(slowMs) * 1e6)));
+        }
+        const char *slowSql = getenv("OCI_DEMO_SLOW_SQL");
+        if (slowSql && !slowLog.parseThresholds(slowSql)) {
+            logWarn("bad OCI_DEMO_SLOW_SQL: %s", slowSql);
+        }
+        string binds = getenv("OCI_DEMO_SLOW_BINDS") ? getenv("OCI_DEMO_SLOW_BINDS") : "mask";
+        slowLog.setRedaction(binds == "plain" ? BindRedaction::PLAIN : binds == "hash" ? BindRedaction::HASH :
+                             binds == "drop" ? BindRedaction::DROP : BindRedaction::MASK);
+        const char *bindSample = getenv("OCI_DEMO_SLOW_BIND_SAMPLE");
+        if (bindSample) {
+            slowLog.setBindSample((unsigned int) atoi(bindSample));
+        }
+        slowLog.start(slowLogFile);
+    }
+
+    // 设置 OCI_DEMO_MEMORY_BUDGET_MB 后取数缓冲和预取内存从这个总预算里拿, 紧张时缩小批大小或等待
+    // (OCI_DEMO_MEMORY_WAIT_MS, 默认 5000), 退出前打印每条语句的内存峰值
+    const char *memoryBudget = getenv("OCI_DEMO_MEMORY_BUDGET_MB");
+    if (memoryBudget) {
+        MemoryGovernor::instance().setBudget((size_t) (atof(memoryBudget) * 1024 * 1024));
+        const char *memoryWait = getenv("OCI_DEMO_MEMORY_WAIT_MS");
+        if (memoryWait) {
+            MemoryGovernor::instance().setMaxWait(chrono::milliseconds(atoi(memoryWait)));
+        }
+    }
 
-        printResultSet("SELECT * FROM all_users");
+    // 设置 OCI_DEMO_OCI_HEAP=1 后 OCI 的 malloc/realloc/free 走 OciHeap (每线程小块缓存);
+    // OCI_DEMO_OCI_HUGE_MB=<n> 再给大块 (预取/定义缓冲) 映射一块大页区, 隐含 OCI_DEMO_OCI_HEAP.
+    // 退出前打印客户端堆用量
+    const char *hugeMb = getenv("OCI_DEMO_OCI_HUGE_MB");
+    G_OCI_HEAP = getenv("OCI_DEMO_OCI_HEAP") != nullptr || hugeMb != nullptr;
+    if (hugeMb) {
+        OciHeap::instance().reserveHugeRegion((size_t) (atof(hugeMb) * 1024 * 1024));
+    }
+
+    // 设置 OCI_DEMO_TUNED=<file> 后按 tune 子命令写出的配置设置每条语句的 prefetch/批大小
+    const char *tunedFile = getenv("OCI_DEMO_TUNED");
+    if (tunedFile) {
+        string error;
+        if (TunedConfig::instance().load(tunedFile, error)) {
+            logInfo("%zu tuned statements loaded from %s", TunedConfig::instance().size(), tunedFile);
+        } else {
+            logWarn("%s", error.c_str());
+        }
+    }
+
+    string mode = argc > 1 ? argv[1] : "";
+    int ret = 0;
+    if (mode == "shard" && argc > 3) {
+        // 用法: oracle_oci_demo shard <key> <sql>
+        G_ENV = newEnvironment();
+        ret = runShardQuery(argv[2], argv[3]);
+        Environment::terminateEnvironment(G_ENV);
+    } else if (mode == "hedge" && argc > 2) {
+        // 用法: oracle_oci_demo hedge <sql> [times]
+        ret = -1;
+        if (connect()) {
+            ret = runHedgedQuery(argv[2], argc > 3 ? atoi(argv[3]) : 1);
+            disConnect();
+        }
+    } else if (mode == "replay" && argc > 2) {
+        // 用法: oracle_oci_demo replay <file> [--speed N|max] [--concurrency N] [--prefetch N] [--no-writes]
+        //                                     [--unordered]
+        ReplayOptions options;
+        for (int i = 3; i < argc; ++i) {
+            string arg = argv[i];
+            if (arg == "--no-writes") {
+                options.writes = false;
+            } else if (arg == "--unordered") {
+                options.sessionOrder = false;
+            } else if (i + 1 < argc && arg == "--speed") {
+                string speed = argv[++i];
+                options.speed = speed == "max" ? 0 : atof(speed.c_str());
+            } else if (i + 1 < argc && arg == "--concurrency") {
+                options.concurrency = (unsigned int) atoi(argv[++i]);
+            } else if (i + 1 < argc && arg == "--prefetch") {
+                options.prefetch = (unsigned int) atoi(argv[++i]);
+            }
+        }
+        ret = runReplay(argv[2], options);
+    } else if (mode == "loadgen") {
+        // 用法: oracle_oci_demo loadgen [--qps N] [--threads N] [--seconds N] [--keys N] [--seed N]
+        //                               [--mix select=70,insert=10,update=10,delete=10]
+        LoadgenOptions options;
+        for (int i = 2; i < argc; i += 2) {
+            string arg = argv[i];
+            // 拼错的选项不能悄悄按默认值跑, 压测负载就不对了
+            if (i + 1 >= argc) {
+                logError("missing value for %s", arg.c_str());
+                return 1;
+            }
+            if (!parseLoadgenOption(arg, argv[i + 1], options)) {
+                logError("bad %s: %s", arg.c_str(), argv[i + 1]);
+                return 1;
+            }
+        }
+        ret = runLoadgen(options);
+    } else if (mode == "tune" && argc > 2) {
+        // 用法: oracle_oci_demo tune <sql> [--out tuned.json] [--binds a,b] [--warmup N] [--repeats N] [--rows N]
+        //                               [--prefetch-rows 1,10,100,1000] [--prefetch-memory 0,1048576]
+        //                               [--array-rows 1,100,1000] [--stmt-cache 0,20] [--dml-batch 1,10,100,1000]
+        //                               [--p99-slack 1.2]
+        TuneOptions options;
+        string outPath = "tuned.json";
+        for (int i = 3; i + 1 < argc; i += 2) {
+            string arg = argv[i];
+            if (arg == "--out") {
+                outPath = argv[i + 1];
+            } else if (!parseTuneOption(arg, argv[i + 1], options)) {
+                logError("bad %s: %s", arg.c_str(), argv[i + 1]);
+                return 1;
+            }
+        }
+        ret = runTune(argv[2], options, outPath);
+    } else if (mode == "occidml") {
+        ret = runOccidmlDemo(G_USER, G_PASS, G_CONNECT_STRING);
+    } else if (connect()){
+        printReadOnlyResultSet("SELECT * FROM all_users");
         disConnect();
     }
     // system("pause");
 
-    return 0;
-}  
\ No newline at end of file
+    if (latencyReport) {
+        LatencyRecorder::instance().stopMerger();
+        printf("%s", LatencyRecorder::instance().report().c_str());
+    }
+    if (traceFile) {
+        Tracer::instance().write();
+    }
+    if (allocReportOn) {
+        printf("%s", allocReport().c_str());
+    }
+    if (memoryBudget) {
+        printf("%s", MemoryGovernor::instance().report().c_str());
+    }
+    if (G_OCI_HEAP) {
+        printf("%s", OciHeap::instance().report().c_str());
+    }
+    if (slowLogFile) {
+        slowLog.stop();
+    }
+    if (captureFile) {
+        capture.close();
+        logInfo("%llu statements captured to %s", (unsigned long long) capture.recorded(), captureFile);
+    }
+    Logger::instance().stop();
+    return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+#include "memory_governor.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "logger.h"
+#include "sql_fingerprint.h"
+
+using namespace std;
+
+MemoryGovernor &MemoryGovernor::instance() {
+    static MemoryGovernor governor;
+    return governor;
+}
+
+MemoryGovernor::MemoryGovernor() {
+    // 先构造注册表, 它就比调控器晚析构, 析构时还能摘掉仪表
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    shrinks = metrics.counter("oci_memory_shrinks_total");
+    waits = metrics.counter("oci_memory_waits_total");
+    overcommits = metrics.counter("oci_memory_overcommit_total");
+    waitTime = metrics.histogram("oci_memory_wait_seconds");
+    gaugeIds.push_back(metrics.addGauge("oci_memory_budget_bytes", "", [this] { return (double) budget(); }));
+    gaugeIds.push_back(metrics.addGauge("oci_memory_reserved_bytes", "", [this] { return (double) reserved(); }));
+}
+
+MemoryGovernor::~MemoryGovernor() {
+    for (int id: gaugeIds) {
+        MetricsRegistry::instance().removeGauge(id);
+    }
+}
+
+void MemoryGovernor::setBudget(size_t bytes) {
+    {
+        lock_guard<mutex> guard(lock);
+        limit.store(bytes, memory_order_relaxed);
+    }
+    freed.notify_all();
+}
+
+void MemoryGovernor::setMaxWait(chrono::milliseconds wait) {
+    lock_guard<mutex> guard(lock);
+    maxWait = wait;
+}
+
+size_t MemoryGovernor::acquire(size_t wanted, size_t minimum) {
+    minimum = std::min(minimum, wanted);
+    unique_lock<mutex> guard(lock);
+    auto available = [this] {
+        size_t budgetBytes = limit.load(memory_order_relaxed);
+        size_t usedBytes = used.load(memory_order_relaxed);
+        return 0 == budgetBytes ? SIZE_MAX : budgetBytes > usedBytes ? budgetBytes - usedBytes : 0;
+    };
+    size_t granted = std::min(wanted, available());
+    if (granted < minimum) {
+        waits->add();
+        auto start = chrono::steady_clock::now();
+        bool fits = freed.wait_for(guard, maxWait, [&] { return available() >= minimum; });
+        waitTime->observe(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        granted = std::max(minimum, std::min(wanted, available()));
+        if (!fits) {
+            // 等不到就超额给最低限度, 让查询能跑完, 而不是永远卡住
+            overcommits->add();
+            logWarn("memory budget: %zu bytes over budget after waiting %lldms", minimum,
+                    (long long) maxWait.count());
+        }
+    }
+    if (granted < wanted) {
+        shrinks->add();
+    }
+    size_t now = used.load(memory_order_relaxed) + granted;
+    used.store(now, memory_order_relaxed);
+    if (now > peak.load(memory_order_relaxed)) {
+        peak.store(now, memory_order_relaxed);
+    }
+    return granted;
+}
+
+void MemoryGovernor::release(size_t bytes) {
+    if (0 == bytes) {
+        return;
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        size_t usedBytes = used.load(memory_order_relaxed);
+        used.store(usedBytes > bytes ? usedBytes - bytes : 0, memory_order_relaxed);
+    }
+    freed.notify_all();
+}
+
+void MemoryGovernor::recordPeak(uint64_t fingerprint, size_t bytes) {
+    atomic<size_t> *slot;
+    bool added = false;
+    {
+        lock_guard<mutex> guard(lock);
+        auto &entry = statementPeaks[fingerprint];
+        if (!entry) {
+            entry.reset(new atomic<size_t>(0));
+            added = true;
+        }
+        slot = entry.get();
+        if (bytes > slot->load(memory_order_relaxed)) {
+            slot->store(bytes, memory_order_relaxed);
+        }
+    }
+    // 注册仪表要拿注册表的锁, 不能在自己的锁里做; 槽位地址不会变, 仪表直接读它
+    if (added) {
+        int id = MetricsRegistry::instance().addGauge(
+                "oci_query_memory_peak_bytes", metricLabel("sql", fingerprintHex(fingerprint)),
+                [slot] { return (double) slot->load(memory_order_relaxed); });
+        lock_guard<mutex> guard(lock);
+        gaugeIds.push_back(id);
+    }
+}
+
+string MemoryGovernor::report() {
+    char line[256];
+    string out;
+    size_t budgetBytes = budget();
+    snprintf(line, sizeof(line), "memory: budget %s, peak reserved %.1f KiB, %llu shrinks, %llu waits, "
+                                 "%llu over budget\n",
+             budgetBytes ? (to_string(budgetBytes / 1024) + " KiB").c_str() : "unlimited",
+             peakReserved() / 1024.0, (unsigned long long) shrinks->get(), (unsigned long long) waits->get(),
+             (unsigned long long) overcommits->get());
+    out += line;
+    lock_guard<mutex> guard(lock);
+    for (const auto &entry: statementPeaks) {
+        snprintf(line, sizeof(line), "  %s  peak %10.1f KiB\n", fingerprintHex(entry.first).c_str(),
+                 entry.second->load(memory_order_relaxed) / 1024.0);
+        out += line;
+    }
+    return out;
+}
+
+MemoryLease::~MemoryLease() {
+    MemoryGovernor &governor = MemoryGovernor::instance();
+    governor.release(held);
+    if (fingerprint && top) {
+        governor.recordPeak(fingerprint, top);
+    }
+}
+
+size_t MemoryLease::reserve(size_t wanted, size_t minimum) {
+    size_t granted = MemoryGovernor::instance().acquire(wanted, minimum);
+    held += granted;
+    top = std::max(top, held);
+    return granted;
+}
+
+void MemoryLease::release(size_t bytes) {
+    bytes = std::min(bytes, held);
+    held -= bytes;
+    MemoryGovernor::instance().release(bytes);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metrics.h"
+
+/**
+ * Process-wide budget for client-side query memory: fetch column arrays,
+ * prefetch memory and anything else a query sizes by its row count.
+ *
+ * Queries take memory through a MemoryLease. acquire() grants as much of
+ * the wanted bytes as fits right now, so a query under pressure runs with
+ * a smaller batch instead of pushing the process over its limit. Only when
+ * not even the caller's minimum fits does it wait, up to maxWait, for other
+ * queries to release memory. After that it grants the minimum anyway and
+ * counts an overcommit, so one query larger than the budget still
+ * finishes instead of blocking forever.
+ *
+ * With no budget (the default) nothing waits or shrinks, and the governor
+ * only keeps the accounting and the per-statement high-water marks.
+ */
+class MemoryGovernor {
+public:
+    static MemoryGovernor &instance();
+
+    ~MemoryGovernor();
+
+    MemoryGovernor(const MemoryGovernor &) = delete;
+
+    MemoryGovernor &operator=(const MemoryGovernor &) = delete;
+
+    /**
+     * 0 = unlimited.
+     */
+    void setBudget(size_t bytes);
+
+    void setMaxWait(std::chrono::milliseconds wait);
+
+    size_t budget() const { return limit.load(std::memory_order_relaxed); }
+
+    size_t reserved() const { return used.load(std::memory_order_relaxed); }
+
+    size_t peakReserved() const { return peak.load(std::memory_order_relaxed); }
+
+    /**
+     * Reserves between minimum and wanted bytes and returns how many.
+     */
+    size_t acquire(size_t wanted, size_t minimum);
+
+    void release(size_t bytes);
+
+    /**
+     * Keeps the largest reservation seen for the statement.
+     */
+    void recordPeak(uint64_t fingerprint, size_t bytes);
+
+    /**
+     * Budget, peak, waits and the high-water mark of every statement.
+     */
+    std::string report();
+
+private:
+    MemoryGovernor();
+
+    mutable std::mutex lock;
+    std::condition_variable freed;
+    std::atomic<size_t> limit{0};
+    std::atomic<size_t> used{0};
+    std::atomic<size_t> peak{0};
+    std::chrono::milliseconds maxWait{5000};
+    std::map<uint64_t, std::unique_ptr<std::atomic<size_t>>> statementPeaks;
+
+    MetricCounter *shrinks;
+    MetricCounter *waits;
+    MetricCounter *overcommits;
+    MetricHistogram *waitTime;
+    std::vector<int> gaugeIds;
+};
+
+/**
+ * The memory one query holds from the MemoryGovernor; whatever is still
+ * reserved is released when the lease goes away, and its high-water mark
+ * is recorded under the statement's fingerprint.
+ */
+class MemoryLease {
+public:
+    explicit MemoryLease(uint64_t fingerprint = 0) : fingerprint(fingerprint) {}
+
+    ~MemoryLease();
+
+    MemoryLease(const MemoryLease &) = delete;
+
+    MemoryLease &operator=(const MemoryLease &) = delete;
+
+    /**
+     * Adds between minimum and wanted bytes to the lease, returns how many.
+     */
+    size_t reserve(size_t wanted, size_t minimum);
+
+    void release(size_t bytes);
+
+    size_t reserved() const { return held; }
+
+    size_t highWater() const { return top; }
+
+private:
+    uint64_t fingerprint;
+    size_t held = 0;
+    size_t top = 0;
+};
@@ -0,0 +1,225 @@
+#include "metrics.h"
+
+#include <cstdio>
+#include <set>
+
+#include "sql_fingerprint.h"
+
+using namespace std;
+
+MetricHistogram::MetricHistogram(const vector<double> &bounds)
+        : upper(bounds), counts(new atomic<uint64_t>[bounds.size() + 1]) {
+    for (size_t i = 0; i <= upper.size(); ++i) {
+        counts[i] = 0;
+    }
+}
+
+void MetricHistogram::observe(double seconds) {
+    size_t i = 0;
+    while (i < upper.size() && seconds > upper[i]) {
+        ++i;
+    }
+    counts[i].fetch_add(1, memory_order_relaxed);
+    total.fetch_add(1, memory_order_relaxed);
+    sumNs.fetch_add((uint64_t) (seconds * 1e9), memory_order_relaxed);
+}
+
+MetricsRegistry &MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+const vector<double> &MetricsRegistry::latencyBuckets() {
+    static const vector<double> buckets = {
+            0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+            0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+    };
+    return buckets;
+}
+
+MetricsRegistry::MetricsRegistry() : nextGaugeId(1) {
+    describe("oci_pool_open_sessions", "gauge", "Open sessions in the pool (OCI_ATTR_SPOOL_OPEN_COUNT).");
+    describe("oci_pool_busy_sessions", "gauge", "Checked out sessions (OCI_ATTR_SPOOL_BUSY_COUNT).");
+    describe("oci_pool_max_sessions", "gauge", "Configured pool maximum.");
+    describe("oci_pool_checkouts_total", "counter", "Session checkouts.");
+    describe("oci_pool_hits_total", "counter",
+             "Checkouts served by an already open session (client side OCI_ATTR_SPOOL_HIT_COUNT).");
+    describe("oci_pool_checkout_wait_seconds", "histogram", "Time spent waiting for a pooled session.");
+    describe("oci_sql_execute_seconds", "histogram", "Statement execute latency by SQL fingerprint.");
+    describe("oci_sql_fetch_seconds", "histogram", "Row fetch latency by SQL fingerprint.");
+    describe("oci_sql_rows_total", "counter", "Rows fetched by SQL fingerprint.");
+    describe("oci_sql_bytes_total", "counter", "Bytes fetched by SQL fingerprint.");
+    describe("oci_sql_info", "gauge", "Normalized text of each SQL fingerprint.");
+    describe("oci_sched_queued_jobs", "gauge", "Scheduler jobs waiting, by priority class.");
+    describe("oci_sched_running_jobs", "gauge", "Scheduler jobs running, by priority class.");
+    describe("oci_sched_jobs_total", "counter", "Scheduler jobs finished, by priority class.");
+    describe("oci_sched_queue_wait_seconds", "histogram", "Time a job waited for a worker, by priority class.");
+    describe("oci_limiter_limit", "gauge", "Current adaptive concurrency limit.");
+    describe("oci_limiter_in_flight", "gauge", "Requests holding a limiter slot.");
+    describe("oci_limiter_queued", "gauge", "Requests waiting for a limiter slot.");
+    describe("oci_limiter_shed_total", "counter", "Requests rejected by the limiter, by tenant.");
+    describe("oci_limiter_queue_wait_seconds", "histogram", "Time spent waiting for a limiter slot.");
+    describe("oci_batch_rows", "gauge", "Array fetch/DML batch length chosen by each batch controller.");
+    describe("oci_batch_row_bytes", "gauge", "Buffer bytes per row seen by each batch controller.");
+    describe("oci_batch_resizes_total", "counter", "Batch length changes made by each batch controller.");
+    describe("oci_memory_budget_bytes", "gauge", "Process-wide query memory budget (0 = unlimited).");
+    describe("oci_memory_reserved_bytes", "gauge", "Query memory currently reserved from the budget.");
+    describe("oci_memory_shrinks_total", "counter", "Reservations granted less than asked for.");
+    describe("oci_memory_waits_total", "counter", "Reservations that had to wait for memory.");
+    describe("oci_memory_overcommit_total", "counter", "Reservations granted over budget after waiting.");
+    describe("oci_memory_wait_seconds", "histogram", "Time spent waiting for query memory.");
+    describe("oci_query_memory_peak_bytes", "gauge", "Largest memory reservation of each SQL fingerprint.");
+    describe("oci_client_heap_bytes", "gauge", "Bytes the OCI client library holds from the custom heap.");
+    describe("oci_client_heap_peak_bytes", "gauge", "Largest OCI client heap size seen.");
+    describe("oci_client_heap_huge_bytes", "gauge", "Huge page region bytes handed out to OCI.");
+    describe("oci_client_heap_allocs_total", "counter", "Allocations made by the OCI client library.");
+    describe("oci_client_heap_cache_hits_total", "counter", "OCI allocations served from a per-thread cache.");
+    describe("oci_client_heap_huge_fallbacks_total", "counter", "Large OCI allocations that did not fit the huge region.");
+}
+
+void MetricsRegistry::describe(const string &name, const string &type, const string &help) {
+    lock_guard<mutex> guard(lock);
+    families[name] = make_pair(type, help);
+}
+
+MetricCounter *MetricsRegistry::counter(const string &name, const string &labels) {
+    lock_guard<mutex> guard(lock);
+    auto &slot = counters[make_pair(name, labels)];
+    if (!slot) {
+        slot.reset(new MetricCounter());
+    }
+    return slot.get();
+}
+
+MetricHistogram *MetricsRegistry::histogram(const string &name, const string &labels,
+                                            const vector<double> &bounds) {
+    lock_guard<mutex> guard(lock);
+    auto &slot = histograms[make_pair(name, labels)];
+    if (!slot) {
+        slot.reset(new MetricHistogram(bounds));
+    }
+    return slot.get();
+}
+
+int MetricsRegistry::addGauge(const string &name, const string &labels, function<double()> read) {
+    lock_guard<mutex> guard(lock);
+    int id = nextGaugeId++;
+    gauges.push_back({id, name, labels, std::move(read)});
+    return id;
+}
+
+void MetricsRegistry::removeGauge(int id) {
+    lock_guard<mutex> guard(lock);
+    for (auto it = gauges.begin(); it != gauges.end(); ++it) {
+        if (it->id == id) {
+            gauges.erase(it);
+            return;
+        }
+    }
+}
+
+SqlMetrics MetricsRegistry::sql(const string &sql) {
+    string hex = fingerprintHex(sqlFingerprint(sql));
+    string labels = metricLabel("sql", hex);
+    {
+        lock_guard<mutex> guard(lock);
+        if (sqlTexts.find(hex) == sqlTexts.end()) {
+            sqlTexts[hex] = normalizeSql(sql).substr(0, 200);
+        }
+    }
+    SqlMetrics m;
+    m.execute = histogram("oci_sql_execute_seconds", labels);
+    m.fetch = histogram("oci_sql_fetch_seconds", labels);
+    m.rows = counter("oci_sql_rows_total", labels);
+    m.bytes = counter("oci_sql_bytes_total", labels);
+    return m;
+}
+
+string metricLabel(const string &key, const string &value) {
+    string out = key + "=\"";
+    for (char c: value) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+    return out;
+}
+
+static string series(const string &name, const string &labels, const string &extra = "") {
+    string all = labels;
+    if (!extra.empty()) {
+        all = all.empty() ? extra : all + "," + extra;
+    }
+    return all.empty() ? name : name + "{" + all + "}";
+}
+
+static string number(double v) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.9g", v);
+    return buf;
+}
+
+string MetricsRegistry::render() {
+    lock_guard<mutex> guard(lock);
+    set<string> names;
+    for (const auto &c: counters) {
+        names.insert(c.first.first);
+    }
+    for (const auto &h: histograms) {
+        names.insert(h.first.first);
+    }
+    for (const auto &g: gauges) {
+        names.insert(g.name);
+    }
+    if (!sqlTexts.empty()) {
+        names.insert("oci_sql_info");
+    }
+
+    string out;
+    for (const auto &name: names) {
+        auto family = families.find(name);
+        if (family != families.end()) {
+            out += "# HELP " + name + " " + family->second.second + "\n";
+            out += "# TYPE " + name + " " + family->second.first + "\n";
+        }
+        for (const auto &c: counters) {
+            if (c.first.first == name) {
+                out += series(name, c.first.second) + " " + to_string(c.second->get()) + "\n";
+            }
+        }
+        for (const auto &h: histograms) {
+            if (h.first.first != name) {
+                continue;
+            }
+            const MetricHistogram &hist = *h.second;
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < hist.bounds().size(); ++i) {
+                cumulative += hist.bucket(i);
+                out += series(name + "_bucket", h.first.second, "le=\"" + number(hist.bounds()[i]) + "\"")
+                       + " " + to_string(cumulative) + "\n";
+            }
+            cumulative += hist.bucket(hist.bounds().size());
+            out += series(name + "_bucket", h.first.second, "le=\"+Inf\"") + " " + to_string(cumulative) + "\n";
+            out += series(name + "_sum", h.first.second) + " " + number(hist.sum()) + "\n";
+            out += series(name + "_count", h.first.second) + " " + to_string(hist.count()) + "\n";
+        }
+        for (const auto &g: gauges) {
+            if (g.name == name) {
+                out += series(name, g.labels) + " " + number(g.read()) + "\n";
+            }
+        }
+        if (name == "oci_sql_info") {
+            for (const auto &text: sqlTexts) {
+                out += series(name, metricLabel("sql", text.first) + "," + metricLabel("text", text.second))
+                       + " 1\n";
+            }
+        }
+    }
+    return out;
+}
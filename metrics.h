@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class MetricCounter {
+public:
+    void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value{0};
+};
+
+/**
+ * Cumulative Prometheus histogram with fixed upper bounds (in seconds).
+ */
+class MetricHistogram {
+public:
+    explicit MetricHistogram(const std::vector<double> &bounds);
+
+    void observe(double seconds);
+
+    const std::vector<double> &bounds() const { return upper; }
+
+    uint64_t bucket(size_t i) const { return counts[i].load(std::memory_order_relaxed); }
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+
+    double sum() const { return sumNs.load(std::memory_order_relaxed) / 1e9; }
+
+private:
+    std::vector<double> upper;
+    std::unique_ptr<std::atomic<uint64_t>[]> counts;
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sumNs{0};
+};
+
+/**
+ * Execution / fetch instruments for one SQL fingerprint.
+ */
+struct SqlMetrics {
+    MetricHistogram *execute;
+    MetricHistogram *fetch;
+    MetricCounter *rows;
+    MetricCounter *bytes;
+};
+
+/**
+ * Process-wide metric registry rendered in the Prometheus text format.
+ *
+ * Lookups take a lock, so callers resolve their instruments once (per pool,
+ * per query) and keep the returned pointers; updates themselves are atomic.
+ */
+class MetricsRegistry {
+public:
+    static MetricsRegistry &instance();
+
+    static const std::vector<double> &latencyBuckets();
+
+    void describe(const std::string &name, const std::string &type, const std::string &help);
+
+    MetricCounter *counter(const std::string &name, const std::string &labels = "");
+
+    MetricHistogram *histogram(const std::string &name, const std::string &labels = "",
+                               const std::vector<double> &bounds = latencyBuckets());
+
+    /**
+     * Gauges are sampled at scrape time, returns an id for removeGauge().
+     */
+    int addGauge(const std::string &name, const std::string &labels, std::function<double()> read);
+
+    void removeGauge(int id);
+
+    SqlMetrics sql(const std::string &sql);
+
+    std::string render();
+
+private:
+    MetricsRegistry();
+
+    typedef std::pair<std::string, std::string> Key;
+
+    struct Gauge {
+        int id;
+        std::string name;
+        std::string labels;
+        std::function<double()> read;
+    };
+
+    std::mutex lock;
+    std::map<std::string, std::pair<std::string, std::string>> families;
+    std::map<Key, std::unique_ptr<MetricCounter>> counters;
+    std::map<Key, std::unique_ptr<MetricHistogram>> histograms;
+    std::vector<Gauge> gauges;
+    std::map<std::string, std::string> sqlTexts;
+    int nextGaugeId;
+};
+
+/**
+ * Escapes a label value for the text exposition format.
+ */
+std::string metricLabel(const std::string &key, const std::string &value);
@@ -0,0 +1,167 @@
+#include "metrics_http.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define closesocket_fn closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define closesocket_fn close
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// 客户端连上不发请求、或者不收响应, 最多占住服务线程这么久
+static const int CLIENT_TIMEOUT_MS = 2000;
+static const int POLL_MS = 200;
+
+#include "logger.h"
+#include "metrics.h"
+
+using namespace std;
+
+MetricsServer::MetricsServer() : running(false), listenSocket(-1) {
+}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool MetricsServer::start(unsigned short port) {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        logError("WSAStartup error.");
+        return false;
+    }
+#endif
+    socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET) {
+        logError("metrics socket error.");
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char *) &reuse, sizeof(reuse));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    // 只监听本机回环地址
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(s, (sockaddr *) &addr, sizeof(addr)) != 0 || listen(s, 8) != 0) {
+        logError("metrics bind 127.0.0.1:%u error.", port);
+        closesocket_fn(s);
+        return false;
+    }
+    listenSocket = (long long) s;
+    running = true;
+    worker = thread(&MetricsServer::serve, this);
+    logInfo("metrics on http://127.0.0.1:%u/metrics", port);
+    return true;
+}
+
+void MetricsServer::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+    closesocket_fn((socket_t) listenSocket);
+    listenSocket = -1;
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+/**
+ * Waits up to `ms` for the socket to become readable; false on timeout.
+ */
+static bool readable(socket_t s, int ms) {
+#ifdef _WIN32
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(s, &fds);
+    timeval tv = {ms / 1000, (ms % 1000) * 1000};
+    return select(0, &fds, nullptr, nullptr, &tv) > 0;
+#else
+    pollfd pfd = {s, POLLIN, 0};
+    return poll(&pfd, 1, ms) > 0;
+#endif
+}
+
+static void respond(socket_t client, const atomic<bool> &running) {
+    // 发送也设超时, 不读响应的客户端不会让 send 一直阻塞
+#ifdef _WIN32
+    DWORD timeout = CLIENT_TIMEOUT_MS;
+#else
+    timeval timeout = {CLIENT_TIMEOUT_MS / 1000, (CLIENT_TIMEOUT_MS % 1000) * 1000};
+#endif
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char *) &timeout, sizeof(timeout));
+    // 分段等请求, 中途 stop() 了就不再等
+    int waited = 0;
+    while (!readable(client, POLL_MS)) {
+        waited += POLL_MS;
+        if (!running || waited >= CLIENT_TIMEOUT_MS) {
+            return;
+        }
+    }
+    char request[2048];
+    int n = (int) recv(client, request, sizeof(request) - 1, 0);
+    if (n <= 0) {
+        return;
+    }
+    request[n] = '\0';
+
+    string status = "200 OK";
+    string body;
+    if (strncmp(request, "GET /metrics", 12) == 0) {
+        body = MetricsRegistry::instance().render();
+    } else {
+        status = "404 Not Found";
+        body = "not found\n";
+    }
+    string response = "HTTP/1.1 " + status + "\r\n"
+                      "Content-Type: text/plain; version=0.0.4\r\n"
+                      "Content-Length: " + to_string(body.size()) + "\r\n"
+                      "Connection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        // 对端已经关了时 POSIX 上会收到 SIGPIPE, 默认处理是结束进程
+        int w = (int) send(client, response.data() + sent, (int) (response.size() - sent), MSG_NOSIGNAL);
+        if (w <= 0) {
+            break;
+        }
+        sent += w;
+    }
+}
+
+void MetricsServer::serve() {
+    socket_t s = (socket_t) listenSocket;
+    while (running) {
+        // 定时醒来检查 running
+        if (!readable(s, POLL_MS)) {
+            continue;
+        }
+        socket_t client = accept(s, nullptr, nullptr);
+        if (client == INVALID_SOCKET) {
+            continue;
+        }
+        respond(client, running);
+        closesocket_fn(client);
+    }
+}
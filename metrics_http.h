@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+/**
+ * Minimal loopback HTTP server answering GET /metrics with
+ * MetricsRegistry::instance().render(). One connection at a time, which is
+ * plenty for a Prometheus scrape every few seconds; a client that sends no
+ * request or reads no response is dropped after 2 s, and sooner on stop().
+ */
+class MetricsServer {
+public:
+    MetricsServer();
+
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer &) = delete;
+
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+    /**
+     * Binds 127.0.0.1:port and starts the accept thread.
+     */
+    bool start(unsigned short port);
+
+    void stop();
+
+private:
+    void serve();
+
+    std::atomic<bool> running;
+    long long listenSocket;
+    std::thread worker;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/**
+ * Bounded multi-producer single-consumer queue (Vyukov's ring). Producers
+ * claim a cell with one CAS on the tail and publish it through the cell's
+ * sequence number; nothing blocks, a full ring just refuses the push. Only
+ * one thread may call pop().
+ *
+ * The capacity is rounded up to a power of two. Cells are allocated once,
+ * so T's own members (strings, vectors) are the only allocations per item.
+ */
+template<typename T>
+class MpscRing {
+public:
+    explicit MpscRing(size_t capacity) : mask(roundUp(capacity) - 1), cells(new Cell[mask + 1]) {
+        for (size_t i = 0; i <= mask; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing &) = delete;
+
+    MpscRing &operator=(const MpscRing &) = delete;
+
+    /**
+     * Moves value into the ring; false (value untouched) when it is full.
+     */
+    bool push(T &value) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Consumer side only. False when the ring is empty (or the next producer
+     * has claimed its cell but not finished writing it yet).
+     */
+    bool pop(T &out) {
+        Cell &cell = cells[head & mask];
+        size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if ((intptr_t) seq - (intptr_t) (head + 1) < 0) {
+            return false;
+        }
+        out = std::move(cell.value);
+        cell.sequence.store(head + mask + 1, std::memory_order_release);
+        ++head;
+        return true;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t roundUp(size_t n) {
+        size_t size = 2;
+        while (size < n) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    // 生产者和消费者各占一条缓存行, 避免互相踩
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) size_t head = 0;
+};
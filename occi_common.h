@@ -0,0 +1,8 @@
+#pragma once
+
+// 所有翻译单元必须以相同的方式包含 occi.h, WIN32COMMON 会改变 OCCI 类的布局
+#ifndef WIN32COMMON
+#define WIN32COMMON
+#endif
+
+#include <occi.h>
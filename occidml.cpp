@@ -0,0 +1,345 @@
+#include "occidml.h"
+
+#include <iostream>
+
+#include "alloc_tracker.h"
+#include "latency_histogram.h"
+#include "logger.h"
+#include "roundtrip_counter.h"
+#include "statement_probe.h"
+#include "trace.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+occidml::occidml (string user, string passwd, string db)
+{
+    env = Environment::createEnvironment (Environment::DEFAULT);
+    conn = dbCall (DbOp::CREATE_CONNECTION, 0, [&] { return env->createConnection (user, passwd, db); });
+    stmt = NULL;
+    session = new DbSession (env, conn);
+}
+
+occidml::~occidml ()
+{
+    delete session;
+    env->terminateConnection (conn);
+    Environment::terminateEnvironment (env);
+}
+
+void occidml::createTable(){
+    try{
+        string sqlStmt = "CREATE TABLE author_tab (author_id NUMBER, author_name VARCHAR2(25))";
+        static const uint64_t fp = tagSql (sqlStmt);
+        stmt = dbCall (DbOp::CREATE_STATEMENT, fp, [&] { return conn->createStatement (sqlStmt); });
+        StatementProbe probe (sqlStmt, StatementKind::UPDATE, fp);
+        dbCall (DbOp::EXECUTE_UPDATE, fp, [&] { return stmt->executeUpdate (); });
+        dbCall (DbOp::TERMINATE_STATEMENT, fp, [&] { conn->terminateStatement (stmt); });
+    }catch(const SQLException &ex)
+    {
+        logError ("Exception thrown for createTable, error number %d: %s", ex.getErrorCode (),
+                  ex.getMessage ().c_str ());
+    }
+}
+
+void occidml::deleteTable(){
+    try{
+        string sqlStmt = "DROP TABLE author_tab";
+        static const uint64_t fp = tagSql (sqlStmt);
+        stmt = dbCall (DbOp::CREATE_STATEMENT, fp, [&] { return conn->createStatement (sqlStmt); });
+        StatementProbe probe (sqlStmt, StatementKind::UPDATE, fp);
+        dbCall (DbOp::EXECUTE_UPDATE, fp, [&] { return stmt->executeUpdate (); });
+        dbCall (DbOp::TERMINATE_STATEMENT, fp, [&] { conn->terminateStatement (stmt); });
+    }catch(const SQLException &ex)
+    {
+        logError ("Exception thrown for deleteTable, error number %d: %s", ex.getErrorCode (),
+                  ex.getMessage ().c_str ());
+    }
+}
+
+void occidml::insertBind (int c1, string c2)
+{
+    AllocScope alloc ("occidml.insertBind");
+    string sqlStmt = "INSERT INTO author_tab VALUES (:x, :y)";
+    static const uint64_t fp = tagSql (sqlStmt);
+    DbStatement insert (*session);
+    DbResult<void> prepared = dbCall (DbOp::CREATE_STATEMENT, fp, [&] { return insert.prepare (sqlStmt); });
+    if (!prepared)
+    {
+        logError ("insertBind prepare failed, error number %d: %s", prepared.code (),
+                  prepared.error ().message);
+        return;
+    }
+    StatementProbe probe (sqlStmt, StatementKind::UPDATE, fp);
+    probe.bind (1, c1);
+    probe.bind (2, c2);
+    DbResult<void> bound = insert.bind (1, c1);
+    if (bound)
+    {
+        bound = insert.bind (2, c2);
+    }
+    if (!bound)
+    {
+        probe.setFailed ();
+        logError ("insertBind bind failed, error number %d: %s", bound.code (), bound.error ().message);
+        return;
+    }
+    DbResult<unsigned int> rows = dbCall (DbOp::EXECUTE_UPDATE, fp, [&] { return insert.executeUpdate (); });
+    if (rows)
+    {
+        logInfo ("insert - Success");
+    }
+    else
+    {
+        probe.setFailed ();
+        logError ("insertBind failed, error number %d: %s", rows.code (), rows.error ().message);
+    }
+}
+
+void occidml::insertRow ()
+{
+    AllocScope alloc ("occidml.insertRow");
+    string sqlStmt = "INSERT INTO author_tab VALUES (111, 'ASHOK')";
+    static const uint64_t fp = tagSql (sqlStmt);
+    stmt = dbCall (DbOp::CREATE_STATEMENT, fp, [&] { return conn->createStatement (sqlStmt); });
+    try{
+        StatementProbe probe (sqlStmt, StatementKind::UPDATE, fp);
+        dbCall (DbOp::EXECUTE_UPDATE, fp, [&] { return stmt->executeUpdate (); });
+        logInfo ("insert - Success");
+    }catch(const SQLException &ex)
+    {
+        logError ("Exception thrown for insertRow, error number %d: %s", ex.getErrorCode (),
+                  ex.getMessage ().c_str ());
+    }
+
+    dbCall (DbOp::TERMINATE_STATEMENT, fp, [&] { conn->terminateStatement (stmt); });
+}
+
+void occidml::updateRow (int c1, string c2)
+{
+    AllocScope alloc ("occidml.updateRow");
+    string sqlStmt =
+            "UPDATE author_tab SET author_name = :x WHERE author_id = :y";
+    static const uint64_t fp = tagSql (sqlStmt);
+    stmt = dbCall (DbOp::CREATE_STATEMENT, fp, [&] { return conn->createStatement (sqlStmt); });
+    try{
+        StatementProbe probe (sqlStmt, StatementKind::UPDATE, fp);
+        stmt->setString (1, c2);
+        probe.bind (1, c2);
+        stmt->setInt (2, c1);
+        probe.bind (2, c1);
+        dbCall (DbOp::EXECUTE_UPDATE, fp, [&] { return stmt->executeUpdate (); });
+        logInfo ("update - Success");
+    }catch(const SQLException &ex)
+    {
+        logError ("Exception thrown for updateRow, error number %d: %s", ex.getErrorCode (),
+                  ex.getMessage ().c_str ());
+    }
+
+    dbCall (DbOp::TERMINATE_STATEMENT, fp, [&] { conn->terminateStatement (stmt); });
+}
+
+void occidml::deleteRow (int c1, string c2)
+{
+    AllocScope alloc ("occidml.deleteRow");
+    string sqlStmt =
+            "DELETE FROM author_tab WHERE author_id= :x AND author_name = :y";
+    static const uint64_t fp = tagSql (sqlStmt);
+    stmt = dbCall (DbOp::CREATE_STATEMENT, fp, [&] { return conn->createStatement (sqlStmt); });
+    try{
+        StatementProbe probe (sqlStmt, StatementKind::UPDATE, fp);
+        stmt->setInt (1, c1);
+        probe.bind (1, c1);
+        stmt->setString (2, c2);
+        probe.bind (2, c2);
+        dbCall (DbOp::EXECUTE_UPDATE, fp, [&] { return stmt->executeUpdate (); });
+        logInfo ("delete - Success");
+    }catch(const SQLException &ex)
+    {
+        logError ("Exception thrown for deleteRow, error number %d: %s", ex.getErrorCode (),
+                  ex.getMessage ().c_str ());
+    }
+
+    dbCall (DbOp::TERMINATE_STATEMENT, fp, [&] { conn->terminateStatement (stmt); });
+}
+
+void occidml::displayAllRows ()
+{
+    AllocScope alloc ("occidml.displayAllRows");
+    // CREATE TABLE author_tab (
+    //   author_id NUMBER,
+    //   author_name VARCHAR2(25)
+    // )
+    string sqlStmt = "SELECT * FROM author_tab";
+    static const uint64_t fp = tagSql (sqlStmt);
+    RoundTripScope trips (conn, "displayAllRows");
+    TraceSpan span ("displayAllRows", fp);
+    stmt = dbCall (DbOp::CREATE_STATEMENT, fp, [&] { return conn->createStatement (sqlStmt); });
+    StatementProbe probe (sqlStmt, StatementKind::QUERY, fp);
+    ResultSet *rset = dbCall (DbOp::EXECUTE_QUERY, fp, [&] { return stmt->executeQuery (); });
+    try{
+        vector<MetaData> metaData = rset->getColumnListMetaData();
+        int count = metaData.size();
+        for (const auto &item: metaData) {
+            std::string cName = item.getString(oracle::occi::MetaData::ATTR_NAME);
+            printf("%s,", cName.c_str());
+        }
+        printf("\n");
+        uint64_t rows = 0;
+        while (dbCall (DbOp::NEXT, fp, [&] { return rset->next(); })) {
+            TraceSpan format ("format");
+            for (int i = 0; i < count; ++i) {
+                printf("%s,", rset->getString(i + 1).c_str());
+            }
+            printf("\n");
+            ++rows;
+        }
+        {
+            TraceSpan flush ("flush");
+            fflush (stdout);
+        }
+        trips.addRows(rows);
+        probe.addRows(rows);
+        alloc.addRows(rows);
+        span.setCount(rows);
+    }catch(const SQLException &ex)
+    {
+        logError ("Exception thrown for displayAllRows, error number %d: %s", ex.getErrorCode (),
+                  ex.getMessage ().c_str ());
+    }
+
+    stmt->closeResultSet (rset);
+    dbCall (DbOp::TERMINATE_STATEMENT, fp, [&] { conn->terminateStatement (stmt); });
+}
+
+void occidml::insertElement (string elm_name, float mvol, double awt)
+{
+    AllocScope alloc ("occidml.insertElement");
+    BFloat mol_vol;
+    BDouble at_wt;
+
+    if (!(mvol))
+        mol_vol.isNull = TRUE;
+    else
+        mol_vol.value = mvol;
+
+    if (!(awt))
+        at_wt.isNull = TRUE;
+    else
+        at_wt.value = awt;
+
+    string sqlStmt = "INSERT INTO elements VALUES (:v1, :v2, :v3)";
+    static const uint64_t fp = tagSql (sqlStmt);
+    stmt = dbCall (DbOp::CREATE_STATEMENT, fp, [&] { return conn->createStatement (sqlStmt); });
+
+    try{
+        StatementProbe probe (sqlStmt, StatementKind::UPDATE, fp);
+        stmt->setString(1, elm_name);
+        probe.bind (1, elm_name);
+        stmt->setBFloat(2, mol_vol);
+        stmt->setBDouble(3, at_wt);
+        if (mol_vol.isNull)
+            probe.bindNull (2);
+        else
+            probe.bind (2, (double) mol_vol.value);
+        if (at_wt.isNull)
+            probe.bindNull (3);
+        else
+            probe.bind (3, at_wt.value);
+        dbCall (DbOp::EXECUTE_UPDATE, fp, [&] { return stmt->executeUpdate (); });
+        logInfo ("insertElement - Success");
+    }catch(const SQLException &ex)
+    {
+        logError ("Exception thrown for insertElement, error number %d: %s", ex.getErrorCode (),
+                  ex.getMessage ().c_str ());
+    }
+    dbCall (DbOp::TERMINATE_STATEMENT, fp, [&] { conn->terminateStatement (stmt); });
+}
+
+void occidml::displayElements ()
+{
+    AllocScope alloc ("occidml.displayElements");
+    string sqlStmt =
+            "SELECT element_name, molar_volume, atomic_weight FROM elements \
+    order by element_name";
+    static const uint64_t fp = tagSql (sqlStmt);
+    stmt = dbCall (DbOp::CREATE_STATEMENT, fp, [&] { return conn->createStatement (sqlStmt); });
+    TraceSpan span ("displayElements", fp);
+    StatementProbe probe (sqlStmt, StatementKind::QUERY, fp);
+    ResultSet *rset = dbCall (DbOp::EXECUTE_QUERY, fp, [&] { return stmt->executeQuery (); });
+    try{
+        cout.precision(7);
+        while (dbCall (DbOp::NEXT, fp, [&] { return rset->next (); }))
+        {
+            TraceSpan format ("format");
+            probe.addRows (1);
+            alloc.addRows (1);
+            string elem_name = rset->getString(1);
+            BFloat mol_vol = rset->getBFloat(2);
+            BDouble at_wt = rset->getBDouble(3);
+
+            cout << "Element Name: " << elem_name << "\n";
+
+            if ( mol_vol.isNull )
+                cout << "Molar Volume is NULL\n";
+            else
+                cout << "Molar Volume: " << mol_vol.value << " cm3 mol-1\n";
+
+            if ( at_wt.isNull )
+                cout << "Atomic Weight is NULL\n";
+            else
+                cout << "Atomic Weight: " << at_wt.value << " g/mole\n";
+        }
+        TraceSpan flush ("flush");
+        cout.flush ();
+    }catch(const SQLException &ex)
+    {
+        logError ("Exception thrown for displayElements, error number %d: %s", ex.getErrorCode (),
+                  ex.getMessage ().c_str ());
+    }
+
+    stmt->closeResultSet (rset);
+    dbCall (DbOp::TERMINATE_STATEMENT, fp, [&] { conn->terminateStatement (stmt); });
+}
+
+int runOccidmlDemo(const string &user, const string &pass, const string &db) {
+    try{
+        cout << "occidml - Exhibiting simple insert, delete & update operations\n";
+        occidml *demo = new occidml (user, pass, db);
+
+        demo->deleteTable();
+        demo->createTable();
+
+        cout << "Displaying all records before any operation\n";
+        demo->displayAllRows ();
+
+        cout << "Inserting a record into the table author_tab \n";
+        demo->insertRow ();
+
+        cout << "Displaying the records after insert \n";
+        demo->displayAllRows ();
+
+        cout << "Inserting a records into the table author_tab using dynamic bind\n";
+        demo->insertBind (222, "ANAND");
+
+        cout << "Displaying the records after insert using dynamic bind\n";
+        demo->displayAllRows ();
+
+        cout << "deleting a row with author_id as 222 from author_tab table\n";
+        demo->deleteRow (222, "ANAND");
+
+        cout << "updating a row with author_id as 444 from author_tab table\n";
+        demo->updateRow (444, "ADAM");
+
+        cout << "displaying all rows after all the operations\n";
+        demo->displayAllRows ();
+
+        delete (demo);
+    }
+    catch (const SQLException &ex){
+        logError ("%s", ex.getMessage ().c_str ());
+        return -1;
+    }
+    logInfo ("occidml - done");
+    return 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+
+#include "db_result.h"
+#include "occi_common.h"
+
+/**
+ * Simple insert, delete, update and select operations on author_tab
+ * (and the BFloat/BDouble elements table), moved out of main_cxx.cpp.bak
+ * so the program can run them.
+ */
+class occidml {
+private:
+
+    oracle::occi::Environment *env;
+    oracle::occi::Connection *conn;
+    oracle::occi::Statement *stmt;
+    // 不抛异常的 OCI 路径, 和 conn 共用同一个会话
+    DbSession *session;
+public:
+
+    occidml(std::string user, std::string passwd, std::string db);
+
+    ~occidml();
+
+    void createTable();
+
+    void deleteTable();
+
+    /**
+     * Insertion of a row with dynamic binding, PreparedStatement functionality.
+     * Goes through DbSession, so a failed row (duplicate key, bad value) is a
+     * status code rather than an exception.
+     */
+    void insertBind(int c1, std::string c2);
+
+    /**
+     * Inserting a row into the table.
+     */
+    void insertRow();
+
+    /**
+     * updating a row
+     */
+    void updateRow(int c1, std::string c2);
+
+    /**
+     * deletion of a row
+     */
+    void deleteRow(int c1, std::string c2);
+
+    /**
+     * displaying all the rows in the table
+     */
+    void displayAllRows();
+
+    /**
+     * Inserting a row into elements table.
+     * Demonstrating the usage of BFloat and BDouble datatypes
+     */
+    void insertElement(std::string elm_name, float mvol = 0.0, double awt = 0.0);
+
+    /**
+     * displaying rows from element table
+     */
+    void displayElements();
+
+}; // end of class  occidml
+
+/**
+ * The occidml demo sequence from main_cxx.cpp.bak.
+ */
+int runOccidmlDemo(const std::string &user, const std::string &pass, const std::string &db);
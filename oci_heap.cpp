@@ -0,0 +1,349 @@
+#include "oci_heap.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "logger.h"
+
+using namespace std;
+
+/**
+ * Header in front of every block. A cached small block reuses `size` as
+ * its free-list link.
+ */
+struct alignas(16) OciHeap::Block {
+    union {
+        size_t size;
+        Block *next;
+    };
+    uint32_t kind;
+    // 小块: 档位 (容量 16 << klass); 大页区: 块大小的指数
+    uint32_t klass;
+};
+
+static const uint32_t SMALL_BLOCK = 1;
+static const uint32_t HUGE_BLOCK = 2;
+static const uint32_t MALLOC_BLOCK = 3;
+
+// 16 << 7 = SMALL_MAX
+static const unsigned int SMALL_CLASSES = 8;
+static const unsigned int HUGE_MIN_SHIFT = 16;
+static const size_t REGION_ALIGN = 2 * 1024 * 1024;
+// 字节数没到 FLUSH_BYTES 时, 攒够这么多次分配也发布一次, 计数不至于一直压在线程里
+static const uint64_t FLUSH_ALLOCS = 256;
+
+struct OciHeap::ThreadCache {
+    Block *lists[SMALL_CLASSES] = {};
+    unsigned int counts[SMALL_CLASSES] = {};
+    int64_t pendingBytes = 0;
+    uint64_t pendingAllocs = 0;
+    uint64_t pendingHits = 0;
+
+    ~ThreadCache();
+};
+
+// 线程退出时缓存先析构, 之后这个线程上的分配和释放直接走 malloc/free
+static thread_local bool G_CACHE_RETIRED = false;
+
+OciHeap::ThreadCache::~ThreadCache() {
+    for (unsigned int k = 0; k < SMALL_CLASSES; ++k) {
+        while (lists[k]) {
+            Block *block = lists[k];
+            lists[k] = block->next;
+            free(block);
+        }
+    }
+    G_CACHE_RETIRED = true;
+    OciHeap::instance().publish(pendingBytes, pendingAllocs, pendingHits);
+}
+
+OciHeap::ThreadCache *OciHeap::threadCache() {
+    if (G_CACHE_RETIRED) {
+        return nullptr;
+    }
+    static thread_local ThreadCache cache;
+    return &cache;
+}
+
+static unsigned int smallClass(size_t size) {
+    unsigned int k = 0;
+    while (((size_t) 16 << k) < size) {
+        ++k;
+    }
+    return k;
+}
+
+static unsigned int hugeClass(size_t blockBytes) {
+    unsigned int k = HUGE_MIN_SHIFT;
+    while (((size_t) 1 << k) < blockBytes) {
+        ++k;
+    }
+    return k;
+}
+
+OciHeap &OciHeap::instance() {
+    static OciHeap heap;
+    return heap;
+}
+
+OciHeap::OciHeap() {
+    // 先构造注册表, 它就比堆晚析构, 析构时还能摘掉仪表
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    allocs = metrics.counter("oci_client_heap_allocs_total");
+    hits = metrics.counter("oci_client_heap_cache_hits_total");
+    fallbacks = metrics.counter("oci_client_heap_huge_fallbacks_total");
+    gaugeIds.push_back(metrics.addGauge("oci_client_heap_bytes", "", [this] { return (double) inUse(); }));
+    gaugeIds.push_back(metrics.addGauge("oci_client_heap_peak_bytes", "", [this] { return (double) peak(); }));
+    gaugeIds.push_back(metrics.addGauge("oci_client_heap_huge_bytes", "", [this] { return (double) hugeUsed(); }));
+}
+
+OciHeap::~OciHeap() {
+    // 大页区不解除映射: 退出时别的线程可能还在释放里面的块
+    for (int id: gaugeIds) {
+        MetricsRegistry::instance().removeGauge(id);
+    }
+}
+
+bool OciHeap::reserveHugeRegion(size_t bytes) {
+    lock_guard<mutex> guard(hugeLock);
+    if (region) {
+        logWarn("oci heap: huge region already reserved");
+        return false;
+    }
+    size_t size = (bytes + REGION_ALIGN - 1) / REGION_ALIGN * REGION_ALIGN;
+    void *base = nullptr;
+#ifdef _WIN32
+    // 大页要 SeLockMemoryPrivilege, 拿不到就退回普通页
+    SIZE_T large = GetLargePageMinimum();
+    if (large && size % large == 0) {
+        base = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        hugePages = base != nullptr;
+    }
+    if (!base) {
+        base = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+#else
+    // 先要预留的大页 (vm.nr_hugepages), 没有就用普通映射并建议内核用透明大页
+    base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    hugePages = base != MAP_FAILED;
+    if (!hugePages) {
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            base = nullptr;
+        }
+#ifdef MADV_HUGEPAGE
+        if (base) {
+            madvise(base, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+#endif
+    if (!base) {
+        logWarn("oci heap: mapping %zu bytes failed", size);
+        return false;
+    }
+    region = (unsigned char *) base;
+    regionSize = size;
+    return true;
+}
+
+size_t OciHeap::inUse() const {
+    // 别的线程释放的块记在释放方, 各线程未发布的差额可能让总数暂时为负
+    int64_t bytes = live.load(memory_order_relaxed);
+    return bytes > 0 ? (size_t) bytes : 0;
+}
+
+void OciHeap::flush() {
+    ThreadCache *cache = threadCache();
+    if (cache) {
+        publish(cache->pendingBytes, cache->pendingAllocs, cache->pendingHits);
+        cache->pendingBytes = 0;
+        cache->pendingAllocs = 0;
+        cache->pendingHits = 0;
+    }
+}
+
+void OciHeap::account(int64_t bytes, uint64_t allocations, uint64_t cacheHits) {
+    ThreadCache *cache = threadCache();
+    if (!cache) {
+        publish(bytes, allocations, cacheHits);
+        return;
+    }
+    cache->pendingBytes += bytes;
+    cache->pendingAllocs += allocations;
+    cache->pendingHits += cacheHits;
+    if (cache->pendingBytes < (int64_t) FLUSH_BYTES && cache->pendingBytes > -(int64_t) FLUSH_BYTES &&
+        cache->pendingAllocs < FLUSH_ALLOCS) {
+        return;
+    }
+    flush();
+}
+
+void OciHeap::publish(int64_t bytes, uint64_t allocations, uint64_t cacheHits) {
+    if (allocations) {
+        allocs->add(allocations);
+    }
+    if (cacheHits) {
+        hits->add(cacheHits);
+    }
+    int64_t now = live.fetch_add(bytes, memory_order_relaxed) + bytes;
+    size_t seen = top.load(memory_order_relaxed);
+    while (now > 0 && (size_t) now > seen && !top.compare_exchange_weak(seen, (size_t) now, memory_order_relaxed)) {
+    }
+}
+
+OciHeap::Block *OciHeap::takeHuge(size_t size) {
+    unsigned int k = hugeClass(size + sizeof(Block));
+    size_t blockBytes = (size_t) 1 << k;
+    lock_guard<mutex> guard(hugeLock);
+    Block *block = hugeFree[k];
+    if (block) {
+        hugeFree[k] = block->next;
+    } else if (regionSize - regionTop >= blockBytes) {
+        block = (Block *) (region + regionTop);
+        regionTop += blockBytes;
+    } else {
+        fallbacks->add();
+        return nullptr;
+    }
+    block->kind = HUGE_BLOCK;
+    block->klass = k;
+    hugeBytes.fetch_add(blockBytes, memory_order_relaxed);
+    return block;
+}
+
+void OciHeap::giveHuge(Block *block) {
+    lock_guard<mutex> guard(hugeLock);
+    hugeBytes.fetch_sub((size_t) 1 << block->klass, memory_order_relaxed);
+    block->next = hugeFree[block->klass];
+    hugeFree[block->klass] = block;
+}
+
+void *OciHeap::take(size_t size) {
+    Block *block = nullptr;
+    bool hit = false;
+    if (size <= SMALL_MAX) {
+        unsigned int k = smallClass(size);
+        ThreadCache *cache = threadCache();
+        if (cache && cache->lists[k]) {
+            block = cache->lists[k];
+            cache->lists[k] = block->next;
+            --cache->counts[k];
+            hit = true;
+        } else {
+            block = (Block *) malloc(sizeof(Block) + ((size_t) 16 << k));
+            if (block) {
+                block->kind = SMALL_BLOCK;
+                block->klass = k;
+            }
+        }
+    } else {
+        if (size >= HUGE_MIN && region) {
+            block = takeHuge(size);
+        }
+        if (!block) {
+            block = (Block *) malloc(sizeof(Block) + size);
+            if (block) {
+                block->kind = MALLOC_BLOCK;
+            }
+        }
+    }
+    if (!block) {
+        return nullptr;
+    }
+    block->size = size;
+    account((int64_t) size, 1, hit ? 1 : 0);
+    return block + 1;
+}
+
+void OciHeap::give(void *memptr) {
+    if (nullptr == memptr) {
+        return;
+    }
+    Block *block = (Block *) memptr - 1;
+    account(-(int64_t) block->size, 0, 0);
+    if (block->kind == SMALL_BLOCK) {
+        ThreadCache *cache = threadCache();
+        if (cache && cache->counts[block->klass] < CACHE_BLOCKS) {
+            block->next = cache->lists[block->klass];
+            cache->lists[block->klass] = block;
+            ++cache->counts[block->klass];
+        } else {
+            free(block);
+        }
+    } else if (block->kind == HUGE_BLOCK) {
+        giveHuge(block);
+    } else {
+        free(block);
+    }
+}
+
+void *OciHeap::resize(void *memptr, size_t size) {
+    if (nullptr == memptr) {
+        return take(size);
+    }
+    Block *block = (Block *) memptr - 1;
+    size_t old = block->size;
+    size_t capacity = block->kind == SMALL_BLOCK ? (size_t) 16 << block->klass
+                    : block->kind == HUGE_BLOCK ? ((size_t) 1 << block->klass) - sizeof(Block)
+                    : old;
+    // 块里放得下就原地改大小; 小块缩到更小的档也不搬, 反正会还回同一档
+    if (size <= capacity && (block->kind != MALLOC_BLOCK || size > SMALL_MAX)) {
+        block->size = size;
+        account((int64_t) size - (int64_t) old, 0, 0);
+        return memptr;
+    }
+    // malloc 来的块仍归 malloc 时交给 realloc, 它可能原地扩展
+    if (block->kind == MALLOC_BLOCK && size > SMALL_MAX && (size < HUGE_MIN || !region)) {
+        Block *moved = (Block *) realloc(block, sizeof(Block) + size);
+        if (!moved) {
+            return nullptr;
+        }
+        moved->size = size;
+        account((int64_t) size - (int64_t) old, 0, 0);
+        return moved + 1;
+    }
+    void *copy = take(size);
+    if (copy) {
+        memcpy(copy, memptr, old < size ? old : size);
+        give(memptr);
+    }
+    return copy;
+}
+
+void *OciHeap::allocate(void *ctxp, size_t size) {
+    return static_cast<OciHeap *>(ctxp)->take(size);
+}
+
+void *OciHeap::reallocate(void *ctxp, void *memptr, size_t size) {
+    return static_cast<OciHeap *>(ctxp)->resize(memptr, size);
+}
+
+void OciHeap::release(void *ctxp, void *memptr) {
+    static_cast<OciHeap *>(ctxp)->give(memptr);
+}
+
+string OciHeap::report() {
+    flush();
+    uint64_t allocations = allocs->get();
+    char line[256];
+    snprintf(line, sizeof(line), "oci heap: %.1f KiB live, peak %.1f KiB, %llu allocations, %.1f%% from thread caches",
+             inUse() / 1024.0, peak() / 1024.0, (unsigned long long) allocations,
+             allocations ? 100.0 * hits->get() / allocations : 0.0);
+    string out = line;
+    lock_guard<mutex> guard(hugeLock);
+    if (region) {
+        snprintf(line, sizeof(line), ", huge region %zu MiB (%s) %.1f KiB used, %llu fell back to malloc",
+                 regionSize / (1024 * 1024), hugePages ? "huge pages" : "transparent", hugeUsed() / 1024.0,
+                 (unsigned long long) fallbacks->get());
+        out += line;
+    }
+    return out + "\n";
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metrics.h"
+
+/**
+ * Allocator for the OCI client heap, handed to createEnvironment as its
+ * malocfp/ralocfp/mfreefp callbacks (ctxp = the heap):
+ *
+ *   OciHeap &heap = OciHeap::instance();
+ *   Environment::createEnvironment(Environment::THREADED_MUTEXED, &heap,
+ *                                  OciHeap::allocate, OciHeap::reallocate, OciHeap::release);
+ *
+ * The client library allocates handles, descriptors and small buffers on
+ * nearly every call; with the default callbacks they all meet in malloc.
+ *
+ * - Blocks up to SMALL_MAX bytes come from per-thread free lists in
+ *   power-of-two classes. A thread refills from malloc and frees back to
+ *   its own lists, so the common path takes no lock; each list keeps at
+ *   most CACHE_BLOCKS blocks and hands the rest back to free().
+ * - Blocks of HUGE_MIN bytes and more (prefetch and define buffers) come
+ *   from an optional region backed by huge pages (reserveHugeRegion), in
+ *   power-of-two classes with free lists under one lock. When the region
+ *   is full they fall back to malloc.
+ * - Everything else goes to malloc.
+ *
+ * Every block carries a 16-byte header with its size and kind, so the heap
+ * knows the bytes OCI holds. Threads publish their share every FLUSH_BYTES,
+ * so inUse() is exact to that much per thread.
+ */
+class OciHeap {
+public:
+    static const size_t SMALL_MAX = 2048;
+    static const size_t HUGE_MIN = 64 * 1024;
+    static const unsigned int CACHE_BLOCKS = 64;
+    static const size_t FLUSH_BYTES = 64 * 1024;
+
+    static OciHeap &instance();
+
+    ~OciHeap();
+
+    OciHeap(const OciHeap &) = delete;
+
+    OciHeap &operator=(const OciHeap &) = delete;
+
+    /**
+     * Maps `bytes` (rounded up to 2 MiB) for large blocks, with huge pages
+     * when the system grants them and transparent huge pages otherwise.
+     * Call before the first environment; false when nothing was mapped.
+     */
+    bool reserveHugeRegion(size_t bytes);
+
+    size_t inUse() const;
+
+    size_t peak() const { return top.load(std::memory_order_relaxed); }
+
+    size_t hugeUsed() const { return hugeBytes.load(std::memory_order_relaxed); }
+
+    /**
+     * Publishes the calling thread's pending counts.
+     */
+    void flush();
+
+    /**
+     * Live and peak bytes, cache hit rate and huge region use.
+     */
+    std::string report();
+
+    static void *allocate(void *ctxp, size_t size);
+
+    static void *reallocate(void *ctxp, void *memptr, size_t size);
+
+    static void release(void *ctxp, void *memptr);
+
+private:
+    OciHeap();
+
+    struct Block;
+
+    struct ThreadCache;
+
+    static ThreadCache *threadCache();
+
+    void *take(size_t size);
+
+    void give(void *memptr);
+
+    void *resize(void *memptr, size_t size);
+
+    Block *takeHuge(size_t size);
+
+    void giveHuge(Block *block);
+
+    void account(int64_t bytes, uint64_t allocations, uint64_t cacheHits);
+
+    void publish(int64_t bytes, uint64_t allocations, uint64_t cacheHits);
+
+    std::atomic<int64_t> live{0};
+    std::atomic<size_t> top{0};
+    std::atomic<size_t> hugeBytes{0};
+
+    std::mutex hugeLock;
+    unsigned char *region = nullptr;
+    size_t regionSize = 0;
+    size_t regionTop = 0;
+    bool hugePages = false;
+    // 按 2 的幂分档的空闲块, 下标是块大小的指数
+    Block *hugeFree[64] = {};
+
+    MetricCounter *allocs;
+    MetricCounter *hits;
+    MetricCounter *fallbacks;
+    std::vector<int> gaugeIds;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+/**
+ * Scratch memory for one query, batch or row: a monotonic arena whose
+ * first block is part of the object. An arena on the stack serves small
+ * temporaries without touching the heap, so threads formatting rows in
+ * parallel never meet in malloc. Bigger needs spill into blocks from the
+ * default resource, each larger than the last.
+ *
+ * Nothing is freed one by one; reset() drops everything at once and makes
+ * the inline block current again. Containers must not outlive the reset.
+ *
+ *   QueryArena arena;
+ *   std::pmr::string value(arena.resource());
+ *   ...
+ *   arena.reset();
+ */
+class QueryArena {
+public:
+    static const size_t INLINE_BYTES = 4096;
+
+    QueryArena() : arena(storage, sizeof(storage)) {}
+
+    QueryArena(const QueryArena &) = delete;
+
+    QueryArena &operator=(const QueryArena &) = delete;
+
+    std::pmr::memory_resource *resource() { return &arena; }
+
+    void reset() { arena.release(); }
+
+private:
+    alignas(std::max_align_t) unsigned char storage[INLINE_BYTES];
+    std::pmr::monotonic_buffer_resource arena;
+};
@@ -0,0 +1,377 @@
+#include "query_tuner.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "array_fetch.h"
+#include "latency_histogram.h"
+#include "logger.h"
+#include "sql_fingerprint.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+static bool isQuery(const string &sql) {
+    size_t i = 0;
+    while (i < sql.size() && (isspace((unsigned char) sql[i]) || sql[i] == '(')) {
+        ++i;
+    }
+    string word;
+    while (i < sql.size() && isalpha((unsigned char) sql[i])) {
+        word += (char) toupper((unsigned char) sql[i++]);
+    }
+    return word == "SELECT" || word == "WITH";
+}
+
+static string describe(const TunedSettings &s, bool query) {
+    char text[128];
+    if (query) {
+        snprintf(text, sizeof(text), "prefetch %u rows/%u bytes, array %u, cache %u", s.prefetchRows,
+                 s.prefetchMemory, s.arrayRows, s.stmtCache);
+    } else {
+        snprintf(text, sizeof(text), "batch %u, cache %u", s.dmlBatch, s.stmtCache);
+    }
+    return text;
+}
+
+static void bindAll(Statement *stmt, const vector<string> &binds) {
+    for (size_t i = 0; i < binds.size(); ++i) {
+        stmt->setString((unsigned int) i + 1, binds[i]);
+    }
+}
+
+static uint64_t runQuery(Connection *conn, const string &sql, const TuneOptions &options, const TunedSettings &s,
+                         uint64_t fingerprint) {
+    Statement *stmt = conn->createStatement(sql);
+    uint64_t rows = 0;
+    try {
+        // 缓存里拿回来的语句还带着上一个组合的设置, 每次都显式设
+        stmt->setPrefetchRowCount(s.prefetchRows);
+        stmt->setPrefetchMemorySize(s.prefetchMemory);
+        bindAll(stmt, options.binds);
+        ResultSet *rs = stmt->executeQuery();
+        {
+            ArrayFetcher fetcher(rs, s.arrayRows, fingerprint);
+            while (unsigned int n = fetcher.next()) {
+                rows += n;
+            }
+        }
+        stmt->closeResultSet(rs);
+    }
+    catch (const SQLException &) {
+        conn->terminateStatement(stmt);
+        throw;
+    }
+    conn->terminateStatement(stmt);
+    return rows;
+}
+
+static const string SEQ = "{seq}";
+
+/**
+ * The bind value for DML row `row` (1-based): every "{seq}" replaced by the
+ * row number.
+ */
+static string rowValue(const string &value, unsigned int row) {
+    string out = value;
+    string number = to_string(row);
+    for (size_t at = out.find(SEQ); at != string::npos; at = out.find(SEQ, at + number.size())) {
+        out.replace(at, SEQ.size(), number);
+    }
+    return out;
+}
+
+static uint64_t runDml(Connection *conn, const string &sql, const TuneOptions &options, const TunedSettings &s) {
+    Statement *stmt = conn->createStatement(sql);
+    unsigned int batch = std::max(1u, s.dmlBatch);
+    vector<bool> perRow(options.binds.size());
+    for (size_t b = 0; b < options.binds.size(); ++b) {
+        perRow[b] = options.binds[b].find(SEQ) != string::npos;
+    }
+    vector<vector<char>> values(options.binds.size());
+    vector<vector<ub2>> lengths(options.binds.size());
+    vector<size_t> widths(options.binds.size());
+    try {
+        if (batch == 1) {
+            bindAll(stmt, options.binds);
+            for (unsigned int i = 0; i < options.dmlRows; ++i) {
+                for (size_t b = 0; b < options.binds.size(); ++b) {
+                    if (perRow[b]) {
+                        stmt->setString((unsigned int) b + 1, rowValue(options.binds[b], i + 1));
+                    }
+                }
+                stmt->executeUpdate();
+            }
+        } else {
+            // 除了 {seq} 每一行绑同样的值, 只测批大小的影响
+            for (size_t b = 0; b < options.binds.size(); ++b) {
+                const string &value = options.binds[b];
+                widths[b] = rowValue(value, options.dmlRows).size() + 1;
+                values[b].assign(widths[b] * batch, '\0');
+                lengths[b].assign(batch, (ub2) (value.size() + 1));
+                for (unsigned int r = 0; r < batch; ++r) {
+                    std::copy(value.begin(), value.end(), values[b].begin() + (ptrdiff_t) (r * widths[b]));
+                }
+                stmt->setDataBuffer((unsigned int) b + 1, values[b].data(), OCCI_SQLT_STR, (sb4) widths[b],
+                                    lengths[b].data());
+            }
+            for (unsigned int done = 0; done < options.dmlRows;) {
+                unsigned int n = std::min(batch, options.dmlRows - done);
+                for (size_t b = 0; b < options.binds.size(); ++b) {
+                    if (!perRow[b]) {
+                        continue;
+                    }
+                    for (unsigned int r = 0; r < n; ++r) {
+                        string value = rowValue(options.binds[b], done + r + 1);
+                        char *slot = values[b].data() + r * widths[b];
+                        std::copy(value.begin(), value.end(), slot);
+                        slot[value.size()] = '\0';
+                        lengths[b][r] = (ub2) (value.size() + 1);
+                    }
+                }
+                stmt->executeArrayUpdate(n);
+                done += n;
+            }
+        }
+    }
+    catch (const SQLException &) {
+        conn->terminateStatement(stmt);
+        throw;
+    }
+    conn->terminateStatement(stmt);
+    return options.dmlRows;
+}
+
+static bool parseList(const string &text, vector<unsigned int> &values) {
+    vector<unsigned int> parsed;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(',', start);
+        if (end == string::npos) {
+            end = text.size();
+        }
+        string item = text.substr(start, end - start);
+        char *rest = nullptr;
+        unsigned long value = strtoul(item.c_str(), &rest, 10);
+        if (item.empty() || *rest != '\0') {
+            return false;
+        }
+        parsed.push_back((unsigned int) value);
+        start = end + 1;
+    }
+    values.swap(parsed);
+    return true;
+}
+
+bool parseTuneOption(const string &name, const string &value, TuneOptions &options) {
+    if (name == "--prefetch-rows") {
+        return parseList(value, options.prefetchRows);
+    } else if (name == "--prefetch-memory") {
+        return parseList(value, options.prefetchMemory);
+    } else if (name == "--array-rows") {
+        return parseList(value, options.arrayRows);
+    } else if (name == "--stmt-cache") {
+        return parseList(value, options.stmtCache);
+    } else if (name == "--dml-batch") {
+        return parseList(value, options.dmlBatch);
+    } else if (name == "--binds") {
+        options.binds.clear();
+        size_t start = 0;
+        while (start <= value.size()) {
+            size_t end = value.find(',', start);
+            if (end == string::npos) {
+                end = value.size();
+            }
+            options.binds.push_back(value.substr(start, end - start));
+            start = end + 1;
+        }
+        return true;
+    } else if (name == "--warmup") {
+        options.warmup = (unsigned int) atoi(value.c_str());
+        return true;
+    } else if (name == "--repeats") {
+        options.repeats = (unsigned int) atoi(value.c_str());
+        return options.repeats > 0;
+    } else if (name == "--rows") {
+        options.dmlRows = (unsigned int) atoi(value.c_str());
+        return options.dmlRows > 0;
+    } else if (name == "--p99-slack") {
+        options.p99Slack = atof(value.c_str());
+        return options.p99Slack >= 1;
+    }
+    return false;
+}
+
+static vector<TunedSettings> sweepGrid(const TuneOptions &options, bool query) {
+    vector<TunedSettings> grid;
+    for (unsigned int cache: options.stmtCache) {
+        if (!query) {
+            for (unsigned int batch: options.dmlBatch) {
+                TunedSettings s;
+                s.stmtCache = cache;
+                s.dmlBatch = std::max(1u, batch);
+                grid.push_back(s);
+            }
+            continue;
+        }
+        for (unsigned int prefetch: options.prefetchRows) {
+            for (unsigned int memory: options.prefetchMemory) {
+                for (unsigned int array: options.arrayRows) {
+                    TunedSettings s;
+                    s.prefetchRows = prefetch;
+                    s.prefetchMemory = memory;
+                    s.arrayRows = std::max(1u, array);
+                    s.stmtCache = cache;
+                    grid.push_back(s);
+                }
+            }
+        }
+    }
+    return grid;
+}
+
+vector<TunePoint> paretoFront(const vector<TunePoint> &points) {
+    vector<TunePoint> front;
+    for (size_t i = 0; i < points.size(); ++i) {
+        bool dominated = false;
+        for (size_t j = 0; j < points.size() && !dominated; ++j) {
+            const TunePoint &a = points[j];
+            const TunePoint &b = points[i];
+            bool noWorse = a.rowsPerSec >= b.rowsPerSec && a.p99Us <= b.p99Us;
+            bool better = a.rowsPerSec > b.rowsPerSec || a.p99Us < b.p99Us;
+            // 完全相同的两个点只留前面那个
+            dominated = j != i && noWorse && (better || j < i);
+        }
+        if (!dominated) {
+            front.push_back(points[i]);
+        }
+    }
+    std::sort(front.begin(), front.end(),
+              [](const TunePoint &a, const TunePoint &b) { return a.rowsPerSec > b.rowsPerSec; });
+    return front;
+}
+
+bool tuneStatement(Connection *conn, const string &sql, const TuneOptions &options, TunedStatement &out,
+                   vector<TunePoint> &all, string &error) {
+    bool query = isQuery(sql);
+    uint64_t fingerprint = sqlFingerprint(sql);
+    vector<TunedSettings> grid = sweepGrid(options, query);
+    logInfo("tune %s: %zu combinations, %u warm-up + %u measured runs each", fingerprintHex(fingerprint).c_str(),
+            grid.size(), options.warmup, options.repeats);
+    if (options.repeats < TUNE_P99_RUNS) {
+        logInfo("tune: fewer than %u runs per combination, the tail reported is the slowest run (max), "
+                "not p99", TUNE_P99_RUNS);
+    }
+
+    all.clear();
+    for (const auto &s: grid) {
+        try {
+            // 先清空再设, 每个组合都从空缓存开始 (由 warm-up 填)
+            conn->setStmtCacheSize(0);
+            conn->setStmtCacheSize(s.stmtCache);
+            auto once = [&] {
+                if (!query) {
+                    return (uint64_t) runDml(conn, sql, options, s);
+                }
+                // 不返回行的查询按每次执行算一行, 否则吞吐全是 0 没法比
+                return std::max<uint64_t>(runQuery(conn, sql, options, s, fingerprint), 1);
+            };
+            LatencyHistogram runs;
+            uint64_t rows = 0;
+            uint64_t totalNs = 0;
+            unsigned int repeats = std::max(1u, options.repeats);
+            for (unsigned int r = 0; r < options.warmup + repeats; ++r) {
+                auto start = chrono::steady_clock::now();
+                uint64_t n = once();
+                uint64_t ns = (uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+                        chrono::steady_clock::now() - start).count();
+                // 回滚不算进 DML 的耗时
+                if (!query) {
+                    conn->rollback();
+                }
+                if (r >= options.warmup) {
+                    rows += n;
+                    runs.record(ns);
+                    totalNs += ns;
+                }
+            }
+            TunePoint point;
+            point.settings = s;
+            point.rowsPerSec = totalNs ? (double) rows * 1e9 / (double) totalNs : 0;
+            point.p50Us = runs.quantile(0.50) / 1000.0;
+            point.p99Us = runs.quantile(0.99) / 1000.0;
+            all.push_back(point);
+            logDebug("tune %s: %.1f rows/s, p99 %.1fus", describe(s, query).c_str(), point.rowsPerSec,
+                     point.p99Us);
+        }
+        catch (const SQLException &e) {
+            logWarn("tune %s: %s", describe(s, query).c_str(), e.what());
+            if (!query && e.getErrorCode() == 1) {
+                logWarn("tune: every row binds the same values; put {seq} in the key column's --binds value");
+            }
+            if (!query) {
+                try {
+                    conn->rollback();
+                }
+                catch (const SQLException &) {
+                }
+            }
+        }
+    }
+    conn->setStmtCacheSize(0);
+    if (all.empty()) {
+        error = "no combination ran successfully";
+        return false;
+    }
+
+    out.fingerprint = fingerprint;
+    out.sql = sql;
+    out.query = query;
+    out.runs = std::max(1u, options.repeats);
+    out.pareto = paretoFront(all);
+    // 前沿按吞吐从高到低排, p99 也随之降低, 最后一个的 p99 最好;
+    // 第一个 p99 落在容忍范围内的就是推荐值
+    double bestP99 = out.pareto.back().p99Us;
+    out.settings = out.pareto.back().settings;
+    for (const auto &point: out.pareto) {
+        if (point.p99Us <= bestP99 * options.p99Slack) {
+            out.settings = point.settings;
+            break;
+        }
+    }
+    return true;
+}
+
+static bool sameSettings(const TunedSettings &a, const TunedSettings &b) {
+    return a.prefetchRows == b.prefetchRows && a.prefetchMemory == b.prefetchMemory &&
+           a.arrayRows == b.arrayRows && a.stmtCache == b.stmtCache && a.dmlBatch == b.dmlBatch;
+}
+
+string formatTuneReport(const TunedStatement &tuned, const vector<TunePoint> &all) {
+    char line[256];
+    string out;
+    // 测量次数不够时 quantile(0.99) 就是最慢的那次, 别叫它 p99
+    const char *tail = tuned.runs >= TUNE_P99_RUNS ? "p99" : "max";
+    snprintf(line, sizeof(line), "tuned %s (%s), %zu combinations, %zu on the Pareto front (%s of %u runs)\n",
+             fingerprintHex(tuned.fingerprint).c_str(), tuned.query ? "query" : "dml", all.size(),
+             tuned.pareto.size(), tail, tuned.runs);
+    out += line;
+    vector<TunePoint> sorted = all;
+    std::sort(sorted.begin(), sorted.end(),
+              [](const TunePoint &a, const TunePoint &b) { return a.rowsPerSec > b.rowsPerSec; });
+    for (const auto &point: sorted) {
+        bool front = false;
+        for (const auto &p: tuned.pareto) {
+            front = front || sameSettings(p.settings, point.settings);
+        }
+        // '>' 推荐值, '*' 帕累托前沿上的其它点
+        char mark = sameSettings(point.settings, tuned.settings) ? '>' : front ? '*' : ' ';
+        snprintf(line, sizeof(line), "%c %-52s %14.1f rows/s  p50 %10.1fus  %s %10.1fus\n", mark,
+                 describe(point.settings, tuned.query).c_str(), point.rowsPerSec, point.p50Us, tail, point.p99Us);
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "occi_common.h"
+#include "tuned_config.h"
+
+struct TuneOptions {
+    // 查询扫这四个维度的全部组合
+    std::vector<unsigned int> prefetchRows{1, 10, 100, 1000};
+    std::vector<unsigned int> prefetchMemory{0, 1 << 20};
+    std::vector<unsigned int> arrayRows{1, 100, 1000};
+    std::vector<unsigned int> stmtCache{0, 20};
+    // DML 扫批大小 x 语句缓存, 1 = 逐行 executeUpdate
+    std::vector<unsigned int> dmlBatch{1, 10, 100, 1000};
+    unsigned int warmup = 1;
+    unsigned int repeats = 5;
+    // DML 每次测量执行这么多行, 测完回滚
+    unsigned int dmlRows = 1000;
+    // 推荐值: p99 不超过前沿上最好 p99 的这个倍数的点里, 吞吐最高的那个
+    double p99Slack = 1.2;
+    // 依次绑定到 :1, :2, ... 的值 (按字符串绑定, 由服务端转换);
+    // DML 里值中的 {seq} 换成行号, 主键/唯一列才不会每行都一样
+    std::vector<std::string> binds;
+};
+
+/**
+ * Measured runs per combination from which the tuner reports p99; with
+ * fewer, the slowest run is all there is and the report calls it max.
+ */
+static const unsigned int TUNE_P99_RUNS = 100;
+
+/**
+ * Applies one `tune` command-line option (--prefetch-rows 1,10,100,
+ * --prefetch-memory, --array-rows, --stmt-cache, --dml-batch, --binds a,b,
+ * --warmup, --repeats, --rows, --p99-slack); false for an unknown option
+ * or a bad value.
+ */
+bool parseTuneOption(const std::string &name, const std::string &value, TuneOptions &options);
+
+/**
+ * Sweeps the fetch or DML knobs of one statement on conn and picks its
+ * settings.
+ *
+ * Queries run every combination of prefetch rows, prefetch memory, array
+ * fetch size and statement cache size, each as create statement, execute,
+ * fetch all rows through ArrayFetcher, close. DML (anything that does not
+ * start with SELECT or WITH) runs dmlRows rows per measurement at each
+ * batch length and statement cache size, then rolls back. Every DML row
+ * binds the same values except that "{seq}" in a bind value becomes the
+ * row's number (1..dmlRows), so an INSERT into a primary key or unique
+ * column needs it there or fails with ORA-00001 from the second row on. Each combination
+ * gets `warmup` unmeasured runs and `repeats` measured ones; throughput is
+ * rows over the measured time, p50/p99 are per run. Below TUNE_P99_RUNS
+ * repeats p99Us is the slowest run, and the report labels it max.
+ *
+ * out.pareto is the set of combinations no other one beats on both
+ * throughput and p99, best throughput first; out.settings the pick from it
+ * (see TuneOptions::p99Slack). all holds every combination that ran.
+ * Combinations that fail (e.g. ORA- errors) are logged and left out; false
+ * when none succeeded.
+ */
+bool tuneStatement(oracle::occi::Connection *conn, const std::string &sql, const TuneOptions &options,
+                   TunedStatement &out, std::vector<TunePoint> &all, std::string &error);
+
+/**
+ * The points not dominated on (rowsPerSec, p99Us), best throughput first.
+ */
+std::vector<TunePoint> paretoFront(const std::vector<TunePoint> &points);
+
+/**
+ * Every combination, with the Pareto front marked and the pick on top.
+ */
+std::string formatTuneReport(const TunedStatement &tuned, const std::vector<TunePoint> &all);
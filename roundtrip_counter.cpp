@@ -0,0 +1,140 @@
+#include "roundtrip_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+
+#include "latency_histogram.h"
+#include "logger.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+static const char *ROUNDTRIP_SQL =
+        "SELECT s.value FROM v$mystat s, v$statname n "
+        "WHERE s.statistic# = n.statistic# AND n.name = 'SQL*Net roundtrips to/from client'";
+
+static atomic<int> G_ACCOUNTING(-1);
+// 读取一次统计值本身产生的往返次数, 第一次使用时测量
+static atomic<int64_t> G_PROBE_COST(-1);
+
+static mutex G_TOTALS_LOCK;
+static map<string, RoundTripTotals> G_TOTALS;
+
+bool roundTripAccounting() {
+    int enabled = G_ACCOUNTING.load(memory_order_relaxed);
+    if (enabled < 0) {
+        const char *env = getenv("OCI_DEMO_ROUNDTRIPS");
+        enabled = (env && env[0] == '1') ? 1 : 0;
+        G_ACCOUNTING.store(enabled, memory_order_relaxed);
+    }
+    return enabled == 1;
+}
+
+void setRoundTripAccounting(bool enabled) {
+    G_ACCOUNTING.store(enabled ? 1 : 0, memory_order_relaxed);
+}
+
+int64_t sessionRoundTrips(Connection *conn) {
+    // 不走 dbCall, 统计查询不算进被测操作的客户端调用次数
+    Statement *stmt = nullptr;
+    int64_t value = -1;
+    try {
+        stmt = conn->createStatement(ROUNDTRIP_SQL);
+        ResultSet *rs = stmt->executeQuery();
+        if (rs->next()) {
+            value = (int64_t) rs->getDouble(1);
+        }
+        stmt->closeResultSet(rs);
+        conn->terminateStatement(stmt);
+    }
+    catch (const SQLException &e) {
+        logWarn("round trip statistic unavailable: %s", e.what());
+        // 会从 RoundTripScope 的析构里调到, 会话断了时关语句也会抛, 不能让它逃出去
+        if (stmt) {
+            try {
+                conn->terminateStatement(stmt);
+            }
+            catch (const SQLException &e) {
+                logDebug("%s", e.what());
+            }
+        }
+        return -1;
+    }
+    return value;
+}
+
+static int64_t probeCost(Connection *conn) {
+    int64_t cost = G_PROBE_COST.load(memory_order_relaxed);
+    if (cost < 0) {
+        int64_t first = sessionRoundTrips(conn);
+        int64_t second = sessionRoundTrips(conn);
+        if (first < 0 || second < 0) {
+            return -1;
+        }
+        cost = second - first;
+        G_PROBE_COST.store(cost, memory_order_relaxed);
+    }
+    return cost;
+}
+
+RoundTripScope::RoundTripScope(Connection *conn, const char *operation, bool print)
+        : conn(conn), operation(operation), print(print), active(false),
+          serverBefore(-1), callsBefore(0), rows(0) {
+    if (!roundTripAccounting() || nullptr == conn) {
+        return;
+    }
+    active = true;
+    if (probeCost(conn) >= 0) {
+        serverBefore = sessionRoundTrips(conn);
+    }
+    callsBefore = threadDbCalls();
+}
+
+RoundTripScope::~RoundTripScope() {
+    if (!active) {
+        return;
+    }
+    uint64_t calls = threadDbCalls() - callsBefore;
+    int64_t trips = -1;
+    if (serverBefore >= 0) {
+        int64_t after = sessionRoundTrips(conn);
+        if (after >= 0) {
+            // 减去开始时那次统计查询的往返
+            trips = after - serverBefore - G_PROBE_COST.load(memory_order_relaxed);
+            if (trips < 0) {
+                trips = 0;
+            }
+        }
+    }
+
+    {
+        lock_guard<mutex> guard(G_TOTALS_LOCK);
+        RoundTripTotals &totals = G_TOTALS[operation];
+        ++totals.operations;
+        totals.roundTrips += trips > 0 ? (uint64_t) trips : 0;
+        totals.clientCalls += calls;
+        totals.rows += rows;
+    }
+
+    if (print) {
+        if (trips >= 0) {
+            printf("%s: %lld round trips for %llu rows (%llu client calls)\n", operation,
+                   (long long) trips, (unsigned long long) rows, (unsigned long long) calls);
+        } else {
+            printf("%s: ? round trips for %llu rows (%llu client calls)\n", operation,
+                   (unsigned long long) rows, (unsigned long long) calls);
+        }
+    }
+}
+
+map<string, RoundTripTotals> roundTripTotals() {
+    lock_guard<mutex> guard(G_TOTALS_LOCK);
+    return G_TOTALS;
+}
+
+void resetRoundTripTotals() {
+    lock_guard<mutex> guard(G_TOTALS_LOCK);
+    G_TOTALS.clear();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "occi_common.h"
+
+/**
+ * Totals for one named logical operation, summed over every scope that ran it.
+ */
+struct RoundTripTotals {
+    uint64_t operations = 0;
+    uint64_t roundTrips = 0;
+    uint64_t clientCalls = 0;
+    uint64_t rows = 0;
+};
+
+/**
+ * Counts server round trips and client OCCI calls made by one logical
+ * operation on one connection.
+ *
+ * Round trips come from the session statistic
+ * 'SQL*Net roundtrips to/from client' read before and after; the cost of the
+ * statistic query itself is measured once and subtracted. Client calls are
+ * the dbCall() wrappers the operation went through on this thread.
+ *
+ * Only active when roundTripAccounting() is on (OCI_DEMO_ROUNDTRIPS=1 or
+ * setRoundTripAccounting(true)), otherwise construction and destruction are free.
+ */
+class RoundTripScope {
+public:
+    RoundTripScope(oracle::occi::Connection *conn, const char *operation, bool print = true);
+
+    ~RoundTripScope();
+
+    RoundTripScope(const RoundTripScope &) = delete;
+
+    RoundTripScope &operator=(const RoundTripScope &) = delete;
+
+    void addRows(uint64_t n) { rows += n; }
+
+private:
+    oracle::occi::Connection *conn;
+    const char *operation;
+    bool print;
+    bool active;
+    int64_t serverBefore;
+    uint64_t callsBefore;
+    uint64_t rows;
+};
+
+bool roundTripAccounting();
+
+void setRoundTripAccounting(bool enabled);
+
+/**
+ * Reads 'SQL*Net roundtrips to/from client' for the session, -1 when the
+ * user cannot see v$mystat.
+ */
+int64_t sessionRoundTrips(oracle::occi::Connection *conn);
+
+std::map<std::string, RoundTripTotals> roundTripTotals();
+
+void resetRoundTripTotals();
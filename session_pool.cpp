@@ -0,0 +1,145 @@
+#include "session_pool.h"
+
+#include <chrono>
+#include <iostream>
+
+#include "latency_histogram.h"
+#include "logger.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+SessionPool::SessionPool(Environment *env, const string &connectString,
+                         unsigned int maxConn, unsigned int minConn, unsigned int incrConn)
+        : env(env), pool(nullptr), connect(connectString),
+          maxConn(maxConn), minConn(minConn), incrConn(incrConn),
+          waitTime(nullptr), checkouts(nullptr), hits(nullptr) {
+}
+
+SessionPool::~SessionPool() {
+    close();
+}
+
+bool SessionPool::open(const string &user, const string &pass) {
+    if (pool) {
+        return true;
+    }
+    try {
+        pool = env->createStatelessConnectionPool(user, pass, connect, maxConn, minConn, incrConn,
+                                                  StatelessConnectionPool::HOMOGENEOUS);
+        if (nullptr == pool) {
+            logError("createStatelessConnectionPool error: %s", connect.c_str());
+            return false;
+        }
+        // 池满时等待空闲会话, 而不是直接报错
+        pool->setBusyOption(StatelessConnectionPool::WAIT);
+    }
+    catch (const SQLException &e) {
+        logError("%s: %s", connect.c_str(), e.what());
+        pool = nullptr;
+        return false;
+    }
+
+    MetricsRegistry &metrics = MetricsRegistry::instance();
+    string labels = metricLabel("pool", connect);
+    waitTime = metrics.histogram("oci_pool_checkout_wait_seconds", labels);
+    checkouts = metrics.counter("oci_pool_checkouts_total", labels);
+    hits = metrics.counter("oci_pool_hits_total", labels);
+    gaugeIds.push_back(metrics.addGauge("oci_pool_open_sessions", labels, [this] { return (double) openCount(); }));
+    gaugeIds.push_back(metrics.addGauge("oci_pool_busy_sessions", labels, [this] { return (double) busyCount(); }));
+    gaugeIds.push_back(metrics.addGauge("oci_pool_max_sessions", labels, [this] { return (double) maxConn; }));
+    return true;
+}
+
+void SessionPool::close() {
+    for (int id: gaugeIds) {
+        MetricsRegistry::instance().removeGauge(id);
+    }
+    gaugeIds.clear();
+    if (pool) {
+        try {
+            env->terminateStatelessConnectionPool(pool);
+        }
+        catch (const SQLException &e) {
+            logError("%s: %s", connect.c_str(), e.what());
+        }
+        pool = nullptr;
+    }
+}
+
+Connection *SessionPool::checkout(const string &tenant) {
+    if (nullptr == pool) {
+        return nullptr;
+    }
+    if (limiter && !limiter->acquire(tenant)) {
+        logDebug("%s: request shed by limiter %s (limit %u)", connect.c_str(), limiter->name().c_str(),
+                 limiter->limit());
+        return nullptr;
+    }
+    auto admittedAt = chrono::steady_clock::now();
+    try {
+        // OCCI 不暴露 OCISPool 句柄, 拿不到 OCI_ATTR_SPOOL_HIT_COUNT;
+        // 打开的会话数没有增加就说明复用了已有会话, 记为一次命中
+        unsigned int openBefore = pool->getOpenConnections();
+        auto start = chrono::steady_clock::now();
+        Connection *conn = dbCall(DbOp::CREATE_CONNECTION, 0, [this] { return pool->getConnection(); });
+        waitTime->observe(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        checkouts->add();
+        if (pool->getOpenConnections() <= openBefore) {
+            hits->add();
+        }
+        if (limiter) {
+            lock_guard<mutex> guard(admittedLock);
+            admitted[conn] = {tenant, admittedAt};
+        }
+        return conn;
+    }
+    catch (const SQLException &e) {
+        logError("%s: %s", connect.c_str(), e.what());
+        if (limiter) {
+            limiter->release(tenant, (uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now() - admittedAt).count(), true);
+        }
+        return nullptr;
+    }
+}
+
+void SessionPool::settle(Connection *conn, bool failed) {
+    if (nullptr == limiter) {
+        return;
+    }
+    Admitted entry;
+    {
+        lock_guard<mutex> guard(admittedLock);
+        auto it = admitted.find(conn);
+        if (it == admitted.end()) {
+            return;
+        }
+        entry = std::move(it->second);
+        admitted.erase(it);
+    }
+    limiter->release(entry.tenant, (uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now() - entry.since).count(), failed);
+}
+
+void SessionPool::release(Connection *conn) {
+    if (pool && conn) {
+        settle(conn, false);
+        pool->releaseConnection(conn);
+    }
+}
+
+void SessionPool::drop(Connection *conn) {
+    if (pool && conn) {
+        settle(conn, true);
+        pool->terminateConnection(conn);
+    }
+}
+
+unsigned int SessionPool::busyCount() const {
+    return pool ? pool->getBusyConnections() : 0;
+}
+
+unsigned int SessionPool::openCount() const {
+    return pool ? pool->getOpenConnections() : 0;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "concurrency_limiter.h"
+#include "metrics.h"
+#include "occi_common.h"
+
+/**
+ * A stateless OCCI session pool bound to a single endpoint (connect string).
+ * Sessions are checked out for one request and released right after it.
+ */
+class SessionPool {
+public:
+    SessionPool(oracle::occi::Environment *env, const std::string &connectString,
+                unsigned int maxConn, unsigned int minConn = 0, unsigned int incrConn = 1);
+
+    ~SessionPool();
+
+    SessionPool(const SessionPool &) = delete;
+
+    SessionPool &operator=(const SessionPool &) = delete;
+
+    bool open(const std::string &user, const std::string &pass);
+
+    void close();
+
+    /**
+     * Puts admission control in front of checkout(); the limiter then gets
+     * each session's checkout-to-release time as its latency sample, and
+     * drop() as a failure. nullptr turns it off. Set before use.
+     */
+    void setLimiter(ConcurrencyLimiter *limiter) { this->limiter = limiter; }
+
+    /**
+     * Returns nullptr when the pool is not open, the endpoint refused the
+     * session, or the limiter shed the request.
+     */
+    oracle::occi::Connection *checkout(const std::string &tenant = "");
+
+    void release(oracle::occi::Connection *conn);
+
+    /**
+     * Destroys a session instead of returning it, for sessions that saw a fatal error.
+     */
+    void drop(oracle::occi::Connection *conn);
+
+    unsigned int busyCount() const;
+
+    unsigned int openCount() const;
+
+    unsigned int maxCount() const { return maxConn; }
+
+    const std::string &connectString() const { return connect; }
+
+private:
+    oracle::occi::Environment *env;
+    oracle::occi::StatelessConnectionPool *pool;
+    std::string connect;
+    unsigned int maxConn;
+    unsigned int minConn;
+    unsigned int incrConn;
+
+    // 指标在 open() 时注册, close() 时注销
+    std::vector<int> gaugeIds;
+    MetricHistogram *waitTime;
+    MetricCounter *checkouts;
+    MetricCounter *hits;
+
+    struct Admitted {
+        std::string tenant;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    ConcurrencyLimiter *limiter = nullptr;
+    std::mutex admittedLock;
+    std::map<oracle::occi::Connection *, Admitted> admitted;
+
+    void settle(oracle::occi::Connection *conn, bool failed);
+};
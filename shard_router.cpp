@@ -0,0 +1,171 @@
+#include "shard_router.h"
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+
+#include "logger.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+ShardRouter::ShardRouter(Environment *env, unsigned int chunkCount,
+                         unsigned int maxPerShard, size_t maxCachedKeys)
+        : env(env), chunkCount(chunkCount ? chunkCount : 1), maxPerShard(maxPerShard),
+          maxCachedKeys(maxCachedKeys), hits(0), misses(0) {
+}
+
+ShardRouter::~ShardRouter() {
+    close();
+}
+
+void ShardRouter::addShard(const ShardEndpoint &shard) {
+    unique_lock<shared_mutex> lock(cacheLock);
+    shards.push_back(shard);
+    pools.emplace_back(new SessionPool(env, shard.connectString, maxPerShard));
+    ranges.push_back({shard.firstChunk, shard.lastChunk, (int) shards.size() - 1});
+    keyCache.clear();
+}
+
+void ShardRouter::setCoordinator(const string &connectString) {
+    coordinatorConnect = connectString;
+}
+
+bool ShardRouter::open(const string &user, const string &pass) {
+    int opened = 0;
+    for (size_t i = 0; i < pools.size(); ++i) {
+        if (pools[i]->open(user, pass)) {
+            ++opened;
+        } else {
+            logWarn("shard %s unavailable", shards[i].name.c_str());
+        }
+    }
+    if (!coordinatorConnect.empty()) {
+        coordinator.reset(new SessionPool(env, coordinatorConnect, maxPerShard));
+        if (!coordinator->open(user, pass)) {
+            logWarn("coordinator unavailable");
+        }
+    }
+    return opened > 0;
+}
+
+void ShardRouter::close() {
+    for (auto &pool: pools) {
+        pool->close();
+    }
+    if (coordinator) {
+        coordinator->close();
+    }
+}
+
+unsigned int ShardRouter::chunkOf(const string &shardingKey) const {
+    // FNV-1a, every client must hash the same way for the chunk table to agree
+    unsigned int hash = 2166136261u;
+    for (unsigned char c: shardingKey) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    return hash % chunkCount;
+}
+
+int ShardRouter::lookupChunk(unsigned int chunk, const string &superShardingKey) const {
+    for (const auto &range: ranges) {
+        if (chunk < range.first || chunk > range.last) {
+            continue;
+        }
+        const ShardEndpoint &owner = shards[range.shard];
+        if (superShardingKey.empty() || owner.superKey.empty() || owner.superKey == superShardingKey) {
+            return range.shard;
+        }
+    }
+    return -1;
+}
+
+int ShardRouter::resolve(const string &shardingKey, const string &superShardingKey) {
+    string cacheKey = superShardingKey;
+    cacheKey += '\x1f';
+    cacheKey += shardingKey;
+    {
+        shared_lock<shared_mutex> lock(cacheLock);
+        auto it = keyCache.find(cacheKey);
+        if (it != keyCache.end()) {
+            hits.fetch_add(1, memory_order_relaxed);
+            return it->second;
+        }
+    }
+    misses.fetch_add(1, memory_order_relaxed);
+
+    unsigned int chunk = chunkOf(shardingKey);
+    unique_lock<shared_mutex> lock(cacheLock);
+    int shard = lookupChunk(chunk, superShardingKey);
+    if (shard >= 0) {
+        // 简单的容量控制: 满了就整体清空, 热点 key 会很快重新进入缓存
+        if (keyCache.size() >= maxCachedKeys) {
+            keyCache.clear();
+        }
+        keyCache.emplace(cacheKey, shard);
+    }
+    return shard;
+}
+
+bool ShardRouter::remap(unsigned int firstChunk, unsigned int lastChunk, int shard) {
+    unique_lock<shared_mutex> lock(cacheLock);
+    if (shard < 0 || shard >= (int) shards.size()) {
+        logWarn("remap %u-%u: no shard %d", firstChunk, lastChunk, shard);
+        return false;
+    }
+    if (firstChunk > lastChunk || lastChunk >= chunkCount) {
+        logWarn("remap %u-%u: not a chunk range of 0-%u", firstChunk, lastChunk, chunkCount - 1);
+        return false;
+    }
+    // 被新范围完全盖住、且 super key 上也挡住了的旧范围不会再命中, 删掉,
+    // 反复搬同一段时表不会越来越长
+    const string &superKey = shards[shard].superKey;
+    ranges.erase(remove_if(ranges.begin(), ranges.end(), [&](const ChunkRange &range) {
+        return firstChunk <= range.first && range.last <= lastChunk &&
+               (superKey.empty() || superKey == shards[range.shard].superKey);
+    }), ranges.end());
+    ranges.insert(ranges.begin(), {firstChunk, lastChunk, shard});
+    keyCache.clear();
+    return true;
+}
+
+void ShardRouter::invalidateCache() {
+    unique_lock<shared_mutex> lock(cacheLock);
+    keyCache.clear();
+}
+
+ShardSession ShardRouter::checkout(const string &shardingKey, const string &superShardingKey) {
+    ShardSession session;
+    int shard = resolve(shardingKey, superShardingKey);
+    if (shard < 0) {
+        logError("no shard owns key %s", shardingKey.c_str());
+        return session;
+    }
+    session.conn = pools[shard]->checkout();
+    if (session.conn) {
+        session.shard = shard;
+    }
+    return session;
+}
+
+ShardSession ShardRouter::checkoutCoordinator() {
+    ShardSession session;
+    if (coordinator) {
+        session.conn = coordinator->checkout();
+    }
+    return session;
+}
+
+void ShardRouter::release(const ShardSession &session) {
+    if (nullptr == session.conn) {
+        return;
+    }
+    if (session.shard < 0) {
+        if (coordinator) {
+            coordinator->release(session.conn);
+        }
+    } else {
+        pools[session.shard]->release(session.conn);
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "occi_common.h"
+#include "session_pool.h"
+
+/**
+ * One shard: a directly reachable endpoint that owns a contiguous range of chunks.
+ * superKey is the shardspace the shard belongs to for composite sharding,
+ * empty when the deployment only uses a sharding key.
+ */
+struct ShardEndpoint {
+    std::string name;
+    std::string connectString;
+    unsigned int firstChunk;
+    unsigned int lastChunk;
+    std::string superKey;
+};
+
+/**
+ * A session checked out from one shard's sub-pool.
+ * shard is -1 for the coordinator (catalog) session.
+ */
+struct ShardSession {
+    oracle::occi::Connection *conn = nullptr;
+    int shard = -1;
+};
+
+/**
+ * Routes requests that carry a sharding key straight to the owning shard.
+ *
+ * Keys are hashed into a fixed chunk space the same way for every client, the
+ * chunk -> shard table is kept locally and resolved keys are cached, so a
+ * single-shard request never touches the coordinator. Only multi-shard work
+ * should use checkoutCoordinator().
+ */
+class ShardRouter {
+public:
+    ShardRouter(oracle::occi::Environment *env, unsigned int chunkCount,
+                unsigned int maxPerShard, size_t maxCachedKeys = 65536);
+
+    ~ShardRouter();
+
+    ShardRouter(const ShardRouter &) = delete;
+
+    ShardRouter &operator=(const ShardRouter &) = delete;
+
+    void addShard(const ShardEndpoint &shard);
+
+    void setCoordinator(const std::string &connectString);
+
+    /**
+     * Opens one sub-pool per shard (and the coordinator pool if configured).
+     * Shards that cannot be reached are reported but do not fail the call,
+     * requests routed to them will fail at checkout.
+     */
+    bool open(const std::string &user, const std::string &pass);
+
+    void close();
+
+    ShardSession checkout(const std::string &shardingKey, const std::string &superShardingKey = "");
+
+    ShardSession checkoutCoordinator();
+
+    void release(const ShardSession &session);
+
+    /**
+     * Returns the shard index owning the key, or -1 when no shard covers it.
+     */
+    int resolve(const std::string &shardingKey, const std::string &superShardingKey = "");
+
+    /**
+     * Moves a chunk range to another shard (after a split or a move) and drops
+     * every cached key so nothing is routed with the stale mapping.
+     * Returns false, changing nothing, when the range is empty or outside the
+     * chunk space or the shard is unknown.
+     */
+    bool remap(unsigned int firstChunk, unsigned int lastChunk, int shard);
+
+    void invalidateCache();
+
+    unsigned int chunkOf(const std::string &shardingKey) const;
+
+    const ShardEndpoint &shard(int index) const { return shards[index]; }
+
+    size_t shardCount() const { return shards.size(); }
+
+    unsigned long long cacheHits() const { return hits.load(); }
+
+    unsigned long long cacheMisses() const { return misses.load(); }
+
+private:
+    struct ChunkRange {
+        unsigned int first;
+        unsigned int last;
+        int shard;
+    };
+
+    int lookupChunk(unsigned int chunk, const std::string &superShardingKey) const;
+
+    oracle::occi::Environment *env;
+    unsigned int chunkCount;
+    unsigned int maxPerShard;
+    size_t maxCachedKeys;
+
+    std::vector<ShardEndpoint> shards;
+    std::vector<std::unique_ptr<SessionPool>> pools;
+    std::unique_ptr<SessionPool> coordinator;
+    std::string coordinatorConnect;
+
+    // newest first, so a remapped range shadows the shard's original range
+    std::vector<ChunkRange> ranges;
+
+    mutable std::shared_mutex cacheLock;
+    std::unordered_map<std::string, int> keyCache;
+    std::atomic<unsigned long long> hits;
+    std::atomic<unsigned long long> misses;
+};
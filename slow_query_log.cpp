@@ -0,0 +1,260 @@
+#include "slow_query_log.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+#include <sstream>
+
+#include "logger.h"
+#include "sql_fingerprint.h"
+
+using namespace std;
+
+static const size_t RING_CAPACITY = 4096;
+static const uint64_t DEFAULT_THRESHOLD_NS = 100 * 1000 * 1000;
+
+static uint64_t fnv1a(const string &text) {
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c: text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// logfmt 的引号值: 转义 \ " 和换行
+static void appendQuoted(string &out, const string &text) {
+    out += '"';
+    for (char c: text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n' || c == '\r' || c == '\t') {
+            out += ' ';
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+static void appendBind(string &out, const BindValue &bind, BindRedaction redaction) {
+    char text[64];
+    out += to_string(bind.index);
+    out += '=';
+    if (bind.type == BindType::NUL) {
+        out += "null";
+        return;
+    }
+    if (redaction == BindRedaction::MASK) {
+        if (bind.type == BindType::STRING) {
+            snprintf(text, sizeof(text), "'***'(%zu)", bind.s.size());
+            out += text;
+        } else {
+            out += bind.type == BindType::INT ? "?int" : "?double";
+        }
+        return;
+    }
+    string value;
+    if (bind.type == BindType::INT) {
+        value = to_string(bind.i);
+    } else if (bind.type == BindType::DOUBLE) {
+        snprintf(text, sizeof(text), "%.17g", bind.d);
+        value = text;
+    } else {
+        value = bind.s;
+    }
+    if (redaction == BindRedaction::HASH) {
+        snprintf(text, sizeof(text), "#%08" PRIx32, (uint32_t) fnv1a(value));
+        out += text;
+    } else if (bind.type == BindType::STRING) {
+        // 单引号按 SQL 的写法成对转义
+        out += '\'';
+        for (char c: value) {
+            if (c == '\'') {
+                out += '\'';
+            }
+            out += c;
+        }
+        out += '\'';
+    } else {
+        out += value;
+    }
+}
+
+SlowQueryLog::SlowQueryLog()
+        : defaultThresholdNs(DEFAULT_THRESHOLD_NS), minThresholdNs(DEFAULT_THRESHOLD_NS), ring(RING_CAPACITY) {
+}
+
+SlowQueryLog::~SlowQueryLog() {
+    stop();
+}
+
+void SlowQueryLog::setDefaultThreshold(chrono::nanoseconds threshold) {
+    defaultThresholdNs = (uint64_t) std::max<int64_t>(0, threshold.count());
+    minThresholdNs = defaultThresholdNs;
+    for (const auto &entry: thresholds) {
+        minThresholdNs = std::min(minThresholdNs, entry.second);
+    }
+}
+
+void SlowQueryLog::setThreshold(uint64_t fingerprint, chrono::nanoseconds threshold) {
+    thresholds[fingerprint] = (uint64_t) std::max<int64_t>(0, threshold.count());
+    minThresholdNs = std::min(minThresholdNs, thresholds[fingerprint]);
+}
+
+bool SlowQueryLog::parseThresholds(const string &text) {
+    stringstream in(text);
+    string item;
+    while (getline(in, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == string::npos || eq == 0) {
+            return false;
+        }
+        char *end = nullptr;
+        uint64_t fingerprint = strtoull(item.substr(0, eq).c_str(), &end, 16);
+        if (*end != '\0') {
+            return false;
+        }
+        double ms = atof(item.c_str() + eq + 1);
+        setThreshold(fingerprint, chrono::nanoseconds((int64_t) (ms * 1e6)));
+    }
+    return true;
+}
+
+void SlowQueryLog::setRedaction(BindRedaction redaction) {
+    this->redaction = redaction;
+}
+
+void SlowQueryLog::setBindSample(unsigned int n) {
+    bindSample = n;
+}
+
+bool SlowQueryLog::start(const string &path) {
+    if (path == "-") {
+        out = stdout;
+    } else {
+        out = fopen(path.c_str(), "a");
+        if (nullptr == out) {
+            logError("open %s error.", path.c_str());
+            return false;
+        }
+    }
+    stopping = false;
+    writer = thread(&SlowQueryLog::writeLoop, this);
+    if (!addStatementSink(this)) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void SlowQueryLog::stop() {
+    if (nullptr == out) {
+        return;
+    }
+    removeStatementSink(this);
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    if (out != stdout) {
+        fclose(out);
+    }
+    out = nullptr;
+}
+
+bool SlowQueryLog::wantsBinds() {
+    if (redaction == BindRedaction::DROP || 0 == bindSample) {
+        return false;
+    }
+    static thread_local unsigned int G_BIND_TICK = 0;
+    return ++G_BIND_TICK % bindSample == 0;
+}
+
+uint64_t SlowQueryLog::thresholdFor(uint64_t fingerprint) const {
+    auto it = thresholds.find(fingerprint);
+    return it == thresholds.end() ? defaultThresholdNs : it->second;
+}
+
+bool SlowQueryLog::wants(uint64_t fingerprint, uint64_t durationNs) {
+    // 快路径: 比所有阈值都快就不必查表
+    if (durationNs < minThresholdNs) {
+        return false;
+    }
+    return thresholds.empty() || durationNs >= thresholdFor(fingerprint);
+}
+
+void SlowQueryLog::onStatement(const StatementRecord &record) {
+    SlowQueryEvent event;
+    event.record = record;
+    event.thresholdNs = thresholdFor(record.fingerprint);
+    event.at = chrono::system_clock::now();
+    if (!ring.push(event)) {
+        droppedCount.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void SlowQueryLog::writeLoop() {
+    SlowQueryEvent event;
+    bool done = false;
+    while (!done) {
+        {
+            // 生产者不通知, 写线程每 50ms 醒来一次, 入队路径上没有锁也没有系统调用
+            unique_lock<mutex> guard(lock);
+            wake.wait_for(guard, chrono::milliseconds(50), [this] { return stopping; });
+            done = stopping;
+        }
+        bool wrote = false;
+        while (ring.pop(event)) {
+            string line = format(event);
+            fwrite(line.data(), 1, line.size(), out);
+            loggedCount.fetch_add(1, memory_order_relaxed);
+            wrote = true;
+        }
+        if (wrote) {
+            fflush(out);
+        }
+    }
+    uint64_t lost = droppedCount.load(memory_order_relaxed);
+    if (lost) {
+        fprintf(out, "slow_query_log dropped=%" PRIu64 "\n", lost);
+        fflush(out);
+    }
+}
+
+string SlowQueryLog::format(const SlowQueryEvent &event) const {
+    const StatementRecord &record = event.record;
+    uint64_t serverNs = std::min(record.dbNs, record.durationNs);
+    char text[256];
+    string line;
+    line.reserve(256 + record.sql.size());
+    appendUtcTimestamp(line, event.at);
+    snprintf(text, sizeof(text),
+             " slow_query fp=%s kind=%s elapsed_us=%" PRIu64 " server_us=%" PRIu64 " client_us=%" PRIu64
+             " threshold_us=%" PRIu64 " rows=%" PRIu64 " calls=%" PRIu64 " failed=%d binds=",
+             fingerprintHex(record.fingerprint).c_str(), record.kind == StatementKind::QUERY ? "query" : "update",
+             record.durationNs / 1000, serverNs / 1000, (record.durationNs - serverNs) / 1000,
+             event.thresholdNs / 1000, record.rows, record.calls, record.failed ? 1 : 0);
+    line += text;
+    if (redaction == BindRedaction::DROP) {
+        line += "dropped";
+    } else if (!record.bindsCaptured) {
+        line += "unsampled";
+    } else {
+        line += '[';
+        for (size_t i = 0; i < record.binds.size(); ++i) {
+            if (i) {
+                line += ' ';
+            }
+            appendBind(line, record.binds[i], redaction);
+        }
+        line += ']';
+    }
+    line += " sql=";
+    appendQuoted(line, redaction == BindRedaction::PLAIN ? record.sql : normalizeSql(record.sql));
+    line += '\n';
+    return line;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "mpsc_ring.h"
+#include "statement_probe.h"
+
+/**
+ * What the slow query log writes for bind values. MASK keeps the type and
+ * length ('***'(5), ?int), HASH a short FNV hash so equal values still line
+ * up across lines, DROP nothing. Anything but PLAIN also logs the normalized
+ * SQL instead of the text as executed, since literals carry data too.
+ */
+enum class BindRedaction {
+    PLAIN,
+    MASK,
+    HASH,
+    DROP
+};
+
+struct SlowQueryEvent {
+    StatementRecord record;
+    uint64_t thresholdNs = 0;
+    std::chrono::system_clock::time_point at;
+};
+
+/**
+ * Statement sink that logs executions slower than their threshold, one
+ * logfmt line each:
+ *
+ *   2026-10-19T08:15:02.114Z slow_query fp=3f1c... kind=query elapsed_us=182340 server_us=181900
+ *       client_us=440 threshold_us=100000 rows=12 calls=14 failed=0 binds=[1=?int] sql="SELECT ..."
+ *
+ * server_us is the time spent inside OCCI calls (dbCall: client library,
+ * network and server), client_us the rest of the statement's elapsed time,
+ * calls the number of OCCI calls it made.
+ *
+ * A fast statement costs the probe one threshold comparison: nothing is
+ * copied or formatted. A slow one is copied into a lock-free ring and a
+ * logger thread formats and writes it; when the ring is full the event is
+ * counted as dropped rather than waited for. Bind values are only captured
+ * for one execution in bindSample (per thread), so most slow lines say
+ * binds=unsampled.
+ */
+class SlowQueryLog : public StatementSink {
+public:
+    SlowQueryLog();
+
+    ~SlowQueryLog() override;
+
+    SlowQueryLog(const SlowQueryLog &) = delete;
+
+    SlowQueryLog &operator=(const SlowQueryLog &) = delete;
+
+    /**
+     * Configuration, before start() only.
+     */
+    void setDefaultThreshold(std::chrono::nanoseconds threshold);
+
+    void setThreshold(uint64_t fingerprint, std::chrono::nanoseconds threshold);
+
+    /**
+     * "3f1c0a2b4d5e6f70=250,0123456789abcdef=20": fingerprint hex = ms.
+     */
+    bool parseThresholds(const std::string &text);
+
+    void setRedaction(BindRedaction redaction);
+
+    /**
+     * Capture binds for one execution in n; 0 = never.
+     */
+    void setBindSample(unsigned int n);
+
+    /**
+     * "-" writes to stdout. Registers the log as a statement sink.
+     */
+    bool start(const std::string &path);
+
+    /**
+     * Unregisters, writes what is still queued and closes the file.
+     */
+    void stop();
+
+    bool wantsBinds() override;
+
+    bool wants(uint64_t fingerprint, uint64_t durationNs) override;
+
+    void onStatement(const StatementRecord &record) override;
+
+    uint64_t logged() const { return loggedCount.load(std::memory_order_relaxed); }
+
+    uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+    uint64_t thresholdFor(uint64_t fingerprint) const;
+
+    void writeLoop();
+
+    std::string format(const SlowQueryEvent &event) const;
+
+    FILE *out = nullptr;
+    uint64_t defaultThresholdNs;
+    uint64_t minThresholdNs;
+    std::unordered_map<uint64_t, uint64_t> thresholds;
+    BindRedaction redaction = BindRedaction::MASK;
+    unsigned int bindSample = 10;
+    MpscRing<SlowQueryEvent> ring;
+    std::atomic<uint64_t> loggedCount{0};
+    std::atomic<uint64_t> droppedCount{0};
+    std::mutex lock;
+    std::condition_variable wake;
+    std::thread writer;
+    bool stopping = false;
+};
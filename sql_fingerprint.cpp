@@ -0,0 +1,91 @@
+#include "sql_fingerprint.h"
+
+#include <cctype>
+
+using namespace std;
+
+static bool isIdentChar(char c) {
+    return isalnum((unsigned char) c) || c == '_' || c == '$' || c == '#';
+}
+
+string normalizeSql(const string &sql) {
+    string out;
+    out.reserve(sql.size());
+    size_t i = 0;
+    size_t n = sql.size();
+    bool space = false;
+    while (i < n) {
+        char c = sql[i];
+        if (isspace((unsigned char) c)) {
+            space = true;
+            ++i;
+            continue;
+        }
+        if (space && !out.empty()) {
+            out += ' ';
+        }
+        space = false;
+
+        if (c == '\'') {
+            // 字符串字面量, '' 是转义的单引号
+            ++i;
+            while (i < n) {
+                if (sql[i] == '\'') {
+                    if (i + 1 < n && sql[i + 1] == '\'') {
+                        i += 2;
+                        continue;
+                    }
+                    ++i;
+                    break;
+                }
+                ++i;
+            }
+            out += '?';
+        } else if (c == ':' && i + 1 < n && isIdentChar(sql[i + 1])) {
+            // 绑定变量 :x / :1
+            ++i;
+            while (i < n && isIdentChar(sql[i])) {
+                ++i;
+            }
+            out += '?';
+        } else if (isdigit((unsigned char) c) && (out.empty() || !isIdentChar(out.back()))) {
+            while (i < n && (isalnum((unsigned char) sql[i]) || sql[i] == '.')) {
+                ++i;
+            }
+            out += '?';
+        } else if (c == '"') {
+            // 带引号的标识符保持原样
+            size_t end = sql.find('"', i + 1);
+            end = end == string::npos ? n : end + 1;
+            out.append(sql, i, end - i);
+            i = end;
+        } else {
+            out += (char) toupper((unsigned char) c);
+            ++i;
+        }
+    }
+    return out;
+}
+
+uint64_t sqlFingerprint(const string &sql) {
+    return hashNormalizedSql(normalizeSql(sql));
+}
+
+uint64_t hashNormalizedSql(const string &normalized) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c: normalized) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+string fingerprintHex(uint64_t fingerprint) {
+    static const char digits[] = "0123456789abcdef";
+    string hex(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        hex[i] = digits[fingerprint & 0xf];
+        fingerprint >>= 4;
+    }
+    return hex;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Normalizes a statement so that executions differing only in literals, bind
+ * names, case or whitespace share one shape:
+ *   select * from t where id = 42 and name = 'x'  ->  SELECT * FROM T WHERE ID = ? AND NAME = ?
+ */
+std::string normalizeSql(const std::string &sql);
+
+/**
+ * 64-bit FNV-1a hash of normalizeSql(sql).
+ */
+uint64_t sqlFingerprint(const std::string &sql);
+
+/**
+ * The same hash for text that already went through normalizeSql().
+ */
+uint64_t hashNormalizedSql(const std::string &normalized);
+
+/**
+ * 16 hex digits, used as the label value for per-statement metrics.
+ */
+std::string fingerprintHex(uint64_t fingerprint);
@@ -0,0 +1,400 @@
+#pragma once
+
+/**
+ * In-process stand-in for the part of the OCCI API this program uses.
+ *
+ * Built with -DOCI_DEMO_STANDIN=ON the standin/ directory comes first on the
+ * include path, so <occi.h> resolves here instead of the Instant Client SDK
+ * and the same sources compile and run on any box without a server. Class,
+ * method and enum names follow occiControl.h/occiCommon.h; only the
+ * subset below exists, so code that compiles against it also compiles
+ * against the real SDK. Tables, latency and round trips are configured via
+ * StandinBackend (standin.h).
+ */
+
+#include <cstddef>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "oci.h"
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+namespace oracle {
+    namespace occi {
+
+        class Environment;
+
+        class Connection;
+
+        class StatelessConnectionPool;
+
+        class Statement;
+
+        class ResultSet;
+
+        enum Type {
+            OCCI_SQLT_CHR = 1,
+            OCCI_SQLT_NUM = 2,
+            OCCIINT = 3,
+            OCCIFLOAT = 4,
+            OCCI_SQLT_STR = 5,
+            OCCI_SQLT_VCS = 9,
+            OCCIBFLOAT = 21,
+            OCCIBDOUBLE = 22,
+            OCCIUNSIGNED_INT = 68,
+            OCCI_SQLT_AFC = 96,
+            OCCIIBFLOAT = 100,
+            OCCIIBDOUBLE = 101,
+
+            OCCICHAR = 32 * 1024,
+            OCCIDOUBLE,
+            OCCIBOOL,
+            OCCIANYDATA,
+            OCCINUMBER,
+            OCCIBLOB,
+            OCCIBFILE,
+            OCCIBYTES,
+            OCCICLOB,
+            OCCIVECTOR,
+            OCCIMETADATA,
+            OCCIPOBJECT,
+            OCCIREF,
+            OCCIREFANY,
+            OCCISTRING
+        };
+
+        typedef struct BFloat {
+            float value;
+            bool isNull;
+
+            BFloat() {
+                isNull = false;
+                value = 0.;
+            }
+        } BFloat;
+
+        typedef struct BDouble {
+            double value;
+            bool isNull;
+
+            BDouble() {
+                isNull = false;
+                value = 0.;
+            }
+        } BDouble;
+
+        class SQLException : public std::exception {
+        public:
+            SQLException();
+
+            /**
+             * Stand-in only: the real class is created by the client library.
+             */
+            SQLException(int errorCode, const std::string &message);
+
+            virtual int getErrorCode() const;
+
+            virtual std::string getMessage() const;
+
+            const char *what() const throw();
+
+            virtual ~SQLException() throw() {}
+
+        private:
+            int code;
+            std::string message;
+        };
+
+        /**
+         * Describe information for one select-list column.
+         */
+        class MetaData {
+        public:
+            enum AttrId {
+                ATTR_DATA_SIZE = 1,
+                ATTR_DATA_TYPE = 2,
+                ATTR_NAME = 4,
+                ATTR_PRECISION = 5,
+                ATTR_SCALE = 6,
+                ATTR_IS_NULL = 7,
+                ATTR_CHAR_SIZE = 286
+            };
+
+            /**
+             * Stand-in only.
+             */
+            MetaData(const std::string &name, int dataType, int dataSize);
+
+            int getInt(MetaData::AttrId attrid) const;
+
+            unsigned int getUInt(MetaData::AttrId attrid) const;
+
+            bool getBoolean(MetaData::AttrId attrid) const;
+
+            std::string getString(MetaData::AttrId attrid) const;
+
+        private:
+            std::string name;
+            int dataType;
+            int dataSize;
+        };
+
+        class ResultSet {
+        public:
+            enum Status {
+                END_OF_FETCH = 0,
+                DATA_AVAILABLE,
+                STREAM_DATA_AVAILABLE
+            };
+
+            virtual ~ResultSet() {}
+
+            virtual Status next(unsigned int numRows = 1) = 0;
+
+            virtual Status status() const = 0;
+
+            virtual unsigned int getNumArrayRows() const = 0;
+
+            virtual void cancel() = 0;
+
+            virtual void setMaxColumnSize(unsigned int colIndex, unsigned int max) = 0;
+
+            virtual bool isNull(unsigned int colIndex) const = 0;
+
+            virtual int getInt(unsigned int colIndex) = 0;
+
+            virtual unsigned int getUInt(unsigned int colIndex) = 0;
+
+            virtual float getFloat(unsigned int colIndex) = 0;
+
+            virtual double getDouble(unsigned int colIndex) = 0;
+
+            virtual std::string getString(unsigned int colIndex) = 0;
+
+            virtual BFloat getBFloat(unsigned int colIndex) = 0;
+
+            virtual BDouble getBDouble(unsigned int colIndex) = 0;
+
+            virtual void setDataBuffer(unsigned int colIndex, void *buffer, Type type,
+                                       sb4 size = 0, ub2 *length = NULL,
+                                       sb2 *ind = NULL, ub2 *rc = NULL) = 0;
+
+            virtual std::vector<MetaData> getColumnListMetaData() const = 0;
+
+            virtual Statement *getStatement() const = 0;
+
+            virtual void setPrefetchRowCount(unsigned int rowCount) = 0;
+
+            virtual void setPrefetchMemorySize(unsigned int bytes) = 0;
+        };
+
+        class Statement {
+        public:
+            enum Status {
+                UNPREPARED,
+                PREPARED,
+                RESULT_SET_AVAILABLE,
+                UPDATE_COUNT_AVAILABLE,
+                NEEDS_STREAM_DATA,
+                STREAM_DATA_AVAILABLE
+            };
+
+            virtual ~Statement() {}
+
+            virtual void setSQL(const std::string &sql) = 0;
+
+            virtual std::string getSQL() const = 0;
+
+            virtual Status execute(const std::string &sql = "") = 0;
+
+            virtual ResultSet *getResultSet() = 0;
+
+            virtual unsigned int getUpdateCount() const = 0;
+
+            virtual ResultSet *executeQuery(const std::string &sql = "") = 0;
+
+            virtual unsigned int executeUpdate(const std::string &sql = "") = 0;
+
+            virtual Status status() const = 0;
+
+            virtual void closeResultSet(ResultSet *resultSet) = 0;
+
+            virtual void setPrefetchRowCount(unsigned int rowCount) = 0;
+
+            virtual void setPrefetchMemorySize(unsigned int bytes) = 0;
+
+            virtual void setAutoCommit(bool autoCommit) = 0;
+
+            virtual bool getAutoCommit() const = 0;
+
+            virtual void setMaxParamSize(unsigned int paramIndex, unsigned int maxSize) = 0;
+
+            virtual void setNull(unsigned int paramIndex, Type type) = 0;
+
+            virtual void setInt(unsigned int paramIndex, int x) = 0;
+
+            virtual void setUInt(unsigned int paramIndex, unsigned int x) = 0;
+
+            virtual void setFloat(unsigned int paramIndex, float x) = 0;
+
+            virtual void setDouble(unsigned int paramIndex, double x) = 0;
+
+            virtual void setString(unsigned int paramIndex, const std::string &x) = 0;
+
+            virtual void setBFloat(unsigned int paramIndex, const BFloat &fval) = 0;
+
+            virtual void setBDouble(unsigned int paramIndex, const BDouble &dval) = 0;
+
+            virtual void setDataBuffer(unsigned int paramIndex, void *buffer, Type type,
+                                       sb4 size, ub2 *length, sb2 *ind = NULL,
+                                       ub2 *rc = NULL) = 0;
+
+            virtual void setMaxIterations(unsigned int maxIterations) = 0;
+
+            virtual unsigned int getMaxIterations() const = 0;
+
+            virtual void addIteration() = 0;
+
+            virtual unsigned int getCurrentIteration() const = 0;
+
+            virtual Status executeArrayUpdate(unsigned int arrayLength) = 0;
+
+            virtual Connection *getConnection() const = 0;
+        };
+
+        class Connection {
+        public:
+            virtual ~Connection() {}
+
+            virtual Statement *createStatement(const std::string &sql = "") = 0;
+
+            virtual void terminateStatement(Statement *statement) = 0;
+
+            virtual void commit() = 0;
+
+            virtual void rollback() = 0;
+
+            virtual void setStmtCacheSize(unsigned int cacheSize) = 0;
+
+            virtual unsigned int getStmtCacheSize() const = 0;
+
+            virtual std::string getServerVersion() const = 0;
+
+            virtual void cancel() = 0;
+
+            virtual OCISvcCtx *getOCIServiceContext() const = 0;
+
+            virtual OCIServer *getOCIServer() const = 0;
+        };
+
+        class StatelessConnectionPool {
+        public:
+            enum PoolType {
+                HETEROGENEOUS = 0,
+                HOMOGENEOUS = 1,
+                NO_RLB = 4,
+                USES_EXT_AUTH = 16
+            };
+
+            enum BusyOption {
+                WAIT = 0,
+                NOWAIT = 1,
+                FORCEGET = 2
+            };
+
+            enum DestroyMode {
+                DEFAULT = 0,
+                SPD_FORCE = 1
+            };
+
+            virtual ~StatelessConnectionPool() {}
+
+            virtual unsigned int getBusyConnections() const = 0;
+
+            virtual unsigned int getOpenConnections() const = 0;
+
+            virtual unsigned int getMinConnections() const = 0;
+
+            virtual unsigned int getMaxConnections() const = 0;
+
+            virtual unsigned int getIncrConnections() const = 0;
+
+            virtual std::string getPoolName() const = 0;
+
+            virtual unsigned int getTimeOut() const = 0;
+
+            virtual void setBusyOption(BusyOption busyOption) = 0;
+
+            virtual BusyOption getBusyOption() const = 0;
+
+            virtual void setTimeOut(unsigned int connTimeOut = 0) = 0;
+
+            virtual void setPoolSize(unsigned int maxConn = 1,
+                                     unsigned int minConn = 0, unsigned int incrConn = 1) = 0;
+
+            virtual Connection *getConnection(const std::string &tag = "") = 0;
+
+            virtual void releaseConnection(Connection *connection, const std::string &tag = "") = 0;
+
+            virtual void terminateConnection(Connection *connection) = 0;
+
+            virtual void setStmtCacheSize(unsigned int cacheSize) = 0;
+
+            virtual unsigned int getStmtCacheSize() const = 0;
+        };
+
+        class Environment {
+        public:
+            enum Mode {
+                DEFAULT = 0,
+                OBJECT = 2,
+                NO_USERCALLBACKS = 0x40,
+                THREADED_MUTEXED = 1,
+                THREADED_UNMUTEXED = 1 | 0x80,
+                EVENTS = 4,
+                USE_LDAP = 0x10000
+            };
+
+            virtual ~Environment() {}
+
+            static Environment *createEnvironment(
+                    Mode mode = DEFAULT,
+                    void *ctxp = 0,
+                    void *(*malocfp)(void *ctxp, size_t size) = 0,
+                    void *(*ralocfp)(void *ctxp, void *memptr, size_t newsize) = 0,
+                    void (*mfreefp)(void *ctxp, void *memptr) = 0);
+
+            static void terminateEnvironment(Environment *env);
+
+            virtual Connection *createConnection(
+                    const std::string &userName,
+                    const std::string &password,
+                    const std::string &connectString = "") = 0;
+
+            virtual void terminateConnection(Connection *connection) = 0;
+
+            virtual unsigned int getCurrentHeapSize() const = 0;
+
+            virtual OCIEnv *getOCIEnvironment() const = 0;
+
+            virtual StatelessConnectionPool *createStatelessConnectionPool(
+                    const std::string &poolUserName,
+                    const std::string &poolPassword,
+                    const std::string &connectString = "",
+                    unsigned int maxConn = 1, unsigned int minConn = 0,
+                    unsigned int incrConn = 1,
+                    StatelessConnectionPool::PoolType pType
+                    = StatelessConnectionPool::HETEROGENEOUS) = 0;
+
+            virtual void terminateStatelessConnectionPool(
+                    StatelessConnectionPool *poolp,
+                    StatelessConnectionPool::DestroyMode mode = StatelessConnectionPool::DEFAULT) = 0;
+        };
+
+    } // namespace occi
+} // namespace oracle
@@ -0,0 +1,98 @@
+#pragma once
+
+/**
+ * Stand-in for the part of the OCI C API that db_result.cpp uses.
+ *
+ * Like standin/occi.h it shadows the SDK header when standin/ is first on
+ * the include path; names, constants and signatures are those of oci.h /
+ * ociap.h. Handles obtained from the OCCI stand-in (getOCIEnvironment,
+ * getOCIServiceContext, getOCIServer) are the stand-in objects themselves,
+ * and the statement calls drive the stand-in Statement/ResultSet underneath.
+ * Errors come back as status codes plus an error handle, as in the real
+ * library. OCI_ATTR_NONBLOCKING_MODE on the server handle is emulated too:
+ * execute and fetch then return OCI_STILL_EXECUTING until the injected
+ * server time has passed.
+ */
+
+#include <cstddef>
+
+typedef unsigned char ub1;
+typedef signed char sb1;
+typedef unsigned short ub2;
+typedef signed short sb2;
+typedef unsigned int ub4;
+typedef signed int sb4;
+typedef signed int sword;
+typedef unsigned char oratext;
+typedef oratext OraText;
+
+typedef struct OCIEnv OCIEnv;
+typedef struct OCIError OCIError;
+typedef struct OCISvcCtx OCISvcCtx;
+typedef struct OCIServer OCIServer;
+typedef struct OCIStmt OCIStmt;
+typedef struct OCIBind OCIBind;
+typedef struct OCIDefine OCIDefine;
+typedef struct OCISnapshot OCISnapshot;
+
+#define OCI_SUCCESS 0
+#define OCI_SUCCESS_WITH_INFO 1
+#define OCI_NO_DATA 100
+#define OCI_ERROR -1
+#define OCI_INVALID_HANDLE -2
+#define OCI_STILL_EXECUTING -3123
+
+#define OCI_HTYPE_ERROR 2
+#define OCI_HTYPE_SVCCTX 3
+#define OCI_HTYPE_STMT 4
+#define OCI_HTYPE_SERVER 8
+
+#define OCI_DEFAULT 0x00000000
+#define OCI_COMMIT_ON_SUCCESS 0x00000020
+#define OCI_NTV_SYNTAX 1
+#define OCI_FETCH_NEXT 0x00000002
+
+#define OCI_ATTR_NONBLOCKING_MODE 3
+#define OCI_ATTR_ROW_COUNT 9
+
+#define SQLT_CHR 1
+#define SQLT_INT 3
+#define SQLT_FLT 4
+#define SQLT_STR 5
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+sword OCIHandleAlloc(const void *parenth, void **hndlpp, const ub4 type, const size_t xtramem_sz,
+                     void **usrmempp);
+
+sword OCIHandleFree(void *hndlp, const ub4 type);
+
+sword OCIErrorGet(void *hndlp, ub4 recordno, OraText *sqlstate, sb4 *errcodep, OraText *bufp, ub4 bufsiz,
+                  ub4 type);
+
+sword OCIStmtPrepare2(OCISvcCtx *svchp, OCIStmt **stmtp, OCIError *errhp, const OraText *stmt, ub4 stmt_len,
+                      const OraText *key, ub4 key_len, ub4 language, ub4 mode);
+
+sword OCIStmtRelease(OCIStmt *stmtp, OCIError *errhp, const OraText *key, ub4 key_len, ub4 mode);
+
+sword OCIBindByPos(OCIStmt *stmtp, OCIBind **bindp, OCIError *errhp, ub4 position, void *valuep, sb4 value_sz,
+                   ub2 dty, void *indp, ub2 *alenp, ub2 *rcodep, ub4 maxarr_len, ub4 *curelep, ub4 mode);
+
+sword OCIDefineByPos(OCIStmt *stmtp, OCIDefine **defnp, OCIError *errhp, ub4 position, void *valuep,
+                     sb4 value_sz, ub2 dty, void *indp, ub2 *rlenp, ub2 *rcodep, ub4 mode);
+
+sword OCIStmtExecute(OCISvcCtx *svchp, OCIStmt *stmtp, OCIError *errhp, ub4 iters, ub4 rowoff,
+                     const OCISnapshot *snap_in, OCISnapshot *snap_out, ub4 mode);
+
+sword OCIStmtFetch2(OCIStmt *stmtp, OCIError *errhp, ub4 nrows, ub2 orientation, sb4 scrollOffset, ub4 mode);
+
+sword OCIAttrGet(const void *trgthndlp, ub4 trghndltyp, void *attributep, ub4 *sizep, ub4 attrtype,
+                 OCIError *errhp);
+
+sword OCIAttrSet(void *trgthndlp, ub4 trghndltyp, void *attributep, ub4 size, ub4 attrtype, OCIError *errhp);
+
+#ifdef __cplusplus
+}
+#endif
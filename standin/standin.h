@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * DATE values are kept as 'YYYY-MM-DD HH24:MI:SS' text and described like
+ * Oracle's (SQLT_DAT, data size 7); generated ones are low + n days since
+ * 1970-01-01.
+ */
+enum class StandinType {
+    NUMBER,
+    VARCHAR,
+    BINARY_FLOAT,
+    BINARY_DOUBLE,
+    DATE
+};
+
+/**
+ * How generated values are spread over [low, high]:
+ * SEQUENCE is low + row index, ZIPF favours values near low.
+ */
+enum class StandinDistribution {
+    SEQUENCE,
+    UNIFORM,
+    ZIPF,
+    CONSTANT
+};
+
+struct StandinColumn {
+    std::string name;
+    StandinType type;
+    StandinDistribution distribution;
+    double low;
+    double high;
+    // VARCHAR: declared size, generated values are padded to it
+    unsigned int width;
+};
+
+/**
+ * A synthetic table: `rows` rows generated on the fly from the column
+ * specs, so a table of millions of rows costs no memory until DML touches it.
+ */
+struct StandinTableSpec {
+    std::string name;
+    uint64_t rows;
+    std::vector<StandinColumn> columns;
+    uint64_t seed;
+};
+
+/**
+ * Injected server-side time. Every round trip costs roundTrip plus perRow
+ * for each row it carries; the first execution of a statement that did not
+ * come from the statement cache also pays parse.
+ */
+struct StandinLatency {
+    std::chrono::nanoseconds roundTrip{0};
+    std::chrono::nanoseconds perRow{0};
+    std::chrono::nanoseconds parse{0};
+    std::chrono::nanoseconds connect{0};
+};
+
+struct StandinTable;
+
+/**
+ * The process-wide "database" behind the stand-in OCCI classes.
+ *
+ * reset() (run on first use) creates DUAL, ALL_USERS and BENCH_TAB
+ * (OCI_DEMO_STANDIN_ROWS rows, default 1000) and takes the round-trip
+ * latency from OCI_DEMO_STANDIN_LATENCY_US.
+ */
+class StandinBackend {
+public:
+    static StandinBackend &instance();
+
+    /**
+     * Creates or replaces a table.
+     */
+    void defineTable(const StandinTableSpec &spec);
+
+    bool dropTable(const std::string &name);
+
+    void setLatency(const StandinLatency &latency);
+
+    /**
+     * Latency for sessions opened against one connect string, e.g. a slow replica.
+     */
+    void setLatency(const std::string &connectString, const StandinLatency &latency);
+
+    StandinLatency latency(const std::string &connectString) const;
+
+    /**
+     * Round trips made by every session so far.
+     */
+    uint64_t roundTrips() const;
+
+    void reset();
+
+    std::shared_ptr<StandinTable> table(const std::string &name) const;
+
+    bool createTable(const std::string &name, const std::vector<StandinColumn> &columns);
+
+    void countRoundTrip();
+
+    StandinBackend(const StandinBackend &) = delete;
+
+    StandinBackend &operator=(const StandinBackend &) = delete;
+
+private:
+    StandinBackend();
+
+    mutable std::mutex lock;
+    std::map<std::string, std::shared_ptr<StandinTable>> tables;
+    StandinLatency defaultLatency;
+    std::map<std::string, StandinLatency> endpointLatency;
+    std::atomic<uint64_t> trips;
+};
+
+namespace oracle {
+    namespace occi {
+        class Connection;
+    }
+}
+
+/**
+ * OCI_ATTR_NONBLOCKING_MODE of one stand-in session, for standin_oci.cpp.
+ * In non-blocking mode a round trip does not sleep; its cost is added to
+ * the time the session stays busy, which the OCI shim polls against.
+ */
+void standinSetNonBlocking(oracle::occi::Connection *conn, bool on);
+
+bool standinNonBlocking(const oracle::occi::Connection *conn);
+
+std::chrono::steady_clock::time_point standinBusyUntil(const oracle::occi::Connection *conn);
@@ -0,0 +1,2085 @@
+#include "occi.h"
+#include "standin.h"
+#include "alloc_tracker.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <shared_mutex>
+#include <thread>
+
+using namespace std;
+using namespace oracle::occi;
+
+struct StandinCell {
+    double number = 0;
+    string text;
+    bool isNull = false;
+};
+
+typedef vector<StandinCell> StandinRow;
+
+struct StandinTable {
+    shared_mutex lock;
+    StandinTableSpec spec;
+    // 前 generated 行按 spec 现算, 之后是 DML 写入的行
+    uint64_t generated = 0;
+    vector<StandinRow> rows;
+};
+
+static void fail(int code, const char *text) {
+    char message[256];
+    snprintf(message, sizeof(message), "ORA-%05d: %s", code, text);
+    throw SQLException(code, message);
+}
+
+static string upper(string text) {
+    for (auto &c: text) {
+        c = (char) toupper((unsigned char) c);
+    }
+    return text;
+}
+
+static bool isNumeric(StandinType type) {
+    return type != StandinType::VARCHAR && type != StandinType::DATE;
+}
+
+static string formatNumber(double value) {
+    char text[64];
+    if (value == floor(value) && fabs(value) < 1e15) {
+        snprintf(text, sizeof(text), "%lld", (long long) value);
+    } else {
+        snprintf(text, sizeof(text), "%.15g", value);
+    }
+    return text;
+}
+
+static double parseNumber(const StandinCell &cell) {
+    if (cell.text.empty()) {
+        return cell.number;
+    }
+    char *end = nullptr;
+    double value = strtod(cell.text.c_str(), &end);
+    if (end == cell.text.c_str()) {
+        fail(1722, "invalid number");
+    }
+    return value;
+}
+
+static string cellText(const StandinCell &cell, StandinType type) {
+    return isNumeric(type) ? formatNumber(cell.number) : cell.text;
+}
+
+/**
+ * Converts a bind or literal to the column's storage type.
+ */
+static StandinCell coerce(const StandinCell &value, StandinType type) {
+    StandinCell cell;
+    if (value.isNull) {
+        cell.isNull = true;
+    } else if (isNumeric(type)) {
+        cell.number = parseNumber(value);
+    } else {
+        // 空串在 Oracle 里就是 NULL, 所以 text 为空说明绑定的是数值
+        cell.text = value.text.empty() ? formatNumber(value.number) : value.text;
+    }
+    return cell;
+}
+
+static uint64_t mix(uint64_t x) {
+    // splitmix64
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static StandinCell generateCell(const StandinTableSpec &spec, size_t column, uint64_t row) {
+    const StandinColumn &c = spec.columns[column];
+    double u = (double) (mix(spec.seed * 1000003ULL + row * 131ULL + column) >> 11) / (double) (1ULL << 53);
+    double value;
+    switch (c.distribution) {
+        case StandinDistribution::SEQUENCE:
+            value = c.low + (double) row;
+            break;
+        case StandinDistribution::UNIFORM:
+            value = c.low + u * (c.high - c.low);
+            if (c.type == StandinType::NUMBER || c.type == StandinType::VARCHAR) {
+                value = floor(c.low + u * (c.high - c.low + 1));
+            }
+            break;
+        case StandinDistribution::ZIPF:
+            // 近似 s=1 的 Zipf: 排名的对数均匀分布
+            value = c.low + floor(exp(u * log(c.high - c.low + 2)) - 1);
+            break;
+        default:
+            value = c.low;
+            break;
+    }
+
+    StandinCell cell;
+    if (c.type == StandinType::DATE) {
+        // 1970-01-01 起第 value 天, 换算见 Howard Hinnant 的 civil_from_days
+        long long z = (long long) floor(value) + 719468;
+        long long era = (z >= 0 ? z : z - 146096) / 146097;
+        long long doe = z - era * 146097;
+        long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        long long mp = (5 * doy + 2) / 153;
+        long long day = doy - (153 * mp + 2) / 5 + 1;
+        long long month = mp < 10 ? mp + 3 : mp - 9;
+        long long year = yoe + era * 400 + (month <= 2);
+        char text[32];
+        snprintf(text, sizeof(text), "%04lld-%02lld-%02lld 00:00:00", year, month, day);
+        cell.text = text;
+    } else if (c.type == StandinType::VARCHAR) {
+        char text[64];
+        snprintf(text, sizeof(text), "%.3s%lld", c.name.c_str(), (long long) value);
+        cell.text = text;
+        if (c.width > cell.text.size()) {
+            cell.text.resize(c.width, 'x');
+        } else if (c.width && c.width < cell.text.size()) {
+            cell.text.resize(c.width);
+        }
+    } else if (c.type == StandinType::BINARY_FLOAT) {
+        cell.number = (float) value;
+    } else {
+        cell.number = value;
+    }
+    return cell;
+}
+
+static StandinRow generateRow(const StandinTableSpec &spec, uint64_t row) {
+    StandinRow cells;
+    cells.reserve(spec.columns.size());
+    for (size_t i = 0; i < spec.columns.size(); ++i) {
+        cells.push_back(generateCell(spec, i, row));
+    }
+    return cells;
+}
+
+static void materialize(StandinTable &table) {
+    if (table.generated == 0) {
+        return;
+    }
+    vector<StandinRow> rows;
+    rows.reserve(table.generated + table.rows.size());
+    for (uint64_t i = 0; i < table.generated; ++i) {
+        rows.push_back(generateRow(table.spec, i));
+    }
+    for (auto &row: table.rows) {
+        rows.push_back(std::move(row));
+    }
+    table.rows = std::move(rows);
+    table.generated = 0;
+}
+
+static unsigned int columnBytes(const StandinColumn &column) {
+    switch (column.type) {
+        case StandinType::NUMBER:
+            return 22;
+        case StandinType::BINARY_FLOAT:
+            return 4;
+        case StandinType::BINARY_DOUBLE:
+            return 8;
+        case StandinType::DATE:
+            return 7;
+        default:
+            return column.width ? column.width : 4000;
+    }
+}
+
+// ---------------------------------------------------------------- SQL
+
+enum class TokenType {
+    IDENT,
+    NUMBER,
+    STRING,
+    BIND,
+    SYMBOL,
+    END
+};
+
+struct Token {
+    TokenType type;
+    string text;
+};
+
+static vector<Token> tokenize(const string &sql) {
+    vector<Token> tokens;
+    size_t i = 0;
+    size_t n = sql.size();
+    while (i < n) {
+        char c = sql[i];
+        if (isspace((unsigned char) c)) {
+            ++i;
+        } else if (c == '-' && i + 1 < n && sql[i + 1] == '-') {
+            while (i < n && sql[i] != '\n') {
+                ++i;
+            }
+        } else if (isalpha((unsigned char) c) || c == '_') {
+            size_t start = i;
+            while (i < n && (isalnum((unsigned char) sql[i]) || strchr("_$#.", sql[i]))) {
+                ++i;
+            }
+            tokens.push_back({TokenType::IDENT, upper(sql.substr(start, i - start))});
+        } else if (c == '"') {
+            size_t end = sql.find('"', i + 1);
+            if (end == string::npos) {
+                fail(1740, "missing double quote in identifier");
+            }
+            tokens.push_back({TokenType::IDENT, sql.substr(i + 1, end - i - 1)});
+            i = end + 1;
+        } else if (isdigit((unsigned char) c) || (c == '.' && i + 1 < n && isdigit((unsigned char) sql[i + 1]))) {
+            size_t start = i;
+            while (i < n && (isdigit((unsigned char) sql[i]) || sql[i] == '.' || sql[i] == 'e' || sql[i] == 'E')) {
+                ++i;
+            }
+            tokens.push_back({TokenType::NUMBER, sql.substr(start, i - start)});
+        } else if (c == '\'') {
+            string text;
+            ++i;
+            while (true) {
+                if (i >= n) {
+                    fail(1756, "quoted string not properly terminated");
+                }
+                if (sql[i] == '\'') {
+                    if (i + 1 < n && sql[i + 1] == '\'') {
+                        text += '\'';
+                        i += 2;
+                        continue;
+                    }
+                    ++i;
+                    break;
+                }
+                text += sql[i++];
+            }
+            tokens.push_back({TokenType::STRING, text});
+        } else if (c == ':') {
+            size_t start = ++i;
+            while (i < n && (isalnum((unsigned char) sql[i]) || sql[i] == '_')) {
+                ++i;
+            }
+            tokens.push_back({TokenType::BIND, sql.substr(start, i - start)});
+        } else {
+            string symbol(1, c);
+            if (i + 1 < n && ((c == '<' && (sql[i + 1] == '=' || sql[i + 1] == '>')) ||
+                              ((c == '>' || c == '!') && sql[i + 1] == '='))) {
+                symbol += sql[i + 1];
+            }
+            i += symbol.size();
+            tokens.push_back({TokenType::SYMBOL, symbol});
+        }
+    }
+    tokens.push_back({TokenType::END, ""});
+    return tokens;
+}
+
+enum class SqlKind {
+    SELECT,
+    STAT,
+    INSERT,
+    UPDATE,
+    DELETE,
+    CREATE,
+    DROP,
+    NOOP
+};
+
+/**
+ * A literal, or the n-th bind placeholder of the statement (OCCI binds by position).
+ */
+struct Operand {
+    int bind = -1;
+    StandinCell literal;
+};
+
+struct Condition {
+    // -1 是 ROWNUM
+    int column;
+    string op;
+    Operand value;
+};
+
+struct SelectItem {
+    int column = -1;
+    Operand value;
+    string name;
+    StandinType type = StandinType::NUMBER;
+    unsigned int width = 0;
+};
+
+struct Plan {
+    SqlKind kind = SqlKind::NOOP;
+    string tableName;
+    shared_ptr<StandinTable> table;
+    vector<SelectItem> items;
+    bool count = false;
+    vector<Condition> where;
+    vector<int> columns;
+    vector<Operand> values;
+    vector<StandinColumn> create;
+};
+
+class SqlParser {
+public:
+    explicit SqlParser(const string &sql) : tokens(tokenize(sql)), pos(0), binds(0) {}
+
+    Plan parse() {
+        Plan plan;
+        if (accept("SELECT") || accept("WITH")) {
+            parseSelect(plan);
+        } else if (accept("INSERT")) {
+            parseInsert(plan);
+        } else if (accept("UPDATE")) {
+            parseUpdate(plan);
+        } else if (accept("DELETE")) {
+            parseDelete(plan);
+        } else if (accept("CREATE")) {
+            parseCreate(plan);
+        } else if (accept("DROP")) {
+            expect("TABLE");
+            plan.kind = SqlKind::DROP;
+            plan.tableName = identifier();
+        } else if (accept("COMMIT") || accept("ROLLBACK") || accept("ALTER") || accept("BEGIN")) {
+            plan.kind = SqlKind::NOOP;
+        } else {
+            fail(900, "invalid SQL statement");
+        }
+        return plan;
+    }
+
+private:
+    const Token &peek() const { return tokens[pos]; }
+
+    bool accept(const char *word) {
+        if (peek().type != TokenType::END && peek().type != TokenType::STRING && peek().text == word) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(const char *word) {
+        if (!accept(word)) {
+            char text[128];
+            snprintf(text, sizeof(text), "missing %s near '%s'", word, peek().text.c_str());
+            fail(900, text);
+        }
+    }
+
+    string identifier() {
+        if (peek().type != TokenType::IDENT) {
+            fail(903, "invalid table name");
+        }
+        return tokens[pos++].text;
+    }
+
+    static string stripAlias(const string &name) {
+        size_t dot = name.rfind('.');
+        return dot == string::npos ? name : name.substr(dot + 1);
+    }
+
+    shared_ptr<StandinTable> lookup(const string &name) {
+        auto table = StandinBackend::instance().table(name);
+        if (!table) {
+            fail(942, "table or view does not exist");
+        }
+        return table;
+    }
+
+    static int columnIndex(const StandinTable &table, const string &name) {
+        for (size_t i = 0; i < table.spec.columns.size(); ++i) {
+            if (upper(table.spec.columns[i].name) == name) {
+                return (int) i;
+            }
+        }
+        fail(904, ("\"" + name + "\": invalid identifier").c_str());
+        return -1;
+    }
+
+    Operand operand() {
+        Operand value;
+        const Token &token = tokens[pos++];
+        if (token.type == TokenType::BIND) {
+            value.bind = binds++;
+        } else if (token.type == TokenType::NUMBER) {
+            value.literal.number = strtod(token.text.c_str(), nullptr);
+        } else if (token.type == TokenType::SYMBOL && token.text == "-" && peek().type == TokenType::NUMBER) {
+            value.literal.number = -strtod(tokens[pos++].text.c_str(), nullptr);
+        } else if (token.type == TokenType::STRING) {
+            value.literal.text = token.text;
+            value.literal.isNull = token.text.empty();
+        } else if (token.type == TokenType::IDENT && token.text == "NULL") {
+            value.literal.isNull = true;
+        } else {
+            fail(936, "missing expression");
+        }
+        return value;
+    }
+
+    void parseWhere(Plan &plan) {
+        if (!accept("WHERE")) {
+            return;
+        }
+        do {
+            string name = stripAlias(identifier());
+            Condition condition;
+            condition.column = name == "ROWNUM" ? -1 : columnIndex(*plan.table, name);
+            if (peek().type != TokenType::SYMBOL) {
+                fail(920, "invalid relational operator");
+            }
+            condition.op = tokens[pos++].text;
+            if (condition.op == "!=") {
+                condition.op = "<>";
+            }
+            condition.value = operand();
+            plan.where.push_back(condition);
+        } while (accept("AND"));
+    }
+
+    void parseSelect(Plan &plan) {
+        plan.kind = SqlKind::SELECT;
+        struct RawItem {
+            bool star = false;
+            bool count = false;
+            string column;
+            Operand value;
+            string name;
+        };
+        vector<RawItem> raw;
+        do {
+            RawItem item;
+            if (accept("*")) {
+                item.star = true;
+            } else if (accept("COUNT")) {
+                expect("(");
+                while (!accept(")")) {
+                    if (peek().type == TokenType::END) {
+                        fail(907, "missing right parenthesis");
+                    }
+                    ++pos;
+                }
+                item.count = true;
+                item.name = "COUNT(*)";
+            } else if (peek().type == TokenType::IDENT) {
+                item.column = stripAlias(identifier());
+                item.name = item.column;
+            } else {
+                const Token &token = peek();
+                item.name = token.text;
+                item.value = operand();
+            }
+            if (accept("AS") || (peek().type == TokenType::IDENT && peek().text != "FROM")) {
+                item.name = identifier();
+            }
+            raw.push_back(item);
+        } while (accept(","));
+
+        expect("FROM");
+        do {
+            string name = identifier();
+            if (name == "V$MYSTAT" || name == "V$STATNAME" || name == "V$SESSTAT") {
+                plan.kind = SqlKind::STAT;
+            }
+            if (plan.tableName.empty() || plan.kind == SqlKind::STAT) {
+                plan.tableName = name;
+            }
+            if (peek().type == TokenType::IDENT && peek().text != "WHERE" && peek().text != "ORDER" &&
+                peek().text != "GROUP" && peek().text != "FOR") {
+                ++pos;
+            }
+        } while (accept(","));
+        if (plan.kind == SqlKind::STAT) {
+            return;
+        }
+
+        plan.table = lookup(plan.tableName);
+        shared_lock<shared_mutex> guard(plan.table->lock);
+        const StandinTableSpec &spec = plan.table->spec;
+        for (const auto &item: raw) {
+            if (item.star) {
+                for (size_t i = 0; i < spec.columns.size(); ++i) {
+                    SelectItem select;
+                    select.column = (int) i;
+                    select.name = upper(spec.columns[i].name);
+                    select.type = spec.columns[i].type;
+                    select.width = spec.columns[i].width;
+                    plan.items.push_back(select);
+                }
+            } else if (item.count) {
+                plan.count = true;
+                SelectItem select;
+                select.name = item.name;
+                plan.items.push_back(select);
+            } else if (!item.column.empty()) {
+                SelectItem select;
+                select.column = columnIndex(*plan.table, item.column);
+                select.name = item.name;
+                select.type = spec.columns[select.column].type;
+                select.width = spec.columns[select.column].width;
+                plan.items.push_back(select);
+            } else {
+                SelectItem select;
+                select.value = item.value;
+                select.name = item.name;
+                select.type = item.value.literal.text.empty() ? StandinType::NUMBER : StandinType::VARCHAR;
+                select.width = (unsigned int) item.value.literal.text.size();
+                plan.items.push_back(select);
+            }
+        }
+        parseWhere(plan);
+    }
+
+    void parseInsert(Plan &plan) {
+        plan.kind = SqlKind::INSERT;
+        expect("INTO");
+        plan.tableName = identifier();
+        plan.table = lookup(plan.tableName);
+        shared_lock<shared_mutex> guard(plan.table->lock);
+        if (accept("(")) {
+            do {
+                plan.columns.push_back(columnIndex(*plan.table, stripAlias(identifier())));
+            } while (accept(","));
+            expect(")");
+        } else {
+            for (size_t i = 0; i < plan.table->spec.columns.size(); ++i) {
+                plan.columns.push_back((int) i);
+            }
+        }
+        expect("VALUES");
+        expect("(");
+        do {
+            plan.values.push_back(operand());
+        } while (accept(","));
+        expect(")");
+        if (plan.values.size() < plan.columns.size()) {
+            fail(947, "not enough values");
+        }
+        if (plan.values.size() > plan.columns.size()) {
+            fail(913, "too many values");
+        }
+    }
+
+    void parseUpdate(Plan &plan) {
+        plan.kind = SqlKind::UPDATE;
+        plan.tableName = identifier();
+        plan.table = lookup(plan.tableName);
+        shared_lock<shared_mutex> guard(plan.table->lock);
+        expect("SET");
+        do {
+            plan.columns.push_back(columnIndex(*plan.table, stripAlias(identifier())));
+            expect("=");
+            plan.values.push_back(operand());
+        } while (accept(","));
+        parseWhere(plan);
+    }
+
+    void parseDelete(Plan &plan) {
+        plan.kind = SqlKind::DELETE;
+        accept("FROM");
+        plan.tableName = identifier();
+        plan.table = lookup(plan.tableName);
+        shared_lock<shared_mutex> guard(plan.table->lock);
+        parseWhere(plan);
+    }
+
+    void parseCreate(Plan &plan) {
+        plan.kind = SqlKind::CREATE;
+        expect("TABLE");
+        plan.tableName = identifier();
+        expect("(");
+        do {
+            StandinColumn column{identifier(), StandinType::NUMBER, StandinDistribution::CONSTANT, 0, 0, 0};
+            string type = identifier();
+            if (type == "DATE") {
+                column.type = StandinType::DATE;
+            } else if (type.find("CHAR") != string::npos || type == "CLOB") {
+                column.type = StandinType::VARCHAR;
+                column.width = 4000;
+            } else if (type == "BINARY_FLOAT") {
+                column.type = StandinType::BINARY_FLOAT;
+            } else if (type == "BINARY_DOUBLE" || type == "FLOAT") {
+                column.type = StandinType::BINARY_DOUBLE;
+            }
+            // 跳过长度和约束, 直到下一列
+            int depth = 0;
+            bool sized = false;
+            while (peek().type != TokenType::END && !(depth == 0 && (peek().text == "," || peek().text == ")"))) {
+                if (peek().text == "(") {
+                    ++depth;
+                } else if (peek().text == ")") {
+                    --depth;
+                } else if (depth == 1 && !sized && peek().type == TokenType::NUMBER &&
+                           column.type == StandinType::VARCHAR) {
+                    column.width = (unsigned int) atoi(peek().text.c_str());
+                    sized = true;
+                }
+                ++pos;
+            }
+            plan.create.push_back(column);
+        } while (accept(","));
+        expect(")");
+    }
+
+    vector<Token> tokens;
+    size_t pos;
+    int binds;
+};
+
+static StandinCell resolve(const Operand &operand, const StandinRow &binds) {
+    if (operand.bind < 0) {
+        return operand.literal;
+    }
+    if ((size_t) operand.bind >= binds.size()) {
+        fail(1008, "not all variables bound");
+    }
+    return binds[operand.bind];
+}
+
+static bool matches(const StandinCell &cell, StandinType type, const string &op, const StandinCell &value) {
+    if (cell.isNull || value.isNull) {
+        return false;
+    }
+    int cmp;
+    if (isNumeric(type)) {
+        double a = cell.number;
+        double b = parseNumber(value);
+        cmp = a < b ? -1 : (a > b ? 1 : 0);
+    } else {
+        string b = value.text.empty() ? formatNumber(value.number) : value.text;
+        cmp = cell.text.compare(b);
+    }
+    if (op == "=") {
+        return cmp == 0;
+    } else if (op == "<>") {
+        return cmp != 0;
+    } else if (op == "<") {
+        return cmp < 0;
+    } else if (op == "<=") {
+        return cmp <= 0;
+    } else if (op == ">") {
+        return cmp > 0;
+    } else if (op == ">=") {
+        return cmp >= 0;
+    }
+    fail(920, "invalid relational operator");
+    return false;
+}
+
+/**
+ * Server-side state of an open query: walks generated rows, then stored rows,
+ * applying the WHERE clause as rows are fetched.
+ */
+class StandinCursor {
+public:
+    StandinCursor(const Plan &plan, const StandinRow &binds)
+            : plan(plan), binds(binds), genPos(0), genEnd(0), rowPos(0), limit(UINT64_MAX), produced(0) {
+        for (const auto &condition: plan.where) {
+            if (condition.column < 0) {
+                double n = parseNumber(resolve(condition.value, binds));
+                if (condition.op == "<") {
+                    limit = n > 1 ? (uint64_t) ceil(n) - 1 : 0;
+                } else if (condition.op == "<=") {
+                    limit = n >= 1 ? (uint64_t) floor(n) : 0;
+                } else if (condition.op == "=") {
+                    limit = n == 1 ? 1 : 0;
+                }
+            }
+        }
+        if (plan.table) {
+            shared_lock<shared_mutex> guard(plan.table->lock);
+            genEnd = plan.table->generated;
+            narrow();
+        }
+    }
+
+    /**
+     * Appends up to max rows to out, returns how many.
+     */
+    size_t fetch(size_t max, vector<StandinRow> &out) {
+        size_t got = 0;
+        shared_lock<shared_mutex> guard(plan.table->lock);
+        const StandinTableSpec &spec = plan.table->spec;
+        // DML 物化了表之后, 生成行已经搬进 rows
+        if (plan.table->generated < genEnd) {
+            genEnd = plan.table->generated;
+        }
+        while (got < max && produced < limit && genPos < genEnd) {
+            StandinRow row = generateRow(spec, genPos++);
+            if (accepted(row)) {
+                out.push_back(project(row));
+                ++got;
+                ++produced;
+            }
+        }
+        while (got < max && produced < limit && rowPos < plan.table->rows.size()) {
+            const StandinRow &row = plan.table->rows[rowPos++];
+            if (accepted(row)) {
+                out.push_back(project(row));
+                ++got;
+                ++produced;
+            }
+        }
+        return got;
+    }
+
+    uint64_t countAll() {
+        vector<StandinRow> rows;
+        uint64_t total = 0;
+        while (true) {
+            rows.clear();
+            size_t got = fetch(4096, rows);
+            total += got;
+            if (got < 4096) {
+                return total;
+            }
+        }
+    }
+
+private:
+    /**
+     * Conditions on SEQUENCE columns pin down the generated row range, so a
+     * point lookup on a large synthetic table does not scan it.
+     */
+    void narrow() {
+        const StandinTableSpec &spec = plan.table->spec;
+        for (const auto &condition: plan.where) {
+            if (condition.column < 0 ||
+                spec.columns[condition.column].distribution != StandinDistribution::SEQUENCE ||
+                !isNumeric(spec.columns[condition.column].type)) {
+                continue;
+            }
+            StandinCell value = resolve(condition.value, binds);
+            if (value.isNull) {
+                genEnd = genPos;
+                return;
+            }
+            double offset = parseNumber(value) - spec.columns[condition.column].low;
+            double begin = (double) genPos;
+            double end = (double) genEnd;
+            if (condition.op == "=") {
+                if (offset != floor(offset)) {
+                    end = begin;
+                } else {
+                    begin = std::max(begin, offset);
+                    end = std::min(end, offset + 1);
+                }
+            } else if (condition.op == "<") {
+                end = std::min(end, ceil(offset));
+            } else if (condition.op == "<=") {
+                end = std::min(end, floor(offset) + 1);
+            } else if (condition.op == ">") {
+                begin = std::max(begin, floor(offset) + 1);
+            } else if (condition.op == ">=") {
+                begin = std::max(begin, ceil(offset));
+            }
+            begin = std::max(begin, 0.0);
+            end = std::max(end, begin);
+            genPos = (uint64_t) begin;
+            genEnd = (uint64_t) end;
+        }
+    }
+
+    bool accepted(const StandinRow &row) const {
+        for (const auto &condition: plan.where) {
+            if (condition.column >= 0 &&
+                !matches(row[condition.column], plan.table->spec.columns[condition.column].type, condition.op,
+                         resolve(condition.value, binds))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    StandinRow project(const StandinRow &row) const {
+        StandinRow out;
+        out.reserve(plan.items.size());
+        for (const auto &item: plan.items) {
+            if (item.column >= 0) {
+                out.push_back(row[item.column]);
+            } else {
+                out.push_back(resolve(item.value, binds));
+            }
+        }
+        return out;
+    }
+
+    Plan plan;
+    StandinRow binds;
+    uint64_t genPos;
+    uint64_t genEnd;
+    size_t rowPos;
+    uint64_t limit;
+    uint64_t produced;
+};
+
+static uint64_t executeDml(const Plan &plan, const StandinRow &binds) {
+    switch (plan.kind) {
+        case SqlKind::INSERT: {
+            unique_lock<shared_mutex> guard(plan.table->lock);
+            const auto &columns = plan.table->spec.columns;
+            StandinRow row(columns.size());
+            for (auto &cell: row) {
+                cell.isNull = true;
+            }
+            for (size_t i = 0; i < plan.columns.size(); ++i) {
+                int c = plan.columns[i];
+                row[c] = coerce(resolve(plan.values[i], binds), columns[c].type);
+            }
+            plan.table->rows.push_back(std::move(row));
+            return 1;
+        }
+        case SqlKind::UPDATE:
+        case SqlKind::DELETE: {
+            unique_lock<shared_mutex> guard(plan.table->lock);
+            materialize(*plan.table);
+            const auto &columns = plan.table->spec.columns;
+            auto accepted = [&](const StandinRow &row) {
+                for (const auto &condition: plan.where) {
+                    if (condition.column >= 0 &&
+                        !matches(row[condition.column], columns[condition.column].type, condition.op,
+                                 resolve(condition.value, binds))) {
+                        return false;
+                    }
+                }
+                return true;
+            };
+            uint64_t affected = 0;
+            auto &rows = plan.table->rows;
+            if (plan.kind == SqlKind::DELETE) {
+                size_t before = rows.size();
+                rows.erase(remove_if(rows.begin(), rows.end(), accepted), rows.end());
+                affected = before - rows.size();
+            } else {
+                for (auto &row: rows) {
+                    if (accepted(row)) {
+                        for (size_t i = 0; i < plan.columns.size(); ++i) {
+                            int c = plan.columns[i];
+                            row[c] = coerce(resolve(plan.values[i], binds), columns[c].type);
+                        }
+                        ++affected;
+                    }
+                }
+            }
+            return affected;
+        }
+        case SqlKind::CREATE:
+            if (!StandinBackend::instance().createTable(plan.tableName, plan.create)) {
+                fail(955, "name is already used by an existing object");
+            }
+            return 0;
+        case SqlKind::DROP:
+            if (!StandinBackend::instance().dropTable(plan.tableName)) {
+                fail(942, "table or view does not exist");
+            }
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+// ---------------------------------------------------------------- OCCI classes
+
+SQLException::SQLException() : code(0) {}
+
+SQLException::SQLException(int errorCode, const string &message) : code(errorCode), message(message) {}
+
+int SQLException::getErrorCode() const {
+    return code;
+}
+
+string SQLException::getMessage() const {
+    return message;
+}
+
+const char *SQLException::what() const throw() {
+    return message.c_str();
+}
+
+MetaData::MetaData(const string &name, int dataType, int dataSize)
+        : name(name), dataType(dataType), dataSize(dataSize) {}
+
+int MetaData::getInt(MetaData::AttrId attrid) const {
+    switch (attrid) {
+        case ATTR_DATA_TYPE:
+            return dataType;
+        case ATTR_DATA_SIZE:
+        case ATTR_CHAR_SIZE:
+            return dataSize;
+        case ATTR_IS_NULL:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+unsigned int MetaData::getUInt(MetaData::AttrId attrid) const {
+    return (unsigned int) getInt(attrid);
+}
+
+bool MetaData::getBoolean(MetaData::AttrId attrid) const {
+    return getInt(attrid) != 0;
+}
+
+string MetaData::getString(MetaData::AttrId attrid) const {
+    return attrid == ATTR_NAME ? name : "";
+}
+
+/**
+ * The client heap of one environment: the malocfp/ralocfp/mfreefp given to
+ * createEnvironment, malloc when there are none. Like OCI, statements take
+ * a handle and result sets their define descriptors and prefetch buffer
+ * from it, so custom callbacks see that traffic and getCurrentHeapSize()
+ * has something to report.
+ */
+class StandinHeap {
+public:
+    StandinHeap(void *ctxp, void *(*malocfp)(void *, size_t), void *(*ralocfp)(void *, void *, size_t),
+                void (*mfreefp)(void *, void *))
+            : ctxp(ctxp), malocfp(malocfp), ralocfp(ralocfp), mfreefp(mfreefp) {}
+
+    void *allocate(size_t size) {
+        bytes.fetch_add(size, memory_order_relaxed);
+        return malocfp ? malocfp(ctxp, size) : malloc(size);
+    }
+
+    void *resize(void *memptr, size_t oldSize, size_t size) {
+        bytes.fetch_add(size - oldSize, memory_order_relaxed);
+        return ralocfp ? ralocfp(ctxp, memptr, size) : realloc(memptr, size);
+    }
+
+    void release(void *memptr, size_t size) {
+        if (nullptr == memptr) {
+            return;
+        }
+        bytes.fetch_sub(size, memory_order_relaxed);
+        mfreefp ? mfreefp(ctxp, memptr) : free(memptr);
+    }
+
+    size_t size() const {
+        return bytes.load(memory_order_relaxed);
+    }
+
+private:
+    void *ctxp;
+    void *(*malocfp)(void *, size_t);
+    void *(*ralocfp)(void *, void *, size_t);
+    void (*mfreefp)(void *, void *);
+    atomic<size_t> bytes{0};
+};
+
+// 句柄和每列定义描述符的大小, 量级和 OCI 的差不多
+static const size_t STATEMENT_HANDLE_BYTES = 512;
+static const size_t DEFINE_BYTES = 96;
+
+class StandinEnvironment;
+
+StandinHeap &environmentHeap(StandinEnvironment *env);
+
+class StandinStatement;
+
+class StandinConnection : public Connection {
+public:
+    StandinConnection(StandinEnvironment *env, const string &connectString)
+            : env(env), heap(environmentHeap(env)), latency(StandinBackend::instance().latency(connectString)),
+              trips(0), inCall(false), cancelled(false), cacheSize(0) {
+        serverCall(0, latency.connect);
+    }
+
+    Statement *createStatement(const string &sql) override;
+
+    void terminateStatement(Statement *statement) override;
+
+    void commit() override {
+        serverCall(0);
+    }
+
+    void rollback() override {
+        // 没有事务, DML 立即可见; rollback 只付一次往返
+        serverCall(0);
+    }
+
+    void setStmtCacheSize(unsigned int size) override {
+        lock_guard<mutex> guard(cacheLock);
+        cacheSize = size;
+        while (cache.size() > cacheSize) {
+            cache.pop_back();
+        }
+    }
+
+    unsigned int getStmtCacheSize() const override {
+        return cacheSize;
+    }
+
+    string getServerVersion() const override {
+        return "Oracle Database stand-in 23.4";
+    }
+
+    void cancel() override {
+        if (inCall.load()) {
+            cancelled = true;
+        }
+    }
+
+    // OCI 句柄就是替身对象本身, standin_oci.cpp 再转回来
+    OCISvcCtx *getOCIServiceContext() const override {
+        return (OCISvcCtx *) static_cast<const Connection *>(this);
+    }
+
+    OCIServer *getOCIServer() const override {
+        return (OCIServer *) static_cast<const Connection *>(this);
+    }
+
+    /**
+     * One round trip carrying `rows` rows, sleeping the injected latency.
+     * Throws ORA-01013 when cancel() arrives meanwhile.
+     */
+    void serverCall(uint64_t rows, chrono::nanoseconds extra = chrono::nanoseconds(0)) {
+        trips.fetch_add(1, memory_order_relaxed);
+        StandinBackend::instance().countRoundTrip();
+        chrono::nanoseconds cost = latency.roundTrip + latency.perRow * (int64_t) rows + extra;
+        if (cost.count() <= 0) {
+            return;
+        }
+        if (nonBlocking) {
+            // 非阻塞模式不睡, 只把服务端耗时记到 busyUntil, 由 OCI 替身轮询
+            auto now = chrono::steady_clock::now();
+            busyUntil = std::max(busyUntil, now) + cost;
+            return;
+        }
+        inCall = true;
+        auto deadline = chrono::steady_clock::now() + cost;
+        while (true) {
+            if (cancelled.exchange(false)) {
+                inCall = false;
+                fail(1013, "user requested cancel of current operation");
+            }
+            auto left = deadline - chrono::steady_clock::now();
+            if (left <= chrono::nanoseconds(0)) {
+                break;
+            }
+            // 短于 200us 的等待用自旋, sleep_for 在这个量级不准
+            if (left > chrono::microseconds(200)) {
+                this_thread::sleep_for(std::min<chrono::steady_clock::duration>(left - chrono::microseconds(100),
+                                                                                chrono::milliseconds(1)));
+            }
+        }
+        inCall = false;
+    }
+
+    uint64_t roundTrips() const {
+        return trips.load(memory_order_relaxed);
+    }
+
+    const StandinLatency &callLatency() const {
+        return latency;
+    }
+
+    void setNonBlocking(bool on) {
+        nonBlocking = on;
+    }
+
+    bool isNonBlocking() const {
+        return nonBlocking;
+    }
+
+    chrono::steady_clock::time_point busyDeadline() const {
+        return busyUntil;
+    }
+
+    StandinHeap &clientHeap() {
+        return heap;
+    }
+
+private:
+    StandinEnvironment *env;
+    StandinHeap &heap;
+    StandinLatency latency;
+    atomic<uint64_t> trips;
+    atomic<bool> inCall;
+    atomic<bool> cancelled;
+    mutex cacheLock;
+    unsigned int cacheSize;
+    list<string> cache;
+    // 只由持有会话的线程读写
+    bool nonBlocking = false;
+    chrono::steady_clock::time_point busyUntil;
+
+    friend class StandinStatement;
+};
+
+class StandinResultSet : public ResultSet {
+public:
+    StandinResultSet(StandinStatement *stmt, StandinConnection *conn, const Plan &plan, unique_ptr<StandinCursor> cursor,
+                     vector<StandinRow> fixed, unsigned int prefetchRows, unsigned int prefetchMemory,
+                     chrono::nanoseconds parse)
+            : stmt(stmt), conn(conn), items(plan.items), cursor(std::move(cursor)), exhausted(false),
+              state(DATA_AVAILABLE), arrayRows(0), prefetchRows(prefetchRows), prefetchMemory(prefetchMemory) {
+        for (const auto &item: items) {
+            rowBytes += columnBytes({"", item.type, StandinDistribution::CONSTANT, 0, 0, item.width});
+        }
+        definesBytes = DEFINE_BYTES * std::max<size_t>(1, items.size());
+        defines = conn->clientHeap().allocate(definesBytes);
+        if (!this->cursor) {
+            for (auto &row: fixed) {
+                buffer.push_back(std::move(row));
+            }
+            exhausted = true;
+            conn->serverCall(buffer.size(), parse);
+        } else {
+            // 执行的那次往返顺带预取 prefetchRows 行
+            roundTrip(prefetchLimit(0), parse);
+        }
+    }
+
+    ~StandinResultSet() override {
+        conn->clientHeap().release(defines, definesBytes);
+        conn->clientHeap().release(prefetched, prefetchedBytes);
+    }
+
+    Status next(unsigned int numRows) override {
+        if (!buffers.empty()) {
+            return nextArray(numRows);
+        }
+        if (buffer.empty() && !exhausted) {
+            roundTrip(prefetchLimit(1));
+        }
+        if (buffer.empty()) {
+            current.clear();
+            state = END_OF_FETCH;
+            return state;
+        }
+        current = std::move(buffer.front());
+        buffer.pop_front();
+        state = DATA_AVAILABLE;
+        return state;
+    }
+
+    Status status() const override {
+        return state;
+    }
+
+    unsigned int getNumArrayRows() const override {
+        return arrayRows;
+    }
+
+    void cancel() override {
+        conn->cancel();
+    }
+
+    void setMaxColumnSize(unsigned int, unsigned int) override {}
+
+    bool isNull(unsigned int colIndex) const override {
+        return cell(colIndex).isNull;
+    }
+
+    int getInt(unsigned int colIndex) override {
+        return (int) getDouble(colIndex);
+    }
+
+    unsigned int getUInt(unsigned int colIndex) override {
+        return (unsigned int) getDouble(colIndex);
+    }
+
+    float getFloat(unsigned int colIndex) override {
+        return (float) getDouble(colIndex);
+    }
+
+    double getDouble(unsigned int colIndex) override {
+        const StandinCell &value = cell(colIndex);
+        if (value.isNull) {
+            return 0;
+        }
+        return isNumeric(items[colIndex - 1].type) ? value.number : parseNumber(value);
+    }
+
+    string getString(unsigned int colIndex) override {
+        const StandinCell &value = cell(colIndex);
+        return value.isNull ? "" : cellText(value, items[colIndex - 1].type);
+    }
+
+    BFloat getBFloat(unsigned int colIndex) override {
+        BFloat value;
+        value.isNull = isNull(colIndex);
+        value.value = value.isNull ? 0 : getFloat(colIndex);
+        return value;
+    }
+
+    BDouble getBDouble(unsigned int colIndex) override {
+        BDouble value;
+        value.isNull = isNull(colIndex);
+        value.value = value.isNull ? 0 : getDouble(colIndex);
+        return value;
+    }
+
+    void setDataBuffer(unsigned int colIndex, void *data, Type type, sb4 size, ub2 *length, sb2 *ind,
+                       ub2 *rc) override {
+        if (colIndex == 0 || colIndex > items.size()) {
+            fail(32109, "invalid column or parameter position");
+        }
+        if (buffers.size() < items.size()) {
+            buffers.resize(items.size());
+        }
+        buffers[colIndex - 1] = {data, type, size, length, ind, rc};
+    }
+
+    vector<MetaData> getColumnListMetaData() const override {
+        vector<MetaData> columns;
+        for (const auto &item: items) {
+            int type = item.type == StandinType::VARCHAR ? 1 :
+                       item.type == StandinType::DATE ? 12 :
+                       item.type == StandinType::BINARY_FLOAT ? 100 :
+                       item.type == StandinType::BINARY_DOUBLE ? 101 : 2;
+            columns.emplace_back(item.name, type,
+                                 (int) columnBytes({"", item.type, StandinDistribution::CONSTANT, 0, 0, item.width}));
+        }
+        return columns;
+    }
+
+    Statement *getStatement() const override;
+
+    void setPrefetchRowCount(unsigned int rowCount) override {
+        prefetchRows = rowCount;
+    }
+
+    void setPrefetchMemorySize(unsigned int bytes) override {
+        prefetchMemory = bytes;
+    }
+
+private:
+    struct Buffer {
+        void *data = nullptr;
+        Type type = OCCI_SQLT_STR;
+        sb4 size = 0;
+        ub2 *length = nullptr;
+        sb2 *ind = nullptr;
+        ub2 *rc = nullptr;
+    };
+
+    /**
+     * Rows one round trip brings back: what the caller asked for, topped up
+     * to the prefetch row count, capped by the prefetch memory size.
+     */
+    size_t prefetchLimit(size_t requested) const {
+        size_t rows = prefetchRows;
+        if (prefetchMemory > 0) {
+            size_t byMemory = std::max<size_t>(1, prefetchMemory / std::max<size_t>(1, rowBytes));
+            rows = rows > 0 ? std::min(rows, byMemory) : byMemory;
+        }
+        return std::max(rows, requested);
+    }
+
+    void roundTrip(size_t rows, chrono::nanoseconds extra = chrono::nanoseconds(0)) {
+        // 服务端和 OCI 自己堆上的分配不算客户端代码的, 见 alloc_tracker.h
+        AllocPause pause;
+        vector<StandinRow> fetched;
+        size_t got = rows > 0 ? cursor->fetch(rows, fetched) : 0;
+        // 服务端返回的行数少于请求时客户端就知道结果集结束了
+        if (rows > 0 && got < rows) {
+            exhausted = true;
+        }
+        conn->serverCall(got, extra);
+        // OCI 把一次往返的行先收进客户端堆上的预取缓冲, 只增不减
+        if (got * rowBytes > prefetchedBytes) {
+            prefetched = conn->clientHeap().resize(prefetched, prefetchedBytes, got * rowBytes);
+            prefetchedBytes = got * rowBytes;
+        }
+        for (auto &row: fetched) {
+            buffer.push_back(std::move(row));
+        }
+    }
+
+    Status nextArray(unsigned int numRows) {
+        AllocPause pause;
+        if (buffer.size() < numRows && !exhausted) {
+            roundTrip(prefetchLimit(numRows - buffer.size()));
+        }
+        arrayRows = 0;
+        while (arrayRows < numRows && !buffer.empty()) {
+            store(arrayRows, buffer.front());
+            buffer.pop_front();
+            ++arrayRows;
+        }
+        state = arrayRows < numRows ? END_OF_FETCH : DATA_AVAILABLE;
+        return state;
+    }
+
+    void store(unsigned int index, const StandinRow &row) {
+        for (size_t c = 0; c < buffers.size() && c < row.size(); ++c) {
+            const Buffer &b = buffers[c];
+            if (!b.data) {
+                continue;
+            }
+            const StandinCell &value = row[c];
+            StandinType type = items[c].type;
+            char *slot = (char *) b.data + (size_t) index * (size_t) b.size;
+            if (b.ind) {
+                b.ind[index] = value.isNull ? -1 : 0;
+            }
+            if (b.rc) {
+                b.rc[index] = 0;
+            }
+            if (value.isNull) {
+                if (b.length) {
+                    b.length[index] = 0;
+                }
+                continue;
+            }
+            double number = isNumeric(type) ? value.number : 0;
+            switch (b.type) {
+                case OCCIINT:
+                    *(int *) slot = (int) (isNumeric(type) ? number : parseNumber(value));
+                    break;
+                case OCCIUNSIGNED_INT:
+                    *(unsigned int *) slot = (unsigned int) (isNumeric(type) ? number : parseNumber(value));
+                    break;
+                case OCCIFLOAT:
+                case OCCIBFLOAT:
+                case OCCIIBFLOAT:
+                case OCCIBDOUBLE:
+                case OCCIIBDOUBLE:
+                case OCCIDOUBLE:
+                    if (!isNumeric(type)) {
+                        number = parseNumber(value);
+                    }
+                    if (b.size == (sb4) sizeof(float)) {
+                        *(float *) slot = (float) number;
+                    } else {
+                        *(double *) slot = number;
+                    }
+                    break;
+                default: {
+                    string text = cellText(value, type);
+                    bool terminated = b.type == OCCI_SQLT_STR;
+                    size_t room = (size_t) b.size - (terminated ? 1 : 0);
+                    size_t n = std::min(text.size(), room);
+                    memcpy(slot, text.data(), n);
+                    if (terminated) {
+                        slot[n] = '\0';
+                    }
+                    if (b.length) {
+                        b.length[index] = (ub2) (n + (terminated ? 1 : 0));
+                    }
+                    // 截断和 Oracle 一样: 指示符给原长度, 列返回码 1406, 没有指示符就报错
+                    if (n < text.size()) {
+                        if (!b.ind) {
+                            fail(1406, "fetched column value was truncated");
+                        }
+                        b.ind[index] = (sb2) std::min<size_t>(text.size(), 32767);
+                        if (b.rc) {
+                            b.rc[index] = 1406;
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    const StandinCell &cell(unsigned int colIndex) const {
+        if (colIndex == 0 || colIndex > current.size()) {
+            fail(32109, "invalid column or parameter position");
+        }
+        return current[colIndex - 1];
+    }
+
+    StandinStatement *stmt;
+    StandinConnection *conn;
+    vector<SelectItem> items;
+    unique_ptr<StandinCursor> cursor;
+    deque<StandinRow> buffer;
+    StandinRow current;
+    bool exhausted;
+    Status state;
+    unsigned int arrayRows;
+    unsigned int prefetchRows;
+    unsigned int prefetchMemory;
+    size_t rowBytes = 0;
+    vector<Buffer> buffers;
+    void *defines = nullptr;
+    size_t definesBytes = 0;
+    void *prefetched = nullptr;
+    size_t prefetchedBytes = 0;
+};
+
+class StandinStatement : public Statement {
+public:
+    StandinStatement(StandinConnection *conn, const string &sql, bool parsed)
+            : conn(conn), sql(sql), parsed(parsed), state(sql.empty() ? UNPREPARED : PREPARED),
+              resultSet(nullptr), updateCount(0), prefetchRows(1), prefetchMemory(0), maxIterations(1),
+              iterations(1), handle(conn->clientHeap().allocate(STATEMENT_HANDLE_BYTES)) {}
+
+    ~StandinStatement() override {
+        delete resultSet;
+        conn->clientHeap().release(handle, STATEMENT_HANDLE_BYTES);
+    }
+
+    void setSQL(const string &text) override {
+        if (text != sql) {
+            sql = text;
+            parsed = false;
+        }
+        state = PREPARED;
+    }
+
+    string getSQL() const override {
+        return sql;
+    }
+
+    Status execute(const string &text) override {
+        AllocPause pause;
+        if (!text.empty()) {
+            setSQL(text);
+        }
+        Plan plan = SqlParser(sql).parse();
+        if (plan.kind == SqlKind::SELECT || plan.kind == SqlKind::STAT) {
+            open(plan);
+            state = RESULT_SET_AVAILABLE;
+        } else {
+            updateCount = run(plan);
+            state = UPDATE_COUNT_AVAILABLE;
+        }
+        return state;
+    }
+
+    ResultSet *getResultSet() override {
+        return resultSet;
+    }
+
+    unsigned int getUpdateCount() const override {
+        return updateCount;
+    }
+
+    ResultSet *executeQuery(const string &text) override {
+        AllocPause pause;
+        if (!text.empty()) {
+            setSQL(text);
+        }
+        Plan plan = SqlParser(sql).parse();
+        if (plan.kind != SqlKind::SELECT && plan.kind != SqlKind::STAT) {
+            fail(24333, "zero iteration count");
+        }
+        open(plan);
+        state = RESULT_SET_AVAILABLE;
+        return resultSet;
+    }
+
+    unsigned int executeUpdate(const string &text) override {
+        AllocPause pause;
+        if (!text.empty()) {
+            setSQL(text);
+        }
+        Plan plan = SqlParser(sql).parse();
+        if (plan.kind == SqlKind::SELECT || plan.kind == SqlKind::STAT) {
+            open(plan);
+            updateCount = 0;
+        } else {
+            updateCount = run(plan);
+        }
+        state = UPDATE_COUNT_AVAILABLE;
+        return updateCount;
+    }
+
+    Status status() const override {
+        return state;
+    }
+
+    void closeResultSet(ResultSet *rs) override {
+        AllocPause pause;
+        if (rs && rs == resultSet) {
+            delete resultSet;
+            resultSet = nullptr;
+        }
+    }
+
+    void setPrefetchRowCount(unsigned int rowCount) override {
+        prefetchRows = rowCount;
+    }
+
+    void setPrefetchMemorySize(unsigned int bytes) override {
+        prefetchMemory = bytes;
+    }
+
+    void setAutoCommit(bool) override {}
+
+    bool getAutoCommit() const override {
+        return false;
+    }
+
+    void setMaxParamSize(unsigned int, unsigned int) override {}
+
+    void setNull(unsigned int paramIndex, Type) override {
+        bind(paramIndex).isNull = true;
+    }
+
+    void setInt(unsigned int paramIndex, int x) override {
+        bind(paramIndex).number = x;
+    }
+
+    void setUInt(unsigned int paramIndex, unsigned int x) override {
+        bind(paramIndex).number = x;
+    }
+
+    void setFloat(unsigned int paramIndex, float x) override {
+        bind(paramIndex).number = x;
+    }
+
+    void setDouble(unsigned int paramIndex, double x) override {
+        bind(paramIndex).number = x;
+    }
+
+    void setString(unsigned int paramIndex, const string &x) override {
+        AllocPause pause;
+        StandinCell &cell = bind(paramIndex);
+        cell.text = x;
+        // Oracle 把空串当 NULL
+        cell.isNull = x.empty();
+    }
+
+    void setBFloat(unsigned int paramIndex, const BFloat &fval) override {
+        StandinCell &cell = bind(paramIndex);
+        cell.number = fval.value;
+        cell.isNull = fval.isNull;
+    }
+
+    void setBDouble(unsigned int paramIndex, const BDouble &dval) override {
+        StandinCell &cell = bind(paramIndex);
+        cell.number = dval.value;
+        cell.isNull = dval.isNull;
+    }
+
+    void setDataBuffer(unsigned int paramIndex, void *buffer, Type type, sb4 size, ub2 *length, sb2 *ind,
+                       ub2 *) override {
+        if (paramIndex == 0) {
+            fail(32109, "invalid column or parameter position");
+        }
+        if (buffers.size() < paramIndex) {
+            buffers.resize(paramIndex);
+        }
+        buffers[paramIndex - 1] = {buffer, type, size, length, ind};
+    }
+
+    void setMaxIterations(unsigned int max) override {
+        maxIterations = std::max(1u, max);
+    }
+
+    unsigned int getMaxIterations() const override {
+        return maxIterations;
+    }
+
+    void addIteration() override {
+        AllocPause pause;
+        if (iterations.size() >= maxIterations) {
+            fail(32108, "max iterations exceeded");
+        }
+        iterations.emplace_back();
+    }
+
+    unsigned int getCurrentIteration() const override {
+        return (unsigned int) iterations.size();
+    }
+
+    Status executeArrayUpdate(unsigned int arrayLength) override {
+        AllocPause pause;
+        Plan plan = SqlParser(sql).parse();
+        vector<StandinRow> rows;
+        rows.reserve(arrayLength);
+        for (unsigned int i = 0; i < arrayLength; ++i) {
+            StandinRow row = iterations.front();
+            for (size_t p = 0; p < buffers.size(); ++p) {
+                if (!buffers[p].data) {
+                    continue;
+                }
+                if (row.size() <= p) {
+                    row.resize(p + 1);
+                }
+                row[p] = load(buffers[p], i);
+            }
+            rows.push_back(std::move(row));
+        }
+        updateCount = runAll(plan, rows);
+        state = UPDATE_COUNT_AVAILABLE;
+        return state;
+    }
+
+    Connection *getConnection() const override {
+        return conn;
+    }
+
+private:
+    struct Buffer {
+        void *data = nullptr;
+        Type type = OCCI_SQLT_STR;
+        sb4 size = 0;
+        ub2 *length = nullptr;
+        sb2 *ind = nullptr;
+    };
+
+    StandinCell &bind(unsigned int paramIndex) {
+        if (paramIndex == 0) {
+            fail(32109, "invalid column or parameter position");
+        }
+        StandinRow &row = iterations.back();
+        if (row.size() < paramIndex) {
+            row.resize(paramIndex);
+        }
+        row[paramIndex - 1] = StandinCell();
+        return row[paramIndex - 1];
+    }
+
+    static StandinCell load(const Buffer &b, unsigned int index) {
+        StandinCell cell;
+        if (b.ind && b.ind[index] == -1) {
+            cell.isNull = true;
+            return cell;
+        }
+        const char *slot = (const char *) b.data + (size_t) index * (size_t) b.size;
+        switch (b.type) {
+            case OCCIINT:
+                cell.number = *(const int *) slot;
+                break;
+            case OCCIUNSIGNED_INT:
+                cell.number = *(const unsigned int *) slot;
+                break;
+            case OCCIFLOAT:
+            case OCCIBFLOAT:
+            case OCCIIBFLOAT:
+            case OCCIBDOUBLE:
+            case OCCIIBDOUBLE:
+            case OCCIDOUBLE:
+                cell.number = b.size == (sb4) sizeof(float) ? *(const float *) slot : *(const double *) slot;
+                break;
+            case OCCI_SQLT_STR:
+                cell.text.assign(slot, strnlen(slot, (size_t) b.size));
+                break;
+            default:
+                cell.text.assign(slot, b.length ? b.length[index] : strnlen(slot, (size_t) b.size));
+                break;
+        }
+        if (b.type == OCCI_SQLT_STR || b.type == OCCI_SQLT_CHR || b.type == OCCI_SQLT_AFC ||
+            b.type == OCCI_SQLT_VCS) {
+            cell.isNull = cell.text.empty();
+        }
+        return cell;
+    }
+
+    chrono::nanoseconds takeParse() {
+        if (parsed) {
+            return chrono::nanoseconds(0);
+        }
+        parsed = true;
+        return conn->callLatency().parse;
+    }
+
+    void open(const Plan &plan) {
+        delete resultSet;
+        resultSet = nullptr;
+        const StandinRow &binds = iterations.front();
+        vector<StandinRow> fixed;
+        unique_ptr<StandinCursor> cursor;
+        Plan described = plan;
+        if (plan.kind == SqlKind::STAT) {
+            // 执行这条统计查询本身也算一次往返
+            StandinCell value;
+            value.number = (double) (conn->roundTrips() + 1);
+            fixed.push_back({value});
+            SelectItem item;
+            item.name = "VALUE";
+            described.items = {item};
+        } else if (plan.count) {
+            StandinCursor counter(plan, binds);
+            StandinCell value;
+            value.number = (double) counter.countAll();
+            fixed.push_back({value});
+        } else {
+            cursor.reset(new StandinCursor(plan, binds));
+        }
+        resultSet = new StandinResultSet(this, conn, described, std::move(cursor), std::move(fixed), prefetchRows,
+                                         prefetchMemory, takeParse());
+    }
+
+    uint64_t run(const Plan &plan) {
+        vector<StandinRow> rows(iterations.begin(), iterations.end());
+        iterations.resize(1);
+        return runAll(plan, rows);
+    }
+
+    /**
+     * All iterations of a DML statement go to the server in one round trip.
+     */
+    uint64_t runAll(const Plan &plan, const vector<StandinRow> &rows) {
+        uint64_t affected = 0;
+        for (const auto &binds: rows) {
+            affected += executeDml(plan, binds);
+        }
+        conn->serverCall(rows.size(), takeParse());
+        return affected;
+    }
+
+    StandinConnection *conn;
+    string sql;
+    bool parsed;
+    Status state;
+    StandinResultSet *resultSet;
+    unsigned int updateCount;
+    unsigned int prefetchRows;
+    unsigned int prefetchMemory;
+    unsigned int maxIterations;
+    vector<StandinRow> iterations;
+    vector<Buffer> buffers;
+    void *handle;
+
+    friend class StandinConnection;
+};
+
+Statement *StandinResultSet::getStatement() const {
+    return stmt;
+}
+
+Statement *StandinConnection::createStatement(const string &sql) {
+    AllocPause pause;
+    bool cached = false;
+    if (!sql.empty()) {
+        lock_guard<mutex> guard(cacheLock);
+        auto it = find(cache.begin(), cache.end(), sql);
+        if (it != cache.end()) {
+            cache.erase(it);
+            cached = true;
+        }
+    }
+    return new StandinStatement(this, sql, cached);
+}
+
+void StandinConnection::terminateStatement(Statement *statement) {
+    AllocPause pause;
+    auto *stmt = static_cast<StandinStatement *>(statement);
+    if (nullptr == stmt) {
+        return;
+    }
+    {
+        lock_guard<mutex> guard(cacheLock);
+        if (cacheSize > 0 && stmt->parsed && !stmt->sql.empty()) {
+            cache.push_front(stmt->sql);
+            while (cache.size() > cacheSize) {
+                cache.pop_back();
+            }
+        }
+    }
+    delete stmt;
+}
+
+class StandinPool : public StatelessConnectionPool {
+public:
+    StandinPool(StandinEnvironment *env, const string &connectString, unsigned int maxConn, unsigned int minConn,
+                unsigned int incrConn)
+            : env(env), connectString(connectString), maxConn(maxConn), minConn(minConn), incrConn(incrConn),
+              busyOption(WAIT), timeout(0), busy(0), open(0), cacheSize(0) {
+        for (unsigned int i = 0; i < minConn; ++i) {
+            idle.push_back(new StandinConnection(env, connectString));
+            ++open;
+        }
+    }
+
+    ~StandinPool() override {
+        for (auto *conn: idle) {
+            delete conn;
+        }
+    }
+
+    unsigned int getBusyConnections() const override {
+        lock_guard<mutex> guard(lock);
+        return busy;
+    }
+
+    unsigned int getOpenConnections() const override {
+        lock_guard<mutex> guard(lock);
+        return open;
+    }
+
+    unsigned int getMinConnections() const override {
+        return minConn;
+    }
+
+    unsigned int getMaxConnections() const override {
+        return maxConn;
+    }
+
+    unsigned int getIncrConnections() const override {
+        return incrConn;
+    }
+
+    string getPoolName() const override {
+        return "standin:" + connectString;
+    }
+
+    unsigned int getTimeOut() const override {
+        return timeout;
+    }
+
+    void setBusyOption(BusyOption option) override {
+        busyOption = option;
+    }
+
+    BusyOption getBusyOption() const override {
+        return busyOption;
+    }
+
+    void setTimeOut(unsigned int connTimeOut) override {
+        timeout = connTimeOut;
+    }
+
+    void setPoolSize(unsigned int max, unsigned int min, unsigned int incr) override {
+        lock_guard<mutex> guard(lock);
+        maxConn = max;
+        minConn = min;
+        incrConn = incr;
+        freed.notify_all();
+    }
+
+    Connection *getConnection(const string &) override {
+        unique_lock<mutex> lk(lock);
+        while (idle.empty() && open >= maxConn && busyOption != FORCEGET) {
+            if (busyOption == NOWAIT) {
+                fail(24496, "OCISessionGet() timed out waiting for a free connection");
+            }
+            freed.wait(lk);
+        }
+        ++busy;
+        if (!idle.empty()) {
+            StandinConnection *conn = idle.back();
+            idle.pop_back();
+            return conn;
+        }
+        ++open;
+        lk.unlock();
+        try {
+            auto *conn = new StandinConnection(env, connectString);
+            conn->setStmtCacheSize(cacheSize);
+            return conn;
+        }
+        catch (...) {
+            lk.lock();
+            --open;
+            --busy;
+            freed.notify_one();
+            throw;
+        }
+    }
+
+    void releaseConnection(Connection *connection, const string &) override {
+        lock_guard<mutex> guard(lock);
+        idle.push_back(static_cast<StandinConnection *>(connection));
+        --busy;
+        freed.notify_one();
+    }
+
+    void terminateConnection(Connection *connection) override {
+        delete static_cast<StandinConnection *>(connection);
+        lock_guard<mutex> guard(lock);
+        --open;
+        --busy;
+        freed.notify_one();
+    }
+
+    void setStmtCacheSize(unsigned int size) override {
+        lock_guard<mutex> guard(lock);
+        cacheSize = size;
+        for (auto *conn: idle) {
+            conn->setStmtCacheSize(size);
+        }
+    }
+
+    unsigned int getStmtCacheSize() const override {
+        return cacheSize;
+    }
+
+private:
+    StandinEnvironment *env;
+    string connectString;
+    unsigned int maxConn;
+    unsigned int minConn;
+    unsigned int incrConn;
+    BusyOption busyOption;
+    unsigned int timeout;
+    mutable mutex lock;
+    condition_variable freed;
+    vector<StandinConnection *> idle;
+    unsigned int busy;
+    unsigned int open;
+    unsigned int cacheSize;
+};
+
+class StandinEnvironment : public Environment {
+public:
+    StandinEnvironment(Mode mode, void *ctxp, void *(*malocfp)(void *, size_t),
+                       void *(*ralocfp)(void *, void *, size_t), void (*mfreefp)(void *, void *))
+            : mode(mode), heap(ctxp, malocfp, ralocfp, mfreefp) {}
+
+    Connection *createConnection(const string &userName, const string &, const string &connectString) override {
+        if (userName.empty()) {
+            fail(1017, "invalid username/password; logon denied");
+        }
+        return new StandinConnection(this, connectString);
+    }
+
+    void terminateConnection(Connection *connection) override {
+        delete static_cast<StandinConnection *>(connection);
+    }
+
+    unsigned int getCurrentHeapSize() const override {
+        return (unsigned int) heap.size();
+    }
+
+    OCIEnv *getOCIEnvironment() const override {
+        return (OCIEnv *) static_cast<const Environment *>(this);
+    }
+
+    StatelessConnectionPool *createStatelessConnectionPool(const string &poolUserName, const string &,
+                                                           const string &connectString, unsigned int maxConn,
+                                                           unsigned int minConn, unsigned int incrConn,
+                                                           StatelessConnectionPool::PoolType) override {
+        if (poolUserName.empty()) {
+            fail(1017, "invalid username/password; logon denied");
+        }
+        return new StandinPool(this, connectString, maxConn, minConn, incrConn);
+    }
+
+    void terminateStatelessConnectionPool(StatelessConnectionPool *poolp,
+                                          StatelessConnectionPool::DestroyMode) override {
+        delete static_cast<StandinPool *>(poolp);
+    }
+
+private:
+    Mode mode;
+    StandinHeap heap;
+
+    friend StandinHeap &environmentHeap(StandinEnvironment *env);
+};
+
+StandinHeap &environmentHeap(StandinEnvironment *env) {
+    return env->heap;
+}
+
+Environment *Environment::createEnvironment(Mode mode, void *ctxp, void *(*malocfp)(void *, size_t),
+                                            void *(*ralocfp)(void *, void *, size_t),
+                                            void (*mfreefp)(void *, void *)) {
+    StandinBackend::instance();
+    return new StandinEnvironment(mode, ctxp, malocfp, ralocfp, mfreefp);
+}
+
+void Environment::terminateEnvironment(Environment *env) {
+    delete static_cast<StandinEnvironment *>(env);
+}
+
+// ---------------------------------------------------------------- backend
+
+StandinBackend &StandinBackend::instance() {
+    static StandinBackend backend;
+    return backend;
+}
+
+StandinBackend::StandinBackend() : trips(0) {
+    reset();
+}
+
+void StandinBackend::defineTable(const StandinTableSpec &spec) {
+    auto table = make_shared<StandinTable>();
+    table->spec = spec;
+    table->spec.name = upper(spec.name);
+    table->generated = spec.rows;
+    lock_guard<mutex> guard(lock);
+    tables[table->spec.name] = table;
+}
+
+bool StandinBackend::dropTable(const string &name) {
+    lock_guard<mutex> guard(lock);
+    return tables.erase(upper(name)) > 0;
+}
+
+bool StandinBackend::createTable(const string &name, const vector<StandinColumn> &columns) {
+    auto table = make_shared<StandinTable>();
+    table->spec = {upper(name), 0, columns, 1};
+    lock_guard<mutex> guard(lock);
+    return tables.emplace(table->spec.name, table).second;
+}
+
+shared_ptr<StandinTable> StandinBackend::table(const string &name) const {
+    lock_guard<mutex> guard(lock);
+    auto it = tables.find(upper(name));
+    return it == tables.end() ? nullptr : it->second;
+}
+
+void StandinBackend::setLatency(const StandinLatency &latency) {
+    lock_guard<mutex> guard(lock);
+    defaultLatency = latency;
+}
+
+void StandinBackend::setLatency(const string &connectString, const StandinLatency &latency) {
+    lock_guard<mutex> guard(lock);
+    endpointLatency[connectString] = latency;
+}
+
+StandinLatency StandinBackend::latency(const string &connectString) const {
+    lock_guard<mutex> guard(lock);
+    auto it = endpointLatency.find(connectString);
+    return it == endpointLatency.end() ? defaultLatency : it->second;
+}
+
+uint64_t StandinBackend::roundTrips() const {
+    return trips.load(memory_order_relaxed);
+}
+
+void StandinBackend::countRoundTrip() {
+    trips.fetch_add(1, memory_order_relaxed);
+}
+
+void StandinBackend::reset() {
+    const char *rowsEnv = getenv("OCI_DEMO_STANDIN_ROWS");
+    const char *latencyEnv = getenv("OCI_DEMO_STANDIN_LATENCY_US");
+    uint64_t rows = rowsEnv ? strtoull(rowsEnv, nullptr, 10) : 1000;
+
+    {
+        lock_guard<mutex> guard(lock);
+        tables.clear();
+        endpointLatency.clear();
+        defaultLatency = StandinLatency();
+        if (latencyEnv) {
+            defaultLatency.roundTrip = chrono::microseconds(atoll(latencyEnv));
+            defaultLatency.connect = defaultLatency.roundTrip * 4;
+        }
+        trips = 0;
+    }
+
+    defineTable({"DUAL", 1, {{"DUMMY", StandinType::VARCHAR, StandinDistribution::CONSTANT, 0, 0, 1}}, 1});
+    defineTable({"ALL_USERS", 40,
+                 {{"USERNAME", StandinType::VARCHAR, StandinDistribution::SEQUENCE, 1, 0, 0},
+                  {"USER_ID", StandinType::NUMBER, StandinDistribution::SEQUENCE, 100, 0, 0},
+                  {"CREATED", StandinType::DATE, StandinDistribution::UNIFORM, 18000, 20000, 0},
+                  {"COMMON", StandinType::VARCHAR, StandinDistribution::CONSTANT, 0, 0, 0}},
+                 7});
+    defineTable({"BENCH_TAB", rows,
+                 {{"ID", StandinType::NUMBER, StandinDistribution::SEQUENCE, 1, 0, 0},
+                  {"NAME", StandinType::VARCHAR, StandinDistribution::UNIFORM, 1, 100000, 32},
+                  {"AMOUNT", StandinType::BINARY_DOUBLE, StandinDistribution::UNIFORM, 0, 10000, 0},
+                  {"CATEGORY", StandinType::NUMBER, StandinDistribution::ZIPF, 1, 100, 0}},
+                 42});
+}
+
+void standinSetNonBlocking(Connection *conn, bool on) {
+    static_cast<StandinConnection *>(conn)->setNonBlocking(on);
+}
+
+bool standinNonBlocking(const Connection *conn) {
+    return static_cast<const StandinConnection *>(conn)->isNonBlocking();
+}
+
+chrono::steady_clock::time_point standinBusyUntil(const Connection *conn) {
+    return static_cast<const StandinConnection *>(conn)->busyDeadline();
+}
@@ -0,0 +1,347 @@
+#include "oci.h"
+#include "occi.h"
+#include "standin.h"
+#include "alloc_tracker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace oracle::occi;
+
+// OCI 句柄在替身里的样子: 错误句柄存最后一个错误, 语句句柄包着替身 Statement
+struct OCIError {
+    sb4 code = 0;
+    string message;
+};
+
+struct OciSlot {
+    void *value = nullptr;
+    sb4 size = 0;
+    ub2 dty = 0;
+    sb2 *ind = nullptr;
+    ub2 *length = nullptr;
+};
+
+struct OCIStmt {
+    Connection *conn = nullptr;
+    Statement *stmt = nullptr;
+    ResultSet *rs = nullptr;
+    ub4 rowCount = 0;
+    vector<OciSlot> binds;
+    vector<OciSlot> defines;
+    // 非阻塞模式下已经做完、还在"等服务端"的调用的结果
+    bool inFlight = false;
+    sword pending = OCI_SUCCESS;
+};
+
+static sword setError(OCIError *errhp, int code, const string &message) {
+    if (errhp) {
+        errhp->code = code;
+        errhp->message = message;
+    }
+    return OCI_ERROR;
+}
+
+static sword setError(OCIError *errhp, const SQLException &e) {
+    return setError(errhp, e.getErrorCode(), e.getMessage());
+}
+
+static void setSlot(vector<OciSlot> &slots, ub4 position, void *value, sb4 size, ub2 dty, void *ind, ub2 *length) {
+    if (slots.size() < position) {
+        slots.resize(position);
+    }
+    OciSlot &slot = slots[position - 1];
+    slot.value = value;
+    slot.size = size;
+    slot.dty = dty;
+    slot.ind = (sb2 *) ind;
+    slot.length = length;
+}
+
+static void applyBind(Statement *stmt, unsigned int position, const OciSlot &slot) {
+    if (slot.ind && *slot.ind < 0) {
+        stmt->setNull(position, slot.dty == SQLT_STR || slot.dty == SQLT_CHR ? OCCI_SQLT_STR : OCCINUMBER);
+        return;
+    }
+    switch (slot.dty) {
+        case SQLT_INT:
+            if (slot.size == 8) {
+                stmt->setDouble(position, (double) *(const long long *) slot.value);
+            } else {
+                stmt->setInt(position, *(const int *) slot.value);
+            }
+            break;
+        case SQLT_FLT:
+            if (slot.size == 4) {
+                stmt->setFloat(position, *(const float *) slot.value);
+            } else {
+                stmt->setDouble(position, *(const double *) slot.value);
+            }
+            break;
+        case SQLT_CHR:
+            stmt->setString(position, string((const char *) slot.value, slot.length ? *slot.length : slot.size));
+            break;
+        default:
+            stmt->setString(position, string((const char *) slot.value,
+                                             strnlen((const char *) slot.value, (size_t) slot.size)));
+            break;
+    }
+}
+
+static void storeColumn(ResultSet *rs, unsigned int position, const OciSlot &slot) {
+    bool null = rs->isNull(position);
+    if (slot.ind) {
+        *slot.ind = null ? -1 : 0;
+    }
+    if (null) {
+        return;
+    }
+    switch (slot.dty) {
+        case SQLT_INT:
+            if (slot.size == 8) {
+                *(long long *) slot.value = (long long) rs->getDouble(position);
+            } else {
+                *(int *) slot.value = rs->getInt(position);
+            }
+            break;
+        case SQLT_FLT:
+            if (slot.size == 4) {
+                *(float *) slot.value = (float) rs->getDouble(position);
+            } else {
+                *(double *) slot.value = rs->getDouble(position);
+            }
+            break;
+        default: {
+            string text = rs->getString(position);
+            size_t n = std::min(text.size(), (size_t) (slot.size > 0 ? slot.size - 1 : 0));
+            memcpy(slot.value, text.data(), n);
+            ((char *) slot.value)[n] = '\0';
+            if (slot.length) {
+                *slot.length = (ub2) n;
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * Non-blocking mode: the first call does the work right away and keeps the
+ * status; until the session's injected server time has passed, repeating the
+ * call returns OCI_STILL_EXECUTING, as the real client does until the reply
+ * is in.
+ */
+template<typename Work>
+static sword serverWork(OCIStmt *stmtp, Work work) {
+    if (!standinNonBlocking(stmtp->conn)) {
+        return work();
+    }
+    if (!stmtp->inFlight) {
+        stmtp->pending = work();
+        stmtp->inFlight = true;
+    }
+    if (chrono::steady_clock::now() < standinBusyUntil(stmtp->conn)) {
+        return OCI_STILL_EXECUTING;
+    }
+    stmtp->inFlight = false;
+    return stmtp->pending;
+}
+
+sword OCIHandleAlloc(const void *parenth, void **hndlpp, const ub4 type, const size_t, void **) {
+    if (nullptr == parenth || nullptr == hndlpp || type != OCI_HTYPE_ERROR) {
+        return OCI_INVALID_HANDLE;
+    }
+    AllocPause pause;
+    *hndlpp = new OCIError();
+    return OCI_SUCCESS;
+}
+
+sword OCIHandleFree(void *hndlp, const ub4 type) {
+    if (nullptr == hndlp || type != OCI_HTYPE_ERROR) {
+        return OCI_INVALID_HANDLE;
+    }
+    AllocPause pause;
+    delete (OCIError *) hndlp;
+    return OCI_SUCCESS;
+}
+
+sword OCIErrorGet(void *hndlp, ub4 recordno, OraText *, sb4 *errcodep, OraText *bufp, ub4 bufsiz, ub4 type) {
+    OCIError *error = (OCIError *) hndlp;
+    if (nullptr == error || type != OCI_HTYPE_ERROR) {
+        return OCI_INVALID_HANDLE;
+    }
+    if (recordno != 1 || error->code == 0) {
+        return OCI_NO_DATA;
+    }
+    if (errcodep) {
+        *errcodep = error->code;
+    }
+    if (bufp && bufsiz) {
+        size_t n = std::min(error->message.size(), (size_t) bufsiz - 1);
+        memcpy(bufp, error->message.data(), n);
+        bufp[n] = '\0';
+    }
+    return OCI_SUCCESS;
+}
+
+sword OCIStmtPrepare2(OCISvcCtx *svchp, OCIStmt **stmtp, OCIError *errhp, const OraText *stmt, ub4 stmt_len,
+                      const OraText *, ub4, ub4, ub4) {
+    if (nullptr == svchp || nullptr == stmtp) {
+        return OCI_INVALID_HANDLE;
+    }
+    AllocPause pause;
+    Connection *conn = (Connection *) svchp;
+    try {
+        Statement *statement = conn->createStatement(string((const char *) stmt, stmt_len));
+        *stmtp = new OCIStmt();
+        (*stmtp)->conn = conn;
+        (*stmtp)->stmt = statement;
+    }
+    catch (const SQLException &e) {
+        return setError(errhp, e);
+    }
+    return OCI_SUCCESS;
+}
+
+sword OCIStmtRelease(OCIStmt *stmtp, OCIError *, const OraText *, ub4, ub4) {
+    if (nullptr == stmtp) {
+        return OCI_INVALID_HANDLE;
+    }
+    AllocPause pause;
+    if (stmtp->rs) {
+        stmtp->stmt->closeResultSet(stmtp->rs);
+    }
+    stmtp->conn->terminateStatement(stmtp->stmt);
+    delete stmtp;
+    return OCI_SUCCESS;
+}
+
+sword OCIBindByPos(OCIStmt *stmtp, OCIBind **, OCIError *errhp, ub4 position, void *valuep, sb4 value_sz, ub2 dty,
+                   void *indp, ub2 *alenp, ub2 *, ub4, ub4 *, ub4) {
+    if (nullptr == stmtp) {
+        return OCI_INVALID_HANDLE;
+    }
+    if (0 == position) {
+        return setError(errhp, 1036, "ORA-01036: illegal variable name/number");
+    }
+    AllocPause pause;
+    setSlot(stmtp->binds, position, valuep, value_sz, dty, indp, alenp);
+    return OCI_SUCCESS;
+}
+
+sword OCIDefineByPos(OCIStmt *stmtp, OCIDefine **, OCIError *errhp, ub4 position, void *valuep, sb4 value_sz,
+                     ub2 dty, void *indp, ub2 *rlenp, ub2 *, ub4) {
+    if (nullptr == stmtp) {
+        return OCI_INVALID_HANDLE;
+    }
+    if (0 == position) {
+        return setError(errhp, 1007, "ORA-01007: variable not in select list");
+    }
+    AllocPause pause;
+    setSlot(stmtp->defines, position, valuep, value_sz, dty, indp, rlenp);
+    return OCI_SUCCESS;
+}
+
+sword OCIStmtExecute(OCISvcCtx *svchp, OCIStmt *stmtp, OCIError *errhp, ub4 iters, ub4, const OCISnapshot *,
+                     OCISnapshot *, ub4 mode) {
+    if (nullptr == svchp || nullptr == stmtp) {
+        return OCI_INVALID_HANDLE;
+    }
+    AllocPause pause;
+    return serverWork(stmtp, [&]() -> sword {
+        // 替身引擎内部用异常报错, 在 C 接口边界上转成状态码, 和真实客户端的 C 层一样
+        try {
+            if (stmtp->rs) {
+                stmtp->stmt->closeResultSet(stmtp->rs);
+                stmtp->rs = nullptr;
+            }
+            for (size_t i = 0; i < stmtp->binds.size(); ++i) {
+                if (stmtp->binds[i].value) {
+                    applyBind(stmtp->stmt, (unsigned int) i + 1, stmtp->binds[i]);
+                }
+            }
+            stmtp->rowCount = 0;
+            if (0 == iters) {
+                stmtp->rs = stmtp->stmt->executeQuery();
+            } else {
+                stmtp->stmt->setAutoCommit((mode & OCI_COMMIT_ON_SUCCESS) != 0);
+                stmtp->rowCount = stmtp->stmt->executeUpdate();
+            }
+        }
+        catch (const SQLException &e) {
+            return setError(errhp, e);
+        }
+        return OCI_SUCCESS;
+    });
+}
+
+sword OCIStmtFetch2(OCIStmt *stmtp, OCIError *errhp, ub4 nrows, ub2, sb4, ub4) {
+    if (nullptr == stmtp) {
+        return OCI_INVALID_HANDLE;
+    }
+    if (nullptr == stmtp->rs) {
+        return setError(errhp, 1002, "ORA-01002: fetch out of sequence");
+    }
+    if (nrows != 1) {
+        return setError(errhp, 24374, "ORA-24374: stand-in fetches one row per call");
+    }
+    AllocPause pause;
+    return serverWork(stmtp, [&]() -> sword {
+        try {
+            if (ResultSet::END_OF_FETCH == stmtp->rs->next()) {
+                return OCI_NO_DATA;
+            }
+            for (size_t i = 0; i < stmtp->defines.size(); ++i) {
+                if (stmtp->defines[i].value) {
+                    storeColumn(stmtp->rs, (unsigned int) i + 1, stmtp->defines[i]);
+                }
+            }
+            ++stmtp->rowCount;
+        }
+        catch (const SQLException &e) {
+            return setError(errhp, e);
+        }
+        return OCI_SUCCESS;
+    });
+}
+
+sword OCIAttrGet(const void *trgthndlp, ub4 trghndltyp, void *attributep, ub4 *sizep, ub4 attrtype,
+                 OCIError *errhp) {
+    if (nullptr == trgthndlp || (trghndltyp != OCI_HTYPE_STMT && trghndltyp != OCI_HTYPE_SERVER)) {
+        return OCI_INVALID_HANDLE;
+    }
+    if (trghndltyp == OCI_HTYPE_SERVER) {
+        if (attrtype != OCI_ATTR_NONBLOCKING_MODE) {
+            return setError(errhp, 24315, "ORA-24315: illegal attribute type");
+        }
+        *(ub1 *) attributep = standinNonBlocking((const Connection *) trgthndlp) ? 1 : 0;
+        if (sizep) {
+            *sizep = sizeof(ub1);
+        }
+        return OCI_SUCCESS;
+    }
+    if (attrtype != OCI_ATTR_ROW_COUNT) {
+        return setError(errhp, 24315, "ORA-24315: illegal attribute type");
+    }
+    *(ub4 *) attributep = ((const OCIStmt *) trgthndlp)->rowCount;
+    if (sizep) {
+        *sizep = sizeof(ub4);
+    }
+    return OCI_SUCCESS;
+}
+
+sword OCIAttrSet(void *trgthndlp, ub4 trghndltyp, void *, ub4, ub4 attrtype, OCIError *errhp) {
+    if (nullptr == trgthndlp || trghndltyp != OCI_HTYPE_SERVER) {
+        return OCI_INVALID_HANDLE;
+    }
+    if (attrtype != OCI_ATTR_NONBLOCKING_MODE) {
+        return setError(errhp, 24315, "ORA-24315: illegal attribute type");
+    }
+    // 和真实客户端一样, 设置这个属性是切换模式, 值本身不看
+    Connection *conn = (Connection *) trgthndlp;
+    standinSetNonBlocking(conn, !standinNonBlocking(conn));
+    return OCI_SUCCESS;
+}
@@ -0,0 +1,186 @@
+#include "statement_probe.h"
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "latency_histogram.h"
+#include "logger.h"
+#include "sql_fingerprint.h"
+
+using namespace std;
+
+typedef vector<StatementSink *> SinkList;
+
+// 写时复制: 执行语句的线程只拿一份快照, 注册/注销时整体替换.
+// 探针只在调用 sink 的那一小段里持有快照, 注销方等含这个 sink 的旧快照都没人持有了才返回
+static mutex G_SINK_LOCK;
+static shared_ptr<const SinkList> G_SINKS = make_shared<const SinkList>();
+static vector<weak_ptr<const SinkList>> G_REPLACED_SINKS;
+
+/**
+ * Installs the new list; the one it replaces is remembered until no probe
+ * holds it any more. Called with G_SINK_LOCK held.
+ */
+static void publishSinks(const shared_ptr<const SinkList> &sinks) {
+    G_REPLACED_SINKS.erase(std::remove_if(G_REPLACED_SINKS.begin(), G_REPLACED_SINKS.end(),
+                                          [](const weak_ptr<const SinkList> &old) { return old.expired(); }),
+                           G_REPLACED_SINKS.end());
+    G_REPLACED_SINKS.push_back(atomic_load(&G_SINKS));
+    atomic_store(&G_SINKS, sinks);
+}
+static atomic<bool> G_PROBES_ACTIVE(false);
+
+static chrono::steady_clock::time_point probeOrigin() {
+    static const chrono::steady_clock::time_point origin = chrono::steady_clock::now();
+    return origin;
+}
+
+static uint32_t threadSession() {
+    static atomic<uint32_t> next(1);
+    thread_local uint32_t session = next.fetch_add(1, memory_order_relaxed);
+    return session;
+}
+
+bool addStatementSink(StatementSink *sink) {
+    probeOrigin();
+    lock_guard<mutex> guard(G_SINK_LOCK);
+    if (G_SINKS->size() >= MAX_STATEMENT_SINKS) {
+        logError("at most %zu statement sinks", MAX_STATEMENT_SINKS);
+        return false;
+    }
+    auto sinks = make_shared<SinkList>(*G_SINKS);
+    sinks->push_back(sink);
+    publishSinks(sinks);
+    G_PROBES_ACTIVE.store(true, memory_order_relaxed);
+    return true;
+}
+
+void removeStatementSink(StatementSink *sink) {
+    vector<weak_ptr<const SinkList>> holding;
+    {
+        lock_guard<mutex> guard(G_SINK_LOCK);
+        auto sinks = make_shared<SinkList>(*G_SINKS);
+        sinks->erase(std::remove(sinks->begin(), sinks->end(), sink), sinks->end());
+        G_PROBES_ACTIVE.store(!sinks->empty(), memory_order_relaxed);
+        publishSinks(sinks);
+        for (const auto &old: G_REPLACED_SINKS) {
+            shared_ptr<const SinkList> list = old.lock();
+            if (list && std::find(list->begin(), list->end(), sink) != list->end()) {
+                holding.push_back(old);
+            }
+        }
+    }
+    // 引用计数的递减是 acq_rel, 看到过期后加 acquire 栅栏, 探针对 sink 的调用都先于返回
+    for (const auto &old: holding) {
+        while (!old.expired()) {
+            this_thread::yield();
+        }
+    }
+    atomic_thread_fence(memory_order_acquire);
+}
+
+bool statementProbesActive() {
+    return G_PROBES_ACTIVE.load(memory_order_relaxed);
+}
+
+StatementProbe::StatementProbe(const string &sql, StatementKind kind, uint64_t fingerprint)
+        : active(statementProbesActive()), captureBinds(false), failed(false), exceptions(0), kind(kind),
+          fingerprint(fingerprint), rows(0), dbNsStart(0), callsStart(0), sql(sql) {
+    if (!active) {
+        return;
+    }
+    {
+        shared_ptr<const SinkList> sinks = atomic_load(&G_SINKS);
+        for (StatementSink *sink: *sinks) {
+            captureBinds = sink->wantsBinds() || captureBinds;
+        }
+    }
+    if (0 == this->fingerprint) {
+        this->fingerprint = sqlFingerprint(sql);
+    }
+    exceptions = uncaught_exceptions();
+    dbNsStart = threadDbNanos();
+    callsStart = threadDbCalls();
+    start = chrono::steady_clock::now();
+}
+
+StatementProbe::~StatementProbe() {
+    if (!active) {
+        return;
+    }
+    auto end = chrono::steady_clock::now();
+    uint64_t durationNs = (uint64_t) chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+    // 重新取快照: 语句执行期间注销的 sink 可能已经停了, 不再交给它.
+    // 先问一遍, 没有 sink 要这条语句就什么都不拷贝
+    shared_ptr<const SinkList> sinks = atomic_load(&G_SINKS);
+    StatementSink *wanting[MAX_STATEMENT_SINKS];
+    size_t count = 0;
+    for (StatementSink *sink: *sinks) {
+        if (sink->wants(fingerprint, durationNs)) {
+            wanting[count++] = sink;
+        }
+    }
+    if (0 == count) {
+        return;
+    }
+
+    StatementRecord record;
+    record.kind = kind;
+    record.fingerprint = fingerprint;
+    record.sql = sql;
+    record.binds = std::move(binds);
+    record.bindsCaptured = captureBinds;
+    record.startNs = (uint64_t) chrono::duration_cast<chrono::nanoseconds>(start - probeOrigin()).count();
+    record.durationNs = durationNs;
+    record.dbNs = threadDbNanos() - dbNsStart;
+    record.calls = threadDbCalls() - callsStart;
+    record.rows = rows;
+    record.session = threadSession();
+    record.failed = failed || uncaught_exceptions() > exceptions;
+    for (size_t i = 0; i < count; ++i) {
+        wanting[i]->onStatement(record);
+    }
+}
+
+BindValue &StatementProbe::slot(unsigned int index, BindType type) {
+    // 同一位置重复 set 以最后一次为准
+    for (auto &bind: binds) {
+        if (bind.index == index) {
+            bind = BindValue();
+            bind.index = index;
+            bind.type = type;
+            return bind;
+        }
+    }
+    binds.emplace_back();
+    binds.back().index = index;
+    binds.back().type = type;
+    return binds.back();
+}
+
+void StatementProbe::bind(unsigned int index, int64_t value) {
+    if (captureBinds) {
+        slot(index, BindType::INT).i = value;
+    }
+}
+
+void StatementProbe::bind(unsigned int index, double value) {
+    if (captureBinds) {
+        slot(index, BindType::DOUBLE).d = value;
+    }
+}
+
+void StatementProbe::bind(unsigned int index, const string &value) {
+    if (captureBinds) {
+        slot(index, BindType::STRING).s = value;
+    }
+}
+
+void StatementProbe::bindNull(unsigned int index) {
+    if (captureBinds) {
+        slot(index, BindType::NUL);
+    }
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class StatementKind : uint8_t {
+    QUERY = 1,
+    UPDATE = 2
+};
+
+enum class BindType : uint8_t {
+    NUL = 0,
+    INT = 1,
+    DOUBLE = 2,
+    STRING = 3
+};
+
+/**
+ * One bind value as the program set it (1-based position like OCCI).
+ */
+struct BindValue {
+    unsigned int index = 0;
+    BindType type = BindType::NUL;
+    int64_t i = 0;
+    double d = 0;
+    std::string s;
+};
+
+/**
+ * One finished statement execution. startNs counts from the first probe in
+ * the process; session is a small per-thread number, stable for the thread's
+ * lifetime. dbNs is the part of durationNs spent inside dbCall() (client
+ * library, network, server), calls the number of OCCI calls made.
+ * bindsCaptured is false when no sink asked for this execution's binds.
+ */
+struct StatementRecord {
+    StatementKind kind = StatementKind::QUERY;
+    uint64_t fingerprint = 0;
+    std::string sql;
+    std::vector<BindValue> binds;
+    bool bindsCaptured = false;
+    uint64_t startNs = 0;
+    uint64_t durationNs = 0;
+    uint64_t dbNs = 0;
+    uint64_t calls = 0;
+    uint64_t rows = 0;
+    uint32_t session = 0;
+    bool failed = false;
+};
+
+/**
+ * Receives probed statements. A sink that only cares about some executions
+ * says so in wants(), which runs before any record is built, so the probe
+ * copies nothing when no sink wants the statement; the same goes for
+ * wantsBinds(), asked once when the statement starts.
+ *
+ * onStatement runs on the executing thread, right after the statement
+ * finished, so it should hand the record off rather than do I/O inline.
+ */
+class StatementSink {
+public:
+    virtual ~StatementSink() = default;
+
+    virtual bool wantsBinds() { return true; }
+
+    virtual bool wants(uint64_t /* fingerprint */, uint64_t /* durationNs */) { return true; }
+
+    virtual void onStatement(const StatementRecord &record) = 0;
+};
+
+static const size_t MAX_STATEMENT_SINKS = 8;
+
+/**
+ * Sinks are not owned; remove a sink before destroying it. At most
+ * MAX_STATEMENT_SINKS at once; false (and nothing registered) beyond that.
+ */
+bool addStatementSink(StatementSink *sink);
+
+/**
+ * Returns once no probe is still calling into the sink, so the sink may be
+ * stopped and destroyed right after. Must not be called from a sink's own
+ * callbacks.
+ */
+void removeStatementSink(StatementSink *sink);
+
+/**
+ * True while any sink is registered (one relaxed load).
+ */
+bool statementProbesActive();
+
+/**
+ * Watches one statement execution from construction to destruction and hands
+ * the result to every sink. With no sink registered it records nothing, so
+ * the bind()/addRows() calls next to the real OCCI calls cost a branch each:
+ *
+ *   StatementProbe probe(sql, StatementKind::UPDATE, fp);
+ *   stmt->setInt(1, id);    probe.bind(1, id);
+ *   stmt->executeUpdate();
+ *
+ * A probe destroyed while an exception propagates marks the record failed.
+ * sql must outlive the probe; it is only copied if a sink wants the record.
+ */
+class StatementProbe {
+public:
+    StatementProbe(const std::string &sql, StatementKind kind, uint64_t fingerprint = 0);
+
+    ~StatementProbe();
+
+    StatementProbe(const StatementProbe &) = delete;
+
+    StatementProbe &operator=(const StatementProbe &) = delete;
+
+    void bind(unsigned int index, int64_t value);
+
+    void bind(unsigned int index, int value) { bind(index, (int64_t) value); }
+
+    void bind(unsigned int index, double value);
+
+    void bind(unsigned int index, const std::string &value);
+
+    void bindNull(unsigned int index);
+
+    void addRows(uint64_t n) { rows += n; }
+
+    void setFailed() { failed = true; }
+
+private:
+    BindValue &slot(unsigned int index, BindType type);
+
+    bool active;
+    bool captureBinds;
+    bool failed;
+    int exceptions;
+    StatementKind kind;
+    uint64_t fingerprint;
+    uint64_t rows;
+    uint64_t dbNsStart;
+    uint64_t callsStart;
+    const std::string &sql;
+    std::chrono::steady_clock::time_point start;
+    std::vector<BindValue> binds;
+};
@@ -0,0 +1,121 @@
+#include "trace.h"
+
+#include <cstdio>
+
+#include "logger.h"
+#include "sql_fingerprint.h"
+
+using namespace std;
+
+Tracer &Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::start(const string &file) {
+    lock_guard<mutex> guard(lock);
+    path = file;
+    origin = chrono::steady_clock::now();
+    on.store(true, memory_order_relaxed);
+}
+
+Tracer::ThreadBuffer &Tracer::local() {
+    // shared_ptr 由 Tracer 持有, 线程退出后缓冲区仍然保留到 write()
+    static thread_local shared_ptr<ThreadBuffer> buffer;
+    if (!buffer) {
+        buffer = make_shared<ThreadBuffer>();
+        lock_guard<mutex> guard(lock);
+        buffer->tid = (int) buffers.size() + 1;
+        buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void Tracer::record(const char *name, const char *call, chrono::steady_clock::time_point start,
+                    chrono::steady_clock::time_point end, uint64_t fingerprint, uint64_t count) {
+    if (!enabled() || start < origin) {
+        return;
+    }
+    ThreadBuffer &buffer = local();
+    TraceEvent event;
+    event.name = name;
+    event.call = call;
+    event.startNs = (uint64_t) chrono::duration_cast<chrono::nanoseconds>(start - origin).count();
+    event.durationNs = (uint64_t) chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+    event.fingerprint = fingerprint;
+    event.count = count;
+
+    lock_guard<mutex> guard(buffer.lock);
+    if (buffer.events.size() >= MAX_EVENTS_PER_THREAD) {
+        ++buffer.dropped;
+        return;
+    }
+    buffer.events.push_back(event);
+}
+
+void Tracer::setThreadName(const string &name) {
+    if (!enabled()) {
+        return;
+    }
+    ThreadBuffer &buffer = local();
+    lock_guard<mutex> guard(buffer.lock);
+    buffer.name = name;
+}
+
+bool Tracer::write() {
+    on.store(false, memory_order_relaxed);
+
+    vector<shared_ptr<ThreadBuffer>> all;
+    string file;
+    {
+        lock_guard<mutex> guard(lock);
+        all = buffers;
+        file = path;
+    }
+    if (file.empty()) {
+        return false;
+    }
+    FILE *out = fopen(file.c_str(), "w");
+    if (nullptr == out) {
+        logError("open trace file %s error.", file.c_str());
+        return false;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(out, "{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"oracle_oci_demo\"}}");
+    uint64_t total = 0;
+    uint64_t dropped = 0;
+    for (const auto &buffer: all) {
+        lock_guard<mutex> guard(buffer->lock);
+        string name = buffer->name.empty() ? "thread " + to_string(buffer->tid) : buffer->name;
+        fprintf(out, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}",
+                buffer->tid, name.c_str());
+        for (const auto &event: buffer->events) {
+            // Chrome trace 的时间单位是微秒
+            fprintf(out, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+                    buffer->tid, event.name, event.startNs / 1000.0, event.durationNs / 1000.0);
+            const char *sep = "";
+            if (event.call) {
+                fprintf(out, "\"call\":\"%s\"", event.call);
+                sep = ",";
+            }
+            if (event.fingerprint) {
+                fprintf(out, "%s\"fp\":\"%s\"", sep, fingerprintHex(event.fingerprint).c_str());
+                sep = ",";
+            }
+            if (event.count) {
+                fprintf(out, "%s\"count\":%llu", sep, (unsigned long long) event.count);
+            }
+            fprintf(out, "}}");
+        }
+        total += buffer->events.size();
+        dropped += buffer->dropped;
+    }
+    fprintf(out, "\n]}\n");
+    bool ok = ferror(out) == 0;
+    fclose(out);
+
+    logInfo("trace: %llu spans (%llu dropped) written to %s", (unsigned long long) total,
+            (unsigned long long) dropped, file.c_str());
+    return ok;
+}
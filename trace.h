@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * One completed span. name/call point at string literals.
+ */
+struct TraceEvent {
+    const char *name;
+    const char *call;
+    uint64_t startNs;
+    uint64_t durationNs;
+    uint64_t fingerprint;
+    uint64_t count;
+};
+
+/**
+ * Opt-in span recorder that writes Chrome trace-event JSON (chrome://tracing,
+ * ui.perfetto.dev).
+ *
+ * Every thread appends to its own buffer, so recording only takes that
+ * buffer's (uncontended) lock; buffers outlive their threads and are written
+ * out together by write(). When not started, spans cost one relaxed load.
+ */
+class Tracer {
+public:
+    static const size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+    static Tracer &instance();
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+
+    /**
+     * Starts recording; write() goes to path.
+     */
+    void start(const std::string &path);
+
+    void record(const char *name, const char *call, std::chrono::steady_clock::time_point start,
+                std::chrono::steady_clock::time_point end, uint64_t fingerprint = 0, uint64_t count = 0);
+
+    /**
+     * Names the calling thread in the timeline.
+     */
+    void setThreadName(const std::string &name);
+
+    /**
+     * Stops recording and writes every buffer to the path given to start().
+     */
+    bool write();
+
+    Tracer(const Tracer &) = delete;
+
+    Tracer &operator=(const Tracer &) = delete;
+
+private:
+    struct ThreadBuffer {
+        std::mutex lock;
+        int tid = 0;
+        std::string name;
+        std::vector<TraceEvent> events;
+        uint64_t dropped = 0;
+    };
+
+    Tracer() = default;
+
+    ThreadBuffer &local();
+
+    std::atomic<bool> on{false};
+    std::chrono::steady_clock::time_point origin;
+    std::string path;
+    std::mutex lock;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+};
+
+/**
+ * Records [construction, destruction) as one span when the tracer is on:
+ *   TraceSpan span("format");
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char *name, uint64_t fingerprint = 0)
+            : name(name), fingerprint(fingerprint), count(0), active(Tracer::instance().enabled()) {
+        if (active) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~TraceSpan() {
+        if (active) {
+            Tracer::instance().record(name, nullptr, start, std::chrono::steady_clock::now(), fingerprint, count);
+        }
+    }
+
+    /**
+     * Rows or bytes the span covered, shown as args.count.
+     */
+    void setCount(uint64_t n) { count = n; }
+
+    TraceSpan(const TraceSpan &) = delete;
+
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *name;
+    uint64_t fingerprint;
+    uint64_t count;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
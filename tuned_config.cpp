@@ -0,0 +1,160 @@
+#include "tuned_config.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "json_reader.h"
+#include "occi_common.h"
+#include "sql_fingerprint.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+TunedConfig &TunedConfig::instance() {
+    static TunedConfig config;
+    return config;
+}
+
+static string jsonString(const string &text) {
+    string out = "\"";
+    for (char c: text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char) c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static TunedSettings readSettings(const JsonValue &value) {
+    TunedSettings settings;
+    settings.prefetchRows = (unsigned int) value["prefetch_rows"].number();
+    settings.prefetchMemory = (unsigned int) value["prefetch_memory"].number();
+    settings.arrayRows = (unsigned int) value["array_rows"].number();
+    settings.stmtCache = (unsigned int) value["stmt_cache"].number();
+    settings.dmlBatch = (unsigned int) value["dml_batch"].number();
+    return settings;
+}
+
+static string settingsFields(const TunedSettings &s) {
+    char text[192];
+    snprintf(text, sizeof(text),
+             "\"prefetch_rows\": %u, \"prefetch_memory\": %u, \"array_rows\": %u, \"stmt_cache\": %u, "
+             "\"dml_batch\": %u", s.prefetchRows, s.prefetchMemory, s.arrayRows, s.stmtCache, s.dmlBatch);
+    return text;
+}
+
+bool TunedConfig::load(const string &path, string &error) {
+    JsonValue doc;
+    if (!readJsonFile(path, doc, error)) {
+        return false;
+    }
+    const JsonValue &list = doc["statements"];
+    if (!list.isArray()) {
+        error = path + ": no \"statements\" array";
+        return false;
+    }
+    vector<TunedStatement> loaded;
+    for (size_t i = 0; i < list.size(); ++i) {
+        const JsonValue &item = list[i];
+        TunedStatement statement;
+        statement.fingerprint = strtoull(item["fingerprint"].text().c_str(), nullptr, 16);
+        statement.sql = item["sql"].text();
+        // 手工编辑过只留了 sql 的条目, 按 sql 重新算指纹
+        if (0 == statement.fingerprint && !statement.sql.empty()) {
+            statement.fingerprint = sqlFingerprint(statement.sql);
+        }
+        if (0 == statement.fingerprint) {
+            continue;
+        }
+        statement.query = item["kind"].text() != "dml";
+        statement.runs = (unsigned int) item["runs"].number();
+        statement.settings = readSettings(item["settings"]);
+        const JsonValue &pareto = item["pareto"];
+        for (size_t p = 0; p < pareto.size(); ++p) {
+            TunePoint point;
+            point.settings = readSettings(pareto[p]);
+            point.rowsPerSec = pareto[p]["rows_per_sec"].number();
+            point.p50Us = pareto[p]["p50_us"].number();
+            point.p99Us = pareto[p]["p99_us"].number();
+            statement.pareto.push_back(point);
+        }
+        loaded.push_back(std::move(statement));
+    }
+    statements.swap(loaded);
+    return true;
+}
+
+bool TunedConfig::save(const string &path, string &error) const {
+    FILE *out = fopen(path.c_str(), "w");
+    if (nullptr == out) {
+        error = "open " + path + " error";
+        return false;
+    }
+    fprintf(out, "{\n  \"statements\": [");
+    for (size_t i = 0; i < statements.size(); ++i) {
+        const TunedStatement &s = statements[i];
+        fprintf(out, "%s\n    {\"fingerprint\": \"%s\", \"sql\": %s, \"kind\": \"%s\", \"runs\": %u,\n",
+                i ? "," : "", fingerprintHex(s.fingerprint).c_str(), jsonString(s.sql).c_str(),
+                s.query ? "query" : "dml", s.runs);
+        fprintf(out, "     \"settings\": {%s},\n", settingsFields(s.settings).c_str());
+        fprintf(out, "     \"pareto\": [");
+        for (size_t p = 0; p < s.pareto.size(); ++p) {
+            const TunePoint &point = s.pareto[p];
+            fprintf(out, "%s\n       {%s, \"rows_per_sec\": %.9g, \"p50_us\": %.9g, \"p99_us\": %.9g}",
+                    p ? "," : "", settingsFields(point.settings).c_str(), point.rowsPerSec, point.p50Us,
+                    point.p99Us);
+        }
+        fprintf(out, "]}");
+    }
+    fprintf(out, "\n  ]\n}\n");
+    bool ok = ferror(out) == 0;
+    fclose(out);
+    if (!ok) {
+        error = "write " + path + " error";
+    }
+    return ok;
+}
+
+void TunedConfig::put(const TunedStatement &statement) {
+    for (auto &existing: statements) {
+        if (existing.fingerprint == statement.fingerprint) {
+            existing = statement;
+            return;
+        }
+    }
+    statements.push_back(statement);
+}
+
+const TunedStatement *TunedConfig::find(uint64_t fingerprint) const {
+    for (const auto &statement: statements) {
+        if (statement.fingerprint == fingerprint) {
+            return &statement;
+        }
+    }
+    return nullptr;
+}
+
+unsigned int TunedConfig::stmtCacheSize() const {
+    unsigned int size = 0;
+    for (const auto &statement: statements) {
+        size = std::max(size, statement.settings.stmtCache);
+    }
+    return size;
+}
+
+void applyTunedSettings(Statement *stmt, const TunedSettings &settings) {
+    if (settings.prefetchRows) {
+        stmt->setPrefetchRowCount(settings.prefetchRows);
+    }
+    if (settings.prefetchMemory) {
+        stmt->setPrefetchMemorySize(settings.prefetchMemory);
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 不引 occi.h: oratypes.h 把 boolean 定义成了宏, 会和 json_reader.h 冲突
+namespace oracle {
+    namespace occi {
+        class Statement;
+    }
+}
+
+/**
+ * Fetch/DML knobs for one statement; 0 = leave the OCCI default.
+ */
+struct TunedSettings {
+    unsigned int prefetchRows = 0;
+    unsigned int prefetchMemory = 0;
+    // ArrayFetcher 每批行数, 1 = 一次 next() 一行
+    unsigned int arrayRows = 0;
+    unsigned int stmtCache = 0;
+    // executeArrayUpdate 每批行数, 查询为 0
+    unsigned int dmlBatch = 0;
+};
+
+/**
+ * One measured combination of settings.
+ */
+struct TunePoint {
+    TunedSettings settings;
+    double rowsPerSec = 0;
+    double p50Us = 0;
+    double p99Us = 0;
+};
+
+/**
+ * The tuning outcome for one statement: the chosen settings and the
+ * Pareto front (throughput vs p99) they were picked from.
+ */
+struct TunedStatement {
+    uint64_t fingerprint = 0;
+    std::string sql;
+    bool query = true;
+    // 每个组合测量的次数; 少于 TUNE_P99_RUNS 时 p99Us 其实是最大值
+    unsigned int runs = 0;
+    TunedSettings settings;
+    std::vector<TunePoint> pareto;
+};
+
+/**
+ * Per-statement settings written by `oracle_oci_demo tune` and loaded at
+ * start-up (OCI_DEMO_TUNED=<file>), keyed by SQL fingerprint:
+ *
+ *   {"statements": [{"fingerprint": "5f1c...", "sql": "SELECT ...", "kind": "query", "runs": 100,
+ *                    "settings": {"prefetch_rows": 100, "prefetch_memory": 0, "array_rows": 500,
+ *                                 "stmt_cache": 20, "dml_batch": 0},
+ *                    "pareto": [{..settings.., "rows_per_sec": 1.2e6, "p50_us": 700, "p99_us": 900}]}]}
+ *
+ * Loaded once before any session is opened and only read afterwards, so
+ * lookups take no lock.
+ */
+class TunedConfig {
+public:
+    static TunedConfig &instance();
+
+    /**
+     * Replaces the current entries with the file's; false (entries
+     * unchanged) when it cannot be read or parsed.
+     */
+    bool load(const std::string &path, std::string &error);
+
+    bool save(const std::string &path, std::string &error) const;
+
+    /**
+     * Adds the statement, replacing an entry with the same fingerprint.
+     */
+    void put(const TunedStatement &statement);
+
+    /**
+     * nullptr when the statement was never tuned.
+     */
+    const TunedStatement *find(uint64_t fingerprint) const;
+
+    /**
+     * Largest statement cache any tuned statement asked for; the cache
+     * belongs to the session, not to one statement.
+     */
+    unsigned int stmtCacheSize() const;
+
+    size_t size() const { return statements.size(); }
+
+private:
+    std::vector<TunedStatement> statements;
+};
+
+/**
+ * Sets the statement's prefetch row count and memory where tuned.
+ */
+void applyTunedSettings(oracle::occi::Statement *stmt, const TunedSettings &settings);
@@ -0,0 +1,335 @@
+#include "workload_capture.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "logger.h"
+
+using namespace std;
+
+// 文件头, 最后一位是格式版本
+static const char MAGIC[8] = {'O', 'C', 'I', 'W', 'K', 'L', 'D', '1'};
+static const char TAG_SQL = 'T';
+static const char TAG_EXEC = 'E';
+static const size_t FLUSH_BYTES = 1 << 20;
+
+static void putVarint(string &out, uint64_t v) {
+    while (v >= 0x80) {
+        out += (char) (v | 0x80);
+        v >>= 7;
+    }
+    out += (char) v;
+}
+
+// zigzag: 小的负数也只占一两个字节
+static void putSigned(string &out, int64_t v) {
+    putVarint(out, ((uint64_t) v << 1) ^ (uint64_t) (v >> 63));
+}
+
+static void putFixed64(string &out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+        out += (char) (v >> (8 * i));
+    }
+}
+
+static void putBytes(string &out, const string &s) {
+    putVarint(out, s.size());
+    out += s;
+}
+
+WorkloadWriter::~WorkloadWriter() {
+    close();
+}
+
+bool WorkloadWriter::open(const string &path) {
+    out = fopen(path.c_str(), "wb");
+    if (nullptr == out) {
+        logError("open %s error.", path.c_str());
+        return false;
+    }
+    fwrite(MAGIC, 1, sizeof(MAGIC), out);
+    stopping = false;
+    flusher = thread(&WorkloadWriter::flushLoop, this);
+    if (!addStatementSink(this)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void WorkloadWriter::close() {
+    if (nullptr == out) {
+        return;
+    }
+    removeStatementSink(this);
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    flusher.join();
+    fclose(out);
+    out = nullptr;
+}
+
+void WorkloadWriter::onStatement(const StatementRecord &record) {
+    string exec;
+    exec += TAG_EXEC;
+    exec += (char) record.kind;
+    exec += (char) (record.failed ? 1 : 0);
+    putVarint(exec, record.durationNs);
+    putVarint(exec, record.rows);
+    putVarint(exec, record.session);
+    putVarint(exec, record.binds.size());
+    for (const auto &bind: record.binds) {
+        putVarint(exec, bind.index);
+        exec += (char) bind.type;
+        switch (bind.type) {
+            case BindType::INT:
+                putSigned(exec, bind.i);
+                break;
+            case BindType::DOUBLE: {
+                uint64_t bits;
+                memcpy(&bits, &bind.d, sizeof(bits));
+                putFixed64(exec, bits);
+                break;
+            }
+            case BindType::STRING:
+                putBytes(exec, bind.s);
+                break;
+            default:
+                break;
+        }
+    }
+
+    bool flush;
+    {
+        lock_guard<mutex> guard(lock);
+        auto it = sqlIds.find(record.sql);
+        if (it == sqlIds.end()) {
+            it = sqlIds.emplace(record.sql, (uint32_t) sqlIds.size()).first;
+            pending += TAG_SQL;
+            putVarint(pending, it->second);
+            putFixed64(pending, record.fingerprint);
+            putBytes(pending, record.sql);
+        }
+        // sql id 和起始时间差依赖写入顺序, 只能在锁内编码
+        pending += exec.substr(0, 3);
+        putVarint(pending, it->second);
+        putSigned(pending, (int64_t) (record.startNs - lastStartNs));
+        pending.append(exec, 3, string::npos);
+        lastStartNs = record.startNs;
+        ++count;
+        flush = pending.size() >= FLUSH_BYTES;
+    }
+    if (flush) {
+        wake.notify_one();
+    }
+}
+
+uint64_t WorkloadWriter::recorded() const {
+    lock_guard<mutex> guard(lock);
+    return count;
+}
+
+void WorkloadWriter::flushLoop() {
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        wake.wait_for(guard, chrono::milliseconds(100),
+                      [this] { return stopping || pending.size() >= FLUSH_BYTES; });
+        string chunk;
+        chunk.swap(pending);
+        bool last = stopping;
+        guard.unlock();
+        if (!chunk.empty()) {
+            fwrite(chunk.data(), 1, chunk.size(), out);
+            fflush(out);
+        }
+        guard.lock();
+        if (last && pending.empty()) {
+            return;
+        }
+    }
+}
+
+class WorkloadReader {
+public:
+    WorkloadReader(const string &data) : data(data), pos(0) {}
+
+    bool done() const { return pos >= data.size(); }
+
+    bool byte(uint8_t &v) {
+        if (pos >= data.size()) {
+            return false;
+        }
+        v = (uint8_t) data[pos++];
+        return true;
+    }
+
+    bool varint(uint64_t &v) {
+        v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b;
+            if (!byte(b)) {
+                return false;
+            }
+            v |= (uint64_t) (b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool signedVarint(int64_t &v) {
+        uint64_t u;
+        if (!varint(u)) {
+            return false;
+        }
+        v = (int64_t) (u >> 1) ^ -(int64_t) (u & 1);
+        return true;
+    }
+
+    bool fixed64(uint64_t &v) {
+        if (pos + 8 > data.size()) {
+            return false;
+        }
+        v = 0;
+        for (int i = 0; i < 8; ++i) {
+            v |= (uint64_t) (uint8_t) data[pos++] << (8 * i);
+        }
+        return true;
+    }
+
+    bool bytes(string &s) {
+        uint64_t n;
+        if (!varint(n) || n > data.size() - pos) {
+            return false;
+        }
+        s.assign(data, pos, (size_t) n);
+        pos += (size_t) n;
+        return true;
+    }
+
+    size_t offset() const { return pos; }
+
+private:
+    const string &data;
+    size_t pos;
+};
+
+static bool readExec(WorkloadReader &in, const vector<pair<uint64_t, string>> &sqls, uint64_t &startNs,
+                     StatementRecord &record) {
+    uint8_t kind;
+    uint8_t failed;
+    uint64_t id;
+    int64_t delta;
+    uint64_t session;
+    uint64_t bindCount;
+    if (!in.byte(kind) || !in.byte(failed) || !in.varint(id) || id >= sqls.size() || !in.signedVarint(delta) ||
+        !in.varint(record.durationNs) || !in.varint(record.rows) || !in.varint(session) || !in.varint(bindCount)) {
+        return false;
+    }
+    startNs += (uint64_t) delta;
+    record.kind = (StatementKind) kind;
+    record.failed = failed != 0;
+    record.fingerprint = sqls[id].first;
+    record.sql = sqls[id].second;
+    record.startNs = startNs;
+    record.session = (uint32_t) session;
+    for (uint64_t i = 0; i < bindCount; ++i) {
+        BindValue bind;
+        uint64_t index;
+        uint8_t type;
+        if (!in.varint(index) || !in.byte(type)) {
+            return false;
+        }
+        bind.index = (unsigned int) index;
+        bind.type = (BindType) type;
+        bool ok = true;
+        switch (bind.type) {
+            case BindType::NUL:
+                break;
+            case BindType::INT:
+                ok = in.signedVarint(bind.i);
+                break;
+            case BindType::DOUBLE: {
+                uint64_t bits;
+                ok = in.fixed64(bits);
+                memcpy(&bind.d, &bits, sizeof(bits));
+                break;
+            }
+            case BindType::STRING:
+                ok = in.bytes(bind.s);
+                break;
+            default:
+                ok = false;
+        }
+        if (!ok) {
+            return false;
+        }
+        record.binds.push_back(std::move(bind));
+    }
+    return true;
+}
+
+bool readWorkload(const string &path, vector<StatementRecord> &out, string &error) {
+    FILE *in = fopen(path.c_str(), "rb");
+    if (nullptr == in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    string data;
+    char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        data.append(buffer, n);
+    }
+    fclose(in);
+    if (data.size() < sizeof(MAGIC) || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        error = path + ": not a workload capture";
+        return false;
+    }
+
+    string body = data.substr(sizeof(MAGIC));
+    WorkloadReader reader(body);
+    vector<pair<uint64_t, string>> sqls;
+    uint64_t startNs = 0;
+    out.clear();
+    while (!reader.done()) {
+        size_t at = reader.offset();
+        uint8_t tag;
+        reader.byte(tag);
+        bool ok;
+        if (tag == TAG_SQL) {
+            uint64_t id;
+            uint64_t fp;
+            string sql;
+            ok = reader.varint(id) && reader.fixed64(fp) && reader.bytes(sql) && id == sqls.size();
+            if (ok) {
+                sqls.emplace_back(fp, std::move(sql));
+            }
+        } else if (tag == TAG_EXEC) {
+            StatementRecord record;
+            ok = readExec(reader, sqls, startNs, record);
+            if (ok) {
+                out.push_back(std::move(record));
+            }
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            // 进程被杀时最后一条可能只写了一半, 前面的记录仍然可用
+            if (out.empty()) {
+                error = path + ": corrupt record at offset " + to_string(at + sizeof(MAGIC));
+                return false;
+            }
+            logWarn("%s: truncated at offset %zu, %zu statements read.", path.c_str(), at + sizeof(MAGIC),
+                    out.size());
+            break;
+        }
+    }
+    stable_sort(out.begin(), out.end(),
+                [](const StatementRecord &a, const StatementRecord &b) { return a.startNs < b.startNs; });
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "statement_probe.h"
+
+/**
+ * Statement sink that appends every probed execution to a compact binary log
+ * (SQL text once per distinct statement, then per execution: kind, start
+ * delta, duration, rows, session and bind values, varint-encoded).
+ *
+ * Encoding happens on the executing thread into a shared buffer; a writer
+ * thread flushes it to disk every 100ms or once it passes 1 MiB.
+ *
+ * Bind values are stored verbatim so the log can be replayed; treat capture
+ * files like the data they came from.
+ */
+class WorkloadWriter : public StatementSink {
+public:
+    WorkloadWriter() = default;
+
+    ~WorkloadWriter() override;
+
+    WorkloadWriter(const WorkloadWriter &) = delete;
+
+    WorkloadWriter &operator=(const WorkloadWriter &) = delete;
+
+    /**
+     * Creates path and registers the writer as a statement sink.
+     */
+    bool open(const std::string &path);
+
+    /**
+     * Unregisters, flushes what is buffered and closes the file.
+     */
+    void close();
+
+    void onStatement(const StatementRecord &record) override;
+
+    uint64_t recorded() const;
+
+private:
+    void flushLoop();
+
+    FILE *out = nullptr;
+    mutable std::mutex lock;
+    std::condition_variable wake;
+    std::thread flusher;
+    bool stopping = false;
+    std::string pending;
+    std::map<std::string, uint32_t> sqlIds;
+    uint64_t lastStartNs = 0;
+    uint64_t count = 0;
+};
+
+/**
+ * Reads a log written by WorkloadWriter, ordered by start time.
+ */
+bool readWorkload(const std::string &path, std::vector<StatementRecord> &out, std::string &error);
@@ -0,0 +1,202 @@
+#include "workload_replay.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "logger.h"
+
+using namespace std;
+using namespace oracle::occi;
+
+static void bindValues(Statement *stmt, const vector<BindValue> &binds) {
+    for (const auto &bind: binds) {
+        switch (bind.type) {
+            case BindType::INT:
+                if (bind.i >= INT_MIN && bind.i <= INT_MAX) {
+                    stmt->setInt(bind.index, (int) bind.i);
+                } else {
+                    stmt->setDouble(bind.index, (double) bind.i);
+                }
+                break;
+            case BindType::DOUBLE:
+                stmt->setDouble(bind.index, bind.d);
+                break;
+            case BindType::STRING:
+                stmt->setString(bind.index, bind.s);
+                break;
+            default:
+                stmt->setNull(bind.index, OCCISTRING);
+                break;
+        }
+    }
+}
+
+/**
+ * Runs one captured statement, returns the rows it fetched or affected.
+ */
+static uint64_t replayOne(Connection *conn, const StatementRecord &record, const ReplayOptions &options) {
+    Statement *stmt = dbCall(DbOp::CREATE_STATEMENT, record.fingerprint,
+                             [&] { return conn->createStatement(record.sql); });
+    uint64_t rows = 0;
+    try {
+        bindValues(stmt, record.binds);
+        if (record.kind == StatementKind::QUERY) {
+            if (options.prefetch) {
+                stmt->setPrefetchRowCount(options.prefetch);
+            }
+            ResultSet *rs = dbCall(DbOp::EXECUTE_QUERY, record.fingerprint, [&] { return stmt->executeQuery(); });
+            while (dbCall(DbOp::NEXT, record.fingerprint, [&] { return rs->next(); })) {
+                ++rows;
+            }
+            stmt->closeResultSet(rs);
+        } else {
+            stmt->setAutoCommit(true);
+            rows = dbCall(DbOp::EXECUTE_UPDATE, record.fingerprint, [&] { return stmt->executeUpdate(); });
+        }
+    }
+    catch (const SQLException &e) {
+        dbCall(DbOp::TERMINATE_STATEMENT, record.fingerprint, [&] { conn->terminateStatement(stmt); });
+        throw;
+    }
+    dbCall(DbOp::TERMINATE_STATEMENT, record.fingerprint, [&] { conn->terminateStatement(stmt); });
+    return rows;
+}
+
+ReplayReport replayWorkload(SessionPool &pool, const vector<StatementRecord> &workload, const ReplayOptions &options) {
+    ReplayReport report;
+    for (const auto &record: workload) {
+        report.captured.record(record.durationNs);
+        report.capturedFailed += record.failed ? 1 : 0;
+    }
+    if (workload.empty()) {
+        return report;
+    }
+
+    // previous[i]: 同一采集会话中紧挨在 i 前面的语句, 回放时要等它先执行完
+    vector<int64_t> previous(workload.size(), -1);
+    if (options.sessionOrder) {
+        map<uint32_t, int64_t> last;
+        for (size_t i = 0; i < workload.size(); ++i) {
+            auto it = last.find(workload[i].session);
+            if (it != last.end()) {
+                previous[i] = it->second;
+            }
+            last[workload[i].session] = (int64_t) i;
+        }
+    }
+    unique_ptr<bool[]> finished(new bool[workload.size()]());
+    mutex finishedLock;
+    condition_variable finishedChanged;
+
+    atomic<size_t> next(0);
+    mutex lock;
+    string firstError;
+    uint64_t origin = workload.front().startNs;
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (unsigned int w = 0; w < std::max(1u, options.concurrency); ++w) {
+        workers.emplace_back([&] {
+            LatencyHistogram replayed;
+            LatencyHistogram lag;
+            uint64_t statements = 0;
+            uint64_t skipped = 0;
+            uint64_t errors = 0;
+            uint64_t rows = 0;
+            for (size_t i = next.fetch_add(1); i < workload.size(); i = next.fetch_add(1)) {
+                const StatementRecord &record = workload[i];
+                auto markFinished = [&] {
+                    lock_guard<mutex> guard(finishedLock);
+                    finished[i] = true;
+                    finishedChanged.notify_all();
+                };
+                if (!options.writes && record.kind != StatementKind::QUERY) {
+                    ++skipped;
+                    markFinished();
+                    continue;
+                }
+                auto scheduled = start;
+                if (options.speed > 0) {
+                    scheduled += chrono::nanoseconds((int64_t) ((double) (record.startNs - origin) / options.speed));
+                    this_thread::sleep_until(scheduled);
+                }
+                // 编号小的语句一定先被取走, 所以等前一条不会死锁
+                if (previous[i] >= 0) {
+                    unique_lock<mutex> guard(finishedLock);
+                    finishedChanged.wait(guard, [&] { return finished[previous[i]]; });
+                }
+                auto begin = chrono::steady_clock::now();
+                if (options.speed > 0) {
+                    lag.record((uint64_t) chrono::duration_cast<chrono::nanoseconds>(begin - scheduled).count());
+                }
+                Connection *conn = pool.checkout();
+                if (nullptr == conn) {
+                    ++errors;
+                    markFinished();
+                    continue;
+                }
+                try {
+                    rows += replayOne(conn, record, options);
+                }
+                catch (const SQLException &e) {
+                    ++errors;
+                    lock_guard<mutex> guard(lock);
+                    if (firstError.empty()) {
+                        firstError = e.getMessage();
+                    }
+                }
+                pool.release(conn);
+                markFinished();
+                replayed.record((uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+                        chrono::steady_clock::now() - begin).count());
+                ++statements;
+            }
+            lock_guard<mutex> guard(lock);
+            report.replayed.add(replayed);
+            report.lag.add(lag);
+            report.statements += statements;
+            report.skipped += skipped;
+            report.errors += errors;
+            report.rows += rows;
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (!firstError.empty()) {
+        logError("first replay error: %s", firstError.c_str());
+    }
+    return report;
+}
+
+string formatReplayReport(const ReplayReport &report) {
+    char line[256];
+    string out;
+    snprintf(line, sizeof(line),
+             "replayed %llu statements (%llu skipped, %llu errors, %llu failed when captured), %llu rows in %.3fs, "
+             "%.1f stmt/s\n",
+             (unsigned long long) report.statements, (unsigned long long) report.skipped,
+             (unsigned long long) report.errors, (unsigned long long) report.capturedFailed,
+             (unsigned long long) report.rows, report.seconds,
+             report.seconds > 0 ? (double) report.statements / report.seconds : 0);
+    out += line;
+    auto row = [&](const char *name, const LatencyHistogram &h) {
+        snprintf(line, sizeof(line), "%-10s p50 %10.1fus  p99 %10.1fus  max %10.1fus\n", name,
+                 h.quantile(0.50) / 1000.0, h.quantile(0.99) / 1000.0, h.max() / 1000.0);
+        out += line;
+    };
+    row("captured", report.captured);
+    row("replayed", report.replayed);
+    if (report.lag.count()) {
+        row("lag", report.lag);
+    }
+    return out;
+}
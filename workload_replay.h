@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "latency_histogram.h"
+#include "session_pool.h"
+#include "statement_probe.h"
+
+struct ReplayOptions {
+    // 1 = 原速, 2 = 两倍速, 0 = 不等待, 能跑多快跑多快
+    double speed = 1;
+    unsigned int concurrency = 4;
+    // 0 = 保持 OCCI 默认
+    unsigned int prefetch = 0;
+    // false 时跳过 INSERT/UPDATE/DELETE/DDL, 只回放查询
+    bool writes = true;
+    // 同一个采集会话里的语句按原顺序一条接一条执行 (先 CREATE 再 INSERT 再 SELECT)
+    bool sessionOrder = true;
+};
+
+struct ReplayReport {
+    uint64_t statements = 0;
+    uint64_t skipped = 0;
+    uint64_t errors = 0;
+    // 采集时就已经失败的语句, 回放时通常也会失败
+    uint64_t capturedFailed = 0;
+    uint64_t rows = 0;
+    double seconds = 0;
+    LatencyHistogram captured;
+    LatencyHistogram replayed;
+    // 实际开始时间比计划晚了多少, 说明回放端跟不上
+    LatencyHistogram lag;
+};
+
+/**
+ * Drives a captured workload against pool's endpoint.
+ *
+ * Statements are issued in captured start order, each at its captured
+ * offset divided by speed, by `concurrency` workers that check a session out
+ * of the pool per statement (as the program itself does). With sessionOrder a
+ * statement also waits for the previous one of its captured session to
+ * finish, so only statements of different sessions overlap. Captured
+ * sessions are not pinned to replay sessions, so DML runs with auto-commit on.
+ */
+ReplayReport replayWorkload(SessionPool &pool, const std::vector<StatementRecord> &workload,
+                            const ReplayOptions &options);
+
+/**
+ * Counts, throughput and captured vs replayed latency quantiles.
+ */
+std::string formatReplayReport(const ReplayReport &report);